@@ -0,0 +1,218 @@
+/**
+ * Benchmark of the two ways to draw billboards: points expanded by the geometry
+ * shader (billboards.vert + billboards.geom) and instanced quads expanded in the
+ * vertex shader (billboards_instanced.vert).
+ *
+ * It renders a million billboards with per-point attributes to an offscreen framebuffer
+ * with plain OpenGL (no window, no Qt3D), using the same shaders as the demo. Runs on
+ * the "offscreen" platform by default - set QT_QPA_PLATFORM to use another one (e.g. "xcb"
+ * with Xvfb). Each case prints its throughput in million billboards per second.
+ * Use "-csv" for machine-readable output.
+ */
+
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QOpenGLShaderProgram>
+#include <QRandomGenerator>
+
+#include "billboardgeometry.h"
+#include "offscreengl.h"
+
+
+class BenchBillboards : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void draw_data();
+    void draw();
+
+  private:
+    static const int WIDTH = 1600;
+    static const int HEIGHT = 800;
+    static const int COUNT = 1000000;
+
+    //! Sets up attributes of billboards in the vertex buffer for the \a program (advancing per instance if \a divisor is 1)
+    void setupBillboardAttributes( QOpenGLShaderProgram &program, GLuint divisor );
+
+    OffscreenGl mOffscreen;
+    QOpenGLFunctions_3_3_Core *mGl = nullptr;
+
+    QOpenGLShaderProgram mPointProgram;
+    QOpenGLShaderProgram mInstancedProgram;
+
+    GLuint mPointVao = 0, mInstancedVao = 0;
+    GLuint mBuffers[2] = { 0, 0 };
+    GLuint mTexture = 0;
+};
+
+
+void BenchBillboards::initTestCase()
+{
+    if ( !mOffscreen.create( WIDTH, HEIGHT ) )
+        QSKIP( mOffscreen.errorMessage() );
+    mGl = mOffscreen.functions();
+
+    QVERIFY( mPointProgram.addShaderFromSourceFile( QOpenGLShader::Vertex, ":/shaders/billboards.vert" ) );
+    QVERIFY( mPointProgram.addShaderFromSourceFile( QOpenGLShader::Geometry, ":/shaders/billboards.geom" ) );
+    QVERIFY( mPointProgram.addShaderFromSourceFile( QOpenGLShader::Fragment, ":/shaders/billboards.frag" ) );
+    QVERIFY( mPointProgram.link() );
+    QVERIFY( mInstancedProgram.addShaderFromSourceFile( QOpenGLShader::Vertex, ":/shaders/billboards_instanced.vert" ) );
+    QVERIFY( mInstancedProgram.addShaderFromSourceFile( QOpenGLShader::Fragment, ":/shaders/billboards.frag" ) );
+    QVERIFY( mInstancedProgram.link() );
+
+    // small icons scattered in front of the camera, with a few different sizes and tints
+    QRandomGenerator random( 1 );
+    QByteArray vertexData;
+    vertexData.resize( COUNT * BillboardGeometry::BILLBOARD_STRIDE );
+    for ( int i = 0; i < COUNT; ++i )
+    {
+        Billboard billboard;
+        billboard.position = QVector3D( random.bounded( 100. ) - 50, random.bounded( 10. ), random.bounded( 100. ) - 80 );
+        billboard.size = QSizeF( 8 + i % 4 * 4, 8 + i % 4 * 4 );
+        billboard.textureRect = QRectF( ( i % 8 ) / 8., 0, 1 / 8., 1 );
+        billboard.tint = qRgba( 255, 255 - i % 128, 255, 255 );
+        BillboardGeometry::writeBillboard( vertexData.data() + i * BillboardGeometry::BILLBOARD_STRIDE, billboard );
+    }
+
+    const float corners[BillboardGeometry::QUAD_VERTICES * 2] = { 0, 0, 1, 0, 0, 1, 1, 1 };
+
+    mGl->glGenBuffers( 2, mBuffers );
+    mGl->glBindBuffer( GL_ARRAY_BUFFER, mBuffers[0] );
+    mGl->glBufferData( GL_ARRAY_BUFFER, vertexData.size(), vertexData.constData(), GL_STATIC_DRAW );
+    mGl->glBindBuffer( GL_ARRAY_BUFFER, mBuffers[1] );
+    mGl->glBufferData( GL_ARRAY_BUFFER, sizeof( corners ), corners, GL_STATIC_DRAW );
+
+    // geometry shader: a point per billboard
+    mGl->glGenVertexArrays( 1, &mPointVao );
+    mGl->glBindVertexArray( mPointVao );
+    setupBillboardAttributes( mPointProgram, 0 );
+
+    // instanced: quad corners + billboards as instance data
+    mGl->glGenVertexArrays( 1, &mInstancedVao );
+    mGl->glBindVertexArray( mInstancedVao );
+    mGl->glBindBuffer( GL_ARRAY_BUFFER, mBuffers[1] );
+    const GLint cornerLocation = mInstancedProgram.attributeLocation( "vertexCorner" );
+    mGl->glEnableVertexAttribArray( cornerLocation );
+    mGl->glVertexAttribPointer( cornerLocation, 2, GL_FLOAT, GL_FALSE, 0, nullptr );
+    setupBillboardAttributes( mInstancedProgram, 1 );
+    mGl->glBindVertexArray( 0 );
+
+    // plain white texture - the fragment shader work is the same in both cases anyway
+    const QVector<quint32> pixels( 64 * 64, 0xffffffff );
+    mGl->glGenTextures( 1, &mTexture );
+    mGl->glBindTexture( GL_TEXTURE_2D, mTexture );
+    mGl->glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA8, 64, 64, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.constData() );
+    mGl->glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+    mGl->glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+
+    QMatrix4x4 projection, view;
+    projection.perspective( 45, float( WIDTH ) / HEIGHT, 0.1f, 1000 );
+    view.lookAt( QVector3D( 0, 10, 30 ), QVector3D( 0, 0, 0 ), QVector3D( 0, 1, 0 ) );
+    for ( QOpenGLShaderProgram *program : { &mPointProgram, &mInstancedProgram } )
+    {
+        program->bind();
+        program->setUniformValue( "modelViewProjection", projection * view );
+        program->setUniformValue( "WIN_SCALE", QSizeF( WIDTH, HEIGHT ) );
+        program->setUniformValue( "BB_SIZE", QSizeF( 16, 16 ) );
+        program->setUniformValue( "useVertexStyle", true );
+        program->setUniformValue( "tex0", 0 );
+    }
+
+    qInfo( "%d billboards", COUNT );
+}
+
+void BenchBillboards::setupBillboardAttributes( QOpenGLShaderProgram &program, GLuint divisor )
+{
+    // the same layout as BillboardGeometry::setBillboards(), integers are normalized
+    struct Attribute
+    {
+        const char *name;
+        GLint size;
+        GLenum type;
+        GLboolean normalized;
+        int offset;
+    };
+    const Attribute attributes[] =
+    {
+        { "vertexPosition", 3, GL_FLOAT, GL_FALSE, 0 },
+        { "billboardSize", 2, GL_FLOAT, GL_FALSE, 12 },
+        { "billboardTextureRect", 4, GL_UNSIGNED_SHORT, GL_TRUE, 20 },
+        { "billboardTint", 4, GL_UNSIGNED_BYTE, GL_TRUE, 28 },
+    };
+
+    mGl->glBindBuffer( GL_ARRAY_BUFFER, mBuffers[0] );
+    for ( const Attribute &attribute : attributes )
+    {
+        const GLint location = program.attributeLocation( attribute.name );
+        QVERIFY( location >= 0 );
+        mGl->glEnableVertexAttribArray( location );
+        mGl->glVertexAttribPointer( location, attribute.size, attribute.type, attribute.normalized,
+                                    BillboardGeometry::BILLBOARD_STRIDE, reinterpret_cast<void *>( attribute.offset ) );
+        mGl->glVertexAttribDivisor( location, divisor );
+    }
+}
+
+void BenchBillboards::cleanupTestCase()
+{
+    if ( !mGl )
+        return;
+
+    mGl->glDeleteVertexArrays( 1, &mPointVao );
+    mGl->glDeleteVertexArrays( 1, &mInstancedVao );
+    mGl->glDeleteBuffers( 2, mBuffers );
+    mGl->glDeleteTextures( 1, &mTexture );
+    mOffscreen.destroy();
+}
+
+
+void BenchBillboards::draw_data()
+{
+    QTest::addColumn<bool>( "instanced" );
+    QTest::newRow( "geometry shader" ) << false;
+    QTest::newRow( "instanced" ) << true;
+}
+
+void BenchBillboards::draw()
+{
+    QFETCH( bool, instanced );
+
+    QElapsedTimer timer;
+    qint64 elapsedNs = 0;
+    qint64 runs = 0;
+
+    mGl->glActiveTexture( GL_TEXTURE0 );
+    mGl->glBindTexture( GL_TEXTURE_2D, mTexture );
+
+    QBENCHMARK
+    {
+        timer.start();
+        mGl->glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+        if ( instanced )
+        {
+            mInstancedProgram.bind();
+            mGl->glBindVertexArray( mInstancedVao );
+            mGl->glDrawArraysInstanced( GL_TRIANGLE_STRIP, 0, BillboardGeometry::QUAD_VERTICES, COUNT );
+        }
+        else
+        {
+            mPointProgram.bind();
+            mGl->glBindVertexArray( mPointVao );
+            mGl->glDrawArrays( GL_POINTS, 0, COUNT );
+        }
+        mGl->glFinish();   // wait until the GPU is done
+        elapsedNs += timer.nsecsElapsed();
+        ++runs;
+    }
+
+    QCOMPARE( mGl->glGetError(), static_cast<GLenum>( GL_NO_ERROR ) );
+    qInfo( "%s: %.1f Mbillboards/s", QTest::currentDataTag(), double( COUNT ) * runs / ( elapsedNs / 1e9 ) / 1e6 );
+}
+
+
+OFFSCREEN_GL_MAIN( BenchBillboards )
+
+#include "benchbillboards.moc"
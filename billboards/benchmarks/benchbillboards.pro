@@ -0,0 +1,22 @@
+TEMPLATE = app
+TARGET = benchbillboards
+QT += testlib gui 3dcore 3drender
+CONFIG += console
+CONFIG -= app_bundle
+
+# headless benchmark of geometry shader vs instanced billboards (see benchbillboards.cpp)
+
+INCLUDEPATH += .. ../../common
+
+SOURCES += \
+    benchbillboards.cpp \
+    ../billboardgeometry.cpp \
+    ../../common/offscreengl.cpp \
+    ../../common/pointfile.cpp
+
+HEADERS += \
+    ../billboardgeometry.h \
+    ../../common/offscreengl.h \
+    ../../common/pointfile.h
+
+RESOURCES += ../shaders.qrc
@@ -0,0 +1,194 @@
+/**
+ * Benchmark and checks of BillboardDeclutter on the CPU (no OpenGL needed).
+ *
+ * A hundred thousand billboards of various sizes - some of them spanning several tiles - get
+ * decluttered for a sequence of camera positions at 1920x1080. "sequential" compares
+ * the visible billboards after each update with a plain greedy pass over the whole screen
+ * in priority order. "updateCamera" measures BillboardDeclutter::updateCamera() (projection,
+ * placement and the index buffer update) while the camera orbits in small or large steps,
+ * and prints the time per update with the number of visible billboards. The passes run on
+ * the global thread pool, i.e. on all cores - use e.g. taskset to measure with fewer.
+ * Use "-csv" for machine-readable output.
+ */
+
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "billboarddeclutter.h"
+
+
+class BenchDeclutter : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void initTestCase();
+
+    void sequential();
+
+    void updateCamera_data();
+    void updateCamera();
+
+  private:
+    static const int COUNT = 100000;
+
+    //! Returns indices of billboards visible after a single greedy pass over the whole screen (in ascending order)
+    QVector<quint32> sequentialDeclutter( const QMatrix4x4 &viewProjection ) const;
+
+    //! Returns view-projection matrix of the camera at \a step of the path over the scene
+    QMatrix4x4 camera( int step ) const;
+
+    const QSizeF mViewport = QSizeF( 1920, 1080 );
+    QVector<Billboard> mBillboards;
+    QVector<float> mPriorities;
+};
+
+
+void BenchDeclutter::initTestCase()
+{
+    // icons scattered over a terrain, a few of them big enough to cross tile boundaries
+    QRandomGenerator random( 1 );
+    for ( int i = 0; i < COUNT; ++i )
+    {
+        Billboard billboard;
+        billboard.position = QVector3D( random.bounded( 400. ) - 200, random.bounded( 2. ), random.bounded( 400. ) - 200 );
+        const double size = random.bounded( 100 ) == 0 ? 300 + random.bounded( 900. ) : 16 + random.bounded( 80. );
+        billboard.size = QSizeF( size, size * 0.75 );
+        mBillboards << billboard;
+        mPriorities << random.bounded( 16 );   // with ties - those go in the order of billboards
+    }
+
+    qInfo( "%d billboards, viewport %.0fx%.0f", COUNT, mViewport.width(), mViewport.height() );
+}
+
+QMatrix4x4 BenchDeclutter::camera( int step ) const
+{
+    // orbiting around the center, with steps small enough that most tiles keep their billboards
+    const float angle = step * 0.002f;
+    QMatrix4x4 projection, view;
+    projection.perspective( 45, float( mViewport.width() / mViewport.height() ), 0.1f, 2000 );
+    view.lookAt( QVector3D( 150 * std::sin( angle ), 60, 150 * std::cos( angle ) ), QVector3D( 0, 0, 0 ), QVector3D( 0, 1, 0 ) );
+    return projection * view;
+}
+
+QVector<quint32> BenchDeclutter::sequentialDeclutter( const QMatrix4x4 &viewProjection ) const
+{
+    const float width = mViewport.width(), height = mViewport.height();
+    const int cellSize = BillboardDeclutter::CELL_SIZE;
+    const int columns = static_cast<int>( std::ceil( width / cellSize ) );
+    const int rows = static_cast<int>( std::ceil( height / cellSize ) );
+    QVector<bool> grid( columns * rows, false );
+
+    QVector<int> order( COUNT );
+    std::iota( order.begin(), order.end(), 0 );
+    std::stable_sort( order.begin(), order.end(), [this]( int a, int b )
+    {
+        return mPriorities[a] > mPriorities[b];
+    } );
+
+    // the same projection to cells as BillboardDeclutter
+    const float *m = viewProjection.constData();
+    QVector<quint32> visible;
+    for ( int i : qAsConst( order ) )
+    {
+        const Billboard &billboard = mBillboards[i];
+        const float p[3] = { billboard.position.x(), billboard.position.y(), billboard.position.z() };
+        const float clipX = m[0] * p[0] + m[4] * p[1] + m[8] * p[2] + m[12];
+        const float clipY = m[1] * p[0] + m[5] * p[1] + m[9] * p[2] + m[13];
+        const float clipZ = m[2] * p[0] + m[6] * p[1] + m[10] * p[2] + m[14];
+        const float clipW = m[3] * p[0] + m[7] * p[1] + m[11] * p[2] + m[15];
+        const float centerX = ( clipX / clipW + 1 ) * 0.5f * width;
+        const float centerY = ( clipY / clipW + 1 ) * 0.5f * height;
+        const float halfWidth = static_cast<float>( billboard.size.width() ) / 4;
+        const float halfHeight = static_cast<float>( billboard.size.height() ) / 4;
+        if ( clipW <= 0 || clipZ < -clipW || clipZ > clipW ||
+             centerX + halfWidth < 0 || centerX - halfWidth >= width || centerY + halfHeight < 0 || centerY - halfHeight >= height )
+            continue;
+
+        const int x0 = std::max( 0, static_cast<int>( ( centerX - halfWidth ) / cellSize ) );
+        const int y0 = std::max( 0, static_cast<int>( ( centerY - halfHeight ) / cellSize ) );
+        const int x1 = std::min( columns - 1, static_cast<int>( ( centerX + halfWidth ) / cellSize ) );
+        const int y1 = std::min( rows - 1, static_cast<int>( ( centerY + halfHeight ) / cellSize ) );
+
+        bool free = true;
+        for ( int y = y0; y <= y1 && free; ++y )
+        {
+            for ( int x = x0; x <= x1 && free; ++x )
+                free = !grid[y * columns + x];
+        }
+        if ( !free )
+            continue;
+
+        for ( int y = y0; y <= y1; ++y )
+            std::fill( grid.begin() + y * columns + x0, grid.begin() + y * columns + x1 + 1, true );
+        visible.append( i );
+    }
+
+    std::sort( visible.begin(), visible.end() );
+    return visible;
+}
+
+
+void BenchDeclutter::sequential()
+{
+    BillboardGeometry geometry;
+    BillboardDeclutter declutter;
+    declutter.setBillboards( mBillboards, mPriorities, &geometry );
+
+    // forth and back, so that tiles get results from earlier updates reused
+    for ( int step : { 0, 1, 2, 50, 2, 1, 0, 200 } )
+    {
+        const QMatrix4x4 viewProjection = camera( step );
+        declutter.updateCamera( viewProjection, mViewport );
+        const QVector<quint32> expected = sequentialDeclutter( viewProjection );
+        QVERIFY( !expected.isEmpty() );
+        QCOMPARE( declutter.visibleIndices(), expected );
+    }
+}
+
+void BenchDeclutter::updateCamera_data()
+{
+    // steps of the camera path between updates (see camera())
+    QTest::addColumn<int>( "step" );
+    QTest::newRow( "small moves" ) << 1;
+    QTest::newRow( "large moves" ) << 50;
+}
+
+void BenchDeclutter::updateCamera()
+{
+    QFETCH( int, step );
+
+    BillboardGeometry geometry;
+    BillboardDeclutter declutter;
+    declutter.setBillboards( mBillboards, mPriorities, &geometry );
+    declutter.updateCamera( camera( 0 ), mViewport );
+
+    QElapsedTimer timer;
+    qint64 elapsedNs = 0;
+    qint64 runs = 0;
+    int position = 0;
+
+    QBENCHMARK
+    {
+        // the matrix is the application's work, not measured
+        position += step;
+        const QMatrix4x4 viewProjection = camera( position );
+
+        timer.start();
+        declutter.updateCamera( viewProjection, mViewport );
+        elapsedNs += timer.nsecsElapsed();
+        ++runs;
+    }
+
+    qInfo( "%s: %.2f ms per update, %d visible", QTest::currentDataTag(), elapsedNs / 1e6 / runs, declutter.visibleCount() );
+}
+
+
+QTEST_GUILESS_MAIN( BenchDeclutter )
+
+#include "benchdeclutter.moc"
@@ -0,0 +1,20 @@
+TEMPLATE = app
+TARGET = benchdeclutter
+QT += testlib concurrent 3dcore 3drender
+CONFIG += console
+CONFIG -= app_bundle
+
+# headless checks of billboard decluttering (see benchdeclutter.cpp)
+
+INCLUDEPATH += .. ../../common
+
+SOURCES += \
+    benchdeclutter.cpp \
+    ../billboarddeclutter.cpp \
+    ../billboardgeometry.cpp \
+    ../../common/pointfile.cpp
+
+HEADERS += \
+    ../billboarddeclutter.h \
+    ../billboardgeometry.h \
+    ../../common/pointfile.h
@@ -0,0 +1,210 @@
+#include "billboardatlas.h"
+
+#include <QPainter>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+
+namespace
+{
+
+  //! Returns the smallest power of two that is not less than \a value
+  int nextPowerOfTwo( int value )
+  {
+    int result = 1;
+    while ( result < value )
+      result *= 2;
+    return result;
+  }
+
+  /**
+   * Skyline of the packed area: horizontal segments forming the outline of the top edges
+   * of placed rectangles (y is going down, so "top" is the largest y).
+   */
+  class Skyline
+  {
+    public:
+      explicit Skyline( int width )
+        : mWidth( width )
+      {
+        mSegments.append( { 0, 0, width } );
+      }
+
+      //! Places a rectangle of the given \a size at the lowest possible position, returns false if it is too wide
+      bool insert( const QSize &size, QPoint &position )
+      {
+        int bestIndex = -1, bestBottom = 0, bestY = 0;
+        for ( int i = 0; i < mSegments.count(); ++i )
+        {
+          int y;
+          if ( !fits( i, size.width(), y ) )
+            continue;
+          if ( bestIndex == -1 || y + size.height() < bestBottom )
+          {
+            bestIndex = i;
+            bestBottom = y + size.height();
+            bestY = y;
+          }
+        }
+        if ( bestIndex == -1 )
+          return false;
+
+        position = QPoint( mSegments[bestIndex].x, bestY );
+        addSegment( bestIndex, { position.x(), bestBottom, size.width() } );
+        return true;
+      }
+
+      //! Returns the height of the packed area
+      int height() const
+      {
+        int height = 0;
+        for ( const Segment &segment : mSegments )
+          height = std::max( height, segment.y );
+        return height;
+      }
+
+    private:
+      struct Segment
+      {
+        int x, y, width;
+      };
+
+      //! Checks whether a rectangle of the given \a width fits at the start of segment \a index, sets \a y to its position
+      bool fits( int index, int width, int &y ) const
+      {
+        if ( mSegments[index].x + width > mWidth )
+          return false;
+
+        y = 0;
+        int remaining = width;
+        for ( int i = index; remaining > 0; ++i )
+        {
+          y = std::max( y, mSegments[i].y );
+          remaining -= mSegments[i].width;
+        }
+        return true;
+      }
+
+      //! Inserts \a segment at \a index, shrinking the segments it covers and merging segments at the same height
+      void addSegment( int index, const Segment &segment )
+      {
+        mSegments.insert( index, segment );
+        const int end = segment.x + segment.width;
+        for ( int i = index + 1; i < mSegments.count(); )
+        {
+          if ( mSegments[i].x >= end )
+            break;
+          const int shrink = end - mSegments[i].x;
+          mSegments[i].x += shrink;
+          mSegments[i].width -= shrink;
+          if ( mSegments[i].width > 0 )
+            break;
+          mSegments.remove( i );
+        }
+        for ( int i = 0; i + 1 < mSegments.count(); )
+        {
+          if ( mSegments[i].y == mSegments[i + 1].y )
+          {
+            mSegments[i].width += mSegments[i + 1].width;
+            mSegments.remove( i + 1 );
+          }
+          else
+            ++i;
+        }
+      }
+
+      int mWidth;
+      QVector<Segment> mSegments;
+  };
+
+}
+
+
+BillboardAtlas::BillboardAtlas( Qt3DCore::QNode *parent )
+  : Qt3DRender::QPaintedTextureImage( parent )
+{
+}
+
+bool BillboardAtlas::setImages( const QVector<QImage> &images, int maxWidth, int padding )
+{
+  QVector<QSize> sizes;
+  sizes.reserve( images.count() );
+  int widest = 0;
+  qint64 area = 0;
+  for ( const QImage &image : images )
+  {
+    const QSize size = image.size() + QSize( 2 * padding, 2 * padding );
+    sizes.append( size );
+    widest = std::max( widest, size.width() );
+    area += static_cast<qint64>( size.width() ) * size.height();
+  }
+  if ( widest > maxWidth )
+    return false;
+
+  // roughly square atlas if possible
+  const int width = std::min( maxWidth, nextPowerOfTwo( std::max( widest, static_cast<int>( std::ceil( std::sqrt( area ) ) ) ) ) );
+  int height = 0;
+  const QVector<QRect> rects = pack( sizes, width, height );
+
+  mAtlas = QImage( width, nextPowerOfTwo( std::max( height, 1 ) ), QImage::Format_ARGB32_Premultiplied );
+  mAtlas.fill( Qt::transparent );
+  mRects.clear();
+  mRects.reserve( images.count() );
+  QPainter painter( &mAtlas );
+  painter.setCompositionMode( QPainter::CompositionMode_Source );
+  for ( int i = 0; i < images.count(); ++i )
+  {
+    const QRect rect( rects[i].topLeft() + QPoint( padding, padding ), images[i].size() );
+    painter.drawImage( rect.topLeft(), images[i] );
+    mRects.append( rect );
+  }
+  painter.end();
+
+  setSize( mAtlas.size() );
+  update();
+  return true;
+}
+
+QRectF BillboardAtlas::textureRect( int index ) const
+{
+  // the atlas gets uploaded upside down (see paint()), so t = 0 is at the bottom of the atlas
+  const QRect &rect = mRects.at( index );
+  const qreal width = mAtlas.width(), height = mAtlas.height();
+  return QRectF( rect.x() / width, ( height - rect.y() - rect.height() ) / height, rect.width() / width, rect.height() / height );
+}
+
+QVector<QRect> BillboardAtlas::pack( const QVector<QSize> &sizes, int width, int &height )
+{
+  // tallest (then widest) first
+  QVector<int> order( sizes.count() );
+  std::iota( order.begin(), order.end(), 0 );
+  std::sort( order.begin(), order.end(), [&sizes]( int a, int b )
+  {
+    if ( sizes[a].height() != sizes[b].height() )
+      return sizes[a].height() > sizes[b].height();
+    return sizes[a].width() > sizes[b].width();
+  } );
+
+  Skyline skyline( width );
+  QVector<QRect> rects( sizes.count() );
+  for ( int i : order )
+  {
+    QPoint position;
+    if ( !skyline.insert( sizes[i], position ) )
+      return QVector<QRect>();
+    rects[i] = QRect( position, sizes[i] );
+  }
+  height = skyline.height();
+  return rects;
+}
+
+void BillboardAtlas::paint( QPainter *painter )
+{
+  // texture data from QPaintedTextureImage are uploaded as they are - the first row ends up
+  // at t = 0 - so the atlas is painted upside down to have images upright on billboards
+  // (the same as TextureImage does with its "mirrored" property)
+  painter->setCompositionMode( QPainter::CompositionMode_Source );
+  painter->drawImage( 0, 0, mAtlas.mirrored() );
+}
@@ -0,0 +1,64 @@
+#ifndef BILLBOARDATLAS_H
+#define BILLBOARDATLAS_H
+
+#include <Qt3DRender/QPaintedTextureImage>
+
+#include <QImage>
+#include <QRect>
+#include <QRectF>
+#include <QVector>
+
+
+/**
+ * Texture atlas combining many icons into a single texture image, so that billboards
+ * with different icons can be drawn with one material and a single draw call.
+ *
+ * Images are packed with a skyline bottom-left packer (the tallest images go first):
+ * the atlas keeps the outline of the top edges of already placed images and puts each
+ * new image at the lowest position where it fits. Images get a padding of transparent
+ * pixels to avoid bleeding of neighbors with linear filtering.
+ *
+ * It can be used directly as a texture image of a Texture2D in QML.
+ */
+class BillboardAtlas : public Qt3DRender::QPaintedTextureImage
+{
+  Q_OBJECT
+
+public:
+  BillboardAtlas( Qt3DCore::QNode *parent = nullptr );
+
+  /**
+   * Packs the \a images into the atlas (replacing any previous content). The atlas is at most
+   * \a maxWidth pixels wide and as tall as needed (both sizes are powers of two).
+   * Returns false if some image is wider than the atlas.
+   */
+  bool setImages( const QVector<QImage> &images, int maxWidth = 2048, int padding = 1 );
+
+  //! Returns number of images in the atlas
+  int imageCount() const { return mRects.count(); }
+
+  //! Returns rectangle of the image with the given \a index in the atlas (in pixels, y going down)
+  QRect imageRect( int index ) const { return mRects.at( index ); }
+
+  //! Returns rectangle of the image with the given \a index in normalized texture coordinates (as used by billboards)
+  QRectF textureRect( int index ) const;
+
+  //! Returns the atlas as an image
+  QImage atlasImage() const { return mAtlas; }
+
+  /**
+   * Packs rectangles of the given \a sizes into an area \a width pixels wide and returns
+   * their positions (in the same order), or an empty array if some of them does not fit.
+   * \a height is set to the height of the used area.
+   */
+  static QVector<QRect> pack( const QVector<QSize> &sizes, int width, int &height );
+
+protected:
+  void paint( QPainter *painter ) override;
+
+private:
+  QImage mAtlas;
+  QVector<QRect> mRects;
+};
+
+#endif // BILLBOARDATLAS_H
@@ -0,0 +1,264 @@
+#include "billboarddeclutter.h"
+
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+// billboards projected by a single task when running in parallel
+static const int CHUNK_SIZE = 8192;
+
+
+namespace
+{
+
+  //! Mixes \a value into the hash \a h (FNV-1a style, over 64-bit values)
+  inline quint64 hashCombine( quint64 h, quint64 value )
+  {
+    h ^= value;
+    return h * 1099511628211ULL;
+  }
+
+  //! Returns mask with bits from \a lo to \a hi (inclusive, both within 0-63)
+  inline quint64 bitRange( int lo, int hi )
+  {
+    return ( ~0ULL >> ( 63 - ( hi - lo ) ) ) << lo;
+  }
+
+}
+
+
+BillboardDeclutter::BillboardDeclutter( QObject *parent )
+  : QObject( parent )
+{
+}
+
+void BillboardDeclutter::setBillboards( const QVector<Billboard> &billboards, const QVector<float> &priorities, BillboardGeometry *geometry )
+{
+  Q_ASSERT( priorities.count() == billboards.count() );
+
+  mGeometry = geometry;
+  mGeometry->setBillboards( billboards );
+
+  const int count = billboards.count();
+  mSlotIds.resize( count );
+  std::iota( mSlotIds.begin(), mSlotIds.end(), 0 );
+  std::stable_sort( mSlotIds.begin(), mSlotIds.end(), [&priorities]( int a, int b )
+  {
+    return priorities[a] > priorities[b];
+  } );
+
+  mPositions.resize( count * 3 );
+  mHalfSizes.resize( count * 2 );
+  for ( int slot = 0; slot < count; ++slot )
+  {
+    const Billboard &billboard = billboards[mSlotIds[slot]];
+    mPositions[slot * 3] = billboard.position.x();
+    mPositions[slot * 3 + 1] = billboard.position.y();
+    mPositions[slot * 3 + 2] = billboard.position.z();
+    // the same as billboards.geom: the quad is size / WIN_SCALE in normalized device coordinates,
+    // i.e. half of the size in pixels
+    mHalfSizes[slot * 2] = static_cast<float>( billboard.size.width() ) / 4;
+    mHalfSizes[slot * 2 + 1] = static_cast<float>( billboard.size.height() ) / 4;
+  }
+
+  mCellRects.resize( count );
+  mVisible.fill( 0, count );
+  mVisibleIndices.clear();
+  mTileSignatures.fill( 0 );
+  mViewport = QSizeF();   // force update
+  mGeometry->setDrawIndices( mVisibleIndices );
+  emit visibleCountChanged( 0 );
+}
+
+void BillboardDeclutter::updateCamera( const QMatrix4x4 &viewProjection, const QSizeF &viewport )
+{
+  if ( !mGeometry || viewport.isEmpty() || ( viewProjection == mViewProjection && viewport == mViewport ) )
+    return;
+
+  if ( viewport != mViewport )
+  {
+    const int columns = static_cast<int>( std::ceil( viewport.width() / CELL_SIZE ) );
+    mRows = static_cast<int>( std::ceil( viewport.height() / CELL_SIZE ) );
+    mTilesX = ( columns + 63 ) / 64;
+    mTilesY = ( mRows + 63 ) / 64;
+    mTileSignatures.fill( 0, mTilesX * mTilesY );   // no previous results
+  }
+  mViewProjection = viewProjection;
+  mViewport = viewport;
+  mGrid.fill( 0, mRows * mTilesX );
+
+  // 1. project billboards to cell rectangles
+  const float *m = mViewProjection.constData();
+  const float width = viewport.width(), height = viewport.height();
+  const int count = mSlotIds.count();
+  if ( count <= CHUNK_SIZE )
+  {
+    projectRange( 0, count, m, width, height );
+  }
+  else
+  {
+    QVector<int> chunks;
+    for ( int begin = 0; begin < count; begin += CHUNK_SIZE )
+      chunks.append( begin );
+
+    QtConcurrent::blockingMap( chunks, [this, m, width, height, count]( int begin )
+    {
+      projectRange( begin, std::min( begin + CHUNK_SIZE, count ), m, width, height );
+    } );
+  }
+
+  // 2. tiles joined by billboards crossing their boundaries form groups (union-find, rooted at the first tile),
+  // each group gets processed as a whole so that the priority order holds across tile boundaries
+  const int tileCount = mTilesX * mTilesY;
+  QVector<int> tileGroups( tileCount );
+  std::iota( tileGroups.begin(), tileGroups.end(), 0 );
+  const auto findGroup = [&tileGroups]( int tile )
+  {
+    while ( tileGroups[tile] != tile )
+      tile = tileGroups[tile] = tileGroups[tileGroups[tile]];
+    return tile;
+  };
+  for ( int slot = 0; slot < count; ++slot )
+  {
+    const CellRect &r = mCellRects[slot];
+    if ( r.x0 < 0 || ( r.x0 / 64 == r.x1 / 64 && r.y0 / 64 == r.y1 / 64 ) )
+      continue;
+    int first = findGroup( r.y0 / 64 * mTilesX + r.x0 / 64 );
+    for ( int tileY = r.y0 / 64; tileY <= r.y1 / 64; ++tileY )
+    {
+      for ( int tileX = r.x0 / 64; tileX <= r.x1 / 64; ++tileX )
+      {
+        const int group = findGroup( tileY * mTilesX + tileX );
+        if ( group != first )
+        {
+          tileGroups[std::max( group, first )] = std::min( group, first );
+          first = std::min( group, first );
+        }
+      }
+    }
+  }
+
+  // 3. sort billboards (in priority order) into groups
+  QVector<QVector<int>> groupSlots( tileCount );
+  for ( int slot = 0; slot < count; ++slot )
+  {
+    const CellRect &r = mCellRects[slot];
+    if ( r.x0 >= 0 )
+      groupSlots[findGroup( r.y0 / 64 * mTilesX + r.x0 / 64 )].append( slot );
+  }
+  QVector<int> groups;
+  for ( int tile = 0; tile < tileCount; ++tile )
+  {
+    if ( findGroup( tile ) == tile )
+      groups.append( tile );
+    else
+      mTileSignatures[tile] = 0;   // results of other tiles of a group are kept at its first tile
+  }
+
+  // 4. groups in parallel (they cover different grid words), skipping the ones with the same input as last time
+  QtConcurrent::blockingMap( groups, [this, &groupSlots]( int group )
+  {
+    const QVector<int> &slotIndices = groupSlots[group];
+
+    // the grid starts empty, so billboards of the group and their cell rectangles decide the result
+    quint64 signature = 14695981039346656037ULL;
+    for ( int slot : slotIndices )
+    {
+      const CellRect &r = mCellRects[slot];
+      signature = hashCombine( signature, static_cast<quint64>( slot ) );
+      signature = hashCombine( signature, static_cast<quint64>( quint16( r.x0 ) ) << 48 | static_cast<quint64>( quint16( r.y0 ) ) << 32 |
+                               static_cast<quint64>( quint16( r.x1 ) ) << 16 | quint16( r.y1 ) );
+    }
+    signature |= 1;   // zero means no signature
+
+    if ( signature == mTileSignatures[group] )
+      return;   // visibility of these billboards is the same as last time
+    mTileSignatures[group] = signature;
+    placeBillboards( slotIndices );
+  } );
+
+  // 5. draw only the visible billboards (upload only if something changed)
+  QVector<quint32> visibleIndices;
+  visibleIndices.reserve( mVisibleIndices.count() );
+  for ( int slot = 0; slot < count; ++slot )
+  {
+    if ( mVisible[slot] )
+      visibleIndices.append( mSlotIds[slot] );
+  }
+  std::sort( visibleIndices.begin(), visibleIndices.end() );
+  if ( visibleIndices != mVisibleIndices )
+  {
+    mVisibleIndices = std::move( visibleIndices );
+    mGeometry->setDrawIndices( mVisibleIndices );
+    emit visibleCountChanged( mVisibleIndices.count() );
+  }
+}
+
+void BillboardDeclutter::projectRange( int begin, int end, const float *m, float width, float height )
+{
+  const int maxColumn = static_cast<int>( std::ceil( width / CELL_SIZE ) ) - 1;
+  const int maxRow = static_cast<int>( std::ceil( height / CELL_SIZE ) ) - 1;
+  const float *positions = mPositions.constData();
+  const float *halfSizes = mHalfSizes.constData();
+  CellRect *rects = mCellRects.data();
+  quint8 *visible = mVisible.data();
+  for ( int slot = begin; slot < end; ++slot )
+  {
+    const float *p = positions + slot * 3;
+    const float clipX = m[0] * p[0] + m[4] * p[1] + m[8] * p[2] + m[12];
+    const float clipY = m[1] * p[0] + m[5] * p[1] + m[9] * p[2] + m[13];
+    const float clipZ = m[2] * p[0] + m[6] * p[1] + m[10] * p[2] + m[14];
+    const float clipW = m[3] * p[0] + m[7] * p[1] + m[11] * p[2] + m[15];
+
+    const float centerX = ( clipX / clipW + 1 ) * 0.5f * width;
+    const float centerY = ( clipY / clipW + 1 ) * 0.5f * height;
+    const float halfWidth = halfSizes[slot * 2];
+    const float halfHeight = halfSizes[slot * 2 + 1];
+
+    CellRect &r = rects[slot];
+    if ( clipW <= 0 || clipZ < -clipW || clipZ > clipW ||
+         centerX + halfWidth < 0 || centerX - halfWidth >= width || centerY + halfHeight < 0 || centerY - halfHeight >= height )
+    {
+      // visibility of billboards on the screen is kept until their tile gets processed
+      r.x0 = -1;
+      visible[slot] = 0;
+      continue;
+    }
+
+    r.x0 = static_cast<qint16>( std::max( 0, static_cast<int>( ( centerX - halfWidth ) / CELL_SIZE ) ) );
+    r.y0 = static_cast<qint16>( std::max( 0, static_cast<int>( ( centerY - halfHeight ) / CELL_SIZE ) ) );
+    r.x1 = static_cast<qint16>( std::min( maxColumn, static_cast<int>( ( centerX + halfWidth ) / CELL_SIZE ) ) );
+    r.y1 = static_cast<qint16>( std::min( maxRow, static_cast<int>( ( centerY + halfHeight ) / CELL_SIZE ) ) );
+  }
+}
+
+void BillboardDeclutter::placeBillboards( const QVector<int> &slotIndices )
+{
+  for ( int slot : slotIndices )
+    mVisible[slot] = place( mCellRects[slot] );
+}
+
+bool BillboardDeclutter::place( const CellRect &r )
+{
+  const int firstWord = r.x0 / 64, lastWord = r.x1 / 64;
+  for ( int row = r.y0; row <= r.y1; ++row )
+  {
+    const quint64 *words = mGrid.constData() + row * mTilesX;
+    for ( int word = firstWord; word <= lastWord; ++word )
+    {
+      const quint64 mask = bitRange( std::max<int>( r.x0, word * 64 ) - word * 64, std::min<int>( r.x1, word * 64 + 63 ) - word * 64 );
+      if ( words[word] & mask )
+        return false;
+    }
+  }
+
+  for ( int row = r.y0; row <= r.y1; ++row )
+  {
+    quint64 *words = mGrid.data() + row * mTilesX;
+    for ( int word = firstWord; word <= lastWord; ++word )
+      words[word] |= bitRange( std::max<int>( r.x0, word * 64 ) - word * 64, std::min<int>( r.x1, word * 64 + 63 ) - word * 64 );
+  }
+  return true;
+}
@@ -0,0 +1,95 @@
+#ifndef BILLBOARDDECLUTTER_H
+#define BILLBOARDDECLUTTER_H
+
+#include <QMatrix4x4>
+#include <QObject>
+#include <QPointer>
+#include <QSizeF>
+#include <QVector>
+
+#include "billboardgeometry.h"
+
+
+/**
+ * Hides billboards that would overlap other billboards with a higher priority.
+ *
+ * On each camera update, points get projected with the view-projection matrix (in parallel)
+ * and their screen rectangles are placed greedily in the order of priority into an occupancy
+ * grid - a bit per cell of CELL_SIZE pixels, so a rectangle is tested and marked with a few
+ * bit masks per row. Only billboards that got placed are drawn: the geometry gets an index
+ * buffer with the visible points, uploaded only when the visible set changes.
+ *
+ * The screen is split into tiles of TILE_SIZE pixels that are processed in parallel. Tiles
+ * joined by billboards crossing their boundaries are processed together as one group, so
+ * the result is the same as of a single greedy pass over the whole screen. A group whose
+ * billboards and cell rectangles are the same as in the previous update keeps the previous
+ * result without being processed again.
+ */
+class BillboardDeclutter : public QObject
+{
+  Q_OBJECT
+
+  Q_PROPERTY(int visibleCount READ visibleCount NOTIFY visibleCountChanged)
+
+public:
+  //! Size of a cell of the occupancy grid in pixels
+  static const int CELL_SIZE = 8;
+  //! Size of a tile processed by one task in pixels (64 cells - one 64-bit word per row)
+  static const int TILE_SIZE = 64 * CELL_SIZE;
+
+  BillboardDeclutter( QObject *parent = nullptr );
+
+  /**
+   * Sets \a billboards to be decluttered (also setting them to the \a geometry) with their
+   * \a priorities (higher priority wins, the same priority goes in the order of billboards).
+   */
+  void setBillboards( const QVector<Billboard> &billboards, const QVector<float> &priorities, BillboardGeometry *geometry );
+
+  //! Returns number of billboards visible after the last update
+  int visibleCount() const { return mVisibleIndices.count(); }
+
+  //! Returns indices of billboards visible after the last update (in ascending order)
+  QVector<quint32> visibleIndices() const { return mVisibleIndices; }
+
+  //! Updates visibility of billboards for the given projection * view matrix and \a viewport size in pixels
+  Q_INVOKABLE void updateCamera( const QMatrix4x4 &viewProjection, const QSizeF &viewport );
+
+signals:
+  void visibleCountChanged( int count );
+
+private:
+  //! Rectangle of a billboard in cells of the occupancy grid (inclusive), x0 < 0 if not on the screen
+  struct CellRect
+  {
+    qint16 x0, y0, x1, y1;
+  };
+
+  //! Projects billboards from \a begin to \a end (in priority order) to cell rectangles
+  void projectRange( int begin, int end, const float *m, float width, float height );
+
+  //! Places billboards \a slotIndices (in priority order) to the grid and sets their visibility
+  void placeBillboards( const QVector<int> &slotIndices );
+
+  //! Tries to place a billboard with cell rectangle \a r to the grid
+  bool place( const CellRect &r );
+
+  QPointer<BillboardGeometry> mGeometry;
+
+  // billboards are stored sorted by priority (in "slots"), so that all passes go through memory sequentially
+  QVector<int> mSlotIds;            //!< Index of billboard in each slot
+  QVector<float> mPositions;        //!< [x, y, z] of each slot
+  QVector<float> mHalfSizes;        //!< Half of the [width, height] in pixels on the screen of each slot
+
+  QMatrix4x4 mViewProjection;
+  QSizeF mViewport;
+  QVector<CellRect> mCellRects;     //!< Cell rectangles of slots from the last update
+  QVector<quint8> mVisible;         //!< Visibility of slots from the last update
+
+  int mTilesX = 0, mTilesY = 0, mRows = 0;
+  QVector<quint64> mGrid;           //!< Occupancy bits: mRows rows of mTilesX words
+  QVector<quint64> mTileSignatures; //!< Hashes of inputs of tile groups (at their first tile) from the last update
+
+  QVector<quint32> mVisibleIndices;
+};
+
+#endif // BILLBOARDDECLUTTER_H
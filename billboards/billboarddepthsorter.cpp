@@ -0,0 +1,237 @@
+#include "billboarddepthsorter.h"
+
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+// bits of radix sort digits (and the number of buckets)
+static const int RADIX_BITS = 8;
+static const int RADIX_BUCKETS = 1 << RADIX_BITS;
+
+
+BillboardDepthSorter::BillboardDepthSorter( QObject *parent )
+  : QObject( parent )
+{
+  connect( &mWatcher, &QFutureWatcher<Result>::finished, this, &BillboardDepthSorter::updateFinished );
+}
+
+BillboardDepthSorter::~BillboardDepthSorter()
+{
+  mWatcher.waitForFinished();
+}
+
+void BillboardDepthSorter::setPoints( const QVector<QVector3D> &points, BillboardGeometry *geometry )
+{
+  geometry->setPoints( points );
+  setPositions( points, geometry );
+}
+
+void BillboardDepthSorter::setBillboards( const QVector<Billboard> &billboards, BillboardGeometry *geometry )
+{
+  geometry->setBillboards( billboards );
+
+  QVector<QVector3D> positions;
+  positions.reserve( billboards.count() );
+  for ( const Billboard &billboard : billboards )
+    positions.append( billboard.position );
+  setPositions( positions, geometry );
+}
+
+void BillboardDepthSorter::setPositions( const QVector<QVector3D> &positions, BillboardGeometry *geometry )
+{
+  if ( mGeometry != geometry )
+  {
+    if ( mGeometry )
+      disconnect( mGeometry, nullptr, this, nullptr );
+    connect( geometry, &BillboardGeometry::instancedChanged, this, &BillboardDepthSorter::geometryInstancedChanged );
+  }
+  mGeometry = geometry;
+
+  // a new state - a running update of the previous one gets discarded
+  QSharedPointer<SortState> state( new SortState );
+  const int count = positions.count();
+  state->positions.resize( count * 3 );
+  for ( int i = 0; i < count; ++i )
+  {
+    state->positions[i * 3] = positions[i].x();
+    state->positions[i * 3 + 1] = positions[i].y();
+    state->positions[i * 3 + 2] = positions[i].z();
+  }
+
+  state->order.resize( count );
+  std::iota( state->order.begin(), state->order.end(), 0 );
+  state->keys.resize( count );
+  state->depths.resize( count );
+  state->tempOrder.resize( count );
+  state->tempKeys.resize( count );
+  mState = state;
+
+  mOrder = state->order;
+  mIncremental = false;
+  mSortedDepthRow = QVector4D();   // force update
+  if ( !mGeometry->isInstanced() )
+    mGeometry->setDrawIndices( mOrder );
+  if ( mDepthRow != QVector4D() && !mWatcher.isRunning() )
+    startUpdate();
+}
+
+void BillboardDepthSorter::updateCamera( const QMatrix4x4 &viewProjection )
+{
+  // clip space z is an affine function of the view space depth (with both perspective and orthographic
+  // projection), so it can be used for sorting instead of the distance - it grows going away from the camera
+  mDepthRow = viewProjection.row( 2 );
+  mPendingUpdate = true;
+  if ( !mWatcher.isRunning() )
+    startUpdate();
+}
+
+void BillboardDepthSorter::startUpdate()
+{
+  mPendingUpdate = false;
+  if ( !mGeometry || !mState || mState->order.isEmpty() || mGeometry->isInstanced() || mDepthRow == mSortedDepthRow )
+    return;
+
+  mSortedDepthRow = mDepthRow;
+  mWatcher.setFuture( QtConcurrent::run( &BillboardDepthSorter::sortPoints, mState, mDepthRow ) );
+}
+
+void BillboardDepthSorter::updateFinished()
+{
+  const Result result = mWatcher.result();
+  if ( result.state == mState )
+  {
+    mIncremental = result.incremental;
+    if ( result.changed )
+    {
+      mOrder = result.order;
+      // only indices get uploaded
+      if ( mGeometry && !mGeometry->isInstanced() )
+        mGeometry->setDrawIndices( mOrder );
+    }
+  }
+
+  // the camera has moved in the meantime
+  if ( mPendingUpdate || result.state != mState )
+    startUpdate();
+}
+
+void BillboardDepthSorter::geometryInstancedChanged( bool instanced )
+{
+  if ( instanced )
+  {
+    // draw indices would get expanded to a copy of all points
+    mGeometry->resetDrawIndices();
+    return;
+  }
+
+  // the camera may have moved while not sorting
+  mGeometry->setDrawIndices( mOrder );
+  if ( !mWatcher.isRunning() )
+    startUpdate();
+}
+
+BillboardDepthSorter::Result BillboardDepthSorter::sortPoints( QSharedPointer<SortState> state, QVector4D depthRow )
+{
+  Result result;
+  result.state = state;
+
+  // 1. depths of points (in the previous order) and their range
+  const int count = state->order.count();
+  const float *positions = state->positions.constData();
+  const quint32 *order = state->order.constData();
+  float *depths = state->depths.data();
+  float minDepth = std::numeric_limits<float>::max(), maxDepth = -std::numeric_limits<float>::max();
+  for ( int i = 0; i < count; ++i )
+  {
+    const float *p = positions + order[i] * 3;
+    const float depth = depthRow.x() * p[0] + depthRow.y() * p[1] + depthRow.z() * p[2] + depthRow.w();
+    depths[i] = depth;
+    minDepth = std::min( minDepth, depth );
+    maxDepth = std::max( maxDepth, depth );
+  }
+
+  // 2. quantized keys - the farthest point gets zero, so that ascending keys go back to front
+  const float scale = maxDepth > minDepth ? std::numeric_limits<quint16>::max() / ( maxDepth - minDepth ) : 0;
+  quint16 *keys = state->keys.data();
+  for ( int i = 0; i < count; ++i )
+    keys[i] = static_cast<quint16>( ( maxDepth - depths[i] ) * scale );
+
+  // 3. fix the previous order, or sort from scratch if it is too far from the new one
+  result.incremental = insertionSort( *state, static_cast<qint64>( count ) * MAX_SHIFTS_PER_POINT, result.changed );
+  if ( !result.incremental )
+  {
+    radixSort( *state );
+    result.changed = true;
+  }
+
+  // shared with the GUI thread, the next sort works on a copy
+  if ( result.changed )
+    result.order = state->order;
+  return result;
+}
+
+bool BillboardDepthSorter::insertionSort( SortState &state, qint64 maxShifts, bool &changed )
+{
+  quint32 *order = state.order.data();
+  quint16 *keys = state.keys.data();
+  const int count = state.order.count();
+  qint64 shifts = 0;
+  for ( int i = 1; i < count; ++i )
+  {
+    const quint16 key = keys[i];
+    if ( keys[i - 1] <= key )
+      continue;
+
+    // stable: items with the same key keep their previous order
+    const quint32 index = order[i];
+    int j = i;
+    for ( ; j > 0 && keys[j - 1] > key; --j )
+    {
+      keys[j] = keys[j - 1];
+      order[j] = order[j - 1];
+    }
+    keys[j] = key;
+    order[j] = index;
+    changed = true;
+
+    shifts += i - j;
+    if ( shifts > maxShifts )
+      return false;   // the order is still a permutation, the full sort continues from it
+  }
+  return true;
+}
+
+void BillboardDepthSorter::radixSort( SortState &state )
+{
+  const int count = state.order.count();
+  for ( int shift = 0; shift < 16; shift += RADIX_BITS )
+  {
+    const quint32 *sourceOrder = state.order.constData();
+    const quint16 *sourceKeys = state.keys.constData();
+
+    // counts of digits turned to offsets of buckets
+    int offsets[RADIX_BUCKETS] = {};
+    for ( int i = 0; i < count; ++i )
+      ++offsets[( sourceKeys[i] >> shift ) & ( RADIX_BUCKETS - 1 )];
+    int sum = 0;
+    for ( int &offset : offsets )
+    {
+      const int bucketCount = offset;
+      offset = sum;
+      sum += bucketCount;
+    }
+
+    quint32 *order = state.tempOrder.data();
+    quint16 *keys = state.tempKeys.data();
+    for ( int i = 0; i < count; ++i )
+    {
+      const int target = offsets[( sourceKeys[i] >> shift ) & ( RADIX_BUCKETS - 1 )]++;
+      order[target] = sourceOrder[i];
+      keys[target] = sourceKeys[i];
+    }
+    std::swap( state.order, state.tempOrder );
+    std::swap( state.keys, state.tempKeys );
+  }
+}
@@ -0,0 +1,113 @@
+#ifndef BILLBOARDDEPTHSORTER_H
+#define BILLBOARDDEPTHSORTER_H
+
+#include <QFutureWatcher>
+#include <QMatrix4x4>
+#include <QObject>
+#include <QPointer>
+#include <QSharedPointer>
+#include <QVector4D>
+#include <QVector>
+
+#include "billboardgeometry.h"
+
+
+/**
+ * Keeps billboards ordered back to front, so that semi-transparent billboards blend correctly.
+ *
+ * On each camera update, depths of points are quantized to 16-bit keys over their current
+ * range. The order from the previous update is usually still almost sorted, so it just gets
+ * fixed by insertion sort - which is linear then. If the camera moved too much and the
+ * insertion sort would need more than MAX_SHIFTS_PER_POINT shifts per point on average,
+ * a full radix sort (two 8-bit passes) is done instead.
+ *
+ * Sorting runs on a worker thread, only the resulting order gets set to the geometry in the GUI
+ * thread. Camera updates that come while the worker is busy are merged - just the last one
+ * gets processed.
+ *
+ * Points are drawn in the order through the index buffer of the geometry (see
+ * BillboardGeometry::setDrawIndices()), so only the indices get uploaded and only if
+ * the order has changed - point data stay as they are. As the index buffer is taken, it is not
+ * meant to be combined with BillboardDeclutter (decluttered billboards do not overlap anyway).
+ * In the instanced mode of the geometry, an order would mean copying all points to its instance
+ * buffer each time, so billboards are not sorted then and get drawn in their original order.
+ */
+class BillboardDepthSorter : public QObject
+{
+  Q_OBJECT
+
+public:
+  //! Maximal average number of shifts per point for the incremental sort before doing a full sort
+  static const int MAX_SHIFTS_PER_POINT = 8;
+
+  BillboardDepthSorter( QObject *parent = nullptr );
+  ~BillboardDepthSorter() override;
+
+  //! Sets points without per-point attributes to be sorted (also setting them to the \a geometry)
+  void setPoints( const QVector<QVector3D> &points, BillboardGeometry *geometry );
+
+  //! Sets billboards to be sorted (also setting them to the \a geometry)
+  void setBillboards( const QVector<Billboard> &billboards, BillboardGeometry *geometry );
+
+  //! Returns indices of points from the last finished update, back to front
+  QVector<quint32> order() const { return mOrder; }
+
+  //! Returns whether the last finished update was done incrementally (without a full sort)
+  bool wasIncremental() const { return mIncremental; }
+
+  /**
+   * Starts an update of the order of points for the given projection * view (* model) matrix.
+   * The geometry gets the new order when it is finished.
+   */
+  Q_INVOKABLE void updateCamera( const QMatrix4x4 &viewProjection );
+
+private:
+  //! Points and their order, used by the worker (not touched by the GUI thread while it runs)
+  struct SortState
+  {
+    QVector<float> positions;    //!< [x, y, z] of each point
+    QVector<quint32> order;      //!< Indices of points, back to front
+    QVector<quint16> keys;       //!< Quantized depth of each point in order (the farthest is zero)
+    QVector<float> depths;
+    QVector<quint32> tempOrder;
+    QVector<quint16> tempKeys;
+  };
+
+  //! Order of points after an update
+  struct Result
+  {
+    QSharedPointer<SortState> state;
+    QVector<quint32> order;      //!< Only set if the order has changed
+    bool changed = false;
+    bool incremental = false;
+  };
+
+  //! Stores positions of points and resets the order
+  void setPositions( const QVector<QVector3D> &positions, BillboardGeometry *geometry );
+
+  void startUpdate();
+  void updateFinished();
+  void geometryInstancedChanged( bool instanced );
+
+  //! Sorts points of the \a state by clip space z given by \a depthRow
+  static Result sortPoints( QSharedPointer<SortState> state, QVector4D depthRow );
+
+  //! Sorts order by keys by insertion, returns false if it would take more than \a maxShifts shifts
+  static bool insertionSort( SortState &state, qint64 maxShifts, bool &changed );
+
+  //! Sorts order by keys with LSD radix sort
+  static void radixSort( SortState &state );
+
+  QPointer<BillboardGeometry> mGeometry;
+  QSharedPointer<SortState> mState;
+  QFutureWatcher<Result> mWatcher;
+
+  QVector4D mDepthRow;          //!< Row of the matrix giving clip space z from the last camera update
+  QVector4D mSortedDepthRow;    //!< Row used by the last started sort
+  bool mPendingUpdate = false;
+
+  QVector<quint32> mOrder;
+  bool mIncremental = false;
+};
+
+#endif // BILLBOARDDEPTHSORTER_H
@@ -2,6 +2,77 @@
 
 #include <Qt3DRender/QAttribute>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+
+namespace
+{
+
+  /**
+   * Packs vertex data on a Qt3D job thread from points, billboards or a mapped file
+   * (whichever is set) - either all of them, or just the ones \a selected by \a indices
+   */
+  class BillboardDataGenerator : public Qt3DRender::QBufferDataGenerator
+  {
+    public:
+      BillboardDataGenerator( const QVector<QVector3D> &points, const QVector<Billboard> &billboards, QSharedPointer<const PointFile> file,
+                              bool selected = false, const QVector<quint32> &indices = QVector<quint32>() )
+        : mPoints( points )
+        , mBillboards( billboards )
+        , mFile( file )
+        , mSelected( selected )
+        , mIndices( indices )
+      {
+      }
+
+      QByteArray operator()() override
+      {
+        const int stride = mFile ? mFile->stride() : !mBillboards.isEmpty() ? BillboardGeometry::BILLBOARD_STRIDE : 3 * sizeof( float );
+        const int sourceCount = mFile ? mFile->count() : mPoints.count() + mBillboards.count();
+        const int count = mSelected ? mIndices.count() : sourceCount;
+
+        QByteArray data;
+        data.resize( count * stride );
+        char *out = data.data();
+        for ( int i = 0; i < count; ++i, out += stride )
+        {
+          const int index = mSelected ? mIndices[i] : i;
+          Q_ASSERT( index >= 0 && index < sourceCount );
+          if ( mFile )
+            std::memcpy( out, mFile->data() + index * stride, stride );
+          else if ( !mBillboards.isEmpty() )
+            BillboardGeometry::writeBillboard( out, mBillboards[index] );
+          else
+          {
+            const QVector3D &point = mPoints[index];
+            const float position[3] = { point.x(), point.y(), point.z() };
+            std::memcpy( out, position, sizeof( position ) );
+          }
+        }
+        return data;
+      }
+
+      bool operator ==( const Qt3DRender::QBufferDataGenerator &other ) const override
+      {
+        const BillboardDataGenerator *otherGenerator = functor_cast<BillboardDataGenerator>( &other );
+        return otherGenerator && otherGenerator->mFile == mFile && otherGenerator->mSelected == mSelected &&
+               otherGenerator->mIndices == mIndices && otherGenerator->mPoints == mPoints && otherGenerator->mBillboards == mBillboards;
+      }
+
+      QT3D_FUNCTOR( BillboardDataGenerator )
+
+    private:
+      QVector<QVector3D> mPoints;
+      QVector<Billboard> mBillboards;
+      QSharedPointer<const PointFile> mFile;
+      bool mSelected;
+      QVector<quint32> mIndices;
+  };
+
+}
+
 
 BillboardGeometry::BillboardGeometry( Qt3DCore::QNode *parent )
   : Qt3DRender::QGeometry( parent )
@@ -17,28 +88,189 @@ BillboardGeometry::BillboardGeometry( Qt3DCore::QNode *parent )
 
   addAttribute( mPositionAttribute );
 
+  // per-point attributes get added by setBillboards()
+  // (integer types are normalized, see PointFile::Attribute::type)
+  mSizeAttribute = new Qt3DRender::QAttribute( mVertexBuffer, "billboardSize", Qt3DRender::QAttribute::Float, 2, 0, 12, BILLBOARD_STRIDE, this );
+  mTextureRectAttribute = new Qt3DRender::QAttribute( mVertexBuffer, "billboardTextureRect", Qt3DRender::QAttribute::UnsignedShort, 4, 0, 20, BILLBOARD_STRIDE, this );
+  mTintAttribute = new Qt3DRender::QAttribute( mVertexBuffer, "billboardTint", Qt3DRender::QAttribute::UnsignedByte, 4, 0, 28, BILLBOARD_STRIDE, this );
+
+  // added by setDrawIndices()
+  mIndexBuffer = new Qt3DRender::QBuffer( Qt3DRender::QBuffer::IndexBuffer, this );
+  mIndexAttribute = new Qt3DRender::QAttribute( this );
+  mIndexAttribute->setAttributeType( Qt3DRender::QAttribute::IndexAttribute );
+  mIndexAttribute->setVertexBaseType( Qt3DRender::QAttribute::UnsignedInt );
+  mIndexAttribute->setBuffer( mIndexBuffer );
+
+  // corners of the quad for the instanced mode, as a triangle strip
+  const float corners[QUAD_VERTICES * 2] = { 0, 0, 1, 0, 0, 1, 1, 1 };
+  Qt3DRender::QBuffer *quadBuffer = new Qt3DRender::QBuffer( Qt3DRender::QBuffer::VertexBuffer, this );
+  quadBuffer->setData( QByteArray( reinterpret_cast<const char *>( corners ), sizeof( corners ) ) );
+  mCornerAttribute = new Qt3DRender::QAttribute( quadBuffer, "vertexCorner", Qt3DRender::QAttribute::Float, 2, QUAD_VERTICES, 0, 0, this );
+
+  // selected points in the instanced mode
+  mInstanceBuffer = new Qt3DRender::QBuffer( Qt3DRender::QBuffer::VertexBuffer, this );
 }
 
 int BillboardGeometry::count()
 {
-  return mVertexCount;
+  return mDrawIndexCount >= 0 ? mDrawIndexCount : mVertexCount;
 }
 
-void BillboardGeometry::setPoints(const QVector<QVector3D> &vertices)
+void BillboardGeometry::setDrawIndices( const QVector<quint32> &indices )
+{
+  mDrawIndices = indices;
+  mDrawIndexCount = indices.count();
+  updateDrawData();
+
+  emit countChanged( mDrawIndexCount );
+}
+
+void BillboardGeometry::resetDrawIndices()
+{
+  if ( mDrawIndexCount < 0 )
+    return;
+
+  mDrawIndices.clear();
+  mDrawIndexCount = -1;
+  updateDrawData();
+
+  emit countChanged( mVertexCount );
+}
+
+void BillboardGeometry::setInstanced( bool instanced )
+{
+  if ( instanced == mInstanced )
+    return;
+
+  mInstanced = instanced;
+  for ( Qt3DRender::QAttribute *attribute : { mPositionAttribute, mSizeAttribute, mTextureRectAttribute, mTintAttribute } )
+    attribute->setDivisor( instanced ? 1 : 0 );
+  if ( instanced )
+    addAttribute( mCornerAttribute );
+  else
+    removeAttribute( mCornerAttribute );
+  updateDrawData();
+
+  emit instancedChanged( mInstanced );
+}
+
+void BillboardGeometry::updateDrawData()
 {
-  QByteArray vertexBufferData;
-  vertexBufferData.resize( vertices.size() * 3 * sizeof( float ) );
-  float *rawVertexArray = reinterpret_cast<float *>( vertexBufferData.data() );
-  int idx = 0;
-  for ( const auto &v : vertices )
+  // indices can only select points when each point is a vertex
+  const bool useIndices = !mInstanced && mDrawIndexCount >= 0;
+  if ( useIndices )
   {
-    rawVertexArray[idx++] = v.x();
-    rawVertexArray[idx++] = v.y();
-    rawVertexArray[idx++] = v.z();
+    mIndexBuffer->setData( QByteArray( reinterpret_cast<const char *>( mDrawIndices.constData() ), mDrawIndexCount * sizeof( quint32 ) ) );
+    mIndexAttribute->setCount( mDrawIndexCount );
   }
+  else
+    mIndexBuffer->setData( QByteArray() );
+  if ( useIndices && !attributes().contains( mIndexAttribute ) )
+    addAttribute( mIndexAttribute );
+  else if ( !useIndices && attributes().contains( mIndexAttribute ) )
+    removeAttribute( mIndexAttribute );
 
+  // ... so instances get a copy of the selected points
+  const bool useInstanceBuffer = mInstanced && mDrawIndexCount >= 0;
+  if ( useInstanceBuffer )
+    mInstanceBuffer->setDataGenerator( QSharedPointer<BillboardDataGenerator>::create( mPoints, mBillboards, mVertexFile, true, mDrawIndices ) );
+  else
+  {
+    mInstanceBuffer->setDataGenerator( Qt3DRender::QBufferDataGeneratorPtr() );
+    mInstanceBuffer->setData( QByteArray() );
+  }
+
+  for ( Qt3DRender::QAttribute *attribute : { mPositionAttribute, mSizeAttribute, mTextureRectAttribute, mTintAttribute } )
+    attribute->setBuffer( useInstanceBuffer ? mInstanceBuffer : mVertexBuffer );
+}
+
+void BillboardGeometry::setPoints(const QVector<QVector3D> &vertices)
+{
+  setVertexLayout( false, 3 * sizeof( float ) );
   mVertexCount = vertices.count();
-  mVertexBuffer->setData( vertexBufferData );
+  mPoints = vertices;
+  mBillboards.clear();
+  mVertexFile.reset();
+  mVertexBuffer->setData( QByteArray() );
+  mVertexBuffer->setDataGenerator( QSharedPointer<BillboardDataGenerator>::create( mPoints, mBillboards, mVertexFile ) );
+  resetDrawIndices();
+
+  emit countChanged(mVertexCount);
+}
+
+void BillboardGeometry::setBillboards( const QVector<Billboard> &billboards )
+{
+  setVertexLayout( true, BILLBOARD_STRIDE );
+  mVertexCount = billboards.count();
+  mPoints.clear();
+  mBillboards = billboards;
+  mVertexFile.reset();
+  mVertexBuffer->setData( QByteArray() );
+  mVertexBuffer->setDataGenerator( QSharedPointer<BillboardDataGenerator>::create( mPoints, mBillboards, mVertexFile ) );
+  resetDrawIndices();
+
+  emit countChanged(mVertexCount);
+}
+
+void BillboardGeometry::setPoints( QSharedPointer<const PointFile> file )
+{
+  const PointFile::Attribute *position = file->positionAttribute();
+  Q_ASSERT( position && position->type == Qt3DRender::QAttribute::Float && position->size == 3 );
+
+  // per-point attributes only if they are exactly where writeBillboard() puts them
+  auto hasAttribute = [&file]( const QString & name, Qt3DRender::QAttribute::VertexBaseType type, int size, int offset )
+  {
+    const PointFile::Attribute *attribute = file->attribute( name );
+    return attribute && attribute->type == type && attribute->size == size && attribute->offset == offset;
+  };
+  const bool billboardAttributes = file->stride() == BILLBOARD_STRIDE && position->offset == 0 &&
+                                   hasAttribute( QStringLiteral( "billboardSize" ), Qt3DRender::QAttribute::Float, 2, 12 ) &&
+                                   hasAttribute( QStringLiteral( "billboardTextureRect" ), Qt3DRender::QAttribute::UnsignedShort, 4, 20 ) &&
+                                   hasAttribute( QStringLiteral( "billboardTint" ), Qt3DRender::QAttribute::UnsignedByte, 4, 28 );
+
+  setVertexLayout( billboardAttributes, file->stride(), position->offset );
+  mVertexCount = file->count();
+  mPoints.clear();
+  mBillboards.clear();
+  mVertexFile = file;
+  mVertexBuffer->setData( QByteArray() );
+  mVertexBuffer->setDataGenerator( QSharedPointer<PointFileDataGenerator>::create( file ) );
+  resetDrawIndices();
 
   emit countChanged(mVertexCount);
 }
+
+void BillboardGeometry::writeBillboard( char *out, const Billboard &billboard )
+{
+  auto toUnsignedShort = []( qreal value ) { return static_cast<quint16>( std::round( std::min( std::max( value, 0. ), 1. ) * 65535 ) ); };
+
+  const float position[5] = { billboard.position.x(), billboard.position.y(), billboard.position.z(),
+                              static_cast<float>( billboard.size.width() ), static_cast<float>( billboard.size.height() )
+                            };
+  const quint16 textureRect[4] = { toUnsignedShort( billboard.textureRect.x() ), toUnsignedShort( billboard.textureRect.y() ),
+                                   toUnsignedShort( billboard.textureRect.width() ), toUnsignedShort( billboard.textureRect.height() )
+                                 };
+  const quint8 tint[4] = { static_cast<quint8>( qRed( billboard.tint ) ), static_cast<quint8>( qGreen( billboard.tint ) ),
+                           static_cast<quint8>( qBlue( billboard.tint ) ), static_cast<quint8>( qAlpha( billboard.tint ) )
+                         };
+  std::memcpy( out, position, sizeof( position ) );
+  std::memcpy( out + 20, textureRect, sizeof( textureRect ) );
+  std::memcpy( out + 28, tint, sizeof( tint ) );
+}
+
+void BillboardGeometry::setVertexLayout( bool billboardAttributes, int stride, int positionOffset )
+{
+  mPositionAttribute->setByteStride( stride );
+  mPositionAttribute->setByteOffset( positionOffset );
+  if ( billboardAttributes == mHasBillboardAttributes )
+    return;
+
+  mHasBillboardAttributes = billboardAttributes;
+  for ( Qt3DRender::QAttribute *attribute : { mSizeAttribute, mTextureRectAttribute, mTintAttribute } )
+  {
+    if ( billboardAttributes )
+      addAttribute( attribute );
+    else
+      removeAttribute( attribute );
+  }
+}
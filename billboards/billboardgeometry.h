@@ -4,29 +4,132 @@
 #include <Qt3DRender/QGeometry>
 #include <Qt3DRender/QBuffer>
 
+#include <QRectF>
+#include <QRgb>
+#include <QSharedPointer>
+#include <QSizeF>
+#include <QVector>
 #include <QVector3D>
 
+#include "pointfile.h"
 
+
+//! Billboard with its own size, part of the texture (atlas) and tint
+struct Billboard
+{
+  QVector3D position;
+  QSizeF size;                     //!< Size in pixels
+  QRectF textureRect;              //!< Part of the texture in normalized [0, 1] coordinates (see BillboardAtlas::textureRect())
+  QRgb tint = 0xffffffff;          //!< Color multiplied with the texture
+
+  bool operator==( const Billboard &other ) const
+  {
+    return position == other.position && size == other.size && textureRect == other.textureRect && tint == other.tint;
+  }
+};
+
+
+/**
+ * Points to be expanded to billboards by the geometry shader.
+ *
+ * With setPoints() there are just positions - all billboards have the same size and texture
+ * given by uniforms. With setBillboards() each point also has its size, texture rectangle
+ * and tint interleaved in the vertex buffer (32 bytes per point), so billboards with many
+ * different icons from a texture atlas can be drawn with a single draw call.
+ *
+ * In the instanced mode (see setInstanced()) there is no geometry shader: each point is
+ * an instance of a quad of QUAD_VERTICES corners drawn as a triangle strip, expanded
+ * by billboards_instanced.vert. Then it is drawn with count() instances.
+ *
+ * Vertex data are not packed on the GUI thread: the buffers get data generators holding
+ * just the (implicitly shared) points, which Qt3D runs on its job threads. Setting
+ * the same points again (e.g. unchanged order after depth sorting) does not regenerate them.
+ */
 class BillboardGeometry : public Qt3DRender::QGeometry
 {
   Q_OBJECT
 
   Q_PROPERTY(int count READ count NOTIFY countChanged)
+  Q_PROPERTY(bool instanced READ isInstanced WRITE setInstanced NOTIFY instancedChanged)
 
 public:
+  //! Byte stride of billboards with attributes: position (3 floats), size (2 floats), texture rectangle (4 normalized ushorts), tint (4 normalized ubytes)
+  static const int BILLBOARD_STRIDE = 32;
+  //! Number of vertices of the quad drawn for each point in the instanced mode
+  static const int QUAD_VERTICES = 4;
+
   BillboardGeometry( Qt3DCore::QNode *parent = nullptr );
 
+  //! Sets points without per-point attributes
   void setPoints( const QVector<QVector3D> &vertices );
 
+  //! Sets points with per-point attributes
+  void setBillboards( const QVector<Billboard> &billboards );
+
+  /**
+   * Sets points from a memory mapped \a file without copying them. Records with the layout
+   * of setBillboards() (BILLBOARD_STRIDE bytes with "billboardSize", "billboardTextureRect"
+   * and "billboardTint") get per-point attributes, otherwise just the positions are used.
+   */
+  void setPoints( QSharedPointer<const PointFile> file );
+
+  /**
+   * Draws only the points with the given \a indices (e.g. the ones left after decluttering).
+   * Just the indices get uploaded, point data stay as they are. Setting points resets it.
+   */
+  void setDrawIndices( const QVector<quint32> &indices );
+
+  //! Draws all points again (after setDrawIndices())
+  void resetDrawIndices();
+
+  //! Returns whether points have per-point attributes (i.e. were set by setBillboards())
+  bool hasBillboardAttributes() const { return mHasBillboardAttributes; }
+
+  //! Returns number of points to be drawn (vertices, or instances in the instanced mode)
   int count();
 
+  //! Returns whether points are drawn as instances of a quad (without geometry shader)
+  bool isInstanced() const { return mInstanced; }
+
+  /**
+   * Sets whether points are drawn as instances of a quad. Point attributes then advance
+   * once per instance instead of once per vertex. Draw indices cannot pick instances,
+   * so the selected points get copied to a separate instance buffer instead.
+   */
+  void setInstanced( bool instanced );
+
+  //! Writes vertex data of a billboard (BILLBOARD_STRIDE bytes) to \a out
+  static void writeBillboard( char *out, const Billboard &billboard );
+
 signals:
     void countChanged(int count);
+    void instancedChanged(bool instanced);
 
 private:
+  //! Adds or removes attributes of billboards and sets the stride and offset of positions
+  void setVertexLayout( bool billboardAttributes, int stride, int positionOffset = 0 );
+
+  //! Sets up the index attribute and the buffer of point attributes for the current mode and draw indices
+  void updateDrawData();
+
   Qt3DRender::QAttribute *mPositionAttribute = nullptr;
+  Qt3DRender::QAttribute *mSizeAttribute = nullptr;
+  Qt3DRender::QAttribute *mTextureRectAttribute = nullptr;
+  Qt3DRender::QAttribute *mTintAttribute = nullptr;
+  Qt3DRender::QAttribute *mIndexAttribute = nullptr;
+  Qt3DRender::QAttribute *mCornerAttribute = nullptr;
   Qt3DRender::QBuffer *mVertexBuffer = nullptr;
+  Qt3DRender::QBuffer *mIndexBuffer = nullptr;
+  Qt3DRender::QBuffer *mInstanceBuffer = nullptr;   //!< Points selected by draw indices in the instanced mode
+  // points as they were set (only one of them is used)
+  QVector<QVector3D> mPoints;
+  QVector<Billboard> mBillboards;
+  QSharedPointer<const PointFile> mVertexFile;
+  QVector<quint32> mDrawIndices;
   int mVertexCount = 0;
+  int mDrawIndexCount = -1;    //!< Number of indices drawn, -1 if drawing all points without indices
+  bool mHasBillboardAttributes = false;
+  bool mInstanced = false;
 };
 
 #endif // BILLBOARDGEOMETRY_H
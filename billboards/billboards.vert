@@ -2,9 +2,24 @@
 
 uniform mat4 modelViewProjection;
 
+uniform vec2 BB_SIZE;           // billboard size in pixels
+uniform bool useVertexStyle;    // use per-point size, texture rectangle and tint instead of the uniforms
+
 in vec3 vertexPosition;
+in vec2 billboardSize;
+in vec4 billboardTextureRect;   // x, y, width, height in the texture (normalized)
+in vec4 billboardTint;
+
+out VertexData {
+  vec2 size;
+  vec4 textureRect;
+  vec4 tint;
+} VertexOut;
 
 void main(void)
 {
     gl_Position = modelViewProjection * vec4(vertexPosition, 1);
+    VertexOut.size = useVertexStyle ? billboardSize : BB_SIZE;
+    VertexOut.textureRect = useVertexStyle ? billboardTextureRect : vec4(0, 0, 1, 1);
+    VertexOut.tint = useVertexStyle ? billboardTint : vec4(1);
 }
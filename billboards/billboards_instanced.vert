@@ -0,0 +1,35 @@
+#version 150
+
+// billboards without geometry shader: each point is an instance of a quad
+// (the same math as billboards.vert + billboards.geom)
+
+uniform mat4 modelViewProjection;
+
+uniform vec2 WIN_SCALE;         // the size of the viewport in pixels
+uniform vec2 BB_SIZE;           // billboard size in pixels
+uniform bool useVertexStyle;    // use per-point size, texture rectangle and tint instead of the uniforms
+
+in vec2 vertexCorner;           // corner of the quad: [0, 0] - [1, 1]
+
+// per instance
+in vec3 vertexPosition;
+in vec2 billboardSize;
+in vec4 billboardTextureRect;   // x, y, width, height in the texture (normalized)
+in vec4 billboardTint;
+
+out vec2 UV;
+out vec4 tint;
+
+void main(void)
+{
+    vec4 P = modelViewProjection * vec4(vertexPosition, 1);
+    P /= P.w;
+
+    vec2 size = (useVertexStyle ? billboardSize : BB_SIZE) / WIN_SCALE;
+    vec4 textureRect = useVertexStyle ? billboardTextureRect : vec4(0, 0, 1, 1);
+
+    gl_Position = P;
+    gl_Position.xy += (vertexCorner - vec2(0.5)) * size;
+    UV = textureRect.xy + vertexCorner * textureRect.zw;
+    tint = useVertexStyle ? billboardTint : vec4(1);
+}
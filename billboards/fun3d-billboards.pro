@@ -1,5 +1,5 @@
 TEMPLATE = app
-QT += 3dcore 3drender 3dinput 3dquick qml quick 3dquickextras 3dextras
+QT += concurrent 3dcore 3drender 3dinput 3dquick qml quick 3dquickextras 3dextras
 
 # The following define makes your compiler emit warnings if you use
 # any Qt feature that has been marked deprecated (the exact warnings
@@ -12,9 +12,16 @@ DEFINES += QT_DEPRECATED_WARNINGS
 # You can also select to disable deprecated APIs only up to a certain version of Qt.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+# shared with other demos (see common/)
+INCLUDEPATH += ../common
+
 SOURCES += \
         main.cpp \
-    billboardgeometry.cpp
+    billboardatlas.cpp \
+    billboarddeclutter.cpp \
+    billboarddepthsorter.cpp \
+    billboardgeometry.cpp \
+    ../common/pointfile.cpp
 
 RESOURCES += qml.qrc \
     shaders.qrc
@@ -31,4 +38,8 @@ else: unix:!android: target.path = /opt/$${TARGET}/bin
 !isEmpty(target.path): INSTALLS += target
 
 HEADERS += \
-    billboardgeometry.h
+    billboardatlas.h \
+    billboarddeclutter.h \
+    billboarddepthsorter.h \
+    billboardgeometry.h \
+    ../common/pointfile.h
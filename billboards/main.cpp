@@ -1,29 +1,96 @@
 #include <Qt3DQuickExtras/qt3dquickwindow.h>
 #include <Qt3DQuick/QQmlAspectEngine>
 #include <QGuiApplication>
+#include <QPainter>
 #include <QQmlContext>
 #include <QQmlEngine>
+#include <QRandomGenerator>
 
+#include "billboardatlas.h"
+#include "billboarddeclutter.h"
+#include "billboarddepthsorter.h"
 #include "billboardgeometry.h"
 
+// makes a simple icon (a colored shape with a letter) as a stand-in for POI icons
+static QImage makeIcon(int index, int size)
+{
+    QImage image(size, size, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(QPen(Qt::white, 2));
+    painter.setBrush(QColor::fromHsv((index * 37) % 360, 200, 220));
+    const QRectF rect(1, 1, size - 2, size - 2);
+    switch (index % 3) {
+    case 0: painter.drawEllipse(rect); break;
+    case 1: painter.drawRoundedRect(rect, size / 5, size / 5); break;
+    case 2: painter.drawPolygon(QPolygonF() << QPointF(size / 2., 1) << QPointF(size - 1, size - 1) << QPointF(1, size - 1)); break;
+    }
+    QFont font = painter.font();
+    font.setPixelSize(size / 2);
+    painter.setFont(font);
+    painter.drawText(rect, Qt::AlignCenter, QString(QChar('A' + index % 26)));
+    return image;
+}
+
 int main(int argc, char* argv[])
 {
     QGuiApplication app(argc, argv);
 
+    // billboards can be expanded either by the geometry shader (default) or in the vertex
+    // shader from instanced quads (--instanced) - the I key switches between them
+    const bool useInstancedBillboards = app.arguments().contains("--instanced");
+
     QVector<QVector3D> pos;
     pos << QVector3D(1, 1, 0);
     pos << QVector3D(-1, 2, 8);
     pos << QVector3D(1, 1, 7);
     pos << QVector3D(0, 0, 4);
 
+    // semi-transparent billboards get drawn back to front
     BillboardGeometry bbg;
-    bbg.setPoints(pos);
+    BillboardDepthSorter bbgSorter;
+    bbgSorter.setPoints(pos, &bbg);
+
+    // lots of points of interest with different icons, sizes and tints - all drawn
+    // with a single draw call, with icons packed in one texture atlas
+    QVector<QImage> icons;
+    icons << QImage(":/success-kid.png").scaled(64, 64, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    for (int i = 0; i < 60; ++i)
+        icons << makeIcon(i, 16 + (i * 7) % 49);
+
+    BillboardAtlas atlas;
+    atlas.setImages(icons);
+
+    QRandomGenerator random(1);
+    QVector<Billboard> pois;
+    QVector<float> priorities;
+    for (int i = 0; i < 5000; ++i) {
+        const int icon = random.bounded(icons.count());
+        Billboard poi;
+        poi.position = QVector3D(random.bounded(40.) - 20, 0.5 + random.bounded(0.5), random.bounded(40.) - 20);
+        poi.size = atlas.imageRect(icon).size() * 0.75;
+        poi.textureRect = atlas.textureRect(icon);
+        poi.tint = random.bounded(4) == 0 ? qRgba(255, 255, 255, 160) : qRgb(255, 255, 255);
+        pois << poi;
+        priorities << poi.size.width() * poi.size.height();   // bigger icons are more important
+    }
+
+    // only POIs not overlapping more important ones get drawn
+    BillboardGeometry poiGeometry;
+    BillboardDeclutter declutter;
+    declutter.setBillboards(pois, priorities, &poiGeometry);
 
     Qt3DExtras::Quick::Qt3DQuickWindow view;
     view.setTitle("Billboards");
     view.resize(1600, 800);
     view.engine()->qmlEngine()->rootContext()->setContextProperty("_window", &view);
+    view.engine()->qmlEngine()->rootContext()->setContextProperty("_instancedBillboards", useInstancedBillboards);
     view.engine()->qmlEngine()->rootContext()->setContextProperty("_bbg", &bbg);
+    view.engine()->qmlEngine()->rootContext()->setContextProperty("_bbgSorter", &bbgSorter);
+    view.engine()->qmlEngine()->rootContext()->setContextProperty("_poiGeometry", &poiGeometry);
+    view.engine()->qmlEngine()->rootContext()->setContextProperty("_atlas", &atlas);
+    view.engine()->qmlEngine()->rootContext()->setContextProperty("_declutter", &declutter);
     view.setSource(QUrl("qrc:/main.qml"));
     view.show();
 
@@ -5,14 +5,35 @@ import Qt3D.Input 2.0
 import Qt3D.Extras 2.0
 
 Entity {
+    id: root
+
+    // billboards drawn as instanced quads instead of points expanded by the geometry shader
+    // (toggled with the I key)
+    property bool instancedBillboards: _instancedBillboards
 
     components: [
         rendSettings,
-        inputSettings
+        inputSettings,
+        keyboardHandler
     ]
 
     InputSettings { id: inputSettings }
 
+    KeyboardDevice { id: keyboardDevice }
+
+    KeyboardHandler {
+        id: keyboardHandler
+        sourceDevice: keyboardDevice
+        focus: true
+        onPressed: {
+            if (event.key === Qt.Key_I)
+                root.instancedBillboards = !root.instancedBillboards
+        }
+    }
+
+    QQ2.Binding { target: _bbg; property: "instanced"; value: root.instancedBillboards }
+    QQ2.Binding { target: _poiGeometry; property: "instanced"; value: root.instancedBillboards }
+
     RenderSettings {
         id: rendSettings
         activeFrameGraph: RenderSurfaceSelector {
@@ -39,6 +60,24 @@ Entity {
         position: Qt.vector3d(0.0, 10.0, 20.0)
         viewCenter: Qt.vector3d(0.0, 0.0, 0.0)
         upVector: Qt.vector3d(0.0, 1.0, 0.0)
+
+        function viewProjMatrix() {
+            var viewMat = Qt.matrix4x4();
+            viewMat.lookAt(camera.position, camera.viewCenter, camera.upVector)
+            return camera.projectionMatrix.times( viewMat )
+        }
+
+        function updateBillboards() {
+            _declutter.updateCamera(viewProjMatrix(), Qt.size(_window.width, _window.height))
+            _bbgSorter.updateCamera(viewProjMatrix().times(trr.matrix))
+        }
+
+        onPositionChanged: updateBillboards()
+        onViewCenterChanged: updateBillboards()
+        onUpVectorChanged: updateBillboards()
+        // not on fieldOfView / aspectRatio changes: the lens emits those before it updates projectionMatrix
+        onProjectionMatrixChanged: updateBillboards()
+        Component.onCompleted: updateBillboards()
     }
 
     FirstPersonCameraController { camera: camera }
@@ -60,8 +99,9 @@ Entity {
     Entity {
         GeometryRenderer {
             id: gr
-            primitiveType: GeometryRenderer.Points
-            vertexCount: _bbg.count
+            primitiveType: _bbg.instanced ? GeometryRenderer.TriangleStrip : GeometryRenderer.Points
+            vertexCount: _bbg.instanced ? 4 : _bbg.count
+            instanceCount: _bbg.instanced ? _bbg.count : 1
             geometry: _bbg
         }
 
@@ -96,9 +136,20 @@ Entity {
                     graphicsApiFilter { api: GraphicsApiFilter.OpenGL; profile: GraphicsApiFilter.CoreProfile; majorVersion: 3; minorVersion: 1 }
                     renderPasses: [
                         RenderPass {
+                            // semi-transparent, sorted back to front by _bbgSorter
+                            renderStates: [
+                                BlendEquation {
+                                    blendFunction: BlendEquation.Add
+                                },
+                                BlendEquationArguments {
+                                    sourceRgb: BlendEquationArguments.SourceAlpha
+                                    destinationRgb: BlendEquationArguments.OneMinusSourceAlpha
+                                }
+                            ]
+
                             shaderProgram: ShaderProgram {
-                                vertexShaderCode: loadSource("qrc:/shaders/billboards.vert")
-                                geometryShaderCode: loadSource("qrc:/shaders/billboards.geom")
+                                vertexShaderCode: loadSource(root.instancedBillboards ? "qrc:/shaders/billboards_instanced.vert" : "qrc:/shaders/billboards.vert")
+                                geometryShaderCode: root.instancedBillboards ? "" : loadSource("qrc:/shaders/billboards.geom")
                                 fragmentShaderCode: loadSource("qrc:/shaders/billboards.frag")
                             }
                         }
@@ -111,6 +162,63 @@ Entity {
     }
 
 
+    // billboards with per-point size, texture rectangle and tint (icons from a texture atlas)
+    Entity {
+        GeometryRenderer {
+            id: grPoi
+            primitiveType: _poiGeometry.instanced ? GeometryRenderer.TriangleStrip : GeometryRenderer.Points
+            vertexCount: _poiGeometry.instanced ? 4 : _poiGeometry.count
+            instanceCount: _poiGeometry.instanced ? _poiGeometry.count : 1
+            geometry: _poiGeometry
+        }
+
+        Material {
+            id: grmPoi
+
+            parameters: [
+                Parameter { name: "tex0"; value: txtAtlas },
+                Parameter { name: "WIN_SCALE"; value: Qt.size(_window.width,_window.height) },
+                Parameter { name: "useVertexStyle"; value: true }
+            ]
+
+            Texture2D {
+                id : txtAtlas
+                generateMipMaps : false
+                magnificationFilter : Texture.Linear
+                minificationFilter : Texture.Linear
+                textureImages: [ _atlas ]
+            }
+
+            effect: Effect {
+                techniques: Technique {
+                    graphicsApiFilter { api: GraphicsApiFilter.OpenGL; profile: GraphicsApiFilter.CoreProfile; majorVersion: 3; minorVersion: 1 }
+                    renderPasses: [
+                        RenderPass {
+                            // icons have transparent corners
+                            renderStates: [
+                                BlendEquation {
+                                    blendFunction: BlendEquation.Add
+                                },
+                                BlendEquationArguments {
+                                    sourceRgb: BlendEquationArguments.SourceAlpha
+                                    destinationRgb: BlendEquationArguments.OneMinusSourceAlpha
+                                }
+                            ]
+
+                            shaderProgram: ShaderProgram {
+                                vertexShaderCode: loadSource(root.instancedBillboards ? "qrc:/shaders/billboards_instanced.vert" : "qrc:/shaders/billboards.vert")
+                                geometryShaderCode: root.instancedBillboards ? "" : loadSource("qrc:/shaders/billboards.geom")
+                                fragmentShaderCode: loadSource("qrc:/shaders/billboards.frag")
+                            }
+                        }
+                    ]
+                }
+            }
+        }
+
+        components: [ grPoi, grmPoi ]
+    }
+
     Entity {
         PhongMaterial {
             id: redMat
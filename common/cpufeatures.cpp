@@ -0,0 +1,53 @@
+#include "cpufeatures.h"
+
+
+namespace CpuFeatures
+{
+
+  bool isSupported( Isa isa )
+  {
+    switch ( isa )
+    {
+      case Isa::Scalar:
+        return true;
+      case Isa::Sse2:
+#ifdef CPU_HAS_SSE2
+        return true;
+#else
+        return false;
+#endif
+      case Isa::Avx:
+#ifdef CPU_HAS_AVX
+        // also checks that the OS saves YMM registers on context switches
+        return __builtin_cpu_supports( "avx" );
+#else
+        return false;
+#endif
+    }
+    return false;
+  }
+
+  Isa bestIsa()
+  {
+    if ( isSupported( Isa::Avx ) )
+      return Isa::Avx;
+    if ( isSupported( Isa::Sse2 ) )
+      return Isa::Sse2;
+    return Isa::Scalar;
+  }
+
+  const char *isaName( Isa isa )
+  {
+    switch ( isa )
+    {
+      case Isa::Scalar:
+        return "scalar";
+      case Isa::Sse2:
+        return "sse2";
+      case Isa::Avx:
+        return "avx";
+    }
+    return "?";
+  }
+
+}
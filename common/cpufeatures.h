@@ -0,0 +1,49 @@
+#ifndef CPUFEATURES_H
+#define CPUFEATURES_H
+
+#include <QtGlobal>
+
+// Which SIMD kernels get compiled in. SSE2 kernels are compiled only when SSE2
+// is part of the build's baseline (always on x86-64, -msse2 on 32-bit x86), so
+// every CPU running the build has it. AVX kernels are compiled with a target
+// attribute and only used when the CPU supports them (checked at runtime).
+#if defined(Q_PROCESSOR_X86) && (defined(Q_CC_GNU) || defined(Q_CC_CLANG))
+#include <immintrin.h>
+#ifdef __SSE2__
+#define CPU_HAS_SSE2
+#endif
+#define CPU_HAS_AVX
+#define CPU_TARGET_AVX __attribute__((target("avx")))
+#elif defined(Q_PROCESSOR_X86_64) && defined(Q_CC_MSVC)
+// SSE2 is always available on x86-64, AVX would need /arch:AVX for the whole file
+#include <emmintrin.h>
+#define CPU_HAS_SSE2
+#endif
+
+/**
+ * Runtime selection of SIMD kernels.
+ *
+ * Code with SIMD kernels compiles them under the CPU_HAS_SSE2 / CPU_HAS_AVX guards above
+ * (AVX functions marked with CPU_TARGET_AVX) and picks one with bestIsa(), usually once.
+ */
+namespace CpuFeatures
+{
+  //! Instruction set used by a kernel
+  enum class Isa
+  {
+    Scalar,  //!< Plain C++
+    Sse2,    //!< 128-bit SSE2
+    Avx,     //!< 256-bit AVX
+  };
+
+  //! Returns whether the given instruction set is compiled in and supported by the running CPU
+  bool isSupported( Isa isa );
+
+  //! Returns the best instruction set supported by the running CPU
+  Isa bestIsa();
+
+  //! Returns human readable name of the instruction set
+  const char *isaName( Isa isa );
+}
+
+#endif // CPUFEATURES_H
@@ -0,0 +1,59 @@
+#include "offscreengl.h"
+
+
+OffscreenGl::~OffscreenGl()
+{
+  destroy();
+}
+
+bool OffscreenGl::create( int width, int height )
+{
+  QSurfaceFormat format;
+  format.setVersion( 3, 3 );
+  format.setProfile( QSurfaceFormat::CoreProfile );
+
+  mSurface = new QOffscreenSurface;
+  mSurface->setFormat( format );
+  mSurface->create();
+  mContext = new QOpenGLContext;
+  mContext->setFormat( format );
+  if ( !mContext->create() || !mContext->makeCurrent( mSurface ) )
+  {
+    mErrorMessage = "OpenGL 3.3 core context is not available";
+    return false;
+  }
+
+  QOpenGLFunctions_3_3_Core *functions = mContext->versionFunctions<QOpenGLFunctions_3_3_Core>();
+  if ( !functions || !functions->initializeOpenGLFunctions() )
+  {
+    mErrorMessage = "OpenGL 3.3 core functions are not available";
+    return false;
+  }
+  mFunctions = functions;
+
+  mFbo = new QOpenGLFramebufferObject( width, height, QOpenGLFramebufferObject::Depth );
+  mFbo->bind();
+  mFunctions->glViewport( 0, 0, width, height );
+  mFunctions->glEnable( GL_DEPTH_TEST );
+  return true;
+}
+
+void OffscreenGl::destroy()
+{
+  delete mFbo;
+  mFbo = nullptr;
+  mFunctions = nullptr;
+  if ( mContext )
+    mContext->doneCurrent();
+  delete mContext;
+  mContext = nullptr;
+  delete mSurface;
+  mSurface = nullptr;
+}
+
+void OffscreenGl::useOffscreenPlatform()
+{
+  // headless by default
+  if ( !qEnvironmentVariableIsSet( "QT_QPA_PLATFORM" ) )
+    qputenv( "QT_QPA_PLATFORM", "offscreen" );
+}
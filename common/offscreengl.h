@@ -0,0 +1,66 @@
+#ifndef OFFSCREENGL_H
+#define OFFSCREENGL_H
+
+#include <QGuiApplication>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLFunctions_3_3_Core>
+
+/**
+ * OpenGL 3.3 core context for the headless benchmarks of the demos.
+ *
+ * The context is made current on an offscreen surface (no window) and renders
+ * to a framebuffer object with a depth buffer, so benchmarks can draw with plain
+ * OpenGL and the shaders of the demos.
+ */
+class OffscreenGl
+{
+  public:
+    OffscreenGl() = default;
+    ~OffscreenGl();
+
+    OffscreenGl( const OffscreenGl & ) = delete;
+    OffscreenGl &operator=( const OffscreenGl & ) = delete;
+
+    /**
+     * Creates the context and a \a width x \a height framebuffer, binds it with viewport
+     * covering it and depth test enabled. Returns false if OpenGL 3.3 core is not
+     * available - errorMessage() then tells why (for QSKIP()).
+     */
+    bool create( int width, int height );
+
+    //! Returns why create() failed
+    const char *errorMessage() const { return mErrorMessage; }
+
+    //! Returns OpenGL functions of the context (null until create() succeeds)
+    QOpenGLFunctions_3_3_Core *functions() const { return mFunctions; }
+
+    //! Releases the framebuffer and the context (also done on destruction)
+    void destroy();
+
+    //! Makes the benchmark run on the "offscreen" platform unless QT_QPA_PLATFORM says otherwise
+    static void useOffscreenPlatform();
+
+  private:
+    QOffscreenSurface *mSurface = nullptr;
+    QOpenGLContext *mContext = nullptr;
+    QOpenGLFramebufferObject *mFbo = nullptr;
+    QOpenGLFunctions_3_3_Core *mFunctions = nullptr;
+    const char *mErrorMessage = "";
+};
+
+/**
+ * Implements main() of a benchmark \a TestObject using OffscreenGl - like QTEST_MAIN(),
+ * but headless by default (see OffscreenGl::useOffscreenPlatform()).
+ */
+#define OFFSCREEN_GL_MAIN( TestObject ) \
+  int main( int argc, char *argv[] ) \
+  { \
+    OffscreenGl::useOffscreenPlatform(); \
+    QGuiApplication app( argc, argv ); \
+    TestObject bench; \
+    return QTest::qExec( &bench, argc, argv ); \
+  }
+
+#endif // OFFSCREENGL_H
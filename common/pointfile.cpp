@@ -0,0 +1,218 @@
+#include "pointfile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+// alignment of the records in the file
+static const int DATA_ALIGNMENT = 16;
+
+
+namespace
+{
+
+  const char MAGIC[4] = { 'P', 'T', 'S', 'F' };
+  const quint32 VERSION = 1;
+
+  struct FileHeader
+  {
+    char magic[4];
+    quint32 version;
+    quint32 count;
+    quint32 stride;
+    quint32 attributeCount;
+    quint32 reserved;
+    float minimum[3];
+    float maximum[3];
+    quint64 dataOffset;
+  };
+
+  struct FileAttribute
+  {
+    char name[24];   // zero terminated
+    quint32 type;
+    quint32 size;
+    quint32 offset;
+    quint32 reserved;
+  };
+
+  static_assert( sizeof( FileHeader ) == 56 && sizeof( FileAttribute ) == 40, "file structures are expected to be packed" );
+
+  //! Returns byte size of a component of the \a type, or 0 if the type is unknown
+  int componentSize( quint32 type )
+  {
+    switch ( type )
+    {
+      case Qt3DRender::QAttribute::Byte:
+      case Qt3DRender::QAttribute::UnsignedByte:
+        return 1;
+      case Qt3DRender::QAttribute::Short:
+      case Qt3DRender::QAttribute::UnsignedShort:
+      case Qt3DRender::QAttribute::HalfFloat:
+        return 2;
+      case Qt3DRender::QAttribute::Int:
+      case Qt3DRender::QAttribute::UnsignedInt:
+      case Qt3DRender::QAttribute::Float:
+        return 4;
+      case Qt3DRender::QAttribute::Double:
+        return 8;
+      default:
+        return 0;
+    }
+  }
+
+}
+
+
+PointFile::PointFile( const QString &path )
+  : mFile( path )
+{
+  if ( !mFile.open( QIODevice::ReadOnly ) || mFile.size() < static_cast<qint64>( sizeof( FileHeader ) ) )
+    return;
+
+  const uchar *mapped = mFile.map( 0, mFile.size() );
+  if ( !mapped )
+    return;
+
+  FileHeader header;
+  std::memcpy( &header, mapped, sizeof( header ) );
+  const qint64 tableEnd = sizeof( FileHeader ) + static_cast<qint64>( header.attributeCount ) * sizeof( FileAttribute );
+  const qint64 dataSize = static_cast<qint64>( header.count ) * header.stride;
+  if ( std::memcmp( header.magic, MAGIC, sizeof( MAGIC ) ) != 0 || header.version != VERSION ||
+       tableEnd > static_cast<qint64>( header.dataOffset ) || header.dataOffset % DATA_ALIGNMENT != 0 ||
+       static_cast<qint64>( header.dataOffset ) + dataSize > mFile.size() ||
+       dataSize > std::numeric_limits<int>::max() )   // the records need to fit into a QByteArray
+    return;
+
+  QVector<Attribute> attributes;
+  for ( quint32 i = 0; i < header.attributeCount; ++i )
+  {
+    FileAttribute fileAttribute;
+    std::memcpy( &fileAttribute, mapped + sizeof( FileHeader ) + i * sizeof( FileAttribute ), sizeof( fileAttribute ) );
+    fileAttribute.name[sizeof( fileAttribute.name ) - 1] = 0;
+
+    // reject corrupted tables - unknown types, or components beyond the record
+    const int typeSize = componentSize( fileAttribute.type );
+    if ( typeSize == 0 || fileAttribute.size == 0 ||
+         static_cast<qint64>( fileAttribute.offset ) + static_cast<qint64>( fileAttribute.size ) * typeSize > header.stride )
+      return;
+
+    Attribute attribute;
+    attribute.name = QString::fromLatin1( fileAttribute.name );
+    attribute.type = static_cast<Qt3DRender::QAttribute::VertexBaseType>( fileAttribute.type );
+    attribute.size = fileAttribute.size;
+    attribute.offset = fileAttribute.offset;
+    attributes.append( attribute );
+  }
+
+  mRecords = reinterpret_cast<const char *>( mapped + header.dataOffset );
+  mCount = header.count;
+  mStride = header.stride;
+  mAttributes = attributes;
+  mMinimum = QVector3D( header.minimum[0], header.minimum[1], header.minimum[2] );
+  mMaximum = QVector3D( header.maximum[0], header.maximum[1], header.maximum[2] );
+}
+
+const PointFile::Attribute *PointFile::attribute( const QString &name ) const
+{
+  for ( const Attribute &attribute : mAttributes )
+  {
+    if ( attribute.name == name )
+      return &attribute;
+  }
+  return nullptr;
+}
+
+bool PointFile::write( const QString &path, const QVector<Attribute> &attributes, int stride, const QByteArray &records )
+{
+  Q_ASSERT( stride > 0 && records.size() % stride == 0 );
+
+  FileHeader header = {};
+  std::memcpy( header.magic, MAGIC, sizeof( MAGIC ) );
+  header.version = VERSION;
+  header.count = records.size() / stride;
+  header.stride = stride;
+  header.attributeCount = attributes.count();
+  const qint64 tableEnd = sizeof( FileHeader ) + attributes.count() * sizeof( FileAttribute );
+  header.dataOffset = ( tableEnd + DATA_ALIGNMENT - 1 ) / DATA_ALIGNMENT * DATA_ALIGNMENT;
+
+  QVector<FileAttribute> fileAttributes( attributes.count() );
+  int positionOffset = -1;
+  for ( int i = 0; i < attributes.count(); ++i )
+  {
+    const Attribute &attribute = attributes[i];
+    FileAttribute &fileAttribute = fileAttributes[i];
+    fileAttribute = FileAttribute();
+    const QByteArray name = attribute.name.toLatin1();
+    std::memcpy( fileAttribute.name, name.constData(), std::min<int>( name.size(), sizeof( fileAttribute.name ) - 1 ) );
+    fileAttribute.type = attribute.type;
+    fileAttribute.size = attribute.size;
+    fileAttribute.offset = attribute.offset;
+    if ( attribute.name == Qt3DRender::QAttribute::defaultPositionAttributeName() && attribute.type == Qt3DRender::QAttribute::Float && attribute.size == 3 )
+      positionOffset = attribute.offset;
+  }
+
+  // bounding box of positions
+  for ( int i = 0; i < 3; ++i )
+  {
+    header.minimum[i] = std::numeric_limits<float>::max();
+    header.maximum[i] = -std::numeric_limits<float>::max();
+  }
+  if ( positionOffset >= 0 )
+  {
+    for ( quint32 r = 0; r < header.count; ++r )
+    {
+      float position[3];
+      std::memcpy( position, records.constData() + r * stride + positionOffset, sizeof( position ) );
+      for ( int i = 0; i < 3; ++i )
+      {
+        header.minimum[i] = std::min( header.minimum[i], position[i] );
+        header.maximum[i] = std::max( header.maximum[i], position[i] );
+      }
+    }
+  }
+
+  QFile file( path );
+  if ( !file.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+    return false;
+
+  const QByteArray padding( header.dataOffset - tableEnd, 0 );
+  return file.write( reinterpret_cast<const char *>( &header ), sizeof( header ) ) == sizeof( header ) &&
+         file.write( reinterpret_cast<const char *>( fileAttributes.constData() ), fileAttributes.count() * sizeof( FileAttribute ) ) == static_cast<qint64>( fileAttributes.count() * sizeof( FileAttribute ) ) &&
+         file.write( padding ) == padding.size() &&
+         file.write( records ) == records.size();
+}
+
+bool PointFile::write( const QString &path, const QVector<QVector3D> &points )
+{
+  static_assert( sizeof( QVector3D ) == 3 * sizeof( float ), "QVector3D is expected to be packed" );
+
+  Attribute position;
+  position.name = Qt3DRender::QAttribute::defaultPositionAttributeName();
+  const QByteArray records = QByteArray::fromRawData( reinterpret_cast<const char *>( points.constData() ), points.count() * sizeof( QVector3D ) );
+  return write( path, QVector<Attribute>() << position, sizeof( QVector3D ), records );
+}
+
+
+PointFileDataGenerator::PointFileDataGenerator( QSharedPointer<const PointFile> file )
+  : mFile( file )
+{
+}
+
+QByteArray PointFileDataGenerator::operator()()
+{
+  return mFile->rawData();
+}
+
+bool PointFileDataGenerator::operator ==( const Qt3DRender::QBufferDataGenerator &other ) const
+{
+  const PointFileDataGenerator *otherGenerator = functor_cast<PointFileDataGenerator>( &other );
+  return otherGenerator && otherGenerator->mFile == mFile;
+}
+
+
+QByteArray copyGeneratedData( const Qt3DRender::QBufferDataGeneratorPtr &generator )
+{
+  const QByteArray data = ( *generator )();
+  return QByteArray( data.constData(), data.size() );
+}
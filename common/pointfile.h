@@ -0,0 +1,128 @@
+#ifndef POINTFILE_H
+#define POINTFILE_H
+
+#include <Qt3DRender/QAttribute>
+#include <Qt3DRender/QBufferDataGenerator>
+
+#include <QFile>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+#include <QVector3D>
+
+/**
+ * Binary file with points (or vertices, or instances) stored as interleaved records
+ * exactly as they are uploaded to the GPU, so that they can be used without any parsing.
+ *
+ * The file gets memory mapped: data() points directly to the records in the mapping and
+ * PointFileDataGenerator hands them to a QBuffer without copying - the records are only
+ * read from the disk (by the OS, page by page) when Qt3D uploads them.
+ *
+ * File layout (native byte order):
+ *
+ * - header: magic "PTSF", version, record count, record stride, attribute count,
+ *   bounding box of positions and byte offset of the records (aligned to 16 bytes)
+ * - attribute table: name, vertex base type (Qt3DRender::QAttribute::VertexBaseType),
+ *   number of components and byte offset within the record of each attribute
+ * - records
+ *
+ * Positions are the "vertexPosition" attribute (three floats).
+ */
+class PointFile
+{
+  public:
+    //! Attribute of records
+    struct Attribute
+    {
+      QString name;
+      /**
+       * Type of components. Integer types reach shaders normalized to [0, 1] (or [-1, 1]):
+       * Qt3D always passes normalized = true to glVertexAttribPointer(). The same goes for
+       * all integer attributes of the demos' buffers.
+       */
+      Qt3DRender::QAttribute::VertexBaseType type = Qt3DRender::QAttribute::Float;
+      int size = 3;     //!< Number of components
+      int offset = 0;   //!< Byte offset within a record
+    };
+
+    //! Maps the file at \a path (check isValid() afterwards)
+    explicit PointFile( const QString &path );
+
+    //! Returns whether the file got mapped and its header is fine
+    bool isValid() const { return mRecords; }
+
+    //! Returns number of records
+    int count() const { return mCount; }
+
+    //! Returns byte size of a record
+    int stride() const { return mStride; }
+
+    //! Returns attributes of records
+    const QVector<Attribute> &attributes() const { return mAttributes; }
+
+    //! Returns the attribute with the given \a name (null if there is none)
+    const Attribute *attribute( const QString &name ) const;
+
+    //! Returns the position attribute (null if there is none)
+    const Attribute *positionAttribute() const { return attribute( Qt3DRender::QAttribute::defaultPositionAttributeName() ); }
+
+    //! Returns minimum corner of the bounding box of positions
+    QVector3D minimum() const { return mMinimum; }
+
+    //! Returns maximum corner of the bounding box of positions
+    QVector3D maximum() const { return mMaximum; }
+
+    //! Returns the mapped records (count() * stride() bytes)
+    const char *data() const { return mRecords; }
+
+    //! Returns the mapped records wrapped in a byte array without copying (only valid while the file exists)
+    QByteArray rawData() const { return QByteArray::fromRawData( mRecords, mCount * mStride ); }
+
+    /**
+     * Writes \a records (\a stride bytes each) with the given \a attributes to \a path, returns false on error.
+     * The bounding box gets calculated from the position attribute.
+     */
+    static bool write( const QString &path, const QVector<Attribute> &attributes, int stride, const QByteArray &records );
+
+    //! Writes \a points as records with just a position
+    static bool write( const QString &path, const QVector<QVector3D> &points );
+
+  private:
+    Q_DISABLE_COPY( PointFile )
+
+    QFile mFile;
+    const char *mRecords = nullptr;
+    int mCount = 0;
+    int mStride = 0;
+    QVector<Attribute> mAttributes;
+    QVector3D mMinimum, mMaximum;
+};
+
+
+/**
+ * Hands records of a PointFile to a QBuffer: they get wrapped without copying when
+ * Qt3D runs the generator, and the generator keeps the file mapped for as long as Qt3D needs it.
+ * Generators of the same file compare equal, so setting the same file again does not reload it.
+ */
+class PointFileDataGenerator : public Qt3DRender::QBufferDataGenerator
+{
+  public:
+    explicit PointFileDataGenerator( QSharedPointer<const PointFile> file );
+
+    QByteArray operator()() override;
+    bool operator ==( const Qt3DRender::QBufferDataGenerator &other ) const override;
+
+    QT3D_FUNCTOR( PointFileDataGenerator )
+
+  private:
+    QSharedPointer<const PointFile> mFile;
+};
+
+/**
+ * Runs the buffer data \a generator and returns a deep copy of its data, for buffers that
+ * drop their generator (e.g. to be updated partially). Data of a PointFileDataGenerator just
+ * wraps the mapped file, which may get unmapped together with the generator.
+ */
+QByteArray copyGeneratedData( const Qt3DRender::QBufferDataGeneratorPtr &generator );
+
+#endif // POINTFILE_H
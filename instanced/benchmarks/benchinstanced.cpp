@@ -0,0 +1,318 @@
+/**
+ * Benchmark of updating animated instances: replacing the whole buffer on each frame
+ * (a newly encoded array uploaded with glBufferData, like InstanceBuffer::setInstances())
+ * vs. InstanceStream with one to three buffers in rotation, writing just the modified
+ * ranges with glBufferSubData from its staging arrays.
+ *
+ * Each frame moves a share of COUNT instances, updates the buffer and draws all of them
+ * (small octahedra with instanced.vert + instanced.frag) to an offscreen framebuffer with
+ * plain OpenGL (no window, no Qt3D). Frames are not waited for, so an update may have to wait
+ * for the GPU to finish drawing from the buffer it writes. Runs on the "offscreen" platform
+ * by default - set QT_QPA_PLATFORM to use another one (e.g. "xcb" with Xvfb). Each case prints
+ * the update latency (encoding and upload calls), the frame time and heap allocations per
+ * update (counted with glibc only). Use "-csv" for machine-readable output.
+ *
+ * The streaming cases call InstanceStream::prepareUploads() and write the uploads with plain
+ * OpenGL - InstanceStream::commit() (passing them to QBuffer::updateData()) and Qt3D's own
+ * handling of buffer updates are not measured, neither their time nor their allocations.
+ */
+
+#include <cstdlib>
+
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QOpenGLShaderProgram>
+#include <QRandomGenerator>
+
+#include <atomic>
+#include <cmath>
+
+#include "instancebuffer.h"
+#include "instancestream.h"
+#include "offscreengl.h"
+
+
+#if defined( __GLIBC__ )
+// glibc lets the executable replace malloc and friends - count all heap allocations of the process
+extern "C" void *__libc_malloc( size_t size );
+extern "C" void *__libc_calloc( size_t count, size_t size );
+extern "C" void *__libc_realloc( void *ptr, size_t size );
+
+static std::atomic<qint64> sAllocations( 0 );
+
+extern "C" void *malloc( size_t size )
+{
+    sAllocations.fetch_add( 1, std::memory_order_relaxed );
+    return __libc_malloc( size );
+}
+
+extern "C" void *calloc( size_t count, size_t size )
+{
+    sAllocations.fetch_add( 1, std::memory_order_relaxed );
+    return __libc_calloc( count, size );
+}
+
+extern "C" void *realloc( void *ptr, size_t size )
+{
+    sAllocations.fetch_add( 1, std::memory_order_relaxed );
+    return __libc_realloc( ptr, size );
+}
+
+#define ALLOCATIONS_COUNTED 1
+static qint64 allocationCount() { return sAllocations.load( std::memory_order_relaxed ); }
+#else
+#define ALLOCATIONS_COUNTED 0
+static qint64 allocationCount() { return 0; }
+#endif
+
+
+class BenchInstanced : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void update_data();
+    void update();
+
+  private:
+    static const int WIDTH = 1600;
+    static const int HEIGHT = 800;
+    static const int COUNT = 100000;
+    static const int MESH_VERTICES = 24;
+
+    //! Moves the first \a movingCount instances to where they are at \a time
+    void animate( int movingCount, float time );
+
+    OffscreenGl mOffscreen;
+    QOpenGLFunctions_3_3_Core *mGl = nullptr;
+
+    QOpenGLShaderProgram mProgram;
+
+    GLuint mMeshBuffer = 0;
+    GLuint mInstanceBuffers[InstanceStream::MAX_BUFFERS] = { 0, 0, 0 };
+    GLuint mVaos[InstanceStream::MAX_BUFFERS] = { 0, 0, 0 };
+
+    QVector<Instance> mInstances;
+    QVector<QVector3D> mCenters;   //!< Instances circle around these
+    QVector<float> mPhases;
+};
+
+
+void BenchInstanced::initTestCase()
+{
+    if ( !mOffscreen.create( WIDTH, HEIGHT ) )
+        QSKIP( mOffscreen.errorMessage() );
+    mGl = mOffscreen.functions();
+
+    // Qt3D resolves the include of the fragment shader, here it is done by hand
+    QFile fragmentFile( ":/shaders/instanced.frag" ), lightFile( ":/shaders/light.inc.frag" );
+    QVERIFY( fragmentFile.open( QIODevice::ReadOnly ) && lightFile.open( QIODevice::ReadOnly ) );
+    const QByteArray fragmentSource = fragmentFile.readAll().replace( "#pragma include light.inc.frag", lightFile.readAll() );
+    QVERIFY( mProgram.addShaderFromSourceFile( QOpenGLShader::Vertex, ":/shaders/instanced.vert" ) );
+    QVERIFY( mProgram.addShaderFromSourceCode( QOpenGLShader::Fragment, fragmentSource ) );
+    QVERIFY( mProgram.link() );
+
+    // octahedron with flat normals: [x, y, z] [nx, ny, nz]
+    QVector<float> mesh;
+    for ( int face = 0; face < 8; ++face )
+    {
+        const QVector3D x( face & 1 ? -0.3f : 0.3f, 0, 0 ), y( 0, face & 2 ? -0.3f : 0.3f, 0 ), z( 0, 0, face & 4 ? -0.3f : 0.3f );
+        const QVector3D normal = ( x + y + z ).normalized();
+        for ( const QVector3D &corner : { x, y, z } )
+            mesh << corner.x() << corner.y() << corner.z() << normal.x() << normal.y() << normal.z();
+    }
+    QCOMPARE( mesh.count(), MESH_VERTICES * 6 );
+
+    // a grid of objects, each circling around its own center
+    QRandomGenerator random( 1 );
+    const int side = std::ceil( std::sqrt( COUNT ) );
+    for ( int i = 0; i < COUNT; ++i )
+    {
+        mCenters << QVector3D( ( i % side ) * 2.f - side, 0, ( i / side ) * -2.f );
+        mPhases << random.bounded( 2 * M_PI );
+        Instance instance;
+        instance.rotation = QQuaternion::fromAxisAndAngle( 0, 1, 0, random.bounded( 360. ) );
+        mInstances << instance;
+    }
+    animate( COUNT, 0 );
+
+    QVector3D origin, extent;
+    const QByteArray instanceData = InstanceBuffer::encodeInstances( mInstances, InstanceBuffer::Float32, origin, extent );
+
+    mGl->glGenBuffers( 1, &mMeshBuffer );
+    mGl->glBindBuffer( GL_ARRAY_BUFFER, mMeshBuffer );
+    mGl->glBufferData( GL_ARRAY_BUFFER, mesh.count() * sizeof( float ), mesh.constData(), GL_STATIC_DRAW );
+
+    // a vertex array for each buffer of the rotation: the mesh + instances in the Float32 encoding
+    struct Attribute
+    {
+        const char *name;
+        GLint size;
+        int offset;
+    };
+    const Attribute instanceAttributes[] = { { "pos", 3, 0 }, { "instanceRotation", 4, 12 }, { "instanceScale", 3, 28 } };
+    const int stride = InstanceBuffer::instanceStride( InstanceBuffer::Float32 );
+
+    mGl->glGenBuffers( InstanceStream::MAX_BUFFERS, mInstanceBuffers );
+    mGl->glGenVertexArrays( InstanceStream::MAX_BUFFERS, mVaos );
+    for ( int i = 0; i < InstanceStream::MAX_BUFFERS; ++i )
+    {
+        mGl->glBindVertexArray( mVaos[i] );
+        mGl->glBindBuffer( GL_ARRAY_BUFFER, mMeshBuffer );
+        const GLint positionLocation = mProgram.attributeLocation( "vertexPosition" );
+        const GLint normalLocation = mProgram.attributeLocation( "vertexNormal" );
+        mGl->glEnableVertexAttribArray( positionLocation );
+        mGl->glVertexAttribPointer( positionLocation, 3, GL_FLOAT, GL_FALSE, 6 * sizeof( float ), nullptr );
+        mGl->glEnableVertexAttribArray( normalLocation );
+        mGl->glVertexAttribPointer( normalLocation, 3, GL_FLOAT, GL_FALSE, 6 * sizeof( float ), reinterpret_cast<void *>( 3 * sizeof( float ) ) );
+
+        mGl->glBindBuffer( GL_ARRAY_BUFFER, mInstanceBuffers[i] );
+        mGl->glBufferData( GL_ARRAY_BUFFER, instanceData.size(), instanceData.constData(), GL_DYNAMIC_DRAW );
+        for ( const Attribute &attribute : instanceAttributes )
+        {
+            const GLint location = mProgram.attributeLocation( attribute.name );
+            QVERIFY( location >= 0 );
+            mGl->glEnableVertexAttribArray( location );
+            mGl->glVertexAttribPointer( location, attribute.size, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void *>( attribute.offset ) );
+            mGl->glVertexAttribDivisor( location, 1 );
+        }
+    }
+    mGl->glBindVertexArray( 0 );
+
+    QMatrix4x4 projection, view;
+    projection.perspective( 45, float( WIDTH ) / HEIGHT, 0.1f, 2000 );
+    view.lookAt( QVector3D( 0, 120, 80 ), QVector3D( 0, 0, -300 ), QVector3D( 0, 1, 0 ) );
+    mProgram.bind();
+    mProgram.setUniformValue( "modelViewProjection", projection * view );
+    mProgram.setUniformValue( "inst", QMatrix4x4() );
+    mProgram.setUniformValue( "instNormal", QMatrix4x4() );
+    mProgram.setUniformValue( "useInstanceTransform", true );
+    mProgram.setUniformValue( "instanceOrigin", origin );
+    mProgram.setUniformValue( "instanceExtent", extent );
+    mProgram.setUniformValue( "ka", QVector3D( 0.1f, 0.1f, 0.1f ) );
+    mProgram.setUniformValue( "kd", QVector3D( 0.7f, 0.5f, 0.2f ) );
+    mProgram.setUniformValue( "ks", QVector3D( 0.2f, 0.2f, 0.2f ) );
+    mProgram.setUniformValue( "shininess", 50.f );
+    mProgram.setUniformValue( "eyePosition", QVector3D( 0, 120, 80 ) );
+    mProgram.setUniformValue( "lightCount", 1 );
+    mProgram.setUniformValue( "lights[0].type", 1 );   // directional
+    mProgram.setUniformValue( "lights[0].direction", QVector3D( -1, -2, -1 ).normalized() );
+    mProgram.setUniformValue( "lights[0].color", QVector3D( 1, 1, 1 ) );
+    mProgram.setUniformValue( "lights[0].intensity", 1.f );
+
+    qInfo( "%d instances, allocations %s", COUNT, ALLOCATIONS_COUNTED ? "counted" : "not counted (needs glibc)" );
+    qInfo( "updates cover encoding and OpenGL calls only, not InstanceStream::commit() and Qt3D" );
+}
+
+void BenchInstanced::cleanupTestCase()
+{
+    if ( !mGl )
+        return;
+
+    mGl->glDeleteVertexArrays( InstanceStream::MAX_BUFFERS, mVaos );
+    mGl->glDeleteBuffers( InstanceStream::MAX_BUFFERS, mInstanceBuffers );
+    mGl->glDeleteBuffers( 1, &mMeshBuffer );
+    mOffscreen.destroy();
+}
+
+void BenchInstanced::animate( int movingCount, float time )
+{
+    for ( int i = 0; i < movingCount; ++i )
+    {
+        const float angle = time + mPhases[i];
+        mInstances[i].position = mCenters[i] + QVector3D( std::cos( angle ), 0, std::sin( angle ) ) * 0.5f;
+    }
+}
+
+
+void BenchInstanced::update_data()
+{
+    // buffers: 0 replaces the whole buffer, otherwise the number of buffers in the rotation of InstanceStream
+    QTest::addColumn<int>( "buffers" );
+    QTest::addColumn<double>( "moving" );
+    QTest::newRow( "replace, all moving" ) << 0 << 1.;
+    QTest::newRow( "stream 1 buffer, all moving" ) << 1 << 1.;
+    QTest::newRow( "stream 2 buffers, all moving" ) << 2 << 1.;
+    QTest::newRow( "stream 3 buffers, all moving" ) << 3 << 1.;
+    QTest::newRow( "replace, 10% moving" ) << 0 << 0.1;
+    QTest::newRow( "stream 2 buffers, 10% moving" ) << 2 << 0.1;
+}
+
+void BenchInstanced::update()
+{
+    QFETCH( int, buffers );
+    QFETCH( double, moving );
+    const int movingCount = COUNT * moving;
+
+    InstanceStream stream( std::max( buffers, 1 ) );
+    stream.setInstances( mInstances, InstanceBuffer::Float32 );
+
+    // all buffers start with the instances as they are now (previous cases moved them)
+    QVector3D origin, extent;
+    const QByteArray instanceData = InstanceBuffer::encodeInstances( mInstances, InstanceBuffer::Float32, origin, extent );
+    for ( GLuint instanceBuffer : mInstanceBuffers )
+    {
+        mGl->glBindBuffer( GL_ARRAY_BUFFER, instanceBuffer );
+        mGl->glBufferData( GL_ARRAY_BUFFER, instanceData.size(), instanceData.constData(), GL_DYNAMIC_DRAW );
+    }
+
+    mProgram.bind();
+    QElapsedTimer timer, frameTimer;
+    qint64 updateNs = 0;
+    qint64 allocations = 0;
+    qint64 runs = 0;
+    float time = 0;
+
+    frameTimer.start();
+    QBENCHMARK
+    {
+        // moving the objects is the application's work, not measured
+        time += 0.03f;
+        animate( movingCount, time );
+
+        timer.start();
+        const qint64 allocationsBefore = allocationCount();
+        GLuint vao = mVaos[0];
+        if ( buffers == 0 )
+        {
+            const QByteArray frameData = InstanceBuffer::encodeInstances( mInstances, InstanceBuffer::Float32, origin, extent );
+            mGl->glBindBuffer( GL_ARRAY_BUFFER, mInstanceBuffers[0] );
+            mGl->glBufferData( GL_ARRAY_BUFFER, frameData.size(), frameData.constData(), GL_DYNAMIC_DRAW );
+        }
+        else
+        {
+            for ( int i = 0; i < movingCount; ++i )
+                stream.updateInstance( i, mInstances[i] );
+            const int uploadCount = stream.prepareUploads();
+            mGl->glBindBuffer( GL_ARRAY_BUFFER, mInstanceBuffers[stream.currentIndex()] );
+            for ( int i = 0; i < uploadCount; ++i )
+            {
+                const InstanceStream::Upload &upload = stream.upload( i );
+                mGl->glBufferSubData( GL_ARRAY_BUFFER, upload.offset, upload.data.size(), upload.data.constData() );
+            }
+            vao = mVaos[stream.currentIndex()];
+        }
+        allocations += allocationCount() - allocationsBefore;
+        updateNs += timer.nsecsElapsed();
+
+        mGl->glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+        mGl->glBindVertexArray( vao );
+        mGl->glDrawArraysInstanced( GL_TRIANGLES, 0, MESH_VERTICES, COUNT );
+        mGl->glFlush();
+        ++runs;
+    }
+    mGl->glFinish();   // wait until the GPU is done with all frames
+    const qint64 frameNs = frameTimer.nsecsElapsed();
+
+    QCOMPARE( mGl->glGetError(), static_cast<GLenum>( GL_NO_ERROR ) );
+    qInfo( "%s: update %.0f us, frame %.2f ms, %.1f allocations per update", QTest::currentDataTag(),
+           updateNs / 1e3 / runs, frameNs / 1e6 / runs, double( allocations ) / runs );
+}
+
+
+OFFSCREEN_GL_MAIN( BenchInstanced )
+
+#include "benchinstanced.moc"
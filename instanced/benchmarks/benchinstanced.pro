@@ -0,0 +1,24 @@
+TEMPLATE = app
+TARGET = benchinstanced
+QT += testlib gui 3dcore 3drender
+CONFIG += console
+CONFIG -= app_bundle
+
+# headless benchmark of replacing vs streaming animated instances (see benchinstanced.cpp)
+
+INCLUDEPATH += .. ../../common
+
+SOURCES += \
+    benchinstanced.cpp \
+    ../instancebuffer.cpp \
+    ../instancestream.cpp \
+    ../../common/offscreengl.cpp \
+    ../../common/pointfile.cpp
+
+HEADERS += \
+    ../instancebuffer.h \
+    ../instancestream.h \
+    ../../common/offscreengl.h \
+    ../../common/pointfile.h
+
+RESOURCES += ../shaders.qrc
@@ -0,0 +1,144 @@
+/**
+ * Checks and micro-benchmarks of the kernels classifying instances by InstanceLod
+ * (scalar reference code vs SIMD kernels), on the CPU only.
+ *
+ * A million bounding spheres around the camera - inside, crossing and outside the frustum,
+ * some of them behind the camera or with zero radius - get a level of detail or get culled.
+ * "compare" checks that each SIMD kernel gives the same levels as the scalar one, also
+ * for counts that are not multiples of the vector width and for unaligned inputs.
+ * "classify" measures a single kernel over all the spheres (single thread).
+ *
+ * Runs headless. Use "-csv" for machine-readable output.
+ */
+
+#include <QtTest>
+#include <QRandomGenerator>
+
+#include "instancelod_p.h"
+
+Q_DECLARE_METATYPE( CpuFeatures::Isa )
+
+
+class BenchInstanceLod : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void initTestCase();
+
+    void compare_data();
+    void compare();
+
+    void classify_data();
+    void classify();
+
+  private:
+    static const int COUNT = 1000000;
+
+    void addIsaRows( bool withScalar );
+
+    InstanceLodKernels::CullParameters mParameters;
+    QVector<float> mX, mY, mZ, mRadius;
+};
+
+
+void BenchInstanceLod::initTestCase()
+{
+    qInfo( "Culling kernels picked at runtime: %s", CpuFeatures::isaName( CpuFeatures::bestIsa() ) );
+
+    // the same camera set up as InstanceLod::updateCamera() does
+    QMatrix4x4 projection, view;
+    projection.perspective( 45, 16.f / 9, 0.1f, 1000 );
+    view.lookAt( QVector3D( 0, 0, 50 ), QVector3D( 0, 0, 0 ), QVector3D( 0, 1, 0 ) );
+    const float pixelScale = 1080 / std::tan( qDegreesToRadians( 45.f ) / 2 );
+    mParameters = InstanceLodKernels::cullParameters( projection * view, pixelScale );
+
+    // fixed seed so that all runs work with the same data
+    QRandomGenerator random( 42 );
+    for ( int i = 0; i < COUNT; ++i )
+    {
+        mX << random.bounded( 400.f ) - 200;
+        mY << random.bounded( 400.f ) - 200;
+        mZ << random.bounded( 400.f ) - 300;
+        // from points to spheres covering a good part of the screen
+        mRadius << ( i % 97 == 0 ? 0 : random.bounded( 4.f ) * random.bounded( 4.f ) );
+    }
+}
+
+
+// Rows: "scalar" (optionally), "sse2", "avx" - the instruction sets supported by the running CPU
+void BenchInstanceLod::addIsaRows( bool withScalar )
+{
+    QTest::addColumn<CpuFeatures::Isa>( "isa" );
+
+    for ( CpuFeatures::Isa isa : { CpuFeatures::Isa::Scalar, CpuFeatures::Isa::Sse2, CpuFeatures::Isa::Avx } )
+    {
+        if ( ( withScalar || isa != CpuFeatures::Isa::Scalar ) && CpuFeatures::isSupported( isa ) )
+            QTest::newRow( CpuFeatures::isaName( isa ) ) << isa;
+    }
+}
+
+
+void BenchInstanceLod::compare_data()
+{
+    addIsaRows( false );
+}
+
+void BenchInstanceLod::compare()
+{
+    QFETCH( CpuFeatures::Isa, isa );
+
+    const InstanceLodKernels::ClassifyFunc reference = InstanceLodKernels::classifyKernel( CpuFeatures::Isa::Scalar );
+    const InstanceLodKernels::ClassifyFunc kernel = InstanceLodKernels::classifyKernel( isa );
+
+    QVector<quint8> expected( COUNT ), levels( COUNT );
+    reference( mParameters, mX.constData(), mY.constData(), mZ.constData(), mRadius.constData(), COUNT, expected.data() );
+
+    // all levels and culled instances must be covered for the comparison to mean something
+    int counts[InstanceLod::LOD_COUNT + 1] = {};
+    for ( quint8 level : qAsConst( expected ) )
+        ++counts[level == InstanceLodKernels::CULLED ? InstanceLod::LOD_COUNT : level];
+    for ( int count : counts )
+        QVERIFY( count > 0 );
+
+    kernel( mParameters, mX.constData(), mY.constData(), mZ.constData(), mRadius.constData(), COUNT, levels.data() );
+    QCOMPARE( levels, expected );
+
+    // short inputs (only the remainder or a single vector and the remainder) starting at unaligned offsets
+    for ( int offset = 0; offset < 8; ++offset )
+    {
+        for ( int count = 0; count <= 17; ++count )
+        {
+            levels.fill( 0 );
+            kernel( mParameters, mX.constData() + offset, mY.constData() + offset, mZ.constData() + offset, mRadius.constData() + offset,
+                    count, levels.data() + offset );
+            for ( int i = offset; i < offset + count; ++i )
+                QCOMPARE( levels[i], expected[i] );
+            QCOMPARE( levels[offset + count], quint8( 0 ) );
+        }
+    }
+}
+
+
+void BenchInstanceLod::classify_data()
+{
+    addIsaRows( true );
+}
+
+void BenchInstanceLod::classify()
+{
+    QFETCH( CpuFeatures::Isa, isa );
+
+    const InstanceLodKernels::ClassifyFunc kernel = InstanceLodKernels::classifyKernel( isa );
+    QVector<quint8> levels( COUNT );
+
+    QBENCHMARK
+    {
+        kernel( mParameters, mX.constData(), mY.constData(), mZ.constData(), mRadius.constData(), COUNT, levels.data() );
+    }
+}
+
+
+QTEST_GUILESS_MAIN( BenchInstanceLod )
+
+#include "benchinstancelod.moc"
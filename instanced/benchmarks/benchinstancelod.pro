@@ -0,0 +1,18 @@
+TEMPLATE = app
+TARGET = benchinstancelod
+QT += testlib gui 3dcore 3drender
+CONFIG += console
+CONFIG -= app_bundle
+
+# headless checks and benchmark of the culling kernels of InstanceLod (see benchinstancelod.cpp)
+
+INCLUDEPATH += .. ../../common
+
+SOURCES += \
+    benchinstancelod.cpp \
+    ../instancelodkernels.cpp \
+    ../../common/cpufeatures.cpp
+
+HEADERS += \
+    ../instancelod_p.h \
+    ../../common/cpufeatures.h
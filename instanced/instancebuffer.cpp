@@ -0,0 +1,368 @@
+#include "instancebuffer.h"
+
+#include <QFloat16>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+
+namespace
+{
+
+  //! Types and byte offsets of instance attributes with an encoding (the position is always at the start)
+  struct InstanceLayout
+  {
+    Qt3DRender::QAttribute::VertexBaseType positionType, rotationType, scaleType;
+    int rotationOffset, scaleOffset, stride;
+  };
+
+  const InstanceLayout &instanceLayout( InstanceBuffer::InstanceEncoding encoding )
+  {
+    // attributes are 4-byte aligned
+    static const InstanceLayout layouts[] =
+    {
+      // Float32: [x, y, z] [qx, qy, qz, qw] [sx, sy, sz]
+      { Qt3DRender::QAttribute::Float, Qt3DRender::QAttribute::Float, Qt3DRender::QAttribute::Float, 12, 28, 40 },
+      // Float16: [x, y, z, -] [qx, qy, qz, qw] [sx, sy, sz, -]
+      { Qt3DRender::QAttribute::HalfFloat, Qt3DRender::QAttribute::HalfFloat, Qt3DRender::QAttribute::HalfFloat, 8, 16, 24 },
+      // Quantized: [x, y, z, -] as int16, [qx, qy, qz, qw] as int8, [sx, sy, sz, -] as half floats
+      { Qt3DRender::QAttribute::Short, Qt3DRender::QAttribute::Byte, Qt3DRender::QAttribute::HalfFloat, 8, 12, 20 },
+    };
+    return layouts[encoding];
+  }
+
+  //! Writes \a count \a values to \a out as half floats
+  void writeHalfFloats( char *out, const float *values, int count )
+  {
+    for ( int i = 0; i < count; ++i )
+    {
+      const qfloat16 value( values[i] );
+      std::memcpy( out + i * sizeof( qfloat16 ), &value, sizeof( qfloat16 ) );
+    }
+  }
+
+  //! Writes \a count \a values from [-1, 1] to \a out as normalized signed integers of type T
+  template <typename T>
+  void writeSignedNormalized( char *out, const float *values, int count )
+  {
+    for ( int i = 0; i < count; ++i )
+    {
+      const float clamped = std::min( std::max( values[i], -1.f ), 1.f );
+      const T value = static_cast<T>( std::round( clamped * std::numeric_limits<T>::max() ) );
+      std::memcpy( out + i * sizeof( T ), &value, sizeof( T ) );
+    }
+  }
+
+  //! Encodes \a instances with positions relative to \a origin in units of \a extent
+  QByteArray encodeRecords( const QVector<Instance> &instances, InstanceBuffer::InstanceEncoding encoding, const QVector3D &origin, const QVector3D &extent )
+  {
+    QByteArray instanceData( instances.count() * InstanceBuffer::instanceStride( encoding ), Qt::Uninitialized );
+    InstanceBuffer::writeInstances( instanceData.data(), instances.constData(), instances.count(), encoding, origin, extent );
+    return instanceData;
+  }
+
+  //! Returns \a origin and \a extent of positions of \a instances encoded with the \a encoding
+  void instanceBounds( const QVector<Instance> &instances, InstanceBuffer::InstanceEncoding encoding, QVector3D &origin, QVector3D &extent )
+  {
+    // packed positions are relative to the center of the bounding box (with int16 spanning its half size)
+    origin = QVector3D();
+    extent = QVector3D( 1, 1, 1 );
+    if ( encoding == InstanceBuffer::Float32 || instances.isEmpty() )
+      return;
+
+    QVector3D minimum = instances[0].position, maximum = minimum;
+    for ( const Instance &instance : instances )
+    {
+      for ( int i = 0; i < 3; ++i )
+      {
+        minimum[i] = std::min( minimum[i], instance.position[i] );
+        maximum[i] = std::max( maximum[i], instance.position[i] );
+      }
+    }
+    origin = ( minimum + maximum ) / 2;
+    if ( encoding == InstanceBuffer::Quantized )
+    {
+      const QVector3D halfSize = ( maximum - minimum ) / 2;
+      for ( int i = 0; i < 3; ++i )
+        extent[i] = std::max( halfSize[i], std::numeric_limits<float>::min() );
+    }
+  }
+
+  //! Packs points, or encodes instances, on a Qt3D job thread
+  class InstanceDataGenerator : public Qt3DRender::QBufferDataGenerator
+  {
+    public:
+      explicit InstanceDataGenerator( const QVector<QVector3D> &points )
+        : mPoints( points )
+      {
+      }
+
+      InstanceDataGenerator( const QVector<Instance> &instances, InstanceBuffer::InstanceEncoding encoding, const QVector3D &origin, const QVector3D &extent )
+        : mInstances( instances )
+        , mEncoding( encoding )
+        , mOrigin( origin )
+        , mExtent( extent )
+      {
+      }
+
+      QByteArray operator()() override
+      {
+        if ( !mInstances.isEmpty() )
+          return encodeRecords( mInstances, mEncoding, mOrigin, mExtent );
+
+        QByteArray instanceData;
+        instanceData.resize( mPoints.count() * 3 * sizeof( float ) );
+        float *out = reinterpret_cast<float *>( instanceData.data() );
+        for ( const QVector3D &point : mPoints )
+        {
+          *out++ = point.x();
+          *out++ = point.y();
+          *out++ = point.z();
+        }
+        return instanceData;
+      }
+
+      bool operator ==( const Qt3DRender::QBufferDataGenerator &other ) const override
+      {
+        const InstanceDataGenerator *otherGenerator = functor_cast<InstanceDataGenerator>( &other );
+        return otherGenerator && otherGenerator->mEncoding == mEncoding && otherGenerator->mOrigin == mOrigin &&
+               otherGenerator->mExtent == mExtent && otherGenerator->mPoints == mPoints && otherGenerator->mInstances == mInstances;
+      }
+
+      QT3D_FUNCTOR( InstanceDataGenerator )
+
+    private:
+      QVector<QVector3D> mPoints;
+      QVector<Instance> mInstances;
+      InstanceBuffer::InstanceEncoding mEncoding = InstanceBuffer::Float32;
+      QVector3D mOrigin;
+      QVector3D mExtent = QVector3D( 1, 1, 1 );
+  };
+
+}
+
+
+InstanceBuffer::InstanceBuffer( Qt3DCore::QNode *parent )
+  : Qt3DRender::QBuffer( Qt3DRender::QBuffer::VertexBuffer, parent )
+{
+}
+
+void InstanceBuffer::attachTo( Qt3DRender::QGeometry *geometry )
+{
+  if ( !geometry || positionAttribute( geometry ) )
+    return;
+
+  // otherwise the first attribute would take it (and delete it with the attribute)
+  if ( !parent() )
+    setParent( geometry );
+
+  // (integer types are normalized, see PointFile::Attribute::type)
+  Attachment attachment;
+  attachment.geometry = geometry;
+  attachment.position = new Qt3DRender::QAttribute( this, QStringLiteral( "pos" ), Qt3DRender::QAttribute::Float, 3, 0, 0, 0, geometry );
+  attachment.rotation = new Qt3DRender::QAttribute( this, QStringLiteral( "instanceRotation" ), Qt3DRender::QAttribute::Float, 4, 0, 0, 0, geometry );
+  attachment.scale = new Qt3DRender::QAttribute( this, QStringLiteral( "instanceScale" ), Qt3DRender::QAttribute::Float, 3, 0, 0, 0, geometry );
+  for ( Qt3DRender::QAttribute *attribute : { attachment.position.data(), attachment.rotation.data(), attachment.scale.data() } )
+    attribute->setDivisor( 1 );
+  geometry->addAttribute( attachment.position );
+
+  mAttachments.append( attachment );
+  updateAttachment( attachment );
+}
+
+void InstanceBuffer::detachFrom( Qt3DRender::QGeometry *geometry )
+{
+  for ( int i = 0; i < mAttachments.count(); ++i )
+  {
+    const Attachment &attachment = mAttachments[i];
+    if ( attachment.geometry != geometry )
+      continue;
+
+    for ( Qt3DRender::QAttribute *attribute : { attachment.position.data(), attachment.rotation.data(), attachment.scale.data() } )
+    {
+      if ( attribute && geometry->attributes().contains( attribute ) )
+        geometry->removeAttribute( attribute );
+      delete attribute;
+    }
+    mAttachments.removeAt( i );
+    return;
+  }
+}
+
+Qt3DRender::QAttribute *InstanceBuffer::positionAttribute( Qt3DRender::QGeometry *geometry ) const
+{
+  for ( const Attachment &attachment : mAttachments )
+  {
+    if ( attachment.geometry == geometry )
+      return attachment.position;
+  }
+  return nullptr;
+}
+
+void InstanceBuffer::setPoints( const QVector<QVector3D> &points )
+{
+  mCount = points.count();
+  mPointStride = 3 * sizeof( float );
+  mPointOffset = 0;
+  setData( QByteArray() );
+  setDataGenerator( QSharedPointer<InstanceDataGenerator>::create( points ) );
+  setLayout( false, Float32, QVector3D(), QVector3D( 1, 1, 1 ) );
+
+  emit countChanged( mCount );
+}
+
+void InstanceBuffer::setPoints( QSharedPointer<const PointFile> file )
+{
+  const PointFile::Attribute *position = file->positionAttribute();
+  Q_ASSERT( position && position->type == Qt3DRender::QAttribute::Float && position->size == 3 );
+
+  mCount = file->count();
+  mPointStride = file->stride();
+  mPointOffset = position->offset;
+  setData( QByteArray() );
+  setDataGenerator( QSharedPointer<PointFileDataGenerator>::create( file ) );
+  setLayout( false, Float32, QVector3D(), QVector3D( 1, 1, 1 ) );
+
+  emit countChanged( mCount );
+}
+
+void InstanceBuffer::setInstances( const QVector<Instance> &instances, InstanceEncoding encoding )
+{
+  // just the bounding box is needed here, the encoding happens in the generator
+  QVector3D origin, extent;
+  instanceBounds( instances, encoding, origin, extent );
+
+  mCount = instances.count();
+  setData( QByteArray() );
+  setDataGenerator( QSharedPointer<InstanceDataGenerator>::create( instances, encoding, origin, extent ) );
+  setLayout( true, encoding, origin, extent );
+
+  emit countChanged( mCount );
+}
+
+void InstanceBuffer::setInstanceData( const QByteArray &data, InstanceEncoding encoding, const QVector3D &origin, const QVector3D &extent )
+{
+  mCount = data.size() / instanceStride( encoding );
+  setInstanceBytes( data );
+  setLayout( true, encoding, origin, extent );
+
+  emit countChanged( mCount );
+}
+
+void InstanceBuffer::updateInstances( int first, const QVector<Instance> &instances )
+{
+  Q_ASSERT( mHasTransforms && first >= 0 && first + instances.count() <= mCount );
+  detachGenerator();
+  updateData( first * instanceStride( mEncoding ), encodeRecords( instances, mEncoding, mOrigin, mExtent ) );
+}
+
+int InstanceBuffer::instanceStride( InstanceEncoding encoding )
+{
+  return instanceLayout( encoding ).stride;
+}
+
+void InstanceBuffer::writeInstances( char *out, const Instance *instances, int count, InstanceEncoding encoding, const QVector3D &origin, const QVector3D &extent )
+{
+  const InstanceLayout &layout = instanceLayout( encoding );
+  for ( int i = 0; i < count; ++i )
+  {
+    const Instance &instance = instances[i];
+    const QVector3D p = ( instance.position - origin ) / extent;
+    const QQuaternion q = instance.rotation.normalized();
+    const float position[3] = { p.x(), p.y(), p.z() };
+    const float rotation[4] = { q.x(), q.y(), q.z(), q.scalar() };
+    const float scale[3] = { instance.scale.x(), instance.scale.y(), instance.scale.z() };
+    std::memset( out, 0, layout.stride );   // padding
+    switch ( encoding )
+    {
+      case Float32:
+        std::memcpy( out, position, sizeof( position ) );
+        std::memcpy( out + layout.rotationOffset, rotation, sizeof( rotation ) );
+        std::memcpy( out + layout.scaleOffset, scale, sizeof( scale ) );
+        break;
+      case Float16:
+        writeHalfFloats( out, position, 3 );
+        writeHalfFloats( out + layout.rotationOffset, rotation, 4 );
+        writeHalfFloats( out + layout.scaleOffset, scale, 3 );
+        break;
+      case Quantized:
+        writeSignedNormalized<qint16>( out, position, 3 );
+        writeSignedNormalized<qint8>( out + layout.rotationOffset, rotation, 4 );
+        writeHalfFloats( out + layout.scaleOffset, scale, 3 );
+        break;
+    }
+    out += layout.stride;
+  }
+}
+
+QByteArray InstanceBuffer::encodeInstances( const QVector<Instance> &instances, InstanceEncoding encoding, QVector3D &origin, QVector3D &extent )
+{
+  instanceBounds( instances, encoding, origin, extent );
+  return encodeRecords( instances, encoding, origin, extent );
+}
+
+void InstanceBuffer::setLayout( bool transforms, InstanceEncoding encoding, const QVector3D &origin, const QVector3D &extent )
+{
+  mHasTransforms = transforms;
+  mEncoding = encoding;
+  mOrigin = origin;
+  mExtent = extent;
+
+  // drop geometries that got deleted in the meantime
+  mAttachments.erase( std::remove_if( mAttachments.begin(), mAttachments.end(), []( const Attachment & attachment )
+  {
+    return !attachment.geometry;
+  } ), mAttachments.end() );
+
+  for ( const Attachment &attachment : qAsConst( mAttachments ) )
+    updateAttachment( attachment );
+
+  emit layoutChanged();
+}
+
+void InstanceBuffer::setInstanceBytes( const QByteArray &data )
+{
+  setDataGenerator( Qt3DRender::QBufferDataGeneratorPtr() );
+  setData( data );
+}
+
+void InstanceBuffer::detachGenerator()
+{
+  const Qt3DRender::QBufferDataGeneratorPtr generator = dataGenerator();
+  if ( !generator )
+    return;
+
+  setInstanceBytes( copyGeneratedData( generator ) );
+}
+
+void InstanceBuffer::updateAttachment( const Attachment &attachment ) const
+{
+  if ( !attachment.geometry )
+    return;
+
+  const InstanceLayout &layout = instanceLayout( mEncoding );
+  attachment.position->setVertexBaseType( mHasTransforms ? layout.positionType : Qt3DRender::QAttribute::Float );
+  attachment.position->setByteStride( mHasTransforms ? layout.stride : mPointStride );
+  attachment.position->setByteOffset( mHasTransforms ? 0 : mPointOffset );
+  attachment.position->setCount( mCount );
+
+  attachment.rotation->setVertexBaseType( layout.rotationType );
+  attachment.rotation->setByteOffset( layout.rotationOffset );
+  attachment.rotation->setByteStride( layout.stride );
+  attachment.scale->setVertexBaseType( layout.scaleType );
+  attachment.scale->setByteOffset( layout.scaleOffset );
+  attachment.scale->setByteStride( layout.stride );
+
+  Qt3DRender::QGeometry *geometry = attachment.geometry;
+  for ( Qt3DRender::QAttribute *attribute : { attachment.rotation.data(), attachment.scale.data() } )
+  {
+    attribute->setCount( mCount );
+    const bool attached = geometry->attributes().contains( attribute );
+    if ( mHasTransforms && !attached )
+      geometry->addAttribute( attribute );
+    else if ( !mHasTransforms && attached )
+      geometry->removeAttribute( attribute );
+  }
+}
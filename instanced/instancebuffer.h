@@ -0,0 +1,171 @@
+#ifndef INSTANCEBUFFER_H
+#define INSTANCEBUFFER_H
+
+#include <Qt3DRender/QAttribute>
+#include <Qt3DRender/QBuffer>
+#include <Qt3DRender/QGeometry>
+
+#include <QPointer>
+#include <QQuaternion>
+#include <QSharedPointer>
+#include <QVector3D>
+#include <QVector>
+
+#include "pointfile.h"
+
+//! Placement of a single instance: it gets scaled, rotated and then translated
+struct Instance
+{
+  QVector3D position;
+  QQuaternion rotation;
+  QVector3D scale = QVector3D( 1, 1, 1 );
+
+  bool operator==( const Instance &other ) const
+  {
+    return position == other.position && rotation == other.rotation && scale == other.scale;
+  }
+};
+
+
+/**
+ * Buffer with per-instance data that can be attached to any geometry.
+ *
+ * attachTo() adds attributes of instances (with divisor 1) to a geometry - a sphere, a cylinder
+ * or a loaded mesh. Any number of geometries can be attached, all of them reading the same
+ * buffer: e.g. trunks and crowns of trees are two draws with a single upload of instances.
+ * Updates of instances (setInstances(), updateInstances()) only touch this buffer, attributes
+ * of attached geometries are just adjusted when the layout changes.
+ *
+ * With setPoints() instances just have a position. With setInstances() each instance also has
+ * its rotation (a quaternion) and scale, in one of the encodings - from 40 bytes per instance
+ * with floats down to 20 bytes with quantized values (a mat4 would take 64 bytes). Packed
+ * encodings store positions relative to the center of the instances (origin()),
+ * so for large scenes instances should be split into tiles, each with its own buffer.
+ *
+ * All encodings are decoded by the same shader (instanced.vert): integer attributes are normalized
+ * by Qt3D, so the position is origin + pos * extent, and the quaternion just needs to be normalized again.
+ *
+ * setPoints() and setInstances() do not encode on the GUI thread: the buffer gets a data generator
+ * holding the (implicitly shared) instances, which Qt3D runs on its job threads. Setting the same
+ * instances again does not regenerate them.
+ */
+class InstanceBuffer : public Qt3DRender::QBuffer
+{
+  Q_OBJECT
+
+  Q_PROPERTY(int count READ count NOTIFY countChanged)
+  Q_PROPERTY(bool hasTransforms READ hasTransforms NOTIFY layoutChanged)
+  Q_PROPERTY(QVector3D origin READ origin NOTIFY layoutChanged)
+  Q_PROPERTY(QVector3D extent READ extent NOTIFY layoutChanged)
+
+public:
+  //! Encodings of instance data for setInstances()
+  enum InstanceEncoding
+  {
+    Float32,     //!< Position, rotation and scale as floats (40 bytes)
+    Float16,     //!< Position (relative to the origin), rotation and scale as half floats (24 bytes)
+    Quantized,   //!< Position as int16 relative to the origin, rotation as snorm8, scale as half floats (20 bytes)
+  };
+  Q_ENUM(InstanceEncoding)
+
+  InstanceBuffer( Qt3DCore::QNode *parent = nullptr );
+
+  /**
+   * Adds attributes of instances to the \a geometry (the geometry takes their ownership).
+   * A buffer without a parent gets parented to the first geometry it is attached to.
+   */
+  Q_INVOKABLE void attachTo( Qt3DRender::QGeometry *geometry );
+
+  //! Removes attributes of instances from the \a geometry
+  Q_INVOKABLE void detachFrom( Qt3DRender::QGeometry *geometry );
+
+  //! Returns the position attribute added to the \a geometry (null if not attached)
+  Qt3DRender::QAttribute *positionAttribute( Qt3DRender::QGeometry *geometry ) const;
+
+  //! Sets instances with just a position
+  void setPoints( const QVector<QVector3D> &points );
+
+  //! Sets instances with just a position from a memory mapped \a file, without copying them
+  void setPoints( QSharedPointer<const PointFile> file );
+
+  //! Sets instances with position, rotation and scale stored with the given \a encoding
+  void setInstances( const QVector<Instance> &instances, InstanceEncoding encoding = Float32 );
+
+  /**
+   * Sets instances already encoded by encodeInstances() (e.g. a subset of them,
+   * the records can be copied around as they are).
+   */
+  void setInstanceData( const QByteArray &data, InstanceEncoding encoding, const QVector3D &origin, const QVector3D &extent );
+
+  /**
+   * Replaces instances starting at \a first with \a instances, uploading just their records.
+   * They are encoded with the current encoding, origin and extent - with the packed
+   * encodings they need to stay within the bounding box of the instances.
+   */
+  void updateInstances( int first, const QVector<Instance> &instances );
+
+  //! Returns number of instances
+  int count() const { return mCount; }
+
+  //! Returns encoding of instances (Float32 for points)
+  InstanceEncoding encoding() const { return mEncoding; }
+
+  //! Returns whether instances have rotation and scale (i.e. were set by setInstances())
+  bool hasTransforms() const { return mHasTransforms; }
+
+  //! Returns position that instance positions are relative to
+  QVector3D origin() const { return mOrigin; }
+
+  //! Returns scale of decoded instance positions (relative to the origin)
+  QVector3D extent() const { return mExtent; }
+
+  //! Returns byte size of a single instance with the \a encoding
+  static int instanceStride( InstanceEncoding encoding );
+
+  /**
+   * Returns \a instances encoded with the \a encoding (instanceStride() bytes each),
+   * positions are relative to \a origin in units of \a extent.
+   */
+  static QByteArray encodeInstances( const QVector<Instance> &instances, InstanceEncoding encoding, QVector3D &origin, QVector3D &extent );
+
+  /**
+   * Writes \a count \a instances encoded with the \a encoding to \a out (instanceStride() bytes each),
+   * with positions relative to \a origin in units of \a extent.
+   */
+  static void writeInstances( char *out, const Instance *instances, int count, InstanceEncoding encoding, const QVector3D &origin, const QVector3D &extent );
+
+signals:
+  void countChanged( int count );
+  void layoutChanged();
+
+private:
+  //! Attributes of instances added to a geometry
+  struct Attachment
+  {
+    QPointer<Qt3DRender::QGeometry> geometry;
+    QPointer<Qt3DRender::QAttribute> position, rotation, scale;
+  };
+
+  //! Sets up attributes of an attached geometry for the current layout
+  void updateAttachment( const Attachment &attachment ) const;
+
+  //! Sets the layout and updates attributes of all attached geometries
+  void setLayout( bool transforms, InstanceEncoding encoding, const QVector3D &origin, const QVector3D &extent );
+
+  //! Sets \a data as the contents (dropping a data generator)
+  void setInstanceBytes( const QByteArray &data );
+
+  //! Runs the data generator (if there is one) so that the data can be updated in place
+  void detachGenerator();
+
+  QVector<Attachment> mAttachments;
+  int mCount = 0;
+  bool mHasTransforms = false;
+  InstanceEncoding mEncoding = Float32;
+  QVector3D mOrigin;
+  QVector3D mExtent = QVector3D( 1, 1, 1 );
+  int mPointStride = 3 * sizeof( float );   //!< Byte stride of instances without transforms
+  int mPointOffset = 0;                     //!< Byte offset of positions of instances without transforms
+};
+
+#endif // INSTANCEBUFFER_H
@@ -2,7 +2,11 @@
 
 in vec3 vertexPosition;
 in vec3 vertexNormal;
-in vec3 pos;
+
+// per instance (integer encodings come normalized to [-1, 1])
+in vec3 pos;                // position relative to instanceOrigin, in units of instanceExtent
+in vec4 instanceRotation;   // quaternion [x, y, z, w], not necessarily normalized
+in vec3 instanceScale;
 
 out vec3 worldPosition;
 out vec3 worldNormal;
@@ -14,14 +18,35 @@ uniform mat4 modelViewProjection;
 uniform mat4 inst;  // transform of individual object instance
 uniform mat4 instNormal;  // should be mat3 but Qt3D only supports mat4...
 
+uniform bool useInstanceTransform;   // whether instances have rotation and scale
+uniform vec3 instanceOrigin;
+uniform vec3 instanceExtent;
+
+// rotates vector v by unit quaternion q
+vec3 rotate(vec4 q, vec3 v)
+{
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
 void main()
 {
     // TODO: i think this is not entirely correct: the translation by "pos" works
     // like this only because we assume that "inst" matrix only does translation/scale/rotation
     // which all keep "w" set to 1. correctly we should use translation matrix...
-    vec4 offsetPos = inst * vec4(vertexPosition, 1.0) + vec4(pos, 0.0);
+    vec4 instPos = inst * vec4(vertexPosition, 1.0);
+    vec3 instNorm = mat3(instNormal) * vertexNormal;
+
+    if (useInstanceTransform)
+    {
+        // scale, then rotate (normals get the inverse scale)
+        vec4 q = normalize(instanceRotation);
+        instPos.xyz = rotate(q, instPos.xyz * instanceScale);
+        instNorm = rotate(q, instNorm / instanceScale);
+    }
+
+    vec4 offsetPos = instPos + vec4(instanceOrigin + pos * instanceExtent, 0.0);
 
-    worldNormal = normalize(mat3(instNormal) * vertexNormal);
+    worldNormal = normalize(instNorm);
     worldPosition = vec3(offsetPos);
 
     gl_Position = modelViewProjection * offsetPos;
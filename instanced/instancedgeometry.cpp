@@ -1,30 +1,21 @@
 #include "instancedgeometry.h"
 
-#include <Qt3DRender/QAttribute>
-
 
 InstancedGeometry::InstancedGeometry( Qt3DCore::QNode *parent )
   : Qt3DExtras::QSphereGeometry( parent )
-  , mPositionAttribute( new Qt3DRender::QAttribute( this ) )
-  , mInstanceBuffer( new Qt3DRender::QBuffer( Qt3DRender::QBuffer::VertexBuffer, this ) )
+  , mInstanceBuffer( new InstanceBuffer( this ) )
 {
+  mInstanceBuffer->attachTo( this );
+  // note: Qt3D calculates the bounding volume from the encoded positions
+  setBoundingVolumePositionAttribute( mInstanceBuffer->positionAttribute( this ) );
 
-  mPositionAttribute->setAttributeType( Qt3DRender::QAttribute::VertexAttribute );
-  mPositionAttribute->setBuffer( mInstanceBuffer );
-  mPositionAttribute->setVertexBaseType( Qt3DRender::QAttribute::Float );
-  mPositionAttribute->setVertexSize( 3 );
-  mPositionAttribute->setName( Qt3DRender::QAttribute::defaultPositionAttributeName() );
-  mPositionAttribute->setName( QStringLiteral( "pos" ) );
-  mPositionAttribute->setDivisor( 1 );
-  mPositionAttribute->setByteStride( 3 * sizeof( float ) );
-
-  addAttribute( mPositionAttribute );
-  setBoundingVolumePositionAttribute( mPositionAttribute );
+  connect( mInstanceBuffer, &InstanceBuffer::countChanged, this, &InstancedGeometry::countChanged );
+  connect( mInstanceBuffer, &InstanceBuffer::layoutChanged, this, &InstancedGeometry::instanceLayoutChanged );
 }
 
 int InstancedGeometry::count()
 {
-  return mInstanceCount;
+  return mInstanceBuffer->count();
 }
 
 QMatrix4x4 InstancedGeometry::normalMatrix(QMatrix4x4 mat)
@@ -44,21 +35,20 @@ QMatrix4x4 InstancedGeometry::normalMatrix(QMatrix4x4 mat)
 
 void InstancedGeometry::setPoints(const QVector<QVector3D> &vertices)
 {
-  QByteArray vertexBufferData;
-  vertexBufferData.resize( vertices.size() * 3 * sizeof( float ) );
-  float *rawVertexArray = reinterpret_cast<float *>( vertexBufferData.data() );
-  int idx = 0;
-  for ( const auto &v : vertices )
-  {
-    rawVertexArray[idx++] = v.x();
-    rawVertexArray[idx++] = v.y();
-    rawVertexArray[idx++] = v.z();
-  }
+  mInstanceBuffer->setPoints( vertices );
+}
 
-  mInstanceCount = vertices.count();
-  mInstanceBuffer->setData( vertexBufferData );
+void InstancedGeometry::setPoints( QSharedPointer<const PointFile> file )
+{
+  mInstanceBuffer->setPoints( file );
+}
 
-  mPositionAttribute->setCount( mInstanceCount );
+void InstancedGeometry::setInstances( const QVector<Instance> &instances, InstanceBuffer::InstanceEncoding encoding )
+{
+  mInstanceBuffer->setInstances( instances, encoding );
+}
 
-  emit countChanged(mInstanceCount);
+void InstancedGeometry::setInstanceData( const QByteArray &data, InstanceBuffer::InstanceEncoding encoding, const QVector3D &origin, const QVector3D &extent )
+{
+  mInstanceBuffer->setInstanceData( data, encoding, origin, extent );
 }
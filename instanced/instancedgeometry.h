@@ -2,34 +2,67 @@
 #define INSTANCEDGEOMETRY_H
 
 #include <Qt3DExtras/QSphereGeometry>
-#include <Qt3DRender/QBuffer>
 
 #include <QVector3D>
 
 #include <QMatrix4x4>
 
+#include "instancebuffer.h"
+
+
+/**
+ * Sphere geometry with its own InstanceBuffer attached.
+ *
+ * This is a shortcut for the common case of a single mesh per buffer - setting instances
+ * just forwards to the buffer (see InstanceBuffer for the encodings). Other geometries
+ * can be attached to instanceBuffer() as well to draw them at the same placements.
+ */
 class InstancedGeometry : public Qt3DExtras::QSphereGeometry
 {
   Q_OBJECT
 
   Q_PROPERTY(int count READ count NOTIFY countChanged)
+  Q_PROPERTY(bool hasInstanceTransforms READ hasInstanceTransforms NOTIFY instanceLayoutChanged)
+  Q_PROPERTY(QVector3D instanceOrigin READ instanceOrigin NOTIFY instanceLayoutChanged)
+  Q_PROPERTY(QVector3D instanceExtent READ instanceExtent NOTIFY instanceLayoutChanged)
 
 public:
   InstancedGeometry( Qt3DCore::QNode *parent = nullptr );
 
+  //! Returns buffer with the instances (owned by the geometry)
+  InstanceBuffer *instanceBuffer() const { return mInstanceBuffer; }
+
+  //! Sets instances with just a position
   void setPoints( const QVector<QVector3D> &vertices );
 
+  //! Sets instances with just a position from a memory mapped \a file, without copying them
+  void setPoints( QSharedPointer<const PointFile> file );
+
+  //! Sets instances with position, rotation and scale stored with the given \a encoding
+  void setInstances( const QVector<Instance> &instances, InstanceBuffer::InstanceEncoding encoding = InstanceBuffer::Float32 );
+
+  //! Sets instances already encoded by InstanceBuffer::encodeInstances()
+  void setInstanceData( const QByteArray &data, InstanceBuffer::InstanceEncoding encoding, const QVector3D &origin, const QVector3D &extent );
+
   int count();
 
+  //! Returns whether instances have rotation and scale (i.e. were set by setInstances())
+  bool hasInstanceTransforms() const { return mInstanceBuffer->hasTransforms(); }
+
+  //! Returns position that instance positions are relative to
+  QVector3D instanceOrigin() const { return mInstanceBuffer->origin(); }
+
+  //! Returns scale of decoded instance positions (relative to the origin)
+  QVector3D instanceExtent() const { return mInstanceBuffer->extent(); }
+
   Q_INVOKABLE static QMatrix4x4 normalMatrix(QMatrix4x4 mat);
 
 signals:
     void countChanged(int count);
+    void instanceLayoutChanged();
 
 private:
-  Qt3DRender::QAttribute *mPositionAttribute = nullptr;
-  Qt3DRender::QBuffer *mInstanceBuffer = nullptr;
-  int mInstanceCount = 0;
+  InstanceBuffer *mInstanceBuffer = nullptr;
 };
 
 #endif // INSTANCEDGEOMETRY_H
@@ -0,0 +1,209 @@
+#include "instancelod.h"
+#include "instancelod_p.h"
+
+#include <QtMath>
+#include <QtConcurrent/QtConcurrentMap>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// instances processed by a single task when running in parallel
+static const int CHUNK_SIZE = 16384;
+
+// sphere tessellation of levels (rings, slices), from the finest one
+static const int LOD_RINGS[InstanceLod::LOD_COUNT] = { 32, 16, 8, 4 };
+static const int LOD_SLICES[InstanceLod::LOD_COUNT] = { 32, 16, 8, 6 };
+
+using namespace InstanceLodKernels;
+
+
+InstanceLod::InstanceLod( QObject *parent )
+  : QObject( parent )
+{
+  for ( int lod = 0; lod < LOD_COUNT; ++lod )
+  {
+    InstancedGeometry *geometry = new InstancedGeometry;
+    geometry->setRings( LOD_RINGS[lod] );
+    geometry->setSlices( LOD_SLICES[lod] );
+    mLods.append( geometry );
+  }
+
+  connect( &mWatcher, &QFutureWatcher<Result>::finished, this, &InstanceLod::updateFinished );
+}
+
+InstanceLod::~InstanceLod()
+{
+  mWatcher.waitForFinished();
+  for ( const QPointer<InstancedGeometry> &geometry : qAsConst( mLods ) )
+  {
+    if ( geometry && !geometry->parent() )
+      delete geometry;
+  }
+}
+
+float InstanceLod::lodMinimumSize( int lod )
+{
+  return LOD_MINIMUM_SIZE[lod];
+}
+
+void InstanceLod::setInstances( const QVector<Instance> &instances, InstanceBuffer::InstanceEncoding encoding )
+{
+  QSharedPointer<InstanceSet> set( new InstanceSet );
+  set->encoding = encoding;
+  set->records = InstanceBuffer::encodeInstances( instances, encoding, set->origin, set->extent );
+
+  const float meshRadius = mLods[0] ? mLods[0]->radius() : 1;
+  const int count = instances.count();
+  set->x.resize( count );
+  set->y.resize( count );
+  set->z.resize( count );
+  set->radius.resize( count );
+  for ( int i = 0; i < count; ++i )
+  {
+    const Instance &instance = instances[i];
+    set->x[i] = instance.position.x();
+    set->y[i] = instance.position.y();
+    set->z[i] = instance.position.z();
+    set->radius[i] = meshRadius * std::max( { std::abs( instance.scale.x() ), std::abs( instance.scale.y() ), std::abs( instance.scale.z() ) } );
+  }
+  mInstances = set;
+
+  // nothing is drawn until the next update (a running update gets discarded and restarted)
+  for ( const QPointer<InstancedGeometry> &geometry : qAsConst( mLods ) )
+  {
+    if ( geometry )
+      geometry->setInstanceData( QByteArray(), encoding, set->origin, set->extent );
+  }
+  mVisibleCount = 0;
+  emit visibleCountChanged( mVisibleCount );
+
+  if ( mHasCamera && !mWatcher.isRunning() )
+    startUpdate();
+}
+
+QVariantList InstanceLod::lods() const
+{
+  QVariantList list;
+  for ( const QPointer<InstancedGeometry> &geometry : mLods )
+    list.append( QVariant::fromValue<QObject *>( geometry.data() ) );
+  return list;
+}
+
+void InstanceLod::updateCamera( const QMatrix4x4 &viewProjection, float fieldOfView, const QSizeF &viewportSize )
+{
+  // diameter in pixels = 2 * radius / w * (height / 2) / tan(fov / 2)
+  mViewProjection = viewProjection;
+  mPixelScale = viewportSize.height() / std::tan( qDegreesToRadians( fieldOfView ) / 2 );
+  mHasCamera = true;
+  mPendingUpdate = true;
+  if ( !mWatcher.isRunning() )
+    startUpdate();
+}
+
+void InstanceLod::startUpdate()
+{
+  if ( !mInstances )
+    return;
+
+  mPendingUpdate = false;
+  mWatcher.setFuture( QtConcurrent::run( &InstanceLod::cullInstances, mInstances, mViewProjection, mPixelScale ) );
+}
+
+void InstanceLod::updateFinished()
+{
+  const Result result = mWatcher.result();
+  if ( result.instances == mInstances )
+  {
+    int visibleCount = 0;
+    const int stride = InstanceBuffer::instanceStride( mInstances->encoding );
+    for ( int lod = 0; lod < LOD_COUNT; ++lod )
+    {
+      if ( mLods[lod] )
+        mLods[lod]->setInstanceData( result.lodRecords[lod], mInstances->encoding, mInstances->origin, mInstances->extent );
+      visibleCount += result.lodRecords[lod].size() / stride;
+    }
+
+    if ( visibleCount != mVisibleCount )
+    {
+      mVisibleCount = visibleCount;
+      emit visibleCountChanged( mVisibleCount );
+    }
+  }
+
+  // the camera has moved or instances have changed in the meantime
+  if ( mPendingUpdate || result.instances != mInstances )
+    startUpdate();
+}
+
+InstanceLod::Result InstanceLod::cullInstances( QSharedPointer<const InstanceSet> instances, QMatrix4x4 viewProjection, float pixelScale )
+{
+  const int count = instances->x.count();
+  const int chunkCount = ( count + CHUNK_SIZE - 1 ) / CHUNK_SIZE;
+
+  const CullParameters parameters = cullParameters( viewProjection, pixelScale );
+  const ClassifyFunc classifyInstances = classify();
+
+  QVector<quint8> codes( count );
+  QVector<int> chunkCounts( chunkCount * LOD_COUNT );   // instances of each level in each chunk
+  QVector<int> chunks( chunkCount );
+  for ( int chunk = 0; chunk < chunkCount; ++chunk )
+    chunks[chunk] = chunk;
+  quint8 *levels = codes.data();
+  int *lodCounts = chunkCounts.data();
+
+  // 1. level of each instance (or culled)
+  QtConcurrent::blockingMap( chunks, [&]( int chunk )
+  {
+    const int begin = chunk * CHUNK_SIZE, end = std::min( begin + CHUNK_SIZE, count );
+    classifyInstances( parameters, instances->x.constData() + begin, instances->y.constData() + begin, instances->z.constData() + begin,
+                       instances->radius.constData() + begin, end - begin, levels + begin );
+
+    int counts[LOD_COUNT] = {};
+    for ( int i = begin; i < end; ++i )
+    {
+      if ( levels[i] != CULLED )
+        ++counts[levels[i]];
+    }
+    std::copy( counts, counts + LOD_COUNT, lodCounts + chunk * LOD_COUNT );
+  } );
+
+  // 2. offsets of chunks in the output of each level
+  Result result;
+  result.instances = instances;
+  result.lodRecords.resize( LOD_COUNT );
+  QVector<int> chunkOffsets( chunkCount * LOD_COUNT );
+  const int stride = InstanceBuffer::instanceStride( instances->encoding );
+  for ( int lod = 0; lod < LOD_COUNT; ++lod )
+  {
+    int offset = 0;
+    for ( int chunk = 0; chunk < chunkCount; ++chunk )
+    {
+      chunkOffsets[chunk * LOD_COUNT + lod] = offset;
+      offset += chunkCounts[chunk * LOD_COUNT + lod];
+    }
+    result.lodRecords[lod].resize( offset * stride );
+  }
+
+  // 3. compact records of visible instances
+  char *outputs[LOD_COUNT];
+  for ( int lod = 0; lod < LOD_COUNT; ++lod )
+    outputs[lod] = result.lodRecords[lod].data();
+  QtConcurrent::blockingMap( chunks, [&]( int chunk )
+  {
+    const int begin = chunk * CHUNK_SIZE, end = std::min( begin + CHUNK_SIZE, count );
+    const char *records = instances->records.constData();
+    int offsets[LOD_COUNT];
+    std::copy( chunkOffsets.constData() + chunk * LOD_COUNT, chunkOffsets.constData() + ( chunk + 1 ) * LOD_COUNT, offsets );
+    for ( int i = begin; i < end; ++i )
+    {
+      const quint8 lod = levels[i];
+      if ( lod == CULLED )
+        continue;
+      std::memcpy( outputs[lod] + offsets[lod]++ * stride, records + i * stride, stride );
+    }
+  } );
+
+  return result;
+}
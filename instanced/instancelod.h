@@ -0,0 +1,102 @@
+#ifndef INSTANCELOD_H
+#define INSTANCELOD_H
+
+#include <QFutureWatcher>
+#include <QMatrix4x4>
+#include <QObject>
+#include <QPointer>
+#include <QSharedPointer>
+#include <QSizeF>
+#include <QVariantList>
+#include <QVector>
+
+#include "instancedgeometry.h"
+
+/**
+ * Frustum culling and levels of detail of instances on the CPU.
+ *
+ * Each level of detail is an InstancedGeometry with its own sphere tessellation,
+ * meant to be drawn by its own entity - so all instances take just LOD_COUNT instanced draws.
+ * On each camera update, instances whose bounding sphere is outside of the view frustum
+ * get dropped and the others are put to levels by their projected diameter in pixels
+ * (see lodMinimumSize()). Encoded records of instances of each level are then copied
+ * as they are to the instance buffer of its geometry.
+ *
+ * The update runs on a worker thread (with chunks of instances processed in parallel),
+ * only the resulting buffers get set to geometries in the GUI thread. Camera updates
+ * that come while the worker is busy are merged - just the last one gets processed.
+ * Positions and radii are stored as separate arrays, so that bounding spheres get tested
+ * several at a time by SSE2 or AVX kernels (like FrustumCuller of the RTC demo, picked at
+ * runtime with CpuFeatures::bestIsa()).
+ */
+class InstanceLod : public QObject
+{
+  Q_OBJECT
+
+  Q_PROPERTY(QVariantList lods READ lods CONSTANT)
+  Q_PROPERTY(int visibleCount READ visibleCount NOTIFY visibleCountChanged)
+
+public:
+  //! Number of levels of detail
+  static const int LOD_COUNT = 4;
+
+  InstanceLod( QObject *parent = nullptr );
+  ~InstanceLod() override;
+
+  //! Sets \a instances to be drawn, stored with the \a encoding (bounding spheres are based on the sphere of the finest level)
+  void setInstances( const QVector<Instance> &instances, InstanceBuffer::InstanceEncoding encoding );
+
+  //! Returns geometries of levels (InstancedGeometry objects), from the finest one
+  QVariantList lods() const;
+
+  //! Returns number of instances drawn after the last update
+  int visibleCount() const { return mVisibleCount; }
+
+  //! Returns projected diameter in pixels from which instances get drawn with the \a lod
+  static float lodMinimumSize( int lod );
+
+  /**
+   * Starts an update for the given projection * view matrix, vertical field of view \a fieldOfView
+   * (in degrees) and viewport of \a viewportSize pixels. Geometries get updated when it is finished.
+   */
+  Q_INVOKABLE void updateCamera( const QMatrix4x4 &viewProjection, float fieldOfView, const QSizeF &viewportSize );
+
+signals:
+  void visibleCountChanged( int count );
+
+private:
+  //! Instances in the form used by the worker (shared with it, never modified)
+  struct InstanceSet
+  {
+    QVector<float> x, y, z, radius;
+    QByteArray records;   //!< Encoded instances
+    InstanceBuffer::InstanceEncoding encoding = InstanceBuffer::Float32;
+    QVector3D origin, extent;
+  };
+
+  //! Records of visible instances of each level
+  struct Result
+  {
+    QSharedPointer<const InstanceSet> instances;
+    QVector<QByteArray> lodRecords;
+  };
+
+  //! Culls \a instances and splits them to levels (\a pixelScale converts radius / w to diameter in pixels)
+  static Result cullInstances( QSharedPointer<const InstanceSet> instances, QMatrix4x4 viewProjection, float pixelScale );
+
+  void startUpdate();
+  void updateFinished();
+
+  //! Geometries are not owned by us once they get parented to a Qt3D entity
+  QVector<QPointer<InstancedGeometry>> mLods;
+  QSharedPointer<const InstanceSet> mInstances;
+  QFutureWatcher<Result> mWatcher;
+
+  QMatrix4x4 mViewProjection;   //!< Matrix from the last camera update
+  float mPixelScale = 0;        //!< Pixel scale from the last camera update
+  bool mHasCamera = false;
+  bool mPendingUpdate = false;
+  int mVisibleCount = 0;
+};
+
+#endif // INSTANCELOD_H
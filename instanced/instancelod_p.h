@@ -0,0 +1,54 @@
+#ifndef INSTANCELOD_P_H
+#define INSTANCELOD_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the public API. It exposes the low-level kernels
+// used by InstanceLod so that they can be tested and benchmarked against each other.
+//
+
+#include <QMatrix4x4>
+
+#include "cpufeatures.h"
+#include "instancelod.h"
+
+/**
+ * Low-level kernels that classify bounding spheres of instances against the camera.
+ *
+ * Sphere centers and radii are given as separate arrays of floats. Each kernel writes
+ * the level of detail of each instance (or CULLED) to an array of bytes. The SIMD kernels
+ * keep the order of operations of the scalar one, so all variants give identical results.
+ */
+namespace InstanceLodKernels
+{
+  //! Camera parameters used to classify instances
+  struct CullParameters
+  {
+    float planes[6][4];   //!< Frustum planes [a, b, c, d] (normals point inside, normalized)
+    float w[4];           //!< Row of the matrix giving clip space w
+    float pixelScale;     //!< Converts radius / w to diameter in pixels
+  };
+
+  //! Level code of instances outside of the view frustum
+  const quint8 CULLED = 0xff;
+
+  //! Projected diameters in pixels from which levels are used
+  extern const float LOD_MINIMUM_SIZE[InstanceLod::LOD_COUNT];
+
+  //! Returns parameters for the given view-projection matrix and pixel scale (see InstanceLod::cullInstances())
+  CullParameters cullParameters( const QMatrix4x4 &viewProjection, float pixelScale );
+
+  //! Writes the level of each of \a count instances (or CULLED) to \a levels
+  typedef void ( *ClassifyFunc )( const CullParameters &c, const float *xs, const float *ys, const float *zs, const float *radii,
+                                  int count, quint8 *levels );
+
+  //! Returns the classification kernel for the given instruction set (must be supported)
+  ClassifyFunc classifyKernel( CpuFeatures::Isa isa );
+
+  //! Returns the classification kernel picked for the running CPU
+  ClassifyFunc classify();
+}
+
+#endif // INSTANCELOD_P_H
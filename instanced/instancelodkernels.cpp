@@ -0,0 +1,184 @@
+#include "instancelod_p.h"
+
+#include <QVector4D>
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace InstanceLodKernels
+{
+
+  const float LOD_MINIMUM_SIZE[InstanceLod::LOD_COUNT] = { 64, 16, 4, 0 };
+
+  // Kernels write the level of each instance (or CULLED) to levels. The scalar version is the reference,
+  // the SIMD ones (ported from FrustumCuller of the RTC demo) keep its order of operations to give identical results.
+
+  static void classifyScalar( const CullParameters &c, const float *xs, const float *ys, const float *zs, const float *radii,
+                              int count, quint8 *levels )
+  {
+    for ( int i = 0; i < count; ++i )
+    {
+      const float x = xs[i], y = ys[i], z = zs[i], r = radii[i];
+      bool inside = true;
+      for ( int p = 0; p < 6; ++p )
+        inside &= c.planes[p][0] * x + c.planes[p][1] * y + c.planes[p][2] * z + c.planes[p][3] >= -r;
+
+      const float w = std::max( c.w[0] * x + c.w[1] * y + c.w[2] * z + c.w[3], 1e-6f );
+      const float size = r * c.pixelScale / w;
+      const int lod = ( size < LOD_MINIMUM_SIZE[0] ) + ( size < LOD_MINIMUM_SIZE[1] ) + ( size < LOD_MINIMUM_SIZE[2] );
+      levels[i] = inside ? static_cast<quint8>( lod ) : CULLED;
+    }
+  }
+
+#ifdef CPU_HAS_SSE2
+
+  // 4 instances per iteration
+
+  static void classifySse2( const CullParameters &c, const float *xs, const float *ys, const float *zs, const float *radii,
+                            int count, quint8 *levels )
+  {
+    int i = 0;
+    for ( ; i + 4 <= count; i += 4 )
+    {
+      const __m128 x = _mm_loadu_ps( xs + i );
+      const __m128 y = _mm_loadu_ps( ys + i );
+      const __m128 z = _mm_loadu_ps( zs + i );
+      const __m128 r = _mm_loadu_ps( radii + i );
+      const __m128 negRadius = _mm_sub_ps( _mm_setzero_ps(), r );
+
+      __m128 inside = _mm_castsi128_ps( _mm_set1_epi32( -1 ) );
+      for ( int p = 0; p < 6; ++p )
+      {
+        const float *plane = c.planes[p];
+        __m128 dist = _mm_mul_ps( x, _mm_set1_ps( plane[0] ) );
+        dist = _mm_add_ps( dist, _mm_mul_ps( y, _mm_set1_ps( plane[1] ) ) );
+        dist = _mm_add_ps( dist, _mm_mul_ps( z, _mm_set1_ps( plane[2] ) ) );
+        dist = _mm_add_ps( dist, _mm_set1_ps( plane[3] ) );
+        inside = _mm_and_ps( inside, _mm_cmpge_ps( dist, negRadius ) );
+      }
+      const int mask = _mm_movemask_ps( inside );
+
+      __m128 w = _mm_mul_ps( x, _mm_set1_ps( c.w[0] ) );
+      w = _mm_add_ps( w, _mm_mul_ps( y, _mm_set1_ps( c.w[1] ) ) );
+      w = _mm_add_ps( w, _mm_mul_ps( z, _mm_set1_ps( c.w[2] ) ) );
+      w = _mm_add_ps( w, _mm_set1_ps( c.w[3] ) );
+      w = _mm_max_ps( w, _mm_set1_ps( 1e-6f ) );
+      const __m128 size = _mm_div_ps( _mm_mul_ps( r, _mm_set1_ps( c.pixelScale ) ), w );
+
+      // each threshold the size is below adds one
+      __m128 lod = _mm_setzero_ps();
+      for ( int level = 0; level < InstanceLod::LOD_COUNT - 1; ++level )
+        lod = _mm_add_ps( lod, _mm_and_ps( _mm_cmplt_ps( size, _mm_set1_ps( LOD_MINIMUM_SIZE[level] ) ), _mm_set1_ps( 1 ) ) );
+      alignas( 16 ) qint32 lods[4];
+      _mm_store_si128( reinterpret_cast<__m128i *>( lods ), _mm_cvttps_epi32( lod ) );
+
+      for ( int j = 0; j < 4; ++j )
+        levels[i + j] = ( mask >> j ) & 1 ? static_cast<quint8>( lods[j] ) : CULLED;
+    }
+    classifyScalar( c, xs + i, ys + i, zs + i, radii + i, count - i, levels + i );
+  }
+
+#endif
+
+#ifdef CPU_HAS_AVX
+
+  // 8 instances per iteration
+
+  CPU_TARGET_AVX
+  static void classifyAvx( const CullParameters &c, const float *xs, const float *ys, const float *zs, const float *radii,
+                           int count, quint8 *levels )
+  {
+    int i = 0;
+    for ( ; i + 8 <= count; i += 8 )
+    {
+      const __m256 x = _mm256_loadu_ps( xs + i );
+      const __m256 y = _mm256_loadu_ps( ys + i );
+      const __m256 z = _mm256_loadu_ps( zs + i );
+      const __m256 r = _mm256_loadu_ps( radii + i );
+      const __m256 negRadius = _mm256_sub_ps( _mm256_setzero_ps(), r );
+
+      int mask = 0xff;
+      for ( int p = 0; p < 6 && mask; ++p )
+      {
+        const float *plane = c.planes[p];
+        __m256 dist = _mm256_mul_ps( x, _mm256_broadcast_ss( plane + 0 ) );
+        dist = _mm256_add_ps( dist, _mm256_mul_ps( y, _mm256_broadcast_ss( plane + 1 ) ) );
+        dist = _mm256_add_ps( dist, _mm256_mul_ps( z, _mm256_broadcast_ss( plane + 2 ) ) );
+        dist = _mm256_add_ps( dist, _mm256_broadcast_ss( plane + 3 ) );
+        mask &= _mm256_movemask_ps( _mm256_cmp_ps( dist, negRadius, _CMP_GE_OQ ) );
+      }
+      if ( !mask )
+      {
+        std::memset( levels + i, CULLED, 8 );
+        continue;
+      }
+
+      __m256 w = _mm256_mul_ps( x, _mm256_broadcast_ss( c.w + 0 ) );
+      w = _mm256_add_ps( w, _mm256_mul_ps( y, _mm256_broadcast_ss( c.w + 1 ) ) );
+      w = _mm256_add_ps( w, _mm256_mul_ps( z, _mm256_broadcast_ss( c.w + 2 ) ) );
+      w = _mm256_add_ps( w, _mm256_broadcast_ss( c.w + 3 ) );
+      w = _mm256_max_ps( w, _mm256_set1_ps( 1e-6f ) );
+      const __m256 size = _mm256_div_ps( _mm256_mul_ps( r, _mm256_set1_ps( c.pixelScale ) ), w );
+
+      // each threshold the size is below adds one
+      __m256 lod = _mm256_setzero_ps();
+      for ( int level = 0; level < InstanceLod::LOD_COUNT - 1; ++level )
+        lod = _mm256_add_ps( lod, _mm256_and_ps( _mm256_cmp_ps( size, _mm256_set1_ps( LOD_MINIMUM_SIZE[level] ), _CMP_LT_OQ ), _mm256_set1_ps( 1 ) ) );
+      alignas( 32 ) qint32 lods[8];
+      _mm256_store_si256( reinterpret_cast<__m256i *>( lods ), _mm256_cvttps_epi32( lod ) );
+
+      for ( int j = 0; j < 8; ++j )
+        levels[i + j] = ( mask >> j ) & 1 ? static_cast<quint8>( lods[j] ) : CULLED;
+    }
+    classifyScalar( c, xs + i, ys + i, zs + i, radii + i, count - i, levels + i );
+  }
+
+#endif
+
+  CullParameters cullParameters( const QMatrix4x4 &viewProjection, float pixelScale )
+  {
+    // frustum planes (Gribb-Hartmann) normalized, so that they give distances in world units
+    CullParameters parameters;
+    for ( int i = 0; i < 3; ++i )
+    {
+      const QVector4D planePair[2] = { viewProjection.row( 3 ) + viewProjection.row( i ), viewProjection.row( 3 ) - viewProjection.row( i ) };
+      for ( int j = 0; j < 2; ++j )
+      {
+        const QVector4D plane = planePair[j] / planePair[j].toVector3D().length();
+        for ( int k = 0; k < 4; ++k )
+          parameters.planes[i * 2 + j][k] = plane[k];
+      }
+    }
+    const QVector4D wRow = viewProjection.row( 3 );
+    for ( int k = 0; k < 4; ++k )
+      parameters.w[k] = wRow[k];
+    parameters.pixelScale = pixelScale;
+    return parameters;
+  }
+
+  ClassifyFunc classifyKernel( CpuFeatures::Isa isa )
+  {
+    Q_ASSERT( CpuFeatures::isSupported( isa ) );
+    switch ( isa )
+    {
+#ifdef CPU_HAS_SSE2
+      case CpuFeatures::Isa::Sse2:
+        return classifySse2;
+#endif
+#ifdef CPU_HAS_AVX
+      case CpuFeatures::Isa::Avx:
+        return classifyAvx;
+#endif
+      default:
+        return classifyScalar;
+    }
+  }
+
+  ClassifyFunc classify()
+  {
+    static const ClassifyFunc f = classifyKernel( CpuFeatures::bestIsa() );
+    return f;
+  }
+
+}
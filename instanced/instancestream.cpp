@@ -0,0 +1,177 @@
+#include "instancestream.h"
+
+#include <algorithm>
+
+
+InstanceStream::InstanceStream( int bufferCount, QObject *parent )
+  : QObject( parent )
+{
+  Q_ASSERT( bufferCount >= 1 && bufferCount <= MAX_BUFFERS );
+  mSlots.resize( bufferCount );
+  for ( Slot &slot : mSlots )
+  {
+    slot.buffer = new InstanceBuffer;
+    slot.uploads.reserve( MAX_UPLOADS );
+  }
+}
+
+InstanceStream::~InstanceStream()
+{
+  // buffers are owned by the first attached geometry (if there was any)
+  for ( const Slot &slot : qAsConst( mSlots ) )
+  {
+    if ( slot.buffer && !slot.buffer->parent() )
+      delete slot.buffer;
+  }
+}
+
+void InstanceStream::attachTo( Qt3DRender::QGeometry *geometry )
+{
+  if ( !geometry || mGeometries.contains( geometry ) )
+    return;
+
+  for ( const Slot &slot : qAsConst( mSlots ) )
+  {
+    if ( !slot.buffer->parent() )
+      slot.buffer->setParent( geometry );
+  }
+
+  // attributes belong to the first buffer, commit() just switches them to the current one
+  InstanceBuffer *attributeBuffer = mSlots[0].buffer;
+  attributeBuffer->attachTo( geometry );
+  if ( mCurrent != 0 )
+  {
+    for ( Qt3DRender::QAttribute *attribute : geometry->attributes() )
+    {
+      if ( attribute->buffer() == attributeBuffer )
+        attribute->setBuffer( currentBuffer() );
+    }
+  }
+  mGeometries.append( geometry );
+}
+
+void InstanceStream::setInstances( const QVector<Instance> &instances, InstanceBuffer::InstanceEncoding encoding )
+{
+  mInstances = instances;
+  mEncoding = encoding;
+  mModifiedFrames.fill( mFrame, instances.count() );
+  mLastModifiedFrame = mFrame;
+
+  // encoded once, all buffers share the array until their first update
+  const QByteArray instanceData = InstanceBuffer::encodeInstances( mInstances, encoding, mOrigin, mExtent );
+  for ( Slot &slot : mSlots )
+  {
+    slot.buffer->setInstanceData( instanceData, encoding, mOrigin, mExtent );
+    slot.writtenFrame = mFrame;
+  }
+
+  emit countChanged( mInstances.count() );
+  emit layoutChanged();
+}
+
+void InstanceStream::updateInstances( int first, const QVector<Instance> &instances )
+{
+  Q_ASSERT( first >= 0 && first + instances.count() <= mInstances.count() );
+  std::copy( instances.constBegin(), instances.constEnd(), mInstances.begin() + first );
+  std::fill( mModifiedFrames.begin() + first, mModifiedFrames.begin() + first + instances.count(), mFrame + 1 );
+  mLastModifiedFrame = mFrame + 1;
+}
+
+void InstanceStream::updateInstance( int index, const Instance &instance )
+{
+  Q_ASSERT( index >= 0 && index < mInstances.count() );
+  mInstances[index] = instance;
+  mModifiedFrames[index] = mFrame + 1;
+  mLastModifiedFrame = mFrame + 1;
+}
+
+void InstanceStream::commit()
+{
+  InstanceBuffer *previousBuffer = currentBuffer();
+  const int uploadCount = prepareUploads();
+  InstanceBuffer *buffer = currentBuffer();
+  for ( int i = 0; i < uploadCount; ++i )
+    buffer->updateData( upload( i ).offset, upload( i ).data );
+
+  if ( buffer == previousBuffer )
+    return;
+
+  // drop geometries that got deleted in the meantime
+  mGeometries.erase( std::remove_if( mGeometries.begin(), mGeometries.end(), []( const QPointer<Qt3DRender::QGeometry> &geometry )
+  {
+    return !geometry;
+  } ), mGeometries.end() );
+  for ( Qt3DRender::QGeometry *geometry : qAsConst( mGeometries ) )
+  {
+    for ( Qt3DRender::QAttribute *attribute : geometry->attributes() )
+    {
+      if ( attribute->buffer() == previousBuffer )
+        attribute->setBuffer( buffer );
+    }
+  }
+
+  emit currentBufferChanged( buffer );
+}
+
+int InstanceStream::prepareUploads()
+{
+  mCurrent = ( mCurrent + 1 ) % mSlots.count();
+  ++mFrame;
+  const int writtenFrame = mSlots[mCurrent].writtenFrame;
+  mSlots[mCurrent].writtenFrame = mFrame;
+  mUploadCount = 0;
+  if ( mLastModifiedFrame <= writtenFrame )
+    return 0;   // nothing modified since the buffer was written last
+
+  // ranges of modified instances, merged over small gaps
+  mRanges.clear();
+  const int *modified = mModifiedFrames.constData();
+  for ( int i = 0; i < mInstances.count(); ++i )
+  {
+    if ( modified[i] <= writtenFrame )
+      continue;
+    if ( !mRanges.isEmpty() && i - mRanges.last().end <= MERGE_GAP )
+      mRanges.last().end = i + 1;
+    else
+      mRanges.append( Range{ i, i + 1 } );
+  }
+
+  // too many ranges: merge the ones with the smallest gaps between them
+  if ( mRanges.count() > MAX_UPLOADS )
+  {
+    mGaps.clear();
+    for ( int i = 1; i < mRanges.count(); ++i )
+      mGaps.append( mRanges[i].first - mRanges[i - 1].end );
+    const int merges = mRanges.count() - MAX_UPLOADS;
+    std::nth_element( mGaps.begin(), mGaps.begin() + merges - 1, mGaps.end() );
+    const int maximumGap = mGaps[merges - 1];
+
+    int last = 0;
+    for ( int i = 1; i < mRanges.count(); ++i )
+    {
+      if ( mRanges[i].first - mRanges[last].end <= maximumGap )
+        mRanges[last].end = mRanges[i].end;
+      else
+        mRanges[++last] = mRanges[i];
+    }
+    mRanges.resize( last + 1 );
+  }
+
+  for ( const Range &range : qAsConst( mRanges ) )
+    prepareUpload( range.first, range.end );
+  return mUploadCount;
+}
+
+void InstanceStream::prepareUpload( int first, int end )
+{
+  Slot &slot = mSlots[mCurrent];
+  if ( slot.uploads.count() == mUploadCount )
+    slot.uploads.append( Upload() );
+
+  // resizing keeps the allocation, unless the array is still referenced by a pending update
+  const int stride = InstanceBuffer::instanceStride( mEncoding );
+  Upload &upload = slot.uploads[mUploadCount++];
+  upload.offset = first * stride;
+  upload.data.resize( ( end - first ) * stride );
+  InstanceBuffer::writeInstances( upload.data.data(), mInstances.constData() + first, end - first, mEncoding, mOrigin, mExtent );
+}
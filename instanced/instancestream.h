@@ -0,0 +1,152 @@
+#ifndef INSTANCESTREAM_H
+#define INSTANCESTREAM_H
+
+#include <Qt3DRender/QGeometry>
+
+#include <QByteArray>
+#include <QObject>
+#include <QPointer>
+#include <QVector>
+
+#include "instancebuffer.h"
+
+/**
+ * Instances that move every frame, streamed to a rotation of two or three instance buffers.
+ *
+ * Replacing all instances on each frame (InstanceBuffer::setInstances()) allocates, encodes
+ * and uploads the whole buffer - for 100k animated objects that is megabytes per frame.
+ * Here the instances are kept and updates just mark them modified. commit() then writes
+ * only the modified ranges (with updateData()) to the next buffer of the rotation and switches
+ * attached geometries to it, so the buffer being written is not the one the previous frame
+ * draws from. Each buffer gets the instances modified since it was written last.
+ *
+ * Records are encoded into staging arrays kept for each buffer of the rotation. By the time
+ * a buffer comes around again, Qt3D has released the arrays passed to it before, so they get
+ * reused instead of allocating new ones.
+ *
+ * The encoding, origin and extent are given by setInstances() - with the packed encodings
+ * instances need to stay within the bounding box of the initial ones.
+ */
+class InstanceStream : public QObject
+{
+  Q_OBJECT
+
+  Q_PROPERTY(int count READ count NOTIFY countChanged)
+  Q_PROPERTY(bool hasTransforms READ hasTransforms CONSTANT)
+  Q_PROPERTY(QVector3D origin READ origin NOTIFY layoutChanged)
+  Q_PROPERTY(QVector3D extent READ extent NOTIFY layoutChanged)
+  Q_PROPERTY(InstanceBuffer *currentBuffer READ currentBuffer NOTIFY currentBufferChanged)
+
+public:
+  //! Maximum number of buffers in the rotation
+  static const int MAX_BUFFERS = 3;
+  //! Maximum number of updateData() calls per commit (ranges with the smallest gaps get merged)
+  static const int MAX_UPLOADS = 32;
+  //! Modified ranges closer than this number of instances get written as one
+  static const int MERGE_GAP = 64;
+
+  //! Encoded records to be written to a buffer at a byte offset
+  struct Upload
+  {
+    int offset = 0;
+    QByteArray data;
+  };
+
+  //! Creates a rotation of \a bufferCount buffers (1 to MAX_BUFFERS)
+  explicit InstanceStream( int bufferCount = 2, QObject *parent = nullptr );
+  ~InstanceStream() override;
+
+  /**
+   * Adds attributes of instances to the \a geometry (see InstanceBuffer::attachTo()). Buffers
+   * of the rotation get parented to the first geometry.
+   */
+  void attachTo( Qt3DRender::QGeometry *geometry );
+
+  //! Sets all instances (written to all buffers), with the given \a encoding
+  void setInstances( const QVector<Instance> &instances, InstanceBuffer::InstanceEncoding encoding = InstanceBuffer::Float32 );
+
+  //! Replaces instances starting at \a first with \a instances (written on the next commit())
+  void updateInstances( int first, const QVector<Instance> &instances );
+
+  //! Replaces the instance at \a index (written on the next commit())
+  void updateInstance( int index, const Instance &instance );
+
+  //! Writes modified instances to the next buffer of the rotation and switches attached geometries to it
+  void commit();
+
+  /**
+   * Advances to the next buffer of the rotation and encodes instances modified since it was
+   * written last to its staging arrays. Returns number of uploads (see upload()) - commit()
+   * then writes them to currentBuffer(), other uploaders (e.g. benchmarks with plain OpenGL)
+   * may write them to their own buffers.
+   */
+  int prepareUploads();
+
+  //! Returns upload with the given \a index prepared for currentBuffer()
+  const Upload &upload( int index ) const { return mSlots[mCurrent].uploads[index]; }
+
+  //! Returns instances as they were last set or updated
+  const QVector<Instance> &instances() const { return mInstances; }
+
+  //! Returns number of instances
+  int count() const { return mInstances.count(); }
+
+  //! Returns true - streamed instances always have rotation and scale
+  bool hasTransforms() const { return true; }
+
+  //! Returns position that instance positions are relative to
+  QVector3D origin() const { return mOrigin; }
+
+  //! Returns scale of decoded instance positions (relative to the origin)
+  QVector3D extent() const { return mExtent; }
+
+  //! Returns number of buffers in the rotation
+  int bufferCount() const { return mSlots.count(); }
+
+  //! Returns index of the buffer that was written last
+  int currentIndex() const { return mCurrent; }
+
+  //! Returns the buffer that was written last (the one attached geometries draw from)
+  InstanceBuffer *currentBuffer() const { return mSlots[mCurrent].buffer; }
+
+signals:
+  void countChanged( int count );
+  void layoutChanged();
+  void currentBufferChanged( InstanceBuffer *buffer );
+
+private:
+  //! Buffer of the rotation
+  struct Slot
+  {
+    QPointer<InstanceBuffer> buffer;
+    int writtenFrame = 0;      //!< Frame when the buffer was written last
+    QVector<Upload> uploads;   //!< Staging arrays (kept for reuse, only uploadCount are valid)
+  };
+
+  //! Range of instances [first, end)
+  struct Range
+  {
+    int first;
+    int end;
+  };
+
+  //! Encodes instances [first, end) to the next upload of the current slot
+  void prepareUpload( int first, int end );
+
+  QVector<Slot> mSlots;
+  int mCurrent = 0;
+  int mUploadCount = 0;
+  QVector<Range> mRanges;   //!< Ranges to upload (kept to reuse the allocation)
+  QVector<int> mGaps;       //!< Gaps between the ranges (kept to reuse the allocation)
+  QVector<QPointer<Qt3DRender::QGeometry>> mGeometries;
+
+  QVector<Instance> mInstances;
+  QVector<int> mModifiedFrames;   //!< Frame when each instance was modified last
+  int mFrame = 0;                 //!< Number of commits (modified instances belong to the next frame)
+  int mLastModifiedFrame = 0;
+  InstanceBuffer::InstanceEncoding mEncoding = InstanceBuffer::Float32;
+  QVector3D mOrigin;
+  QVector3D mExtent = QVector3D( 1, 1, 1 );
+};
+
+#endif // INSTANCESTREAM_H
@@ -1,10 +1,21 @@
 #include <Qt3DQuickExtras/qt3dquickwindow.h>
 #include <Qt3DQuick/QQmlAspectEngine>
+#include <QFileInfo>
 #include <QGuiApplication>
 #include <QQmlContext>
 #include <QQmlEngine>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QTimer>
+#include <QtMath>
 
+#include <Qt3DExtras/QCylinderGeometry>
+#include <Qt3DExtras/QSphereGeometry>
+
+#include "instancebuffer.h"
 #include "instancedgeometry.h"
+#include "instancelod.h"
+#include "instancestream.h"
 
 int main(int argc, char* argv[])
 {
@@ -22,11 +33,94 @@ int main(int argc, char* argv[])
     InstancedGeometry instGeom;
     instGeom.setPoints(pos);
 
+    // --points-file <path> memory maps the points from a file instead (written with the points above
+    // if it does not exist yet) - the buffer gets them straight from the mapping without a copy
+    const int pointsFileIndex = app.arguments().indexOf("--points-file");
+    if (pointsFileIndex > 0 && pointsFileIndex + 1 < app.arguments().count()) {
+        const QString path = app.arguments()[pointsFileIndex + 1];
+        if (!QFileInfo::exists(path) && !PointFile::write(path, pos))
+            qWarning("failed to write %s", qPrintable(path));
+        QSharedPointer<const PointFile> pointFile = QSharedPointer<const PointFile>::create(path);
+        if (pointFile->isValid())
+            instGeom.setPoints(pointFile);
+        else
+            qWarning("failed to read %s", qPrintable(path));
+    }
+
+    // a "forest" of instances with their own rotation and scale - packed to 20 bytes per instance
+    // by default, --float16 or --float32 switch to the bigger encodings
+    InstanceBuffer::InstanceEncoding encoding = InstanceBuffer::Quantized;
+    if (app.arguments().contains("--float16"))
+        encoding = InstanceBuffer::Float16;
+    else if (app.arguments().contains("--float32"))
+        encoding = InstanceBuffer::Float32;
+
+    // lots of them over a large area: only the ones in the view get drawn, with coarser
+    // spheres further away (culled and sorted to levels of detail on a worker thread)
+    QRandomGenerator random(1);
+    QVector<Instance> trees;
+    for (int i = 0; i < 200000; ++i) {
+        Instance tree;
+        tree.position = QVector3D(random.bounded(400.) - 200, 0, random.bounded(400.) - 420);
+        // leaning a bit in a random direction
+        tree.rotation = QQuaternion::fromAxisAndAngle(0, 1, 0, random.bounded(360.)) *
+                        QQuaternion::fromAxisAndAngle(1, 0, 0, random.bounded(20.));
+        const float size = 0.3 + random.bounded(0.4);
+        tree.scale = QVector3D(size, size * (2 + random.bounded(2.)), size);
+        tree.position.setY(tree.scale.y());   // standing on the ground
+        trees << tree;
+    }
+
+    InstanceLod forestLod;
+    forestLod.setInstances(trees, encoding);
+
+    // an "orchard": trunks and crowns are two meshes drawn from one shared buffer of instances,
+    // so the trees swaying in the wind only need to update that buffer each frame - streamed
+    // to a rotation of buffers, without allocating a new one
+    Qt3DExtras::QCylinderGeometry trunkGeometry;
+    Qt3DExtras::QSphereGeometry crownGeometry;
+    InstanceStream orchard;
+    orchard.attachTo(&trunkGeometry);
+    orchard.attachTo(&crownGeometry);
+
+    QVector<Instance> orchardTrees;
+    QVector<float> orchardPhases;
+    for (int row = 0; row < 20; ++row) {
+        for (int column = 0; column < 20; ++column) {
+            Instance tree;
+            tree.position = QVector3D(12 + column * 1.5, 0, -14 + row * 1.5);
+            const float size = 0.8 + random.bounded(0.4);
+            tree.scale = QVector3D(size, size, size);
+            orchardTrees << tree;
+            orchardPhases << random.bounded(2 * M_PI);
+        }
+    }
+    orchard.setInstances(orchardTrees, encoding);
+
+    QElapsedTimer windClock;
+    windClock.start();
+    QTimer windTimer;
+    QObject::connect(&windTimer, &QTimer::timeout, [&] {
+        const float time = windClock.elapsed() / 1000.f;
+        for (int i = 0; i < orchardTrees.count(); ++i) {
+            const float angle = 4 * qSin(time * 1.5f + orchardPhases[i]);
+            orchardTrees[i].rotation = QQuaternion::fromAxisAndAngle(1, 0, 0.3f, angle);
+        }
+        // positions stay within the bounding box, so the records can be updated in place
+        orchard.updateInstances(0, orchardTrees);
+        orchard.commit();
+    });
+    windTimer.start(16);
+
     Qt3DExtras::Quick::Qt3DQuickWindow view;
     view.setTitle("Instanced Rendering");
     view.resize(1600, 800);
     view.engine()->qmlEngine()->rootContext()->setContextProperty("_window", &view);
     view.engine()->qmlEngine()->rootContext()->setContextProperty("_instg", &instGeom);
+    view.engine()->qmlEngine()->rootContext()->setContextProperty("_forestLod", &forestLod);
+    view.engine()->qmlEngine()->rootContext()->setContextProperty("_orchard", &orchard);
+    view.engine()->qmlEngine()->rootContext()->setContextProperty("_trunkGeometry", &trunkGeometry);
+    view.engine()->qmlEngine()->rootContext()->setContextProperty("_crownGeometry", &crownGeometry);
     view.setSource(QUrl("qrc:/main.qml"));
     view.show();
 
@@ -39,6 +39,22 @@ Entity {
         position: Qt.vector3d(0.0, 10.0, 20.0)
         viewCenter: Qt.vector3d(0.0, 0.0, 0.0)
         upVector: Qt.vector3d(0.0, 1.0, 0.0)
+
+        function viewProjMatrix() {
+            var viewMat = Qt.matrix4x4();
+            viewMat.lookAt(camera.position, camera.viewCenter, camera.upVector)
+            return camera.projectionMatrix.times( viewMat )
+        }
+
+        function updateLod() {
+            _forestLod.updateCamera(viewProjMatrix(), fieldOfView, Qt.size(_window.width, _window.height))
+        }
+
+        onPositionChanged: updateLod()
+        onViewCenterChanged: updateLod()
+        onUpVectorChanged: updateLod()
+        onProjectionMatrixChanged: updateLod()
+        Component.onCompleted: updateLod()
     }
 
     FirstPersonCameraController { camera: camera }
@@ -87,10 +103,15 @@ Entity {
                 Parameter { name: "shininess"; value: 150. },
 
                 Parameter { name: "inst"; value: myEntity.instTransform },
-                Parameter { name: "instNormal"; value: _instg.normalMatrix( myEntity.instTransform ) }  // normal matrix (actually just 3x3)
+                Parameter { name: "instNormal"; value: _instg.normalMatrix( myEntity.instTransform ) },  // normal matrix (actually just 3x3)
+
+                Parameter { name: "useInstanceTransform"; value: _instg.hasInstanceTransforms },
+                Parameter { name: "instanceOrigin"; value: _instg.instanceOrigin },
+                Parameter { name: "instanceExtent"; value: _instg.instanceExtent }
             ]
 
             effect: Effect {
+                id: instancedEffect
                 techniques: Technique {
                     graphicsApiFilter { api: GraphicsApiFilter.OpenGL; profile: GraphicsApiFilter.CoreProfile; majorVersion: 3; minorVersion: 1 }
                     renderPasses: [
@@ -109,6 +130,116 @@ Entity {
     }
 
 
+    // instances with their own position, rotation and scale - an entity for each level of detail
+    NodeInstantiator {
+        model: _forestLod.lods
+        delegate: Entity {
+            GeometryRenderer {
+                id: grForest
+                geometry: modelData
+                instanceCount: modelData.count
+            }
+
+            Material {
+                id: grmForest
+
+                parameters: [
+                    Parameter { name: "ka"; value: Qt.rgba(0.05, 0.1, 0.05, 1.0) },
+                    Parameter { name: "kd"; value: Qt.rgba(0.2, 0.6, 0.2, 1.0) },
+                    Parameter { name: "ks"; value: Qt.rgba(0.01, 0.01, 0.01, 1.0) },
+                    Parameter { name: "shininess"; value: 150. },
+
+                    Parameter { name: "inst"; value: myEntity.instTransform },
+                    Parameter { name: "instNormal"; value: _instg.normalMatrix( myEntity.instTransform ) },
+
+                    Parameter { name: "useInstanceTransform"; value: modelData.hasInstanceTransforms },
+                    Parameter { name: "instanceOrigin"; value: modelData.instanceOrigin },
+                    Parameter { name: "instanceExtent"; value: modelData.instanceExtent }
+                ]
+
+                effect: instancedEffect
+            }
+
+            components: [ grForest, grmForest ]
+        }
+    }
+
+
+    // trunks and crowns of the orchard: two meshes sharing one buffer of instances,
+    // "inst" places each mesh relative to the base of the tree
+    Entity {
+        id: trunks
+        property matrix4x4 meshTransform: Qt.matrix4x4(0.15,0,0,0,
+                                                       0,1,0,0.5,
+                                                       0,0,0.15,0,
+                                                       0,0,0,1)
+
+        GeometryRenderer {
+            id: grTrunks
+            geometry: _trunkGeometry
+            instanceCount: _orchard.count
+        }
+
+        Material {
+            id: grmTrunks
+
+            parameters: [
+                Parameter { name: "ka"; value: Qt.rgba(0.05, 0.05, 0.05, 1.0) },
+                Parameter { name: "kd"; value: Qt.rgba(0.4, 0.25, 0.1, 1.0) },
+                Parameter { name: "ks"; value: Qt.rgba(0.01, 0.01, 0.01, 1.0) },
+                Parameter { name: "shininess"; value: 150. },
+
+                Parameter { name: "inst"; value: trunks.meshTransform },
+                Parameter { name: "instNormal"; value: _instg.normalMatrix( trunks.meshTransform ) },
+
+                Parameter { name: "useInstanceTransform"; value: _orchard.hasTransforms },
+                Parameter { name: "instanceOrigin"; value: _orchard.origin },
+                Parameter { name: "instanceExtent"; value: _orchard.extent }
+            ]
+
+            effect: instancedEffect
+        }
+
+        components: [ grTrunks, grmTrunks ]
+    }
+
+    Entity {
+        id: crowns
+        property matrix4x4 meshTransform: Qt.matrix4x4(0.6,0,0,0,
+                                                       0,0.6,0,1.4,
+                                                       0,0,0.6,0,
+                                                       0,0,0,1)
+
+        GeometryRenderer {
+            id: grCrowns
+            geometry: _crownGeometry
+            instanceCount: _orchard.count
+        }
+
+        Material {
+            id: grmCrowns
+
+            parameters: [
+                Parameter { name: "ka"; value: Qt.rgba(0.05, 0.1, 0.05, 1.0) },
+                Parameter { name: "kd"; value: Qt.rgba(0.3, 0.7, 0.2, 1.0) },
+                Parameter { name: "ks"; value: Qt.rgba(0.01, 0.01, 0.01, 1.0) },
+                Parameter { name: "shininess"; value: 150. },
+
+                Parameter { name: "inst"; value: crowns.meshTransform },
+                Parameter { name: "instNormal"; value: _instg.normalMatrix( crowns.meshTransform ) },
+
+                Parameter { name: "useInstanceTransform"; value: _orchard.hasTransforms },
+                Parameter { name: "instanceOrigin"; value: _orchard.origin },
+                Parameter { name: "instanceExtent"; value: _orchard.extent }
+            ]
+
+            effect: instancedEffect
+        }
+
+        components: [ grCrowns, grmCrowns ]
+    }
+
+
     // reference sphere (for shading)
     Entity {
         PhongMaterial {
@@ -0,0 +1,199 @@
+/**
+ * Benchmark of the two ways to draw lines: lines_adjacency strips expanded
+ * by the geometry shader (lines.vert + lines.geom) and instanced segments
+ * expanded in the vertex shader (lines_instanced.vert).
+ *
+ * It renders to an offscreen framebuffer with plain OpenGL (no window, no Qt3D),
+ * using the same shaders as the demo. Runs on the "offscreen" platform by default -
+ * set QT_QPA_PLATFORM to use another one (e.g. "xcb" with Xvfb). Each case prints
+ * its throughput in million segments per second. Use "-csv" for machine-readable output.
+ */
+
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QOpenGLShaderProgram>
+
+#include <cmath>
+
+#include "linemeshbuilder.h"
+#include "linesegmentgeometry.h"
+#include "offscreengl.h"
+
+
+class BenchLines : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void draw_data();
+    void draw();
+
+  private:
+    static const int WIDTH = 1600;
+    static const int HEIGHT = 800;
+
+    OffscreenGl mOffscreen;
+    QOpenGLFunctions_3_3_Core *mGl = nullptr;
+
+    QOpenGLShaderProgram mStripProgram;
+    QOpenGLShaderProgram mInstancedProgram;
+
+    GLuint mStripVao = 0, mInstancedVao = 0;
+    GLuint mBuffers[4] = { 0, 0, 0, 0 };
+    GLenum mIndexType = GL_UNSIGNED_INT;
+    int mIndexCount = 0;
+    int mSegmentCount = 0;
+};
+
+
+void BenchLines::initTestCase()
+{
+    if ( !mOffscreen.create( WIDTH, HEIGHT ) )
+        QSKIP( mOffscreen.errorMessage() );
+    mGl = mOffscreen.functions();
+
+    QVERIFY( mStripProgram.addShaderFromSourceFile( QOpenGLShader::Vertex, ":/shaders/lines.vert" ) );
+    QVERIFY( mStripProgram.addShaderFromSourceFile( QOpenGLShader::Geometry, ":/shaders/lines.geom" ) );
+    QVERIFY( mStripProgram.addShaderFromSourceFile( QOpenGLShader::Fragment, ":/shaders/lines.frag" ) );
+    QVERIFY( mStripProgram.link() );
+    QVERIFY( mInstancedProgram.addShaderFromSourceFile( QOpenGLShader::Vertex, ":/shaders/lines_instanced.vert" ) );
+    QVERIFY( mInstancedProgram.addShaderFromSourceFile( QOpenGLShader::Fragment, ":/shaders/lines.frag" ) );
+    QVERIFY( mInstancedProgram.link() );
+
+    // wiggly lines like a road network (the same as in the demo, just more of them)
+    QVector<QVector<QVector3D>> network;
+    for ( int i = 0; i < 2000; ++i )
+    {
+        QVector<QVector3D> road;
+        QVector3D pt( -40 + ( i % 40 ) * 2, 0, -40 + ( i / 40 ) * 1.6f );
+        for ( int j = 0; j < 500; ++j )
+        {
+            const float angle = std::sin( i + j * 0.05f ) * 2 + std::sin( j * 0.7f ) * 0.3f;
+            pt += QVector3D( std::cos( angle ), 0, std::sin( angle ) ) * 0.05f;
+            road << pt;
+        }
+        network << road;
+    }
+    const LineMeshData data = LineMeshBuilder::build( network );
+    const QByteArray segmentData = LineSegmentGeometry::segmentsFromStrips( data );
+    mIndexCount = data.indexCount;
+    mIndexType = data.indexType == Qt3DRender::QAttribute::UnsignedShort ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    mSegmentCount = segmentData.size() / ( 12 * sizeof( float ) );
+
+    float corners[LineSegmentGeometry::VERTICES_PER_SEGMENT];
+    for ( int i = 0; i < LineSegmentGeometry::VERTICES_PER_SEGMENT; ++i )
+        corners[i] = i;
+
+    mGl->glGenBuffers( 4, mBuffers );
+
+    // geometry shader: indexed strips with adjacency
+    mGl->glGenVertexArrays( 1, &mStripVao );
+    mGl->glBindVertexArray( mStripVao );
+    mGl->glBindBuffer( GL_ARRAY_BUFFER, mBuffers[0] );
+    mGl->glBufferData( GL_ARRAY_BUFFER, data.vertexData.size(), data.vertexData.constData(), GL_STATIC_DRAW );
+    const GLint positionLocation = mStripProgram.attributeLocation( "vertexPosition" );
+    mGl->glEnableVertexAttribArray( positionLocation );
+    mGl->glVertexAttribPointer( positionLocation, 3, GL_FLOAT, GL_FALSE, 0, nullptr );
+    mGl->glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, mBuffers[1] );
+    mGl->glBufferData( GL_ELEMENT_ARRAY_BUFFER, data.indexData.size(), data.indexData.constData(), GL_STATIC_DRAW );
+
+    // instanced: template of corners + segments as instance data
+    mGl->glGenVertexArrays( 1, &mInstancedVao );
+    mGl->glBindVertexArray( mInstancedVao );
+    mGl->glBindBuffer( GL_ARRAY_BUFFER, mBuffers[2] );
+    mGl->glBufferData( GL_ARRAY_BUFFER, sizeof( corners ), corners, GL_STATIC_DRAW );
+    const GLint cornerLocation = mInstancedProgram.attributeLocation( "vertexCorner" );
+    mGl->glEnableVertexAttribArray( cornerLocation );
+    mGl->glVertexAttribPointer( cornerLocation, 1, GL_FLOAT, GL_FALSE, 0, nullptr );
+    mGl->glBindBuffer( GL_ARRAY_BUFFER, mBuffers[3] );
+    mGl->glBufferData( GL_ARRAY_BUFFER, segmentData.size(), segmentData.constData(), GL_STATIC_DRAW );
+    const char *names[] = { "segmentPrev", "segmentStart", "segmentEnd", "segmentNext" };
+    for ( int i = 0; i < 4; ++i )
+    {
+        const GLint location = mInstancedProgram.attributeLocation( names[i] );
+        mGl->glEnableVertexAttribArray( location );
+        mGl->glVertexAttribPointer( location, 3, GL_FLOAT, GL_FALSE, 12 * sizeof( float ), reinterpret_cast<void *>( i * 3 * sizeof( float ) ) );
+        mGl->glVertexAttribDivisor( location, 1 );
+    }
+    mGl->glBindVertexArray( 0 );
+
+    // camera above the network looking down at an angle, with part of the lines behind the camera
+    QMatrix4x4 projection, view;
+    projection.perspective( 45, float( WIDTH ) / HEIGHT, 0.1f, 1000 );
+    view.lookAt( QVector3D( 0, 10, 30 ), QVector3D( 0, 0, 0 ), QVector3D( 0, 1, 0 ) );
+    for ( QOpenGLShaderProgram *program : { &mStripProgram, &mInstancedProgram } )
+    {
+        program->bind();
+        program->setUniformValue( "modelViewProjection", projection * view );
+        program->setUniformValue( "THICKNESS", 10.f );
+        program->setUniformValue( "MITER_LIMIT", -1.f );
+        program->setUniformValue( "WIN_SCALE", QSizeF( WIDTH, HEIGHT ) );
+        program->setUniformValue( "lineColor", QVector4D( 0, 1, 0, 1 ) );
+        program->setUniformValue( "useTex", false );
+    }
+
+    qInfo( "%d segments", mSegmentCount );
+}
+
+void BenchLines::cleanupTestCase()
+{
+    if ( !mGl )
+        return;
+
+    mGl->glDeleteVertexArrays( 1, &mStripVao );
+    mGl->glDeleteVertexArrays( 1, &mInstancedVao );
+    mGl->glDeleteBuffers( 4, mBuffers );
+    mOffscreen.destroy();
+}
+
+
+void BenchLines::draw_data()
+{
+    QTest::addColumn<bool>( "instanced" );
+    QTest::newRow( "geometry shader" ) << false;
+    QTest::newRow( "instanced" ) << true;
+}
+
+void BenchLines::draw()
+{
+    QFETCH( bool, instanced );
+
+    QElapsedTimer timer;
+    qint64 elapsedNs = 0;
+    qint64 runs = 0;
+
+    QBENCHMARK
+    {
+        timer.start();
+        mGl->glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+        if ( instanced )
+        {
+            mInstancedProgram.bind();
+            mGl->glBindVertexArray( mInstancedVao );
+            mGl->glDrawArraysInstanced( GL_TRIANGLES, 0, LineSegmentGeometry::VERTICES_PER_SEGMENT, mSegmentCount );
+        }
+        else
+        {
+            mStripProgram.bind();
+            mGl->glBindVertexArray( mStripVao );
+            mGl->glEnable( GL_PRIMITIVE_RESTART );
+            mGl->glPrimitiveRestartIndex( 0 );
+            mGl->glDrawElements( GL_LINE_STRIP_ADJACENCY, mIndexCount, mIndexType, nullptr );
+            mGl->glDisable( GL_PRIMITIVE_RESTART );
+        }
+        mGl->glFinish();   // wait until the GPU is done
+        elapsedNs += timer.nsecsElapsed();
+        ++runs;
+    }
+
+    QCOMPARE( mGl->glGetError(), static_cast<GLenum>( GL_NO_ERROR ) );
+    qInfo( "%s: %.1f Msegments/s", QTest::currentDataTag(), double( mSegmentCount ) * runs / ( elapsedNs / 1e9 ) / 1e6 );
+}
+
+
+OFFSCREEN_GL_MAIN( BenchLines )
+
+#include "benchlines.moc"
@@ -0,0 +1,26 @@
+TEMPLATE = app
+TARGET = benchlines
+QT += testlib gui concurrent 3dcore 3drender
+CONFIG += console
+CONFIG -= app_bundle
+
+# headless benchmark of geometry shader vs instanced lines (see benchlines.cpp)
+
+INCLUDEPATH += .. ../../common
+
+SOURCES += \
+    benchlines.cpp \
+    ../drawdata.cpp \
+    ../linemeshbuilder.cpp \
+    ../linesegmentgeometry.cpp \
+    ../../common/offscreengl.cpp \
+    ../../common/pointfile.cpp
+
+HEADERS += \
+    ../drawdata.h \
+    ../linemeshbuilder.h \
+    ../linesegmentgeometry.h \
+    ../../common/offscreengl.h \
+    ../../common/pointfile.h
+
+RESOURCES += ../shaders.qrc
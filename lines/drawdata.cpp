@@ -1,7 +1,78 @@
 #include "drawdata.h"
 
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+// maximum vertex count that can be addressed by 16-bit indices
+static const int MAX_SHORT_INDEX_VERTICES = 65536;
+
+// minimal capacity (in items) when buffers need to grow
+static const int MIN_CAPACITY = 1024;
+
+
+namespace
+{
+
+  //! Packs positions of vertices on a Qt3D job thread
+  class VertexDataGenerator : public Qt3DRender::QBufferDataGenerator
+  {
+    public:
+      explicit VertexDataGenerator( const QVector<QVector3D> &vertices )
+        : mVertices( vertices )
+      {
+      }
+
+      QByteArray operator()() override
+      {
+        return QByteArray( reinterpret_cast<const char *>( mVertices.constData() ), mVertices.count() * sizeof( QVector3D ) );
+      }
+
+      bool operator ==( const Qt3DRender::QBufferDataGenerator &other ) const override
+      {
+        const VertexDataGenerator *otherGenerator = functor_cast<VertexDataGenerator>( &other );
+        return otherGenerator && otherGenerator->mVertices == mVertices;
+      }
+
+      QT3D_FUNCTOR( VertexDataGenerator )
+
+    private:
+      QVector<QVector3D> mVertices;
+  };
+
+  //! Packs indices to 16-bit or 32-bit integers on a Qt3D job thread
+  class IndexDataGenerator : public Qt3DRender::QBufferDataGenerator
+  {
+    public:
+      IndexDataGenerator( const QVector<int> &indices, bool shortIndices )
+        : mIndices( indices )
+        , mShortIndices( shortIndices )
+      {
+      }
+
+      QByteArray operator()() override
+      {
+        QByteArray data;
+        data.resize( mIndices.count() * ( mShortIndices ? sizeof( quint16 ) : sizeof( quint32 ) ) );
+        LineMeshGeometry::writeIndices( data.data(), reinterpret_cast<const quint32 *>( mIndices.constData() ), mIndices.count(), mShortIndices );
+        return data;
+      }
+
+      bool operator ==( const Qt3DRender::QBufferDataGenerator &other ) const override
+      {
+        const IndexDataGenerator *otherGenerator = functor_cast<IndexDataGenerator>( &other );
+        return otherGenerator && otherGenerator->mShortIndices == mShortIndices && otherGenerator->mIndices == mIndices;
+      }
+
+      QT3D_FUNCTOR( IndexDataGenerator )
+
+    private:
+      QVector<int> mIndices;
+      bool mShortIndices;
+  };
+
+}
 
-#include <Qt3DRender/QAttribute>
 
 LineMeshGeometry::LineMeshGeometry( Qt3DCore::QNode *parent )
   : Qt3DRender::QGeometry( parent )
@@ -17,44 +88,283 @@ LineMeshGeometry::LineMeshGeometry( Qt3DCore::QNode *parent )
   mPositionAttribute->setName( Qt3DRender::QAttribute::defaultPositionAttributeName() );
 
   mIndexAttribute->setAttributeType( Qt3DRender::QAttribute::IndexAttribute );
-  mIndexAttribute->setVertexBaseType( Qt3DRender::QAttribute::UnsignedInt );
+  mIndexAttribute->setVertexBaseType( Qt3DRender::QAttribute::UnsignedShort );
+  mIndexAttribute->setBuffer( mIndexBuffer );
+
+  // optional attributes get added by setVertexLayout()
+  // (colors are normalized, see PointFile::Attribute::type)
+  mColorAttribute = new Qt3DRender::QAttribute( mVertexBuffer, "vertexColor", Qt3DRender::QAttribute::UnsignedByte, 4, 0, 0, 0, this );
+  mWidthAttribute = new Qt3DRender::QAttribute( mVertexBuffer, "vertexWidth", Qt3DRender::QAttribute::Float, 1, 0, 0, 0, this );
+  mDistanceAttribute = new Qt3DRender::QAttribute( mVertexBuffer, "vertexDistance", Qt3DRender::QAttribute::Float, 1, 0, 0, 0, this );
 
   addAttribute( mPositionAttribute );
   addAttribute( mIndexAttribute );
 }
 
+void LineMeshGeometry::setVertexLayout( VertexAttributes attributes, int stride )
+{
+  if ( stride == 0 )
+    stride = packedStride( attributes );
+  Q_ASSERT( stride >= packedStride( attributes ) && stride % 4 == 0 );
+
+  mVertexAttributes = attributes;
+  mVertexStride = stride;
+  mPositionAttribute->setByteStride( stride );
+
+  const std::pair<VertexAttribute, Qt3DRender::QAttribute *> optionalAttributes[] =
+  {
+    { Color, mColorAttribute }, { Width, mWidthAttribute }, { Distance, mDistanceAttribute }
+  };
+  for ( const auto &item : optionalAttributes )
+  {
+    Qt3DRender::QAttribute *attribute = item.second;
+    attribute->setByteOffset( attributeOffset( attributes, item.first ) );
+    attribute->setByteStride( stride );
+    const bool used = attributes.testFlag( item.first );
+    if ( used && !this->attributes().contains( attribute ) )
+      addAttribute( attribute );
+    else if ( !used && this->attributes().contains( attribute ) )
+      removeAttribute( attribute );
+  }
+
+  // the existing data are in the old layout
+  mVertexCount = mVertexCapacity = 0;
+  mIndexCount = mIndexCapacity = 0;
+  mVertexBuffer->setDataGenerator( Qt3DRender::QBufferDataGeneratorPtr() );
+  mVertexBuffer->setData( QByteArray() );
+  mIndexBuffer->setDataGenerator( Qt3DRender::QBufferDataGeneratorPtr() );
+  mIndexBuffer->setData( QByteArray() );
+  updateAttributes();
+}
+
+int LineMeshGeometry::packedStride( VertexAttributes attributes )
+{
+  int size = 3 * sizeof( float );
+  for ( VertexAttribute attribute : { Color, Width, Distance } )
+  {
+    if ( attributes.testFlag( attribute ) )
+      size += 4;
+  }
+  return size;
+}
+
+int LineMeshGeometry::attributeOffset( VertexAttributes attributes, VertexAttribute attribute )
+{
+  // attributes are stored in the order of their flags, right after the position
+  int offset = 3 * sizeof( float );
+  for ( VertexAttribute previous : { Color, Width, Distance } )
+  {
+    if ( previous == attribute )
+      break;
+    if ( attributes.testFlag( previous ) )
+      offset += 4;
+  }
+  return offset;
+}
+
 int LineMeshGeometry::vertexCount()
 {
-  return mIndexCount;
+  return mDrawIndexCount;
 }
 
 void LineMeshGeometry::setVertices( const QVector<QVector3D> &vertices, const QVector<int> &indices )
 {
-  QByteArray vertexBufferData;
-  vertexBufferData.resize( vertices.size() * 3 * sizeof( float ) );
-  float *rawVertexArray = reinterpret_cast<float *>( vertexBufferData.data() );
-  int idx = 0;
-  for ( const auto &v : vertices )
+  // QVector3D is just three packed floats
+  static_assert( sizeof( QVector3D ) == 3 * sizeof( float ), "QVector3D is expected to be packed" );
+  static_assert( sizeof( int ) == sizeof( quint32 ), "int is expected to be 32-bit" );
+  Q_ASSERT( mVertexStride == sizeof( QVector3D ) );
+
+  mShortIndices = vertices.count() <= MAX_SHORT_INDEX_VERTICES;
+  mVertexCount = mVertexCapacity = vertices.count();
+  mIndexCount = mIndexCapacity = indices.count();
+
+  // just the vectors are passed on, the packing happens in the generators
+  mVertexBuffer->setData( QByteArray() );
+  mVertexBuffer->setDataGenerator( QSharedPointer<VertexDataGenerator>::create( vertices ) );
+  mIndexBuffer->setData( QByteArray() );
+  mIndexBuffer->setDataGenerator( QSharedPointer<IndexDataGenerator>::create( indices, mShortIndices ) );
+
+  updateAttributes();
+}
+
+void LineMeshGeometry::setVertices( const float *vertices, int vertexCount, const quint32 *indices, int indexCount )
+{
+  mShortIndices = vertexCount <= MAX_SHORT_INDEX_VERTICES;
+
+  QByteArray indexBufferData;
+  indexBufferData.resize( indexCount * indexSize() );
+  writeIndices( indexBufferData.data(), indices, indexCount );
+
+  setVertexData( QByteArray( reinterpret_cast<const char *>( vertices ), vertexCount * mVertexStride ),
+                 std::move( indexBufferData ),
+                 mShortIndices ? Qt3DRender::QAttribute::UnsignedShort : Qt3DRender::QAttribute::UnsignedInt );
+}
+
+void LineMeshGeometry::setVertexData( QByteArray vertexData, QByteArray indexData, Qt3DRender::QAttribute::VertexBaseType indexType )
+{
+  Q_ASSERT( indexType == Qt3DRender::QAttribute::UnsignedShort || indexType == Qt3DRender::QAttribute::UnsignedInt );
+
+  mShortIndices = indexType == Qt3DRender::QAttribute::UnsignedShort;
+  mVertexCount = mVertexCapacity = vertexData.size() / mVertexStride;
+  mIndexCount = mIndexCapacity = indexData.size() / indexSize();
+
+  mVertexBuffer->setDataGenerator( Qt3DRender::QBufferDataGeneratorPtr() );
+  mVertexBuffer->setData( vertexData );
+  mIndexBuffer->setDataGenerator( Qt3DRender::QBufferDataGeneratorPtr() );
+  mIndexBuffer->setData( indexData );
+
+  updateAttributes();
+}
+
+void LineMeshGeometry::setVertexData( QSharedPointer<const PointFile> vertexFile, QByteArray indexData, Qt3DRender::QAttribute::VertexBaseType indexType )
+{
+  Q_ASSERT( indexType == Qt3DRender::QAttribute::UnsignedShort || indexType == Qt3DRender::QAttribute::UnsignedInt );
+  Q_ASSERT( vertexFile->stride() == mVertexStride );
+  Q_ASSERT( vertexFile->positionAttribute() && vertexFile->positionAttribute()->offset == 0 );
+
+  mShortIndices = indexType == Qt3DRender::QAttribute::UnsignedShort;
+  mVertexCount = mVertexCapacity = vertexFile->count();
+  mIndexCount = mIndexCapacity = indexData.size() / indexSize();
+
+  // the buffer gets its data from the generator, so there is no copy on the frontend
+  mVertexBuffer->setData( QByteArray() );
+  mVertexBuffer->setDataGenerator( QSharedPointer<PointFileDataGenerator>::create( vertexFile ) );
+  mIndexBuffer->setDataGenerator( Qt3DRender::QBufferDataGeneratorPtr() );
+  mIndexBuffer->setData( indexData );
+
+  updateAttributes();
+}
+
+void LineMeshGeometry::appendVertices( const float *vertices, int vertexCount, const quint32 *indices, int indexCount )
+{
+  detachGenerators();
+  if ( mShortIndices && mVertexCount + vertexCount > MAX_SHORT_INDEX_VERTICES )
+    convertToLongIndices();
+
+  appendToBuffer( mVertexBuffer, mVertexCapacity, mVertexCount, mVertexStride,
+                  QByteArray( reinterpret_cast<const char *>( vertices ), vertexCount * mVertexStride ) );
+  mVertexCount += vertexCount;
+
+  QByteArray indexBytes;
+  indexBytes.resize( indexCount * indexSize() );
+  writeIndices( indexBytes.data(), indices, indexCount );
+  appendToBuffer( mIndexBuffer, mIndexCapacity, mIndexCount, indexSize(), indexBytes );
+  mIndexCount += indexCount;
+
+  updateAttributes();
+}
+
+void LineMeshGeometry::updateVertices( int firstVertex, const float *vertices, int count )
+{
+  Q_ASSERT( firstVertex >= 0 && firstVertex + count <= mVertexCount );
+  detachGenerators();
+  mVertexBuffer->updateData( firstVertex * mVertexStride,
+                             QByteArray( reinterpret_cast<const char *>( vertices ), count * mVertexStride ) );
+}
+
+void LineMeshGeometry::updateIndices( int firstIndex, const quint32 *indices, int count )
+{
+  Q_ASSERT( firstIndex >= 0 && firstIndex + count <= mIndexCount );
+  detachGenerators();
+  QByteArray bytes;
+  bytes.resize( count * indexSize() );
+  writeIndices( bytes.data(), indices, count );
+  mIndexBuffer->updateData( firstIndex * indexSize(), bytes );
+}
+
+void LineMeshGeometry::setIndexRange( int firstIndex, int count )
+{
+  Q_ASSERT( firstIndex >= 0 && firstIndex + count <= mIndexCount );
+  if ( count == mDrawIndexCount && firstIndex * indexSize() == static_cast<int>( mIndexAttribute->byteOffset() ) )
+    return;
+
+  // no data get uploaded, the attribute just points to another part of the index buffer
+  mDrawIndexCount = count;
+  mIndexAttribute->setByteOffset( firstIndex * indexSize() );
+  mIndexAttribute->setCount( count );
+  emit countChanged( mDrawIndexCount );
+}
+
+void LineMeshGeometry::writeIndices( char *dest, const quint32 *indices, int count ) const
+{
+  writeIndices( dest, indices, count, mShortIndices );
+}
+
+void LineMeshGeometry::writeIndices( char *dest, const quint32 *indices, int count, bool shortIndices )
+{
+  if ( shortIndices )
   {
-    rawVertexArray[idx++] = v.x();
-    rawVertexArray[idx++] = v.y();
-    rawVertexArray[idx++] = v.z();
+    quint16 *out = reinterpret_cast<quint16 *>( dest );
+    for ( int i = 0; i < count; ++i )
+    {
+      Q_ASSERT( indices[i] < static_cast<quint32>( MAX_SHORT_INDEX_VERTICES ) );
+      out[i] = static_cast<quint16>( indices[i] );
+    }
   }
+  else
+    std::memcpy( dest, indices, count * sizeof( quint32 ) );
+}
 
-  mVertexCount = vertices.count();
-  mVertexBuffer->setData( vertexBufferData );
+void LineMeshGeometry::appendToBuffer( Qt3DRender::QBuffer *buffer, int &capacity, int count, int itemSize, const QByteArray &bytes )
+{
+  if ( bytes.isEmpty() )
+    return;
 
+  const int newCount = count + bytes.size() / itemSize;
+  if ( newCount <= capacity )
+  {
+    // only the appended bytes get uploaded
+    buffer->updateData( count * itemSize, bytes );
+    return;
+  }
 
-  mIndexCount = indices.count();
-  QByteArray indexBufferData;
-  indexBufferData.resize( mIndexCount * sizeof(int) );
-  int *rawIndexArray = reinterpret_cast<int *>( indexBufferData.data() );
-  for (int i = 0; i < indices.count(); ++i)
-    rawIndexArray[i] = indices[i];
-  mIndexBuffer->setData( indexBufferData );
+  // reallocate - grow geometrically so that appending is amortized
+  capacity = std::max( { newCount, capacity * 2, MIN_CAPACITY } );
+  QByteArray data = buffer->data();
+  data.resize( capacity * itemSize );
+  std::memcpy( data.data() + count * itemSize, bytes.constData(), bytes.size() );
+  buffer->setData( data );
+}
 
-  mIndexAttribute->setBuffer( mIndexBuffer );
+void LineMeshGeometry::convertToLongIndices()
+{
+  // attributes get updated by the caller
+  const QByteArray shortData = mIndexBuffer->data();
+  const quint16 *in = reinterpret_cast<const quint16 *>( shortData.constData() );
+
+  QByteArray data;
+  data.resize( mIndexCapacity * sizeof( quint32 ) );
+  quint32 *out = reinterpret_cast<quint32 *>( data.data() );
+  for ( int i = 0; i < mIndexCount; ++i )
+    out[i] = in[i];
+
+  mShortIndices = false;
+  mIndexBuffer->setData( data );
+}
+
+void LineMeshGeometry::updateAttributes()
+{
+  for ( Qt3DRender::QAttribute *attribute : { mPositionAttribute, mColorAttribute, mWidthAttribute, mDistanceAttribute } )
+    attribute->setCount( mVertexCount );
+  mIndexAttribute->setVertexBaseType( mShortIndices ? Qt3DRender::QAttribute::UnsignedShort : Qt3DRender::QAttribute::UnsignedInt );
+  mIndexAttribute->setByteOffset( 0 );
   mIndexAttribute->setCount( mIndexCount );
+  mDrawIndexCount = mIndexCount;
 
-  emit countChanged(mVertexCount);
+  emit countChanged( mDrawIndexCount );
+}
+
+void LineMeshGeometry::detachGenerators()
+{
+  // partial updates need the whole buffer data on the frontend, so the generators run here once
+  for ( Qt3DRender::QBuffer *buffer : { mVertexBuffer, mIndexBuffer } )
+  {
+    const Qt3DRender::QBufferDataGeneratorPtr generator = buffer->dataGenerator();
+    if ( !generator )
+      continue;
+
+    const QByteArray data = copyGeneratedData( generator );
+    buffer->setDataGenerator( Qt3DRender::QBufferDataGeneratorPtr() );
+    buffer->setData( data );
+  }
 }
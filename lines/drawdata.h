@@ -2,12 +2,29 @@
 #define DRAWDATA_H
 
 #include <Qt3DCore/QNode>
+#include <Qt3DRender/QAttribute>
 #include <Qt3DRender/QBuffer>
 
+#include <QSharedPointer>
 #include <QVector3D>
 
 #include <Qt3DRender/QGeometry>
 
+#include "pointfile.h"
+
+/**
+ * Geometry for lines rendered as lines with adjacency (each line is given
+ * as prev-p0-p1-next, index 0 is used as the primitive restart index).
+ *
+ * Vertices are packed [x, y, z] floats by default. Optionally they may be followed
+ * by color, width and distance along the line (see setVertexLayout()), interleaved
+ * in the same buffer - so differently styled lines can be drawn with a single draw call.
+ * Indices are 16-bit whenever the number of vertices allows it, 32-bit otherwise.
+ *
+ * Besides setting all the data at once, vertices and indices can be appended
+ * (e.g. for streaming of tracks that keep growing) or updated in place: buffers
+ * are allocated with spare capacity and only the changed bytes get uploaded.
+ */
 class LineMeshGeometry : public Qt3DRender::QGeometry
 {
     Q_OBJECT
@@ -15,23 +32,136 @@ class LineMeshGeometry : public Qt3DRender::QGeometry
   Q_PROPERTY(int count READ vertexCount NOTIFY countChanged)
 
   public:
+
+    /**
+     * Optional per-vertex attributes, stored after the position in this order.
+     * Each of them takes 4 bytes, so vertices can still be handled as arrays of floats.
+     */
+    enum VertexAttribute
+    {
+      Color = 0x1,      //!< "vertexColor" - red, green, blue, alpha as normalized unsigned bytes
+      Width = 0x2,      //!< "vertexWidth" - float line thickness in pixels (replaces THICKNESS)
+      Distance = 0x4,   //!< "vertexDistance" - float distance from the start of the polyline
+    };
+    Q_DECLARE_FLAGS( VertexAttributes, VertexAttribute )
+
     LineMeshGeometry( Qt3DCore::QNode *parent = nullptr );
 
+    /**
+     * Sets which optional \a attributes each vertex has and the byte \a stride between vertices
+     * (zero means tightly packed, otherwise it must be a multiple of 4 and at least packedStride()).
+     * Existing data get cleared - the layout needs to be set before setting vertices.
+     */
+    void setVertexLayout( VertexAttributes attributes, int stride = 0 );
+
+    //! Returns optional per-vertex attributes
+    VertexAttributes vertexAttributes() const { return mVertexAttributes; }
+
+    //! Returns byte stride between vertices
+    int vertexStride() const { return mVertexStride; }
+
+    //! Returns byte size of a vertex with position and the given \a attributes
+    static int packedStride( VertexAttributes attributes );
+
+    //! Returns byte offset of the \a attribute within a vertex with the given \a attributes
+    static int attributeOffset( VertexAttributes attributes, VertexAttribute attribute );
+
+    //! Writes indices to raw index buffer data as 16-bit integers if \a shortIndices is true, 32-bit otherwise
+    static void writeIndices( char *dest, const quint32 *indices, int count, bool shortIndices );
+
+    //! Returns number of indices to be drawn
     int vertexCount();
 
+    /**
+     * Sets vertices (only with the default layout - positions only) and indices. Only references
+     * to the vectors are kept: the buffers get packed by data generators on Qt3D job threads,
+     * and setting the same data again does not regenerate them.
+     */
     void setVertices( const QVector<QVector3D> &vertices, const QVector<int> &indices );
 
+    //! Sets \a vertexCount vertices (vertexStride() bytes each) and \a indexCount indices
+    void setVertices( const float *vertices, int vertexCount, const quint32 *indices, int indexCount );
+
+    /**
+     * Takes already packed buffer data without copying them: \a vertexData with vertexStride()
+     * bytes for each vertex and \a indexData with indices of type \a indexType
+     * (UnsignedShort or UnsignedInt). Pass the arrays with std::move() to avoid
+     * keeping another reference to them.
+     */
+    void setVertexData( QByteArray vertexData, QByteArray indexData, Qt3DRender::QAttribute::VertexBaseType indexType );
+
+    /**
+     * Takes vertices from a memory mapped \a vertexFile (with vertexStride() bytes per record and positions
+     * at the start of records) without copying them - they are only read when Qt3D uploads the buffer.
+     * Appending or updating vertices later copies them from the file first.
+     */
+    void setVertexData( QSharedPointer<const PointFile> vertexFile, QByteArray indexData, Qt3DRender::QAttribute::VertexBaseType indexType );
+
+    /**
+     * Appends \a vertexCount vertices (vertexStride() bytes each) and \a indexCount indices (indices refer
+     * to all vertices, including the existing ones). Only the appended data get uploaded,
+     * unless the buffers need to grow or the indices need to switch to 32-bit.
+     */
+    void appendVertices( const float *vertices, int vertexCount, const quint32 *indices, int indexCount );
+
+    //! Replaces \a count vertices starting at \a firstVertex (only these get uploaded)
+    void updateVertices( int firstVertex, const float *vertices, int count );
+
+    //! Replaces \a count indices starting at \a firstIndex (only these get uploaded)
+    void updateIndices( int firstIndex, const quint32 *indices, int count );
+
+    /**
+     * Draws only \a count indices starting at \a firstIndex, e.g. to switch between levels
+     * of detail stored in one index buffer. Setting new data resets the range to all indices.
+     */
+    void setIndexRange( int firstIndex, int count );
+
+    //! Returns whether the indices are stored as 16-bit integers
+    bool hasShortIndices() const { return mShortIndices; }
+
   signals:
       void countChanged(int count);
 
   private:
+    //! Returns byte size of a single index
+    int indexSize() const { return mShortIndices ? sizeof( quint16 ) : sizeof( quint32 ); }
+
+    //! Writes indices to raw index buffer data in the current index type
+    void writeIndices( char *dest, const quint32 *indices, int count ) const;
+
+    /**
+     * Appends \a bytes after \a count items of size \a itemSize in the \a buffer. If the buffer
+     * has not enough \a capacity, it is reallocated (and \a capacity updated).
+     */
+    static void appendToBuffer( Qt3DRender::QBuffer *buffer, int &capacity, int count, int itemSize, const QByteArray &bytes );
+
+    //! Converts the index buffer from 16-bit to 32-bit indices
+    void convertToLongIndices();
+
+    //! Updates attributes after the counts or index type have changed
+    void updateAttributes();
+
+    //! Runs data generators of the buffers (if they have any) so that their data can be modified
+    void detachGenerators();
+
     Qt3DRender::QAttribute *mPositionAttribute = nullptr;
+    Qt3DRender::QAttribute *mColorAttribute = nullptr;
+    Qt3DRender::QAttribute *mWidthAttribute = nullptr;
+    Qt3DRender::QAttribute *mDistanceAttribute = nullptr;
     Qt3DRender::QAttribute *mIndexAttribute = nullptr;
     Qt3DRender::QBuffer *mVertexBuffer = nullptr;
     Qt3DRender::QBuffer *mIndexBuffer = nullptr;
     int mVertexCount = 0;
     int mIndexCount = 0;
+    int mDrawIndexCount = 0;   //!< Number of indices drawn (see setIndexRange())
+    int mVertexCapacity = 0;   //!< Number of vertices that fit into the vertex buffer
+    int mIndexCapacity = 0;    //!< Number of indices that fit into the index buffer
+    bool mShortIndices = true;
+    VertexAttributes mVertexAttributes;
+    int mVertexStride = 3 * sizeof( float );
 
 };
 
+Q_DECLARE_OPERATORS_FOR_FLAGS( LineMeshGeometry::VertexAttributes )
+
 #endif // DRAWDATA_H
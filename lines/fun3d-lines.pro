@@ -1,5 +1,5 @@
 TEMPLATE = app
-QT += 3dcore 3drender 3dinput 3dquick qml quick 3dquickextras 3dextras
+QT += concurrent 3dcore 3drender 3dinput 3dquick qml quick 3dquickextras 3dextras
 
 # The following define makes your compiler emit warnings if you use
 # any Qt feature that has been marked deprecated (the exact warnings
@@ -12,9 +12,17 @@ DEFINES += QT_DEPRECATED_WARNINGS
 # You can also select to disable deprecated APIs only up to a certain version of Qt.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+# shared with other demos (see common/)
+INCLUDEPATH += ../common
+
 SOURCES += \
         main.cpp \
-    drawdata.cpp
+    drawdata.cpp \
+    linemeshbuilder.cpp \
+    linemeshchunks.cpp \
+    linemeshlod.cpp \
+    linesegmentgeometry.cpp \
+    ../common/pointfile.cpp
 
 RESOURCES += qml.qrc \
     shaders.qrc
@@ -31,9 +39,15 @@ else: unix:!android: target.path = /opt/$${TARGET}/bin
 !isEmpty(target.path): INSTALLS += target
 
 HEADERS += \
-    drawdata.h
+    drawdata.h \
+    linemeshbuilder.h \
+    linemeshchunks.h \
+    linemeshlod.h \
+    linesegmentgeometry.h \
+    ../common/pointfile.h
 
 DISTFILES += \
     lines.vert \
     lines.frag \
-    lines.geom
+    lines.geom \
+    lines_instanced.vert
@@ -0,0 +1,289 @@
+#include "linemeshbuilder.h"
+
+#include "drawdata.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <QtConcurrent/QtConcurrentMap>
+
+// polylines written by a single task when running in parallel
+static const int CHUNK_SIZE = 4096;
+
+// maximum vertex count that can be addressed by 16-bit indices
+static const int MAX_SHORT_INDEX_VERTICES = 65536;
+
+// vertices summed by a single task of the parallel prefix sum
+static const int SCAN_BLOCK_SIZE = 65536;
+
+
+namespace
+{
+
+  //! Figures out how many points of the polyline get used and whether it is handled as a ring
+  void polylineShape( const float *positions, const int *offsets, const quint8 *closed, int i, int &count, bool &ring )
+  {
+    count = offsets[i + 1] - offsets[i];
+    ring = closed && closed[i];
+    if ( ring && count > 1 )
+    {
+      // drop the last point if it repeats the first one
+      const float *first = positions + offsets[i] * 3;
+      const float *last = positions + ( offsets[i + 1] - 1 ) * 3;
+      if ( first[0] == last[0] && first[1] == last[1] && first[2] == last[2] )
+        --count;
+    }
+    if ( count < 2 )
+      count = 0;   // nothing to draw
+    if ( count < 3 )
+      ring = false;
+  }
+
+  // same as LineMeshBuilder::writeStripIndices() - just for consecutive vertices
+  template <typename T>
+  void writePolylineIndices( T *out, int firstVertex, int count, bool ring )
+  {
+    const T first = static_cast<T>( firstVertex );
+    const T last = static_cast<T>( firstVertex + count - 1 );
+
+    *out++ = ring ? last : first;
+    for ( int j = 0; j < count; ++j )
+      *out++ = static_cast<T>( firstVertex + j );
+    if ( ring )
+    {
+      *out++ = first;
+      *out++ = static_cast<T>( firstVertex + 1 );
+    }
+    else
+      *out++ = last;
+    *out++ = 0;   // restart
+  }
+
+  //! Calls \a f( begin, end ) for ranges of \a chunkSize items - in parallel if there is more than one
+  template <typename F>
+  void forEachChunk( int count, int chunkSize, const F &f )
+  {
+    if ( count <= chunkSize )
+    {
+      f( 0, count );
+      return;
+    }
+
+    QVector<int> chunks;
+    for ( int begin = 0; begin < count; begin += chunkSize )
+      chunks.append( begin );
+
+    QtConcurrent::blockingMap( chunks, [&f, count, chunkSize]( int begin )
+    {
+      f( begin, std::min( begin + chunkSize, count ) );
+    } );
+  }
+
+}
+
+
+LineMeshData LineMeshBuilder::build( const float *positions, const int *offsets, int polylineCount, const quint8 *closed, const int *order )
+{
+  // prefix sums of vertex/index counts give offsets of each polyline in the output
+  QVector<int> pointCounts( polylineCount );
+  QVector<quint8> rings( polylineCount );
+  QVector<int> vertexOffsets( polylineCount + 1 );
+  QVector<int> indexOffsets( polylineCount + 1 );
+  vertexOffsets[0] = 1;   // vertex 0 is the restart sentinel
+  indexOffsets[0] = 0;
+  for ( int i = 0; i < polylineCount; ++i )
+  {
+    bool ring;
+    polylineShape( positions, offsets, closed, order ? order[i] : i, pointCounts[i], ring );
+    rings[i] = ring;
+    vertexOffsets[i + 1] = vertexOffsets[i] + pointCounts[i];
+    indexOffsets[i + 1] = indexOffsets[i] + LineMeshBuilder::stripIndexCount( pointCounts[i], ring );
+  }
+
+  LineMeshData data;
+  data.vertexCount = vertexOffsets[polylineCount];
+  data.indexCount = indexOffsets[polylineCount];
+  const bool shortIndices = data.vertexCount <= MAX_SHORT_INDEX_VERTICES;
+  data.indexType = shortIndices ? Qt3DRender::QAttribute::UnsignedShort : Qt3DRender::QAttribute::UnsignedInt;
+
+  data.vertexData.resize( data.vertexCount * 3 * sizeof( float ) );
+  data.indexData.resize( data.indexCount * ( shortIndices ? sizeof( quint16 ) : sizeof( quint32 ) ) );
+  float *vertexOut = reinterpret_cast<float *>( data.vertexData.data() );
+  char *indexOut = data.indexData.data();
+  vertexOut[0] = vertexOut[1] = vertexOut[2] = 0;
+
+  auto writeRange = [ =, &pointCounts, &rings, &vertexOffsets, &indexOffsets ]( int begin, int end )
+  {
+    for ( int i = begin; i < end; ++i )
+    {
+      const int count = pointCounts[i];
+      if ( count == 0 )
+        continue;
+
+      const int source = order ? order[i] : i;
+      std::memcpy( vertexOut + vertexOffsets[i] * 3, positions + offsets[source] * 3, count * 3 * sizeof( float ) );
+      if ( shortIndices )
+        writePolylineIndices( reinterpret_cast<quint16 *>( indexOut ) + indexOffsets[i], vertexOffsets[i], count, rings[i] );
+      else
+        writePolylineIndices( reinterpret_cast<quint32 *>( indexOut ) + indexOffsets[i], vertexOffsets[i], count, rings[i] );
+    }
+  };
+
+  if ( polylineCount <= CHUNK_SIZE )
+  {
+    writeRange( 0, polylineCount );
+  }
+  else
+  {
+    QVector<int> chunks;
+    for ( int begin = 0; begin < polylineCount; begin += CHUNK_SIZE )
+      chunks.append( begin );
+
+    QtConcurrent::blockingMap( chunks, [&writeRange, polylineCount]( int begin )
+    {
+      writeRange( begin, std::min( begin + CHUNK_SIZE, polylineCount ) );
+    } );
+  }
+
+  data.polylineVertexOffsets = std::move( vertexOffsets );
+  data.polylineRings = std::move( rings );
+  return data;
+}
+
+LineMeshData LineMeshBuilder::build( const QVector<QVector<QVector3D>> &polylines, const QVector<bool> &closed )
+{
+  static_assert( sizeof( QVector3D ) == 3 * sizeof( float ), "QVector3D is expected to be packed" );
+
+  QVector<int> offsets;
+  offsets.reserve( polylines.count() + 1 );
+  offsets.append( 0 );
+  for ( const QVector<QVector3D> &polyline : polylines )
+    offsets.append( offsets.last() + polyline.count() );
+
+  QVector<QVector3D> positions;
+  positions.reserve( offsets.last() );
+  for ( const QVector<QVector3D> &polyline : polylines )
+    positions.append( polyline );
+
+  QVector<quint8> closedFlags;
+  if ( !closed.isEmpty() )
+  {
+    Q_ASSERT( closed.count() == polylines.count() );
+    closedFlags.reserve( closed.count() );
+    for ( bool c : closed )
+      closedFlags.append( c );
+  }
+
+  return build( reinterpret_cast<const float *>( positions.constData() ), offsets.constData(), polylines.count(),
+                closedFlags.isEmpty() ? nullptr : closedFlags.constData() );
+}
+
+void LineMeshBuilder::build( LineMeshGeometry *geometry, const QVector<QVector<QVector3D>> &polylines, const QVector<bool> &closed )
+{
+  LineMeshData data = build( polylines, closed );
+  geometry->setVertexData( std::move( data.vertexData ), std::move( data.indexData ), data.indexType );
+}
+
+QVector<float> LineMeshBuilder::cumulativeDistances( const LineMeshData &data )
+{
+  const float *positions = reinterpret_cast<const float *>( data.vertexData.constData() );
+  const int *offsetsBegin = data.polylineVertexOffsets.constData();
+  const int *offsetsEnd = offsetsBegin + data.polylineVertexOffsets.count();
+  QVector<float> distances( data.vertexCount );
+  float *out = distances.data();
+
+  const int blockCount = ( data.vertexCount + SCAN_BLOCK_SIZE - 1 ) / SCAN_BLOCK_SIZE;
+  QVector<float> blockSums( blockCount );
+  QVector<int> blockFirstStarts( blockCount );   // first polyline start in each block (or its end)
+
+  // 1. local sums within blocks, restarting at the first vertex of each polyline
+  forEachChunk( data.vertexCount, SCAN_BLOCK_SIZE, [ =, &blockSums, &blockFirstStarts ]( int begin, int end )
+  {
+    const int block = begin / SCAN_BLOCK_SIZE;
+    const int *nextStart = std::lower_bound( offsetsBegin, offsetsEnd, begin );
+    blockFirstStarts[block] = nextStart != offsetsEnd ? std::min( *nextStart, end ) : end;
+    float sum = 0;
+    for ( int v = begin; v < end; ++v )
+    {
+      if ( nextStart != offsetsEnd && *nextStart == v )
+      {
+        sum = 0;
+        // skip empty polylines starting at the same vertex
+        while ( nextStart != offsetsEnd && *nextStart == v )
+          ++nextStart;
+      }
+      else if ( v > 0 )
+      {
+        const float *p = positions + v * 3;
+        const float dx = p[0] - p[-3], dy = p[1] - p[-2], dz = p[2] - p[-1];
+        sum += std::sqrt( dx * dx + dy * dy + dz * dz );
+      }
+      out[v] = sum;
+    }
+    blockSums[block] = sum;
+  } );
+
+  // 2. sums carried into each block: they pass through a block only if no polyline starts in it
+  QVector<float> carries( blockCount );
+  for ( int block = 1; block < blockCount; ++block )
+  {
+    const bool restarted = blockFirstStarts[block - 1] < std::min( block * SCAN_BLOCK_SIZE, data.vertexCount );
+    carries[block] = restarted ? blockSums[block - 1] : carries[block - 1] + blockSums[block - 1];
+  }
+
+  // 3. add the carried sums up to the first polyline start of each block
+  forEachChunk( data.vertexCount, SCAN_BLOCK_SIZE, [ =, &carries, &blockFirstStarts ]( int begin, int )
+  {
+    const int block = begin / SCAN_BLOCK_SIZE;
+    for ( int v = begin; v < blockFirstStarts[block]; ++v )
+      out[v] += carries[block];
+  } );
+
+  return distances;
+}
+
+QByteArray LineMeshBuilder::interleavedVertexData( const LineMeshData &data, LineMeshGeometry::VertexAttributes attributes, int stride,
+    const QVector<QRgb> &colors, const QVector<float> &widths )
+{
+  const int polylineCount = data.polylineVertexOffsets.count() - 1;
+  Q_ASSERT( !attributes.testFlag( LineMeshGeometry::Color ) || colors.count() == polylineCount );
+  Q_ASSERT( !attributes.testFlag( LineMeshGeometry::Width ) || widths.count() == polylineCount );
+
+  if ( stride == 0 )
+    stride = LineMeshGeometry::packedStride( attributes );
+  const int colorOffset = LineMeshGeometry::attributeOffset( attributes, LineMeshGeometry::Color );
+  const int widthOffset = LineMeshGeometry::attributeOffset( attributes, LineMeshGeometry::Width );
+  const int distanceOffset = LineMeshGeometry::attributeOffset( attributes, LineMeshGeometry::Distance );
+  const QVector<float> distances = attributes.testFlag( LineMeshGeometry::Distance ) ? cumulativeDistances( data ) : QVector<float>();
+
+  QByteArray vertexData( data.vertexCount * stride, 0 );   // the sentinel (and any padding) stays zero
+  const char *positions = data.vertexData.constData();
+  char *out = vertexData.data();
+  std::memcpy( out, positions, 3 * sizeof( float ) );
+
+  forEachChunk( polylineCount, CHUNK_SIZE, [ =, &data, &colors, &widths, &distances ]( int begin, int end )
+  {
+    for ( int i = begin; i < end; ++i )
+    {
+      // colors as bytes in RGBA order
+      const quint8 color[4] = { quint8( qRed( colors.value( i ) ) ), quint8( qGreen( colors.value( i ) ) ),
+                                quint8( qBlue( colors.value( i ) ) ), quint8( qAlpha( colors.value( i ) ) )
+                              };
+      const float width = widths.value( i );
+      for ( int v = data.polylineVertexOffsets[i]; v < data.polylineVertexOffsets[i + 1]; ++v )
+      {
+        char *vertex = out + v * stride;
+        std::memcpy( vertex, positions + v * 3 * sizeof( float ), 3 * sizeof( float ) );
+        if ( attributes.testFlag( LineMeshGeometry::Color ) )
+          std::memcpy( vertex + colorOffset, color, sizeof( color ) );
+        if ( attributes.testFlag( LineMeshGeometry::Width ) )
+          std::memcpy( vertex + widthOffset, &width, sizeof( float ) );
+        if ( attributes.testFlag( LineMeshGeometry::Distance ) )
+          std::memcpy( vertex + distanceOffset, distances.constData() + v, sizeof( float ) );
+      }
+    }
+  } );
+
+  return vertexData;
+}
@@ -0,0 +1,105 @@
+#ifndef LINEMESHBUILDER_H
+#define LINEMESHBUILDER_H
+
+#include <QByteArray>
+#include <QRgb>
+#include <QVector>
+#include <QVector3D>
+
+#include <Qt3DRender/QAttribute>
+
+#include "drawdata.h"
+
+//! Vertex and index buffer data ready to be used by LineMeshGeometry::setVertexData()
+struct LineMeshData
+{
+  QByteArray vertexData;   //!< Packed [x, y, z] floats
+  QByteArray indexData;    //!< Indices of type indexType
+  Qt3DRender::QAttribute::VertexBaseType indexType = Qt3DRender::QAttribute::UnsignedShort;
+  int vertexCount = 0;
+  int indexCount = 0;
+  QVector<int> polylineVertexOffsets;   //!< First vertex of each polyline (plus one item with vertexCount at the end)
+  QVector<quint8> polylineRings;        //!< Whether each polyline is drawn as a closed ring
+};
+
+/**
+ * Builds vertex and index buffers for LineMeshGeometry (line strips with adjacency,
+ * separated by primitive restart index 0) from a list of polylines.
+ *
+ * Vertex 0 is reserved as the restart sentinel, vertices of polylines follow.
+ * Each open polyline p0 ... pn is written as indices p0, p0, p1, ... pn, pn, restart
+ * (the duplicated end points give the first and the last segment their adjacency).
+ * Closed rings wrap around: pn, p0, p1, ... pn, p0, p1, restart - so that there is
+ * a proper miter at the first point as well.
+ *
+ * Offsets of each polyline in the output buffers are calculated upfront with a prefix sum,
+ * so the buffers are allocated just once and polylines get written in parallel.
+ */
+class LineMeshBuilder
+{
+  public:
+
+    /**
+     * Builds buffers for \a polylineCount polylines from packed [x, y, z] float \a positions.
+     * Points of polyline i are positions from offsets[i] to offsets[i+1] (exclusive),
+     * so \a offsets has polylineCount + 1 items. If \a closed is not null, it says for each
+     * polyline whether it is a closed ring (the last point may repeat the first one).
+     * If \a order is not null, the i-th polyline of the output is polyline order[i] of the input.
+     */
+    static LineMeshData build( const float *positions, const int *offsets, int polylineCount, const quint8 *closed = nullptr, const int *order = nullptr );
+
+    //! Builds buffers for the \a polylines (optionally flagged as \a closed rings)
+    static LineMeshData build( const QVector<QVector<QVector3D>> &polylines, const QVector<bool> &closed = QVector<bool>() );
+
+    //! Builds buffers for the \a polylines and sets them to the \a geometry
+    static void build( LineMeshGeometry *geometry, const QVector<QVector<QVector3D>> &polylines, const QVector<bool> &closed = QVector<bool>() );
+
+    /**
+     * Returns distance of each vertex of \a data from the start of its polyline (zero for
+     * the restart sentinel). This is a segmented prefix sum of segment lengths: blocks of
+     * vertices are summed in parallel, then sums of the preceding blocks get added to each block.
+     * Closed rings do not get the closing segment - the distance restarts at their first point.
+     */
+    static QVector<float> cumulativeDistances( const LineMeshData &data );
+
+    /**
+     * Returns vertex data of \a data with the optional \a attributes interleaved, for a LineMeshGeometry
+     * with the same vertex layout (see LineMeshGeometry::setVertexLayout(), zero \a stride means packed).
+     * \a colors and \a widths give the style of each polyline (in the order of polylines in \a data)
+     * and are only needed with the Color and Width attributes.
+     */
+    static QByteArray interleavedVertexData( const LineMeshData &data, LineMeshGeometry::VertexAttributes attributes, int stride = 0,
+        const QVector<QRgb> &colors = QVector<QRgb>(), const QVector<float> &widths = QVector<float>() );
+
+    //! Returns number of indices (including the restart index) of a strip with \a count vertices
+    static int stripIndexCount( int count, bool ring )
+    {
+      if ( count < 2 )
+        return 0;
+      return count + ( ring ? 3 : 2 ) + 1;
+    }
+
+    /**
+     * Writes indices of a strip going through \a count vertices given by \a vertices
+     * to \a out (which must have space for stripIndexCount() items).
+     */
+    template <typename T>
+    static void writeStripIndices( T *out, const quint32 *vertices, int count, bool ring )
+    {
+      if ( count < 2 )
+        return;
+      *out++ = static_cast<T>( ring ? vertices[count - 1] : vertices[0] );
+      for ( int j = 0; j < count; ++j )
+        *out++ = static_cast<T>( vertices[j] );
+      if ( ring )
+      {
+        *out++ = static_cast<T>( vertices[0] );
+        *out++ = static_cast<T>( vertices[1] );
+      }
+      else
+        *out++ = static_cast<T>( vertices[count - 1] );
+      *out++ = 0;   // restart
+    }
+};
+
+#endif // LINEMESHBUILDER_H
@@ -0,0 +1,283 @@
+#include "linemeshchunks.h"
+
+#include "linemeshbuilder.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+#include <QVector4D>
+#include <QtConcurrent/QtConcurrentMap>
+
+// polylines processed by a single task when running in parallel
+static const int CHUNK_SIZE = 4096;
+
+
+LineMeshChunk::LineMeshChunk( Qt3DRender::QBuffer *vertexBuffer, Qt3DRender::QBuffer *indexBuffer, Qt3DRender::QAttribute::VertexBaseType indexType,
+                              int firstIndex, int indexCount, const QVector3D &minimum, const QVector3D &maximum, Qt3DCore::QNode *parent )
+  : Qt3DRender::QGeometry( parent )
+  , mIndexCount( indexCount )
+  , mMinimum( minimum )
+  , mMaximum( maximum )
+{
+  Qt3DRender::QAttribute *positionAttribute = new Qt3DRender::QAttribute( this );
+  positionAttribute->setAttributeType( Qt3DRender::QAttribute::VertexAttribute );
+  positionAttribute->setBuffer( vertexBuffer );
+  positionAttribute->setVertexBaseType( Qt3DRender::QAttribute::Float );
+  positionAttribute->setVertexSize( 3 );
+  positionAttribute->setName( Qt3DRender::QAttribute::defaultPositionAttributeName() );
+
+  const int indexSize = indexType == Qt3DRender::QAttribute::UnsignedShort ? sizeof( quint16 ) : sizeof( quint32 );
+  Qt3DRender::QAttribute *indexAttribute = new Qt3DRender::QAttribute( this );
+  indexAttribute->setAttributeType( Qt3DRender::QAttribute::IndexAttribute );
+  indexAttribute->setBuffer( indexBuffer );
+  indexAttribute->setVertexBaseType( indexType );
+  indexAttribute->setByteOffset( firstIndex * indexSize );
+  indexAttribute->setCount( indexCount );
+
+  addAttribute( positionAttribute );
+  addAttribute( indexAttribute );
+}
+
+void LineMeshChunk::setVisible( bool visible )
+{
+  if ( visible == mVisible )
+    return;
+
+  mVisible = visible;
+  emit visibleChanged( mVisible );
+}
+
+
+namespace
+{
+
+  struct Box
+  {
+    QVector3D minimum = QVector3D( std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() );
+    QVector3D maximum = QVector3D( -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() );
+
+    void add( const QVector3D &p )
+    {
+      minimum = QVector3D( std::min( minimum.x(), p.x() ), std::min( minimum.y(), p.y() ), std::min( minimum.z(), p.z() ) );
+      maximum = QVector3D( std::max( maximum.x(), p.x() ), std::max( maximum.y(), p.y() ), std::max( maximum.z(), p.z() ) );
+    }
+
+    void add( const Box &other )
+    {
+      add( other.minimum );
+      add( other.maximum );
+    }
+
+    int longestAxis() const
+    {
+      const QVector3D size = maximum - minimum;
+      if ( size.x() >= size.y() && size.x() >= size.z() )
+        return 0;
+      return size.y() >= size.z() ? 1 : 2;
+    }
+  };
+
+  //! Range of polylines (in the order array) forming a chunk
+  struct Range
+  {
+    int begin, end;
+  };
+
+}
+
+
+LineMeshChunks::LineMeshChunks( QObject *parent )
+  : QObject( parent )
+{
+}
+
+LineMeshChunks::~LineMeshChunks()
+{
+  clear();
+}
+
+void LineMeshChunks::clear()
+{
+  // chunks with the shared buffers go last, the others may still reference them
+  for ( int i = mChunks.count() - 1; i >= 0; --i )
+  {
+    if ( mChunks[i] && !mChunks[i]->parent() )
+      delete mChunks[i];
+  }
+  mChunks.clear();
+}
+
+void LineMeshChunks::build( const float *positions, const int *offsets, int polylineCount, const quint8 *closed, int maxSegmentsPerChunk )
+{
+  // 1. bounding boxes and segment counts of polylines
+  QVector<Box> boxes( polylineCount );
+  QVector<QVector3D> centers( polylineCount );
+  QVector<int> segments( polylineCount );
+  auto calculateRange = [&]( int begin, int end )
+  {
+    for ( int i = begin; i < end; ++i )
+    {
+      for ( int v = offsets[i]; v < offsets[i + 1]; ++v )
+        boxes[i].add( QVector3D( positions[v * 3], positions[v * 3 + 1], positions[v * 3 + 2] ) );
+      centers[i] = ( boxes[i].minimum + boxes[i].maximum ) / 2;
+      segments[i] = std::max( offsets[i + 1] - offsets[i] - 1, 0 ) + ( closed && closed[i] ? 1 : 0 );
+    }
+  };
+  if ( polylineCount <= CHUNK_SIZE )
+  {
+    calculateRange( 0, polylineCount );
+  }
+  else
+  {
+    QVector<int> chunks;
+    for ( int begin = 0; begin < polylineCount; begin += CHUNK_SIZE )
+      chunks.append( begin );
+
+    QtConcurrent::blockingMap( chunks, [&calculateRange, polylineCount]( int begin )
+    {
+      calculateRange( begin, std::min( begin + CHUNK_SIZE, polylineCount ) );
+    } );
+  }
+
+  // 2. median split along the longest axis until chunks are small enough (depth first,
+  // so that the leaves - our chunks - are ordered and neighbors stay close together)
+  QVector<int> order( polylineCount );
+  std::iota( order.begin(), order.end(), 0 );
+  QVector<Range> leaves;
+  QVector<Range> stack;
+  if ( polylineCount > 0 )
+    stack.append( { 0, polylineCount } );
+  while ( !stack.isEmpty() )
+  {
+    const Range range = stack.takeLast();
+    int segmentCount = 0;
+    Box centerBox;
+    for ( int i = range.begin; i < range.end; ++i )
+    {
+      segmentCount += segments[order[i]];
+      centerBox.add( centers[order[i]] );
+    }
+    if ( segmentCount <= maxSegmentsPerChunk || range.end - range.begin == 1 )
+    {
+      leaves.append( range );
+      continue;
+    }
+
+    const int axis = centerBox.longestAxis();
+    const int middle = ( range.begin + range.end ) / 2;
+    std::nth_element( order.begin() + range.begin, order.begin() + middle, order.begin() + range.end,
+                      [&centers, axis]( int a, int b ) { return centers[a][axis] < centers[b][axis]; } );
+    // pushed in reverse, so the first half gets processed (and output) first
+    stack.append( { middle, range.end } );
+    stack.append( { range.begin, middle } );
+  }
+
+  // 3. buffers with polylines in the order of chunks
+  LineMeshData data = LineMeshBuilder::build( positions, offsets, polylineCount, closed, order.constData() );
+
+  Qt3DRender::QBuffer *vertexBuffer = new Qt3DRender::QBuffer( Qt3DRender::QBuffer::VertexBuffer );
+  Qt3DRender::QBuffer *indexBuffer = new Qt3DRender::QBuffer( Qt3DRender::QBuffer::IndexBuffer );
+  vertexBuffer->setData( data.vertexData );
+  indexBuffer->setData( data.indexData );
+
+  clear();
+  int firstIndex = 0;
+  for ( const Range &range : qAsConst( leaves ) )
+  {
+    int indexCount = 0;
+    Box box;
+    for ( int i = range.begin; i < range.end; ++i )
+    {
+      const int pointCount = data.polylineVertexOffsets[i + 1] - data.polylineVertexOffsets[i];
+      indexCount += LineMeshBuilder::stripIndexCount( pointCount, data.polylineRings[i] );
+      box.add( boxes[order[i]] );
+    }
+
+    LineMeshChunk *chunk = new LineMeshChunk( vertexBuffer, indexBuffer, data.indexType, firstIndex, indexCount, box.minimum, box.maximum );
+    if ( mChunks.isEmpty() )
+    {
+      // the buffers are shared by all chunks
+      vertexBuffer->setParent( chunk );
+      indexBuffer->setParent( chunk );
+    }
+    mChunks.append( chunk );
+    firstIndex += indexCount;
+  }
+  Q_ASSERT( firstIndex == data.indexCount );
+
+  mVisibleCount = mChunks.count();
+  emit chunksChanged();
+  emit visibleCountChanged( mVisibleCount );
+}
+
+void LineMeshChunks::build( const QVector<QVector<QVector3D>> &polylines, const QVector<bool> &closed, int maxSegmentsPerChunk )
+{
+  static_assert( sizeof( QVector3D ) == 3 * sizeof( float ), "QVector3D is expected to be packed" );
+
+  QVector<int> offsets;
+  offsets.reserve( polylines.count() + 1 );
+  offsets.append( 0 );
+  QVector<QVector3D> positions;
+  for ( const QVector<QVector3D> &polyline : polylines )
+  {
+    offsets.append( offsets.last() + polyline.count() );
+    positions.append( polyline );
+  }
+
+  QVector<quint8> closedFlags;
+  for ( bool c : closed )
+    closedFlags.append( c );
+
+  build( reinterpret_cast<const float *>( positions.constData() ), offsets.constData(), polylines.count(),
+         closedFlags.isEmpty() ? nullptr : closedFlags.constData(), maxSegmentsPerChunk );
+}
+
+QVariantList LineMeshChunks::chunks() const
+{
+  QVariantList list;
+  for ( const QPointer<LineMeshChunk> &chunk : mChunks )
+    list.append( QVariant::fromValue<QObject *>( chunk.data() ) );
+  return list;
+}
+
+void LineMeshChunks::updateCamera( const QMatrix4x4 &viewProjection )
+{
+  // frustum planes (Gribb-Hartmann), normals pointing inside
+  QVector4D planes[6];
+  for ( int i = 0; i < 3; ++i )
+  {
+    planes[i * 2] = viewProjection.row( 3 ) + viewProjection.row( i );
+    planes[i * 2 + 1] = viewProjection.row( 3 ) - viewProjection.row( i );
+  }
+
+  int visibleCount = 0;
+  for ( const QPointer<LineMeshChunk> &chunk : qAsConst( mChunks ) )
+  {
+    if ( !chunk )
+      continue;
+
+    // the box is outside if its corner furthest along the plane normal is behind the plane
+    const QVector3D minimum = chunk->minimum(), maximum = chunk->maximum();
+    bool visible = true;
+    for ( const QVector4D &plane : planes )
+    {
+      const QVector3D corner( plane.x() > 0 ? maximum.x() : minimum.x(),
+                              plane.y() > 0 ? maximum.y() : minimum.y(),
+                              plane.z() > 0 ? maximum.z() : minimum.z() );
+      if ( plane.x() * corner.x() + plane.y() * corner.y() + plane.z() * corner.z() + plane.w() < 0 )
+      {
+        visible = false;
+        break;
+      }
+    }
+    chunk->setVisible( visible );
+    visibleCount += visible;
+  }
+
+  if ( visibleCount != mVisibleCount )
+  {
+    mVisibleCount = visibleCount;
+    emit visibleCountChanged( mVisibleCount );
+  }
+}
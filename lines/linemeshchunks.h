@@ -0,0 +1,110 @@
+#ifndef LINEMESHCHUNKS_H
+#define LINEMESHCHUNKS_H
+
+#include <QMatrix4x4>
+#include <QObject>
+#include <QPointer>
+#include <QVariantList>
+#include <QVector3D>
+
+#include <Qt3DRender/QAttribute>
+#include <Qt3DRender/QBuffer>
+#include <Qt3DRender/QGeometry>
+
+/**
+ * Geometry of a single chunk of LineMeshChunks: a range of the index buffer
+ * shared by all chunks, with a bounding box used for culling.
+ */
+class LineMeshChunk : public Qt3DRender::QGeometry
+{
+    Q_OBJECT
+
+    Q_PROPERTY( int count READ vertexCount CONSTANT )
+    Q_PROPERTY( bool visible READ isVisible NOTIFY visibleChanged )
+
+  public:
+    LineMeshChunk( Qt3DRender::QBuffer *vertexBuffer, Qt3DRender::QBuffer *indexBuffer, Qt3DRender::QAttribute::VertexBaseType indexType,
+                   int firstIndex, int indexCount, const QVector3D &minimum, const QVector3D &maximum, Qt3DCore::QNode *parent = nullptr );
+
+    //! Returns number of indices to be drawn
+    int vertexCount() const { return mIndexCount; }
+
+    //! Returns whether the chunk was inside the view frustum in the last update
+    bool isVisible() const { return mVisible; }
+
+    //! Sets whether the chunk is visible
+    void setVisible( bool visible );
+
+    //! Returns minimum corner of the bounding box
+    QVector3D minimum() const { return mMinimum; }
+
+    //! Returns maximum corner of the bounding box
+    QVector3D maximum() const { return mMaximum; }
+
+  signals:
+    void visibleChanged( bool visible );
+
+  private:
+    int mIndexCount = 0;
+    QVector3D mMinimum, mMaximum;
+    bool mVisible = true;
+};
+
+
+/**
+ * Lines split into spatially coherent chunks, so that chunks outside of the view
+ * frustum can be skipped on the CPU before any work gets to the GPU (the geometry
+ * shader can only reject primitives after all their vertices were processed).
+ *
+ * Chunks are leaves of a bounding volume hierarchy built by splitting polylines
+ * at the median of their centers along the longest axis, until a chunk has at most
+ * maxSegmentsPerChunk segments. Polylines are then written by LineMeshBuilder in
+ * the order of chunks, so each chunk is a contiguous range of the shared index buffer
+ * (and its vertices are close together in the vertex buffer as well).
+ *
+ * Each chunk is a separate geometry (LineMeshChunk) meant to be drawn by its own entity,
+ * enabled according to the visibility of the chunk as updated by updateCamera().
+ */
+class LineMeshChunks : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY( QVariantList chunks READ chunks NOTIFY chunksChanged )
+    Q_PROPERTY( int visibleCount READ visibleCount NOTIFY visibleCountChanged )
+
+  public:
+    LineMeshChunks( QObject *parent = nullptr );
+    ~LineMeshChunks() override;
+
+    /**
+     * Builds chunks for \a polylineCount polylines (with the same input as LineMeshBuilder::build()).
+     * Bounding boxes of polylines are calculated in parallel.
+     */
+    void build( const float *positions, const int *offsets, int polylineCount, const quint8 *closed = nullptr, int maxSegmentsPerChunk = 65536 );
+
+    //! Builds chunks for the \a polylines (optionally flagged as \a closed rings)
+    void build( const QVector<QVector<QVector3D>> &polylines, const QVector<bool> &closed = QVector<bool>(), int maxSegmentsPerChunk = 65536 );
+
+    //! Returns chunks (LineMeshChunk objects)
+    QVariantList chunks() const;
+
+    //! Returns number of chunks that were inside the view frustum in the last update
+    int visibleCount() const { return mVisibleCount; }
+
+    //! Updates visibility of chunks for the given projection * view matrix
+    Q_INVOKABLE void updateCamera( const QMatrix4x4 &viewProjection );
+
+  signals:
+    void chunksChanged();
+    void visibleCountChanged( int count );
+
+  private:
+    //! Deletes chunks that have not been taken over by Qt3D entities
+    void clear();
+
+    //! Chunks are not owned by us once they get parented to a Qt3D entity
+    QVector<QPointer<LineMeshChunk>> mChunks;
+    int mVisibleCount = 0;
+};
+
+#endif // LINEMESHCHUNKS_H
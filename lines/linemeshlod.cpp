@@ -0,0 +1,285 @@
+#include "linemeshlod.h"
+
+#include "drawdata.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include <QtConcurrent/QtConcurrentMap>
+#include <QtMath>
+
+// polylines processed by a single task when running in parallel
+static const int CHUNK_SIZE = 1024;
+
+
+namespace
+{
+
+  float distanceToSegment( const float *p, const float *a, const float *b )
+  {
+    const float ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    const float ap[3] = { p[0] - a[0], p[1] - a[1], p[2] - a[2] };
+    const float len2 = ab[0] * ab[0] + ab[1] * ab[1] + ab[2] * ab[2];
+    float t = len2 > 0 ? ( ap[0] * ab[0] + ap[1] * ab[1] + ap[2] * ab[2] ) / len2 : 0;
+    t = std::min( std::max( t, 0.f ), 1.f );
+    const float d[3] = { ap[0] - t * ab[0], ap[1] - t * ab[1], ap[2] - t * ab[2] };
+    return std::sqrt( d[0] * d[0] + d[1] * d[1] + d[2] * d[2] );
+  }
+
+  /**
+   * Douglas-Peucker on a chain of vertices: writes significance of inner vertices of the chain.
+   * A vertex never gets higher significance than the vertex that split its segment,
+   * so any tolerance gives exactly the Douglas-Peucker result.
+   */
+  void chainSignificance( const float *positions, const QVector<int> &chain, float *significance )
+  {
+    struct Segment
+    {
+      int a, b;
+      float parentSignificance;
+    };
+
+    QVector<Segment> stack;
+    stack.append( { 0, chain.count() - 1, std::numeric_limits<float>::infinity() } );
+    while ( !stack.isEmpty() )
+    {
+      const Segment s = stack.takeLast();
+      const float *a = positions + chain[s.a] * 3;
+      const float *b = positions + chain[s.b] * 3;
+      int farthest = -1;
+      float maxDistance = -1;
+      for ( int j = s.a + 1; j < s.b; ++j )
+      {
+        const float d = distanceToSegment( positions + chain[j] * 3, a, b );
+        if ( d > maxDistance )
+        {
+          maxDistance = d;
+          farthest = j;
+        }
+      }
+      if ( farthest < 0 )
+        continue;
+
+      const float sig = std::min( maxDistance, s.parentSignificance );
+      significance[chain[farthest]] = sig;
+      stack.append( { s.a, farthest, sig } );
+      stack.append( { farthest, s.b, sig } );
+    }
+  }
+
+  //! Calculates significance of all vertices of a polyline (vertices first ... first + count - 1)
+  void polylineSignificance( const float *positions, int first, int count, bool ring, float *significance )
+  {
+    const float inf = std::numeric_limits<float>::infinity();
+    QVector<int> chain;
+    if ( !ring )
+    {
+      significance[first] = significance[first + count - 1] = inf;
+      for ( int j = 0; j < count; ++j )
+        chain.append( first + j );
+      chainSignificance( positions, chain, significance );
+      return;
+    }
+
+    // rings are split in two chains at the first vertex and the vertex farthest from it
+    const float *p0 = positions + first * 3;
+    int split = 1;
+    float maxDistance = -1;
+    for ( int j = 1; j < count; ++j )
+    {
+      const float *p = positions + ( first + j ) * 3;
+      const float d = ( p[0] - p0[0] ) * ( p[0] - p0[0] ) + ( p[1] - p0[1] ) * ( p[1] - p0[1] ) + ( p[2] - p0[2] ) * ( p[2] - p0[2] );
+      if ( d > maxDistance )
+      {
+        maxDistance = d;
+        split = j;
+      }
+    }
+    significance[first] = significance[first + split] = inf;
+
+    for ( int j = 0; j <= split; ++j )
+      chain.append( first + j );
+    chainSignificance( positions, chain, significance );
+
+    chain.clear();
+    for ( int j = split; j < count; ++j )
+      chain.append( first + j );
+    chain.append( first );
+    chainSignificance( positions, chain, significance );
+  }
+
+  //! Runs func( begin, end ) on ranges of polylines - in parallel for larger inputs
+  template <typename Func>
+  void forPolylineRanges( int polylineCount, const Func &func )
+  {
+    if ( polylineCount <= CHUNK_SIZE )
+    {
+      func( 0, polylineCount );
+      return;
+    }
+
+    QVector<int> chunks;
+    for ( int begin = 0; begin < polylineCount; begin += CHUNK_SIZE )
+      chunks.append( begin );
+
+    QtConcurrent::blockingMap( chunks, [&func, polylineCount]( int begin )
+    {
+      func( begin, std::min( begin + CHUNK_SIZE, polylineCount ) );
+    } );
+  }
+
+}
+
+
+LineMeshLod::LineMeshLod( QObject *parent )
+  : QObject( parent )
+{
+}
+
+float LineMeshLod::tolerance( int level ) const
+{
+  return level == 0 ? 0 : std::ldexp( mFinestTolerance, level - 1 );
+}
+
+void LineMeshLod::build( LineMeshData data, LineMeshGeometry *geometry, float finestTolerance, int levelCount )
+{
+  mGeometry = geometry;
+  mFinestTolerance = finestTolerance;
+
+  const int polylineCount = data.polylineRings.count();
+  const float *positions = reinterpret_cast<const float *>( data.vertexData.constData() );
+  const int *vertexOffsets = data.polylineVertexOffsets.constData();
+  const quint8 *rings = data.polylineRings.constData();
+  const int coarseLevels = std::max( levelCount - 1, 0 );   // level 0 is already in data.indexData
+
+  // 1. significance of vertices and index counts of each polyline in each coarse level
+  QVector<float> significance( data.vertexCount );
+  QVector<int> counts( coarseLevels * polylineCount );
+  QVector<float> maxSignificance( polylineCount );   // of vertices that may get simplified away
+  forPolylineRanges( polylineCount, [&]( int begin, int end )
+  {
+    for ( int i = begin; i < end; ++i )
+    {
+      const int first = vertexOffsets[i];
+      const int count = vertexOffsets[i + 1] - first;
+      if ( count < 2 )
+        continue;
+
+      polylineSignificance( positions, first, count, rings[i], significance.data() );
+      for ( int v = first; v < first + count; ++v )
+      {
+        if ( !std::isinf( significance[v] ) )
+          maxSignificance[i] = std::max( maxSignificance[i], significance[v] );
+      }
+      for ( int level = 1; level <= coarseLevels; ++level )
+      {
+        const float tol = tolerance( level );
+        const int kept = std::count_if( significance.constData() + first, significance.constData() + first + count,
+                                        [tol]( float s ) { return s > tol; } );
+        counts[( level - 1 ) * polylineCount + i] = LineMeshBuilder::stripIndexCount( kept, rings[i] && kept >= 3 );
+      }
+    }
+  } );
+
+  // 2. prefix sums give offsets of polylines in the index buffer (levels are stored one after another)
+  QVector<int> offsets( coarseLevels * polylineCount );
+  mLevelFirstIndex = QVector<int>() << 0;
+  mLevelIndexCount = QVector<int>() << data.indexCount;
+  const float coarsestNeeded = maxSignificance.isEmpty() ? 0 : *std::max_element( maxSignificance.constBegin(), maxSignificance.constEnd() );
+  int total = data.indexCount;
+  for ( int level = 1; level <= coarseLevels; ++level )
+  {
+    const int levelStart = total;
+    for ( int i = 0; i < polylineCount; ++i )
+    {
+      offsets[( level - 1 ) * polylineCount + i] = total;
+      total += counts[( level - 1 ) * polylineCount + i];
+    }
+    mLevelFirstIndex.append( levelStart );
+    mLevelIndexCount.append( total - levelStart );
+
+    // no point in having more levels once everything is simplified as much as possible
+    if ( tolerance( level ) >= coarsestNeeded )
+      break;
+  }
+
+  // 3. indices of coarse levels written in parallel after the full detail indices
+  const bool shortIndices = data.indexType == Qt3DRender::QAttribute::UnsignedShort;
+  const int indexSize = shortIndices ? sizeof( quint16 ) : sizeof( quint32 );
+  const int builtLevels = mLevelFirstIndex.count();
+  QByteArray indexData;
+  indexData.resize( total * indexSize );
+  std::memcpy( indexData.data(), data.indexData.constData(), data.indexData.size() );
+  char *indexOut = indexData.data();
+
+  forPolylineRanges( polylineCount, [&]( int begin, int end )
+  {
+    QVector<quint32> kept;
+    for ( int i = begin; i < end; ++i )
+    {
+      const int first = vertexOffsets[i];
+      const int count = vertexOffsets[i + 1] - first;
+      for ( int level = 1; level < builtLevels; ++level )
+      {
+        const float tol = tolerance( level );
+        kept.clear();
+        for ( int v = first; v < first + count; ++v )
+        {
+          if ( significance[v] > tol )
+            kept.append( v );
+        }
+
+        const int offset = offsets[( level - 1 ) * polylineCount + i];
+        const bool ring = rings[i] && kept.count() >= 3;
+        if ( shortIndices )
+          LineMeshBuilder::writeStripIndices( reinterpret_cast<quint16 *>( indexOut ) + offset, kept.constData(), kept.count(), ring );
+        else
+          LineMeshBuilder::writeStripIndices( reinterpret_cast<quint32 *>( indexOut ) + offset, kept.constData(), kept.count(), ring );
+      }
+    }
+  } );
+
+  // bounding sphere (vertex 0 is just the restart sentinel)
+  QVector3D minimum( std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() );
+  QVector3D maximum = -minimum;
+  for ( int v = 1; v < data.vertexCount; ++v )
+  {
+    const QVector3D p( positions[v * 3], positions[v * 3 + 1], positions[v * 3 + 2] );
+    minimum = QVector3D( std::min( minimum.x(), p.x() ), std::min( minimum.y(), p.y() ), std::min( minimum.z(), p.z() ) );
+    maximum = QVector3D( std::max( maximum.x(), p.x() ), std::max( maximum.y(), p.y() ), std::max( maximum.z(), p.z() ) );
+  }
+  mCenter = ( minimum + maximum ) / 2;
+  mRadius = data.vertexCount > 1 ? ( maximum - minimum ).length() / 2 : 0;
+
+  geometry->setVertexData( std::move( data.vertexData ), std::move( indexData ), data.indexType );
+  mLevel = -1;
+  setLevel( 0 );
+}
+
+void LineMeshLod::updateCamera( const QVector3D &cameraPosition, float fieldOfView, const QSizeF &viewportSize )
+{
+  // the error is largest at the point of the data closest to the camera
+  const float distance = std::max( ( cameraPosition - mCenter ).length() - mRadius, 1e-6f );
+  const float pixelsPerUnit = viewportSize.height() / ( 2 * distance * std::tan( qDegreesToRadians( fieldOfView ) / 2 ) );
+
+  int best = 0;
+  for ( int level = 1; level < levelCount(); ++level )
+  {
+    if ( tolerance( level ) * pixelsPerUnit > mPixelThreshold )
+      break;
+    best = level;
+  }
+  setLevel( best );
+}
+
+void LineMeshLod::setLevel( int level )
+{
+  if ( level == mLevel || !mGeometry || level < 0 || level >= levelCount() )
+    return;
+
+  mLevel = level;
+  mGeometry->setIndexRange( mLevelFirstIndex[level], mLevelIndexCount[level] );
+  emit levelChanged( mLevel );
+}
@@ -0,0 +1,81 @@
+#ifndef LINEMESHLOD_H
+#define LINEMESHLOD_H
+
+#include <QObject>
+#include <QSizeF>
+#include <QVector>
+#include <QVector3D>
+
+#include "linemeshbuilder.h"
+
+class LineMeshGeometry;
+
+/**
+ * Levels of detail for lines in LineMeshGeometry, driven by screen-space error.
+ *
+ * The hierarchy is built once with Douglas-Peucker simplification: each vertex gets
+ * a significance - the largest tolerance at which the simplification still keeps it.
+ * Level 0 is the full detail, level L keeps only vertices more significant than
+ * tolerance(L) (which doubles with each level). All levels share the same vertices
+ * and their indices are stored one after another in a single index buffer, so switching
+ * levels just points the index attribute elsewhere - nothing gets rebuilt or uploaded.
+ *
+ * At render time updateCamera() picks the coarsest level whose error projected
+ * to the screen (at the closest point of the data) stays under pixelThreshold.
+ */
+class LineMeshLod : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY( int level READ level NOTIFY levelChanged )
+    Q_PROPERTY( float pixelThreshold READ pixelThreshold WRITE setPixelThreshold )
+
+  public:
+    LineMeshLod( QObject *parent = nullptr );
+
+    /**
+     * Builds the level hierarchy for lines in \a data (as returned by LineMeshBuilder) and sets
+     * the buffers to the \a geometry. Level 1 uses \a finestTolerance (in world units),
+     * there are at most \a levelCount levels. Polylines are simplified in parallel.
+     */
+    void build( LineMeshData data, LineMeshGeometry *geometry, float finestTolerance, int levelCount = 12 );
+
+    //! Returns number of levels (including the full detail level 0)
+    int levelCount() const { return mLevelFirstIndex.count(); }
+
+    //! Returns currently used level
+    int level() const { return mLevel; }
+
+    //! Returns maximum error (in world units) of a level
+    float tolerance( int level ) const;
+
+    //! Returns maximum allowed error of the drawn lines in pixels
+    float pixelThreshold() const { return mPixelThreshold; }
+
+    //! Sets maximum allowed error of the drawn lines in pixels
+    void setPixelThreshold( float pixels ) { mPixelThreshold = pixels; }
+
+    /**
+     * Picks the level for a camera at \a cameraPosition with vertical field of view \a fieldOfView
+     * (in degrees) and viewport of \a viewportSize pixels (the same as WIN_SCALE of the shader).
+     */
+    Q_INVOKABLE void updateCamera( const QVector3D &cameraPosition, float fieldOfView, const QSizeF &viewportSize );
+
+    //! Sets the level to be drawn
+    void setLevel( int level );
+
+  signals:
+    void levelChanged( int level );
+
+  private:
+    LineMeshGeometry *mGeometry = nullptr;
+    float mFinestTolerance = 0;
+    float mPixelThreshold = 1;
+    int mLevel = 0;
+    QVector<int> mLevelFirstIndex;   //!< Offsets of levels in the index buffer
+    QVector<int> mLevelIndexCount;   //!< Number of indices of each level
+    QVector3D mCenter;               //!< Bounding sphere of the lines
+    float mRadius = 0;
+};
+
+#endif // LINEMESHLOD_H
@@ -1,12 +1,11 @@
 #version 150
 
-uniform vec4 lineColor;
 uniform bool useTex;
 uniform sampler2D tex0;
 
 in VertexData{
     vec2 mTexCoord;
-//	vec3 mColor;
+    vec4 mColor;
 } VertexIn;
 
 out vec4 oColor;
@@ -15,16 +14,12 @@ void main(void)
 {
     if (!useTex)
     {
-        // option 1: plain color
-        oColor = lineColor;
+        // option 1: plain color (lineColor or per-vertex color)
+        oColor = VertexIn.mColor;
     }
     else
     {
-        // option 2: textured color
+        // option 2: textured color (x coordinate goes along the line, y across it)
         oColor = texture(tex0, VertexIn.mTexCoord.xy );
     }
-
-    //vec4 clr = texture( tex0, VertexIn.mTexCoord.xy );
-    //oColor.rgb = VertexIn.mColor * clr.rgb;
-    //oColor.a = clr.a;
 }
@@ -2,18 +2,28 @@
 
 uniform mat4 modelViewProjection;
 
+uniform float THICKNESS;    // the thickness of the line in pixels
+uniform vec4 lineColor;
+uniform bool useVertexStyle;  // use per-vertex color and width instead of the uniforms
+
 in vec3 vertexPosition;
-//in vec3 ciColor;
+in vec4 vertexColor;
+in float vertexWidth;
+in float vertexDistance;    // distance along the line (zero if the geometry does not have it)
 
 out VertexData{
-//	vec3 mColor;
   vec3 worldPosition;
+  vec4 mColor;
+  float mWidth;
+  float mDistance;
 } VertexOut;
 
 
 void main(void)
 {
-    //VertexOut.mColor = ciColor;
     gl_Position = modelViewProjection * vec4( vertexPosition, 1.0 );
     VertexOut.worldPosition = vertexPosition;
+    VertexOut.mColor = useVertexStyle ? vertexColor : lineColor;
+    VertexOut.mWidth = useVertexStyle ? vertexWidth : THICKNESS;
+    VertexOut.mDistance = vertexDistance;
 }
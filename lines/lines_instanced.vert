@@ -0,0 +1,151 @@
+#version 150
+
+// Alternative to lines.vert + lines.geom without a geometry shader: each line segment
+// is an instance with its adjacent points (prev, p0, p1, next) and the vertex shader
+// expands a fixed template of 9 vertices (triangles) for it - two triangles of the quad
+// and one triangle closing the gap at the start of the segment when it is not mitered.
+// The math is the same as in lines.geom.
+
+uniform float	THICKNESS;		// the thickness of the line in pixels
+uniform float	MITER_LIMIT;	// 1.0: always miter, -1.0: never miter, 0.75: default
+uniform vec2	WIN_SCALE;		// the size of the viewport in pixels
+uniform vec4	lineColor;
+
+uniform mat4 modelViewProjection;
+
+in float vertexCorner;      // index of the vertex in the template (0-8)
+
+in vec3 segmentPrev;        // start of previous segment
+in vec3 segmentStart;       // start of current segment
+in vec3 segmentEnd;         // end of current segment
+in vec3 segmentNext;        // end of next segment
+
+out VertexData{
+    vec2 mTexCoord;
+    vec4 mColor;
+} VertexOut;
+
+vec2 toScreenSpace( vec4 vertex )
+{
+    return vec2( vertex.xy / vertex.w ) * WIN_SCALE;
+}
+
+vec4 clip_near_plane(vec4 pt1, vec4 pt2)
+{
+  // see lines.geom
+  float u = (-pt1.z - pt1.w) / ((pt2.z-pt1.z) + (pt2.w - pt1.w));
+  return pt1 + (pt2-pt1)*u;
+}
+
+// output for vertices that should not be drawn (zero area triangles outside of the view)
+void discardVertex()
+{
+    VertexOut.mTexCoord = vec2( 0, 0 );
+    VertexOut.mColor = lineColor;
+    gl_Position = vec4( 0.0, 0.0, 2.0, 1.0 );
+}
+
+void emitVertex( vec2 screenPos, float z, vec2 texCoord )
+{
+    VertexOut.mTexCoord = texCoord;
+    VertexOut.mColor = lineColor;
+    gl_Position = vec4( screenPos / WIN_SCALE, z, 1.0 );
+}
+
+void main( void )
+{
+    int corner = int( vertexCorner + 0.5 );
+
+    vec4 px0 = modelViewProjection * vec4( segmentPrev, 1.0 );
+    vec4 px1 = modelViewProjection * vec4( segmentStart, 1.0 );
+    vec4 px2 = modelViewProjection * vec4( segmentEnd, 1.0 );
+    vec4 px3 = modelViewProjection * vec4( segmentNext, 1.0 );
+
+    // trivial reject from Cohen-Sutherland line clipping algorithm (see lines.geom)
+    int px1c = int(px1.w+px1.x<0) << 0 | int(px1.w-px1.x<0) << 1 | int(px1.w+px1.y<0) << 2 | int(px1.w-px1.y<0) << 3 | int(px1.w+px1.z<0) << 4 | int(px1.w-px1.z<0) << 5;
+    int px2c = int(px2.w+px2.x<0) << 0 | int(px2.w-px2.x<0) << 1 | int(px2.w+px2.y<0) << 2 | int(px2.w-px2.y<0) << 3 | int(px2.w+px2.z<0) << 4 | int(px2.w-px2.z<0) << 5;
+    if ((px1c & px2c) != 0)
+    {
+      discardVertex();
+      return;
+    }
+
+    // clipping with near plane (see lines.geom)
+    if ((px1c & 16) != 0)
+    {
+      px1 = clip_near_plane(px1, px2);
+      px0 = px1;
+    }
+    if ((px2c & 16) != 0)
+    {
+      px2 = clip_near_plane(px1, px2);
+      px3 = px2;
+    }
+
+    vec2 p0 = toScreenSpace( px0 );
+    vec2 p1 = toScreenSpace( px1 );
+    vec2 p2 = toScreenSpace( px2 );
+    vec2 p3 = toScreenSpace( px3 );
+
+    float p1z = px1.z / px1.w;
+    float p2z = px2.z / px2.w;
+
+    vec2 v0 = normalize( p1 - p0 );
+    vec2 v1 = normalize( p2 - p1 );
+    vec2 v2 = normalize( p3 - p2 );
+
+    if (p1 == p0) v0 = v1;
+    if (p3 == p2) v2 = v1;
+
+    vec2 n0 = vec2( -v0.y, v0.x );
+    vec2 n1 = vec2( -v1.y, v1.x );
+    vec2 n2 = vec2( -v2.y, v2.x );
+
+    vec2 miter_a = normalize( n0 + n1 );
+    vec2 miter_b = normalize( n1 + n2 );
+
+    float length_a = THICKNESS / dot( miter_a, n1 );
+    float length_b = THICKNESS / dot( miter_b, n1 );
+
+    bool flatStart = dot( v0, v1 ) < -MITER_LIMIT;
+    if( flatStart ) {
+        miter_a = n1;
+        length_a = THICKNESS;
+    }
+
+    if( dot( v1, v2 ) < -MITER_LIMIT ) {
+        miter_b = n1;
+        length_b = THICKNESS;
+    }
+
+    // the quad: triangle strip a+, a-, b+, b- from lines.geom as triangles (a+, a-, b+) and (b+, a-, b-)
+    if ( corner == 0 )
+      emitVertex( p1 + length_a * miter_a, p1z, vec2( 0, 0 ) );
+    else if ( corner == 1 || corner == 4 )
+      emitVertex( p1 - length_a * miter_a, p1z, vec2( 0, 1 ) );
+    else if ( corner == 2 || corner == 3 )
+      emitVertex( p2 + length_b * miter_b, p2z, vec2( 0, 0 ) );
+    else if ( corner == 5 )
+      emitVertex( p2 - length_b * miter_b, p2z, vec2( 0, 1 ) );
+    else if ( !flatStart )
+      discardVertex();   // no gap to close
+    // the triangle closing the gap at the start of the segment
+    else if ( dot( v0, n1 ) > 0 )
+    {
+      if ( corner == 6 )
+        emitVertex( p1 + THICKNESS * n1, p1z, vec2( 0, 0 ) );
+      else if ( corner == 7 )
+        emitVertex( p1 + THICKNESS * n0, p1z, vec2( 0, 0 ) );
+      else
+        emitVertex( p1, p1z, vec2( 0, 0.5 ) );
+    }
+    else
+    {
+      if ( corner == 6 )
+        emitVertex( p1 - THICKNESS * n0, p1z, vec2( 0, 1 ) );
+      else if ( corner == 7 )
+        emitVertex( p1 - THICKNESS * n1, p1z, vec2( 0, 1 ) );
+      else
+        emitVertex( p1, p1z, vec2( 0, 0.5 ) );
+    }
+}
@@ -0,0 +1,99 @@
+#include "linesegmentgeometry.h"
+
+#include "linemeshbuilder.h"
+
+#include <Qt3DRender/QAttribute>
+
+// byte stride of a segment in the instance buffer (4 points with [x, y, z] floats)
+static const int SEGMENT_STRIDE = 4 * 3 * sizeof( float );
+
+
+LineSegmentGeometry::LineSegmentGeometry( Qt3DCore::QNode *parent )
+  : Qt3DRender::QGeometry( parent )
+  , mTemplateBuffer( new Qt3DRender::QBuffer( Qt3DRender::QBuffer::VertexBuffer, this ) )
+  , mSegmentBuffer( new Qt3DRender::QBuffer( Qt3DRender::QBuffer::VertexBuffer, this ) )
+{
+  QByteArray templateData;
+  templateData.resize( VERTICES_PER_SEGMENT * sizeof( float ) );
+  float *corners = reinterpret_cast<float *>( templateData.data() );
+  for ( int i = 0; i < VERTICES_PER_SEGMENT; ++i )
+    corners[i] = i;
+  mTemplateBuffer->setData( templateData );
+
+  Qt3DRender::QAttribute *cornerAttribute = new Qt3DRender::QAttribute( this );
+  cornerAttribute->setAttributeType( Qt3DRender::QAttribute::VertexAttribute );
+  cornerAttribute->setBuffer( mTemplateBuffer );
+  cornerAttribute->setVertexBaseType( Qt3DRender::QAttribute::Float );
+  cornerAttribute->setVertexSize( 1 );
+  cornerAttribute->setCount( VERTICES_PER_SEGMENT );
+  cornerAttribute->setName( "vertexCorner" );
+  addAttribute( cornerAttribute );
+
+  const char *names[] = { "segmentPrev", "segmentStart", "segmentEnd", "segmentNext" };
+  for ( int i = 0; i < 4; ++i )
+  {
+    Qt3DRender::QAttribute *pointAttribute = new Qt3DRender::QAttribute( this );
+    pointAttribute->setAttributeType( Qt3DRender::QAttribute::VertexAttribute );
+    pointAttribute->setBuffer( mSegmentBuffer );
+    pointAttribute->setVertexBaseType( Qt3DRender::QAttribute::Float );
+    pointAttribute->setVertexSize( 3 );
+    pointAttribute->setByteOffset( i * 3 * sizeof( float ) );
+    pointAttribute->setByteStride( SEGMENT_STRIDE );
+    pointAttribute->setDivisor( 1 );
+    pointAttribute->setName( names[i] );
+    addAttribute( pointAttribute );
+  }
+}
+
+void LineSegmentGeometry::setLines( const LineMeshData &data )
+{
+  const QByteArray segmentData = segmentsFromStrips( data );
+  mSegmentCount = segmentData.size() / SEGMENT_STRIDE;
+  mSegmentBuffer->setData( segmentData );
+
+  emit instanceCountChanged( mSegmentCount );
+}
+
+QByteArray LineSegmentGeometry::segmentsFromStrips( const LineMeshData &data )
+{
+  const bool shortIndices = data.indexType == Qt3DRender::QAttribute::UnsignedShort;
+  const quint16 *shortIndexData = reinterpret_cast<const quint16 *>( data.indexData.constData() );
+  const quint32 *indexData = reinterpret_cast<const quint32 *>( data.indexData.constData() );
+  auto index = [ = ]( int i ) -> quint32 { return shortIndices ? shortIndexData[i] : indexData[i]; };
+
+  // a strip of n indices has n - 3 segments
+  int segmentCount = 0;
+  int stripLength = 0;
+  for ( int i = 0; i < data.indexCount; ++i )
+  {
+    if ( index( i ) == 0 )
+      stripLength = 0;
+    else if ( ++stripLength >= 4 )
+      ++segmentCount;
+  }
+
+  QByteArray segmentData;
+  segmentData.resize( segmentCount * SEGMENT_STRIDE );
+  const float *positions = reinterpret_cast<const float *>( data.vertexData.constData() );
+  float *out = reinterpret_cast<float *>( segmentData.data() );
+  stripLength = 0;
+  for ( int i = 0; i < data.indexCount; ++i )
+  {
+    if ( index( i ) == 0 )
+    {
+      stripLength = 0;
+      continue;
+    }
+    if ( ++stripLength < 4 )
+      continue;
+
+    for ( int j = i - 3; j <= i; ++j )
+    {
+      const float *p = positions + index( j ) * 3;
+      *out++ = p[0];
+      *out++ = p[1];
+      *out++ = p[2];
+    }
+  }
+  return segmentData;
+}
@@ -0,0 +1,56 @@
+#ifndef LINESEGMENTGEOMETRY_H
+#define LINESEGMENTGEOMETRY_H
+
+#include <Qt3DRender/QBuffer>
+#include <Qt3DRender/QGeometry>
+
+struct LineMeshData;
+
+/**
+ * Geometry for drawing lines without a geometry shader (see lines_instanced.vert).
+ *
+ * Each line segment is an instance with four points: previous point, start, end
+ * and next point - the same as a lines_adjacency primitive of LineMeshGeometry.
+ * The per-vertex data are just a template of 9 corners (two triangles of the quad
+ * and a triangle for the join), which the vertex shader expands in screen space.
+ *
+ * To be drawn as triangles with vertexCount() vertices and instanceCount() instances.
+ */
+class LineSegmentGeometry : public Qt3DRender::QGeometry
+{
+    Q_OBJECT
+
+    Q_PROPERTY( int count READ vertexCount CONSTANT )
+    Q_PROPERTY( int instanceCount READ instanceCount NOTIFY instanceCountChanged )
+
+  public:
+    //! Number of vertices of the template of a single segment
+    static const int VERTICES_PER_SEGMENT = 9;
+
+    LineSegmentGeometry( Qt3DCore::QNode *parent = nullptr );
+
+    //! Returns number of vertices to be drawn for each instance
+    int vertexCount() const { return VERTICES_PER_SEGMENT; }
+
+    //! Returns number of segments
+    int instanceCount() const { return mSegmentCount; }
+
+    //! Sets segments from line strips with adjacency (as built by LineMeshBuilder)
+    void setLines( const LineMeshData &data );
+
+    /**
+     * Returns segment data for line strips with adjacency given by vertex and index data:
+     * for each segment there are 4 points ([x, y, z] floats) - prev, start, end, next.
+     */
+    static QByteArray segmentsFromStrips( const LineMeshData &data );
+
+  signals:
+    void instanceCountChanged( int count );
+
+  private:
+    Qt3DRender::QBuffer *mTemplateBuffer = nullptr;
+    Qt3DRender::QBuffer *mSegmentBuffer = nullptr;
+    int mSegmentCount = 0;
+};
+
+#endif // LINESEGMENTGEOMETRY_H
@@ -3,15 +3,24 @@
 #include <QGuiApplication>
 #include <QQmlContext>
 #include <QQmlEngine>
+#include <QTimer>
+
+#include <cmath>
 
 #include "drawdata.h"
+#include "linemeshbuilder.h"
+#include "linemeshchunks.h"
+#include "linemeshlod.h"
+#include "linesegmentgeometry.h"
 
 
 int main(int argc, char* argv[])
 {
     QGuiApplication app(argc, argv);
 
-    QVector3D px(0,-1,0);  // used as restart primitive (index zero)
+    // lines can be drawn either using the geometry shader (default) or with instanced
+    // segments expanded in the vertex shader (without growing track and levels of detail)
+    const bool useInstancedLines = app.arguments().contains("--instanced");
 
     QVector3D p1(0,0,0);
     QVector3D p2(0,5,0);
@@ -21,35 +30,141 @@ int main(int argc, char* argv[])
     QVector3D p6(5, 5, -5);
     QVector3D p7(5, 1, -5);
 
-    QVector<QVector3D> pos;
-    QVector<int> indices;
-
-    pos << px << p1 << p2 << p3 << p4 << p5 << p6 << p7;
+    QVector<QVector<QVector3D>> polylines;
+    QVector<bool> closed;
 
-    indices << 1 << 1 << 2 << 2 << 0;
-    indices << 3 << 3 << 4 << 4 << 0;
-    indices << 5 << 5 << 6 << 7 << 7 << 0;
+    polylines << (QVector<QVector3D>() << p1 << p2);
+    polylines << (QVector<QVector3D>() << p3 << p4);
+    polylines << (QVector<QVector3D>() << p5 << p6 << p7);
+    closed << false << false << false;
 
-    // make a cube for testing
-    int i0 = 8;
+    // make a cube for testing (each face is a closed ring)
     QVector3D o(2,2,5);
-    pos << QVector3D(-1,-1,-1)+o << QVector3D(+1,-1,-1)+o << QVector3D(+1,+1,-1)+o << QVector3D(-1,+1,-1)+o;
-    pos << QVector3D(-1,-1,+1)+o << QVector3D(+1,-1,+1)+o << QVector3D(+1,+1,+1)+o << QVector3D(-1,+1,+1)+o;
-    indices << i0+3 << i0+0 << i0+1 << i0+2 << i0+3 << i0+0 << i0+1 << 0;
-    indices << i0+7 << i0+4 << i0+5 << i0+6 << i0+7 << i0+4 << i0+5 << 0;
-    indices << i0+3 << i0+0 << i0+4 << i0+7 << i0+3 << i0+0 << i0+4 << 0;
-    indices << i0+2 << i0+1 << i0+5 << i0+6 << i0+2 << i0+1 << i0+5 << 0;
+    QVector3D c[8] = {
+        QVector3D(-1,-1,-1)+o, QVector3D(+1,-1,-1)+o, QVector3D(+1,+1,-1)+o, QVector3D(-1,+1,-1)+o,
+        QVector3D(-1,-1,+1)+o, QVector3D(+1,-1,+1)+o, QVector3D(+1,+1,+1)+o, QVector3D(-1,+1,+1)+o
+    };
+    polylines << (QVector<QVector3D>() << c[0] << c[1] << c[2] << c[3]);
+    polylines << (QVector<QVector3D>() << c[4] << c[5] << c[6] << c[7]);
+    polylines << (QVector<QVector3D>() << c[0] << c[4] << c[7] << c[3]);
+    polylines << (QVector<QVector3D>() << c[1] << c[5] << c[6] << c[2]);
+    closed << true << true << true << true;
 
     // lines adjacency primitive: each line is given as (prev)-(p0)-(p1)-(next)
+    // (the builder takes care of the adjacency, closed rings and restart index)
+
+    LineMeshData lineData = LineMeshBuilder::build(polylines, closed);
+    const quint32 trackStart = lineData.vertexCount;
+
+    LineSegmentGeometry segmentGeometry;
+    segmentGeometry.setLines(lineData);
 
     LineMeshGeometry lmg;
-    lmg.setVertices(pos, indices);
+    lmg.setVertexData(std::move(lineData.vertexData), std::move(lineData.indexData), lineData.indexType);
+
+    // a "track" that keeps growing (like a GPS track): each new point is appended to the buffers
+    // and the end of the strip is updated in place, so only a few bytes get uploaded each time
+    int trackPoints = 2;
+    const float trackPos[] = { 0, 0.1f, -8,   1, 0.1f, -8 };
+    const quint32 trackIdx[] = { trackStart, trackStart, trackStart + 1, trackStart + 1, 0 };
+    lmg.appendVertices(trackPos, 2, trackIdx, 5);
+
+    QTimer trackTimer;
+    QObject::connect(&trackTimer, &QTimer::timeout, [&lmg, &trackPoints, &trackTimer, trackStart] {
+        const float angle = trackPoints * 0.3f;
+        const float radius = 8 - trackPoints * 0.02f;
+        const float pt[] = { radius * std::sin(angle), 0.1f, -radius * std::cos(angle) };
+        const quint32 newIdx = trackStart + trackPoints;
+
+        // strip ends with "... last, last, restart" -> "... last, new, new, restart"
+        const quint32 endIdx[] = { newIdx, newIdx };
+        const quint32 restartIdx = 0;
+        lmg.appendVertices(pt, 1, nullptr, 0);
+        lmg.updateIndices(lmg.vertexCount() - 2, endIdx, 2);
+        lmg.appendVertices(nullptr, 0, &restartIdx, 1);
+        ++trackPoints;
+        if (trackPoints == 300)
+            trackTimer.stop();
+    });
+    trackTimer.start(100);
+
+    // lots of wiggly lines (like a road network) drawn with levels of detail:
+    // the further the camera is, the more simplified lines get drawn
+    QVector<QVector<QVector3D>> network;
+    for (int i = 0; i < 200; ++i) {
+        QVector<QVector3D> road;
+        QVector3D pt(-40 + (i % 20) * 4, 0.05f, -60 - (i / 20) * 4);
+        for (int j = 0; j < 500; ++j) {
+            const float angle = std::sin(i + j * 0.05f) * 2 + std::sin(j * 0.7f) * 0.3f;
+            pt += QVector3D(std::cos(angle), 0, std::sin(angle)) * 0.05f;
+            road << pt;
+        }
+        network << road;
+    }
+
+    LineMeshGeometry networkGeometry;
+    LineMeshLod networkLod;
+    LineMeshData networkData = LineMeshBuilder::build(network);
+    LineSegmentGeometry networkSegmentGeometry;
+    networkSegmentGeometry.setLines(networkData);
+    networkLod.build(std::move(networkData), &networkGeometry, 0.002f);
+
+    // a large field of such lines split into spatial chunks, so that only the chunks
+    // within the view frustum get drawn
+    QVector<QVector<QVector3D>> field;
+    for (int i = 0; i < 2000; ++i) {
+        QVector<QVector3D> road;
+        QVector3D pt(60 + (i % 50) * 2, 0.05f, -40 + (i / 50) * 2);
+        for (int j = 0; j < 300; ++j) {
+            const float angle = std::sin(i + j * 0.05f) * 2 + std::sin(j * 0.7f) * 0.3f;
+            pt += QVector3D(std::cos(angle), 0, std::sin(angle)) * 0.05f;
+            road << pt;
+        }
+        field << road;
+    }
+
+    LineMeshChunks fieldChunks;
+    fieldChunks.build(field, QVector<bool>(), 16384);
+
+    // roads of several classes, each with its own color and width (per-vertex attributes),
+    // all drawn with a single draw call
+    QVector<QVector<QVector3D>> roads;
+    QVector<QRgb> roadColors;
+    QVector<float> roadWidths;
+    const QRgb classColors[] = { qRgb(230, 60, 40), qRgb(250, 200, 40), qRgb(240, 240, 240) };
+    const float classWidths[] = { 12, 8, 4 };
+    for (int i = 0; i < 30; ++i) {
+        QVector<QVector3D> road;
+        QVector3D pt(-20 + i * 1.3f, 0.05f, 15);
+        for (int j = 0; j < 400; ++j) {
+            const float angle = std::sin(i + j * 0.02f) * 0.8f + 1.57f;
+            pt += QVector3D(std::cos(angle), 0, std::sin(angle)) * 0.05f;
+            road << pt;
+        }
+        roads << road;
+        roadColors << classColors[i % 3];
+        roadWidths << classWidths[i % 3];
+    }
+
+    const LineMeshGeometry::VertexAttributes roadAttributes = LineMeshGeometry::Color | LineMeshGeometry::Width | LineMeshGeometry::Distance;
+    LineMeshData roadData = LineMeshBuilder::build(roads);
+    LineMeshGeometry styledGeometry;
+    styledGeometry.setVertexLayout(roadAttributes);
+    styledGeometry.setVertexData(LineMeshBuilder::interleavedVertexData(roadData, roadAttributes, 0, roadColors, roadWidths),
+                                 std::move(roadData.indexData), roadData.indexType);
 
     Qt3DExtras::Quick::Qt3DQuickWindow view;
     view.setTitle("Lines");
     view.resize(1600, 800);
     view.engine()->qmlEngine()->rootContext()->setContextProperty("_window", &view);
     view.engine()->qmlEngine()->rootContext()->setContextProperty("_lmg", &lmg);
+    view.engine()->qmlEngine()->rootContext()->setContextProperty("_networkGeometry", &networkGeometry);
+    view.engine()->qmlEngine()->rootContext()->setContextProperty("_networkLod", &networkLod);
+    view.engine()->qmlEngine()->rootContext()->setContextProperty("_fieldChunks", &fieldChunks);
+    view.engine()->qmlEngine()->rootContext()->setContextProperty("_styledGeometry", &styledGeometry);
+    view.engine()->qmlEngine()->rootContext()->setContextProperty("_segmentGeometry", &segmentGeometry);
+    view.engine()->qmlEngine()->rootContext()->setContextProperty("_networkSegmentGeometry", &networkSegmentGeometry);
+    view.engine()->qmlEngine()->rootContext()->setContextProperty("_useInstancedLines", useInstancedLines);
     view.setSource(QUrl("qrc:/main.qml"));
     view.show();
 
@@ -137,8 +137,24 @@ Entity {
 
         }
 
-        onPositionChanged: tstLineClipping()
-        onViewCenterChanged: tstLineClipping()
+        function updateLod() {
+            _networkLod.updateCamera(position, fieldOfView, Qt.size(_window.width, _window.height))
+        }
+
+        function updateCulling() {
+            _fieldChunks.updateCamera(viewProjMatrix())
+        }
+
+        onPositionChanged: { tstLineClipping(); updateLod(); updateCulling() }
+        onViewCenterChanged: { tstLineClipping(); updateCulling() }
+        onUpVectorChanged: updateCulling()
+        onProjectionMatrixChanged: { updateLod(); updateCulling() }
+    }
+
+    // the pixel threshold of levels of detail depends on the viewport height
+    QQ2.Connections {
+        target: _window
+        onHeightChanged: camera.updateLod()
     }
 
     FirstPersonCameraController { camera: camera }
@@ -157,6 +173,8 @@ Entity {
     }
 
     Entity {
+        enabled: !_useInstancedLines
+
         GeometryRenderer {
             id: gr
             primitiveType: GeometryRenderer.LineStripAdjacency
@@ -244,6 +262,174 @@ Entity {
         components:  [ gr, grm ]
     }
 
+    // lines with levels of detail (the same material)
+    Entity {
+        enabled: !_useInstancedLines
+
+        GeometryRenderer {
+            id: grNetwork
+            primitiveType: GeometryRenderer.LineStripAdjacency
+            primitiveRestartEnabled: true
+            restartIndexValue: 0
+            vertexCount: _networkGeometry.count
+            geometry: _networkGeometry
+        }
+
+        components: [ grNetwork, grm ]
+    }
+
+    // chunked lines: an entity for each chunk, disabled when outside of the view frustum
+    NodeInstantiator {
+        model: _fieldChunks.chunks
+        delegate: Entity {
+            enabled: modelData.visible && !_useInstancedLines
+
+            GeometryRenderer {
+                id: grChunk
+                primitiveType: GeometryRenderer.LineStripAdjacency
+                primitiveRestartEnabled: true
+                restartIndexValue: 0
+                vertexCount: modelData.count
+                geometry: modelData
+            }
+
+            components: [ grChunk, grm ]
+        }
+    }
+
+    // lines with per-vertex color, width and distance along the line: differently styled
+    // lines in a single draw call (distance gives texture coordinates along the line)
+    Material {
+        id: grmStyled
+
+        parameters: [
+            Parameter { name: "useVertexStyle"; value: true },
+            Parameter { name: "MITER_LIMIT"; value: -1 },
+            Parameter { name: "WIN_SCALE"; value: Qt.size(_window.width,_window.height) },
+            Parameter { name: "TEX_SCALE"; value: 0.5 },
+            Parameter { name: "tex0"; value: txtRepeated },
+            Parameter { name: "useTex"; value: false }
+        ]
+
+        Texture2D {
+            id : txtRepeated
+            generateMipMaps : false
+            magnificationFilter : Texture.Linear
+            minificationFilter : Texture.Linear
+            wrapMode { x: WrapMode.Repeat; y: WrapMode.ClampToEdge }
+            textureImages: [
+                TextureImage {
+                    source: "qrc:/line-texture.png"
+                }
+            ]
+        }
+
+        effect: Effect {
+            techniques: Technique {
+                graphicsApiFilter { api: GraphicsApiFilter.OpenGL; profile: GraphicsApiFilter.CoreProfile; majorVersion: 3; minorVersion: 1 }
+                renderPasses: [
+                    RenderPass {
+                        renderStates: [
+                            BlendEquation {
+                                blendFunction: BlendEquation.Add
+                            },
+                            BlendEquationArguments {
+                                sourceRgb: BlendEquationArguments.SourceAlpha
+                                destinationRgb: BlendEquationArguments.OneMinusSourceAlpha
+                            }
+                        ]
+
+                        shaderProgram: ShaderProgram {
+                            vertexShaderCode: loadSource("qrc:/shaders/lines.vert")
+                            geometryShaderCode: loadSource("qrc:/shaders/lines.geom")
+                            fragmentShaderCode: loadSource("qrc:/shaders/lines.frag")
+                        }
+                    }
+                ]
+            }
+        }
+    }
+
+    Entity {
+        GeometryRenderer {
+            id: grStyled
+            primitiveType: GeometryRenderer.LineStripAdjacency
+            primitiveRestartEnabled: true
+            restartIndexValue: 0
+            vertexCount: _styledGeometry.count
+            geometry: _styledGeometry
+        }
+
+        components: [ grStyled, grmStyled ]
+    }
+
+    // the same lines drawn without geometry shader: each segment is an instance
+    // with adjacent points, expanded to triangles in the vertex shader
+    Material {
+        id: grmInstanced
+
+        parameters: [
+            Parameter { name: "THICKNESS"; value: 10 },
+            Parameter { name: "MITER_LIMIT"; value: -1 },
+            Parameter { name: "WIN_SCALE"; value: Qt.size(_window.width,_window.height) },
+            Parameter { name: "tex0"; value: txt },
+            Parameter { name: "lineColor"; value: Qt.rgba(0,1,0,1) },
+            Parameter { name: "useTex"; value: false }
+        ]
+
+        effect: Effect {
+            techniques: Technique {
+                graphicsApiFilter { api: GraphicsApiFilter.OpenGL; profile: GraphicsApiFilter.CoreProfile; majorVersion: 3; minorVersion: 3 }
+                renderPasses: [
+                    RenderPass {
+                        renderStates: [
+                            BlendEquation {
+                                blendFunction: BlendEquation.Add
+                            },
+                            BlendEquationArguments {
+                                sourceRgb: BlendEquationArguments.SourceAlpha
+                                destinationRgb: BlendEquationArguments.OneMinusSourceAlpha
+                            }
+                        ]
+
+                        shaderProgram: ShaderProgram {
+                            vertexShaderCode: loadSource("qrc:/shaders/lines_instanced.vert")
+                            fragmentShaderCode: loadSource("qrc:/shaders/lines.frag")
+                        }
+                    }
+                ]
+            }
+        }
+    }
+
+    Entity {
+        enabled: _useInstancedLines
+
+        GeometryRenderer {
+            id: grInstanced
+            primitiveType: GeometryRenderer.Triangles
+            vertexCount: _segmentGeometry.count
+            instanceCount: _segmentGeometry.instanceCount
+            geometry: _segmentGeometry
+        }
+
+        components: [ grInstanced, grmInstanced ]
+    }
+
+    Entity {
+        enabled: _useInstancedLines
+
+        GeometryRenderer {
+            id: grNetworkInstanced
+            primitiveType: GeometryRenderer.Triangles
+            vertexCount: _networkSegmentGeometry.count
+            instanceCount: _networkSegmentGeometry.instanceCount
+            geometry: _networkSegmentGeometry
+        }
+
+        components: [ grNetworkInstanced, grmInstanced ]
+    }
+
     Entity {
         PhongMaterial {
             id: redMat
@@ -0,0 +1,74 @@
+#include <Qt3DQuickExtras/qt3dquickwindow.h>
+#include <Qt3DQuick/QQmlAspectEngine>
+#include <QDir>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QQmlContext>
+#include <QQmlEngine>
+#include <QRandomGenerator>
+
+#include <cmath>
+
+#include "pointcloudoctree.h"
+#include "pointcloudstreamer.h"
+
+// writes a synthetic terrain with the given number of points as an octree file
+static bool generateTerrain(const QString &path, int pointCount)
+{
+    QRandomGenerator random(1);
+    QVector<QVector3D> points;
+    QVector<QRgb> colors;
+    points.reserve(pointCount);
+    colors.reserve(pointCount);
+    for (int i = 0; i < pointCount; ++i) {
+        const float x = random.bounded(2000.), z = random.bounded(2000.);
+        const float y = 40 * std::sin(x / 170) * std::cos(z / 230) + 8 * std::sin(x / 23 + z / 31) + random.bounded(0.3);
+        points << QVector3D(x - 1000, y, z - 1000);
+        // green valleys, brown slopes and white tops
+        const float t = qBound(0.f, (y + 48) / 96, 1.f);
+        colors << (t < 0.5 ? qRgb(60 + 200 * t, 140 - 40 * t, 50) : t < 0.85 ? qRgb(160, 120, 80) : qRgb(240, 240, 240));
+    }
+    return PointCloudOctree::write(path, points, colors);
+}
+
+int main(int argc, char* argv[])
+{
+    QGuiApplication app(argc, argv);
+
+    // usage: fun3d-pointcloud [file.pcot] [--points N]
+    // without a file, a synthetic terrain gets generated to the temp directory on the first run
+    QStringList args = app.arguments();
+    int pointCount = 5000000;
+    const int pointsIndex = args.indexOf("--points");
+    if (pointsIndex > 0 && pointsIndex + 1 < args.count()) {
+        pointCount = args[pointsIndex + 1].toInt();
+        args.erase(args.begin() + pointsIndex, args.begin() + pointsIndex + 2);
+    }
+
+    QString path = args.count() > 1 ? args[1] : QDir::temp().filePath(QString("fun3d-pointcloud-%1.pcot").arg(pointCount));
+    if (!QFileInfo::exists(path)) {
+        if (!generateTerrain(path, pointCount)) {
+            qWarning("failed to write %s", qPrintable(path));
+            return 1;
+        }
+    }
+
+    PointCloudStreamer pointCloud;
+    if (!pointCloud.open(path)) {
+        qWarning("failed to open %s", qPrintable(path));
+        return 1;
+    }
+
+    Qt3DExtras::Quick::Qt3DQuickWindow view;
+    view.setTitle("Point Cloud Streaming");
+    view.resize(1600, 800);
+    QObject::connect(&pointCloud, &PointCloudStreamer::visiblePointCountChanged, [&view](int count) {
+        view.setTitle(QString("Point Cloud Streaming - %1 points").arg(count));
+    });
+    view.engine()->qmlEngine()->rootContext()->setContextProperty("_window", &view);
+    view.engine()->qmlEngine()->rootContext()->setContextProperty("_pointCloud", &pointCloud);
+    view.setSource(QUrl("qrc:/main.qml"));
+    view.show();
+
+    return app.exec();
+}
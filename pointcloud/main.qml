@@ -0,0 +1,105 @@
+import Qt3D.Core 2.0
+import Qt3D.Render 2.0
+import Qt3D.Input 2.0
+import Qt3D.Extras 2.0
+
+Entity {
+
+    components: [
+        rendSettings,
+        inputSettings
+    ]
+
+    InputSettings { id: inputSettings }
+
+    RenderSettings {
+        id: rendSettings
+        activeFrameGraph: RenderSurfaceSelector {
+            Viewport {
+                normalizedRect: Qt.rect(0,0,1,1)
+                CameraSelector {
+                    camera: camera
+                    ClearBuffers {
+                        buffers: ClearBuffers.ColorDepthBuffer
+                        clearColor: Qt.rgba(0.6, 0.75, 0.9, 1)
+                    }
+                }
+            }
+        }
+
+    }
+
+    Camera {
+        id: camera
+        projectionType: CameraLens.PerspectiveProjection
+        fieldOfView: 45
+        aspectRatio: _window.width / _window.height
+        nearPlane: 1
+        farPlane: 5000.0
+        position: Qt.vector3d(0.0, 300.0, 1200.0)
+        viewCenter: Qt.vector3d(0.0, 0.0, 0.0)
+        upVector: Qt.vector3d(0.0, 1.0, 0.0)
+
+        function viewProjMatrix() {
+            var viewMat = Qt.matrix4x4();
+            viewMat.lookAt(camera.position, camera.viewCenter, camera.upVector)
+            return camera.projectionMatrix.times( viewMat )
+        }
+
+        function updatePointCloud() {
+            _pointCloud.updateCamera(viewProjMatrix(), position, fieldOfView, Qt.size(_window.width, _window.height))
+        }
+
+        onPositionChanged: updatePointCloud()
+        onViewCenterChanged: updatePointCloud()
+        onUpVectorChanged: updatePointCloud()
+        onProjectionMatrixChanged: updatePointCloud()
+        Component.onCompleted: updatePointCloud()
+    }
+
+    FirstPersonCameraController {
+        camera: camera
+        linearSpeed: 200
+    }
+
+    Effect {
+        id: pointCloudEffect
+        techniques: Technique {
+            graphicsApiFilter { api: GraphicsApiFilter.OpenGL; profile: GraphicsApiFilter.CoreProfile; majorVersion: 3; minorVersion: 1 }
+            renderPasses: [
+                RenderPass {
+                    shaderProgram: ShaderProgram {
+                        vertexShaderCode: loadSource("qrc:/shaders/pointcloud.vert")
+                        fragmentShaderCode: loadSource("qrc:/shaders/pointcloud.frag")
+                    }
+                    renderStates: [
+                        PointSize { sizeMode: PointSize.Fixed; value: 2 }
+                    ]
+                }
+            ]
+        }
+    }
+
+    // an entity for each slot of resident nodes (enabled when its node is selected)
+    NodeInstantiator {
+        model: _pointCloud.nodes
+        delegate: Entity {
+            enabled: modelData.visible
+
+            GeometryRenderer {
+                id: grNode
+                primitiveType: GeometryRenderer.Points
+                geometry: modelData
+                vertexCount: modelData.count
+            }
+
+            Material {
+                id: matNode
+                effect: pointCloudEffect
+            }
+
+            components: [ grNode, matNode ]
+        }
+    }
+
+}
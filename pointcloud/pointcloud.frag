@@ -0,0 +1,10 @@
+#version 150
+
+in vec4 color;
+
+out vec4 fragColor;
+
+void main(void)
+{
+  fragColor = color;
+}
@@ -0,0 +1,14 @@
+#version 150
+
+in vec3 vertexPosition;
+in vec4 vertexColor;   // RGBA bytes, normalized
+
+uniform mat4 modelViewProjection;
+
+out vec4 color;
+
+void main(void)
+{
+  color = vertexColor;
+  gl_Position = modelViewProjection * vec4(vertexPosition, 1.0);
+}
@@ -0,0 +1,274 @@
+#include "pointcloudoctree.h"
+
+#include <QFile>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <vector>
+
+// byte size of a point as stored in the file: 3 x uint16 position + RGBA color
+static const int STORED_STRIDE = 10;
+
+// largest value of quantized coordinates within a node
+static const float QUANTIZED_MAXIMUM = 65535;
+
+
+namespace
+{
+
+  const char MAGIC[4] = { 'P', 'C', 'O', 'T' };
+  const quint32 VERSION = 1;
+
+  struct FileHeader
+  {
+    char magic[4];
+    quint32 version;
+    quint32 nodeCount;
+    quint32 reserved;
+    quint64 pointCount;
+    float minimum[3];
+    float size;
+  };
+
+  struct FileNode
+  {
+    qint32 parent;
+    quint32 level;
+    quint32 pointCount;
+    quint32 reserved;
+    quint64 offset;
+    float minimum[3];
+    float size;
+  };
+
+  static_assert( sizeof( FileHeader ) == 40 && sizeof( FileNode ) == 40, "file structures are expected to be packed" );
+
+  //! Node being built by PointCloudOctree::write(), with indices of its points
+  struct BuildNode
+  {
+    PointCloudNode node;
+    QVector<int> points;
+  };
+
+}
+
+
+bool PointCloudOctree::open( const QString &path )
+{
+  QFile file( path );
+  if ( !file.open( QIODevice::ReadOnly ) )
+    return false;
+
+  FileHeader header;
+  if ( file.read( reinterpret_cast<char *>( &header ), sizeof( header ) ) != sizeof( header ) ||
+       std::memcmp( header.magic, MAGIC, sizeof( MAGIC ) ) != 0 || header.version != VERSION || header.nodeCount == 0 )
+    return false;
+
+  QVector<FileNode> fileNodes( header.nodeCount );
+  const qint64 tableSize = static_cast<qint64>( header.nodeCount ) * sizeof( FileNode );
+  if ( file.read( reinterpret_cast<char *>( fileNodes.data() ), tableSize ) != tableSize )
+    return false;
+
+  QVector<PointCloudNode> nodes( fileNodes.count() );
+  int maximumNodePointCount = 0;
+  for ( int i = 0; i < fileNodes.count(); ++i )
+  {
+    const FileNode &fileNode = fileNodes[i];
+    if ( fileNode.parent >= i || ( i > 0 && fileNode.parent < 0 ) ||
+         static_cast<qint64>( fileNode.offset + fileNode.pointCount * STORED_STRIDE ) > file.size() )
+      return false;   // corrupted table
+
+    PointCloudNode &node = nodes[i];
+    node.parent = fileNode.parent;
+    node.level = fileNode.level;
+    node.pointCount = fileNode.pointCount;
+    node.offset = fileNode.offset;
+    node.minimum = QVector3D( fileNode.minimum[0], fileNode.minimum[1], fileNode.minimum[2] );
+    node.size = fileNode.size;
+    if ( node.parent >= 0 )
+      nodes[node.parent].children.append( i );
+    maximumNodePointCount = std::max( maximumNodePointCount, node.pointCount );
+  }
+
+  mPath = path;
+  mNodes = std::move( nodes );
+  mPointCount = header.pointCount;
+  mMaximumNodePointCount = maximumNodePointCount;
+  return true;
+}
+
+QByteArray PointCloudOctree::readNode( const QString &path, const PointCloudNode &node )
+{
+  QFile file( path );
+  if ( !file.open( QIODevice::ReadOnly ) || !file.seek( node.offset ) )
+    return QByteArray();
+
+  const QByteArray stored = file.read( static_cast<qint64>( node.pointCount ) * STORED_STRIDE );
+  if ( stored.size() != node.pointCount * STORED_STRIDE )
+    return QByteArray();
+
+  QByteArray decoded( node.pointCount * DECODED_STRIDE, Qt::Uninitialized );
+  const char *in = stored.constData();
+  char *out = decoded.data();
+  const float scale = node.size / QUANTIZED_MAXIMUM;
+  for ( int i = 0; i < node.pointCount; ++i )
+  {
+    quint16 quantized[3];
+    std::memcpy( quantized, in, sizeof( quantized ) );
+    const float position[3] = { node.minimum.x() + quantized[0] * scale,
+                                node.minimum.y() + quantized[1] * scale,
+                                node.minimum.z() + quantized[2] * scale
+                              };
+    std::memcpy( out, position, sizeof( position ) );
+    std::memcpy( out + sizeof( position ), in + sizeof( quantized ), 4 );   // RGBA stays as it is
+    in += STORED_STRIDE;
+    out += DECODED_STRIDE;
+  }
+  return decoded;
+}
+
+bool PointCloudOctree::write( const QString &path, const QVector<QVector3D> &points, const QVector<QRgb> &colors, int maximumNodePoints )
+{
+  Q_ASSERT( colors.count() == points.count() );
+  if ( points.isEmpty() )
+    return false;
+
+  // the root is the bounding cube of all points (made a bit larger so that all points are inside)
+  QVector3D minimum = points[0], maximum = points[0];
+  for ( const QVector3D &p : points )
+  {
+    for ( int i = 0; i < 3; ++i )
+    {
+      minimum[i] = std::min( minimum[i], p[i] );
+      maximum[i] = std::max( maximum[i], p[i] );
+    }
+  }
+  const QVector3D extent = maximum - minimum;
+  const float rootSize = std::max( { extent.x(), extent.y(), extent.z(), 1e-6f } ) * 1.0001f;
+
+  // points get picked to subsamples in random order, so that the first ones in each cell are not biased
+  QVector<BuildNode> queue( 1 );
+  queue[0].node.minimum = minimum;
+  queue[0].node.size = rootSize;
+  queue[0].points.resize( points.count() );
+  std::iota( queue[0].points.begin(), queue[0].points.end(), 0 );
+  std::shuffle( queue[0].points.begin(), queue[0].points.end(), std::mt19937( 1 ) );
+
+  // breadth first, so that parents come before children
+  QVector<PointCloudNode> nodes;
+  QVector<QVector<int>> nodePoints;
+  std::vector<bool> occupied;
+  for ( int current = 0; current < queue.count(); ++current )
+  {
+    BuildNode building = std::move( queue[current] );
+    PointCloudNode &node = building.node;
+    const int index = nodes.count();
+
+    QVector<int> taken;
+    QVector<int> childPoints[8];
+    if ( building.points.count() <= maximumNodePoints || node.level == MAX_LEVEL )
+    {
+      taken = std::move( building.points );
+    }
+    else
+    {
+      occupied.assign( GRID_SIZE * GRID_SIZE * GRID_SIZE, false );
+      const float cellScale = GRID_SIZE / node.size;
+      for ( int p : qAsConst( building.points ) )
+      {
+        const QVector3D relative = ( points[p] - node.minimum ) * cellScale;
+        int cell[3];
+        for ( int i = 0; i < 3; ++i )
+          cell[i] = std::min( std::max( static_cast<int>( relative[i] ), 0 ), GRID_SIZE - 1 );
+        const int cellIndex = ( cell[2] * GRID_SIZE + cell[1] ) * GRID_SIZE + cell[0];
+        if ( taken.count() < maximumNodePoints && !occupied[cellIndex] )
+        {
+          occupied[cellIndex] = true;
+          taken.append( p );
+          continue;
+        }
+        const int octant = ( cell[0] >= GRID_SIZE / 2 ) | ( cell[1] >= GRID_SIZE / 2 ) << 1 | ( cell[2] >= GRID_SIZE / 2 ) << 2;
+        childPoints[octant].append( p );
+      }
+    }
+
+    for ( int octant = 0; octant < 8; ++octant )
+    {
+      if ( childPoints[octant].isEmpty() )
+        continue;
+      BuildNode child;
+      child.node.parent = index;
+      child.node.level = node.level + 1;
+      child.node.size = node.size / 2;
+      child.node.minimum = node.minimum + QVector3D( octant & 1, ( octant >> 1 ) & 1, ( octant >> 2 ) & 1 ) * child.node.size;
+      child.points = std::move( childPoints[octant] );
+      queue.append( std::move( child ) );
+    }
+    queue[current] = BuildNode();   // free the memory of processed nodes
+
+    node.pointCount = taken.count();
+    nodes.append( node );
+    nodePoints.append( std::move( taken ) );
+  }
+
+  QFile file( path );
+  if ( !file.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+    return false;
+
+  FileHeader header = {};
+  std::memcpy( header.magic, MAGIC, sizeof( MAGIC ) );
+  header.version = VERSION;
+  header.nodeCount = nodes.count();
+  header.pointCount = points.count();
+  header.minimum[0] = minimum.x();
+  header.minimum[1] = minimum.y();
+  header.minimum[2] = minimum.z();
+  header.size = rootSize;
+
+  QVector<FileNode> fileNodes( nodes.count() );
+  quint64 offset = sizeof( FileHeader ) + nodes.count() * sizeof( FileNode );
+  for ( int i = 0; i < nodes.count(); ++i )
+  {
+    const PointCloudNode &node = nodes[i];
+    FileNode &fileNode = fileNodes[i];
+    fileNode = FileNode();
+    fileNode.parent = node.parent;
+    fileNode.level = node.level;
+    fileNode.pointCount = node.pointCount;
+    fileNode.offset = offset;
+    fileNode.minimum[0] = node.minimum.x();
+    fileNode.minimum[1] = node.minimum.y();
+    fileNode.minimum[2] = node.minimum.z();
+    fileNode.size = node.size;
+    offset += static_cast<quint64>( node.pointCount ) * STORED_STRIDE;
+  }
+
+  if ( file.write( reinterpret_cast<const char *>( &header ), sizeof( header ) ) != sizeof( header ) ||
+       file.write( reinterpret_cast<const char *>( fileNodes.constData() ), fileNodes.count() * sizeof( FileNode ) ) != static_cast<qint64>( fileNodes.count() * sizeof( FileNode ) ) )
+    return false;
+
+  for ( int i = 0; i < nodes.count(); ++i )
+  {
+    const PointCloudNode &node = nodes[i];
+    QByteArray stored( node.pointCount * STORED_STRIDE, Qt::Uninitialized );
+    char *out = stored.data();
+    const float scale = QUANTIZED_MAXIMUM / node.size;
+    for ( int p : qAsConst( nodePoints[i] ) )
+    {
+      const QVector3D relative = ( points[p] - node.minimum ) * scale;
+      quint16 quantized[3];
+      for ( int j = 0; j < 3; ++j )
+        quantized[j] = static_cast<quint16>( std::min( std::max( std::round( relative[j] ), 0.f ), QUANTIZED_MAXIMUM ) );
+      const quint8 color[4] = { quint8( qRed( colors[p] ) ), quint8( qGreen( colors[p] ) ), quint8( qBlue( colors[p] ) ), quint8( qAlpha( colors[p] ) ) };
+      std::memcpy( out, quantized, sizeof( quantized ) );
+      std::memcpy( out + sizeof( quantized ), color, sizeof( color ) );
+      out += STORED_STRIDE;
+    }
+    if ( file.write( stored ) != stored.size() )
+      return false;
+  }
+  return true;
+}
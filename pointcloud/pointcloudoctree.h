@@ -0,0 +1,89 @@
+#ifndef POINTCLOUDOCTREE_H
+#define POINTCLOUDOCTREE_H
+
+#include <QByteArray>
+#include <QRgb>
+#include <QString>
+#include <QVector>
+#include <QVector3D>
+
+//! Node of PointCloudOctree: a cube with a subsample of points inside it
+struct PointCloudNode
+{
+  int parent = -1;         //!< Index of the parent node (-1 for the root)
+  int level = 0;           //!< Depth in the tree (0 for the root)
+  int pointCount = 0;
+  qint64 offset = 0;       //!< Byte offset of point data in the file
+  QVector3D minimum;       //!< Minimum corner of the cube
+  float size = 0;          //!< Edge length of the cube
+  QVector<int> children;   //!< Indices of child nodes (not stored, rebuilt when the file is opened)
+};
+
+
+/**
+ * Octree of a point cloud stored in a single file, so that only the nodes needed
+ * for the current view have to be read from the disk.
+ *
+ * Every node holds a subsample of the points inside its cube - at most one point per cell
+ * of a GRID_SIZE^3 grid, up to a maximum count - and the remaining points are passed down
+ * to its children (the same idea as in Potree or Entwine). A node drawn together with its
+ * ancestors has about the density of the whole cloud at its level of detail.
+ *
+ * File layout (native byte order):
+ *
+ * - header: magic "PCOT", version, node count, total point count, cube of the root
+ * - node table: parent, level, point count, offset of point data and cube of each node
+ *   (parents always come before their children)
+ * - point data: each point as 3 x uint16 position within the cube of its node + RGBA color (10 bytes)
+ *
+ * The header and the node table are small and get read by open(). Point data of nodes
+ * are read by readNode(), which can be called from any thread.
+ */
+class PointCloudOctree
+{
+  public:
+    //! Cells along each side of a node used to pick its subsample
+    static const int GRID_SIZE = 128;
+
+    //! Maximum depth of the tree (deepest nodes take all their points)
+    static const int MAX_LEVEL = 20;
+
+    //! Byte size of a point with the decoded layout: [x, y, z] floats + RGBA bytes
+    static const int DECODED_STRIDE = 16;
+
+    //! Reads the header and node table of the file at \a path, returns false on error
+    bool open( const QString &path );
+
+    //! Returns path of the opened file
+    QString path() const { return mPath; }
+
+    //! Returns nodes, the root is the first one
+    const QVector<PointCloudNode> &nodes() const { return mNodes; }
+
+    //! Returns total number of points
+    qint64 pointCount() const { return mPointCount; }
+
+    //! Returns the highest point count of a node
+    int maximumNodePointCount() const { return mMaximumNodePointCount; }
+
+    /**
+     * Reads points of the \a node from the file at \a path and decodes them (DECODED_STRIDE bytes each).
+     * Returns an empty array on error. Each call opens the file on its own, so this is safe to run
+     * on worker threads.
+     */
+    static QByteArray readNode( const QString &path, const PointCloudNode &node );
+
+    /**
+     * Builds an octree of \a points (with \a colors) and writes it to \a path, returns false on error.
+     * Nodes get at most \a maximumNodePoints points (except for the deepest ones).
+     */
+    static bool write( const QString &path, const QVector<QVector3D> &points, const QVector<QRgb> &colors, int maximumNodePoints = 20000 );
+
+  private:
+    QString mPath;
+    QVector<PointCloudNode> mNodes;
+    qint64 mPointCount = 0;
+    int mMaximumNodePointCount = 0;
+};
+
+#endif // POINTCLOUDOCTREE_H
@@ -0,0 +1,297 @@
+#include "pointcloudstreamer.h"
+
+#include <QVector4D>
+#include <QtMath>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+
+// nodes read at the same time (reading is mostly waiting for the disk)
+static const int MAX_CONCURRENT_LOADS = 4;
+
+// projected diameter in pixels below which nodes are not drawn
+static const float MINIMUM_NODE_SIZE = 100;
+
+
+PointCloudNodeGeometry::PointCloudNodeGeometry( int capacity, Qt3DCore::QNode *parent )
+  : Qt3DRender::QGeometry( parent )
+  , mBuffer( new Qt3DRender::QBuffer( Qt3DRender::QBuffer::VertexBuffer, this ) )
+  , mCapacity( capacity )
+{
+  // (colors are normalized - integer attributes always are with Qt3D)
+  mPositionAttribute = new Qt3DRender::QAttribute( mBuffer, Qt3DRender::QAttribute::defaultPositionAttributeName(), Qt3DRender::QAttribute::Float,
+      3, 0, 0, PointCloudOctree::DECODED_STRIDE, this );
+  mColorAttribute = new Qt3DRender::QAttribute( mBuffer, Qt3DRender::QAttribute::defaultColorAttributeName(), Qt3DRender::QAttribute::UnsignedByte,
+      4, 0, 3 * sizeof( float ), PointCloudOctree::DECODED_STRIDE, this );
+
+  addAttribute( mPositionAttribute );
+  addAttribute( mColorAttribute );
+}
+
+void PointCloudNodeGeometry::setPoints( const QByteArray &decoded )
+{
+  const int count = decoded.size() / PointCloudOctree::DECODED_STRIDE;
+  Q_ASSERT( count <= mCapacity );
+
+  if ( mBuffer->data().isEmpty() )
+  {
+    // allocated on the first use for the largest node, later nodes just overwrite the beginning
+    QByteArray data( mCapacity * PointCloudOctree::DECODED_STRIDE, 0 );
+    std::copy( decoded.constBegin(), decoded.constEnd(), data.begin() );
+    mBuffer->setData( data );
+  }
+  else if ( !decoded.isEmpty() )
+    mBuffer->updateData( 0, decoded );
+
+  mCount = count;
+  mPositionAttribute->setCount( mCount );
+  mColorAttribute->setCount( mCount );
+  emit countChanged( mCount );
+}
+
+void PointCloudNodeGeometry::setVisible( bool visible )
+{
+  if ( visible == mVisible )
+    return;
+
+  mVisible = visible;
+  emit visibleChanged( mVisible );
+}
+
+
+PointCloudStreamer::PointCloudStreamer( QObject *parent )
+  : QObject( parent )
+{
+}
+
+PointCloudStreamer::~PointCloudStreamer()
+{
+  clear();
+}
+
+void PointCloudStreamer::clear()
+{
+  // results of running loads are dropped (reading a node does not take long)
+  for ( QFutureWatcher<QByteArray> *watcher : qAsConst( mLoads ) )
+  {
+    watcher->waitForFinished();
+    delete watcher;
+  }
+  mLoads.clear();
+  mFailedNodes.clear();
+
+  for ( const QPointer<PointCloudNodeGeometry> &slot : qAsConst( mSlots ) )
+  {
+    if ( slot && !slot->parent() )
+      delete slot;
+  }
+  mSlots.clear();
+  mSlotNodes.clear();
+  mSlotLastUsed.clear();
+  mNodeSlots.clear();
+}
+
+bool PointCloudStreamer::open( const QString &path, int slotCount )
+{
+  PointCloudOctree octree;
+  if ( !octree.open( path ) )
+    return false;
+
+  clear();
+  mOctree = octree;
+  for ( int i = 0; i < slotCount; ++i )
+    mSlots.append( new PointCloudNodeGeometry( mOctree.maximumNodePointCount() ) );
+  mSlotNodes.fill( -1, slotCount );
+  mSlotLastUsed.fill( 0, slotCount );
+  mNodeSlots.fill( -1, mOctree.nodes().count() );
+
+  emit nodesChanged();
+  emit loadingCountChanged( 0 );
+  if ( mHasCamera )
+    updateSelection();
+  return true;
+}
+
+QVariantList PointCloudStreamer::nodes() const
+{
+  QVariantList list;
+  for ( const QPointer<PointCloudNodeGeometry> &slot : mSlots )
+    list.append( QVariant::fromValue<QObject *>( slot.data() ) );
+  return list;
+}
+
+void PointCloudStreamer::setPointBudget( int budget )
+{
+  if ( budget == mPointBudget )
+    return;
+
+  mPointBudget = budget;
+  emit pointBudgetChanged( mPointBudget );
+  if ( mHasCamera )
+    updateSelection();
+}
+
+float PointCloudStreamer::minimumNodeSize()
+{
+  return MINIMUM_NODE_SIZE;
+}
+
+void PointCloudStreamer::updateCamera( const QMatrix4x4 &viewProjection, const QVector3D &cameraPosition, float fieldOfView, const QSizeF &viewportSize )
+{
+  // diameter in pixels = 2 * radius / distance * (height / 2) / tan(fov / 2)
+  mViewProjection = viewProjection;
+  mCameraPosition = cameraPosition;
+  mPixelScale = viewportSize.height() / std::tan( qDegreesToRadians( fieldOfView ) / 2 );
+  mHasCamera = true;
+  updateSelection();
+}
+
+void PointCloudStreamer::updateSelection()
+{
+  const QVector<PointCloudNode> &nodes = mOctree.nodes();
+  if ( nodes.isEmpty() )
+    return;
+
+  ++mUpdate;
+
+  // frustum planes (Gribb-Hartmann), normals pointing inside
+  QVector4D planes[6];
+  for ( int i = 0; i < 3; ++i )
+  {
+    planes[i * 2] = mViewProjection.row( 3 ) + mViewProjection.row( i );
+    planes[i * 2 + 1] = mViewProjection.row( 3 ) - mViewProjection.row( i );
+  }
+
+  auto isVisible = [&planes]( const PointCloudNode & node )
+  {
+    // the cube is outside if its corner furthest along the plane normal is behind the plane
+    const QVector3D minimum = node.minimum, maximum = node.minimum + QVector3D( node.size, node.size, node.size );
+    for ( const QVector4D &plane : planes )
+    {
+      const QVector3D corner( plane.x() > 0 ? maximum.x() : minimum.x(),
+                              plane.y() > 0 ? maximum.y() : minimum.y(),
+                              plane.z() > 0 ? maximum.z() : minimum.z() );
+      if ( plane.x() * corner.x() + plane.y() * corner.y() + plane.z() * corner.z() + plane.w() < 0 )
+        return false;
+    }
+    return true;
+  };
+
+  auto projectedSize = [this]( const PointCloudNode & node )
+  {
+    const float radius = node.size * std::sqrt( 3.f ) / 2;
+    const QVector3D center = node.minimum + QVector3D( node.size, node.size, node.size ) / 2;
+    const float distance = ( center - mCameraPosition ).length();
+    if ( distance <= radius )
+      return std::numeric_limits<float>::max();   // the camera is inside
+    return radius * mPixelScale / distance;
+  };
+
+  // the largest nodes on the screen first
+  typedef std::pair<float, int> QueueItem;
+  std::priority_queue<QueueItem> queue;
+  queue.push( QueueItem( projectedSize( nodes[0] ), 0 ) );
+
+  int pointCount = 0;
+  int visiblePointCount = 0;
+  QVector<int> missing;   // in the order of priority
+  while ( !queue.empty() )
+  {
+    const QueueItem item = queue.top();
+    queue.pop();
+    const PointCloudNode &node = nodes[item.second];
+    if ( ( item.first < MINIMUM_NODE_SIZE && item.second != 0 ) || !isVisible( node ) )
+      continue;
+    if ( pointCount + node.pointCount > mPointBudget )
+      break;
+    pointCount += node.pointCount;
+
+    const int slot = mNodeSlots[item.second];
+    if ( slot < 0 )
+    {
+      missing.append( item.second );
+      continue;
+    }
+
+    mSlotLastUsed[slot] = mUpdate;
+    visiblePointCount += node.pointCount;
+    for ( int child : node.children )
+      queue.push( QueueItem( projectedSize( nodes[child] ), child ) );
+  }
+
+  for ( int slot = 0; slot < mSlots.count(); ++slot )
+  {
+    if ( mSlots[slot] )
+      mSlots[slot]->setVisible( mSlotNodes[slot] >= 0 && mSlotLastUsed[slot] == mUpdate );
+  }
+
+  if ( visiblePointCount != mVisiblePointCount )
+  {
+    mVisiblePointCount = visiblePointCount;
+    emit visiblePointCountChanged( mVisiblePointCount );
+  }
+
+  // start loading missing nodes (unless they would have nowhere to go)
+  const int loadingCount = mLoads.count();
+  for ( int node : qAsConst( missing ) )
+  {
+    if ( mLoads.count() >= MAX_CONCURRENT_LOADS || slotForLoad() < 0 )
+      break;
+    if ( mLoads.contains( node ) || mFailedNodes.contains( node ) )
+      continue;
+
+    QFutureWatcher<QByteArray> *watcher = new QFutureWatcher<QByteArray>( this );
+    connect( watcher, &QFutureWatcher<QByteArray>::finished, this, [this, node] { loadFinished( node ); } );
+    watcher->setFuture( QtConcurrent::run( &PointCloudOctree::readNode, mOctree.path(), nodes[node] ) );
+    mLoads.insert( node, watcher );
+  }
+  if ( mLoads.count() != loadingCount )
+    emit loadingCountChanged( mLoads.count() );
+}
+
+int PointCloudStreamer::slotForLoad() const
+{
+  int best = -1;
+  for ( int slot = 0; slot < mSlots.count(); ++slot )
+  {
+    if ( !mSlots[slot] )
+      continue;
+    if ( mSlotNodes[slot] < 0 )
+      return slot;
+    // nodes selected in the last update are in use
+    if ( mSlotLastUsed[slot] != mUpdate && ( best < 0 || mSlotLastUsed[slot] < mSlotLastUsed[best] ) )
+      best = slot;
+  }
+  return best;
+}
+
+void PointCloudStreamer::loadFinished( int node )
+{
+  QFutureWatcher<QByteArray> *watcher = mLoads.take( node );
+  const QByteArray decoded = watcher->result();
+  watcher->deleteLater();
+  emit loadingCountChanged( mLoads.count() );
+
+  if ( decoded.isEmpty() )
+    mFailedNodes.insert( node );   // not tried again until the file gets reopened
+
+  const int slot = decoded.isEmpty() ? -1 : slotForLoad();
+  if ( slot >= 0 )
+  {
+    // evict the previous node (its children are not selected anymore as it was not selected either)
+    if ( mSlotNodes[slot] >= 0 )
+      mNodeSlots[mSlotNodes[slot]] = -1;
+    mSlotNodes[slot] = node;
+    mNodeSlots[node] = slot;
+    mSlotLastUsed[slot] = 0;
+    mSlots[slot]->setPoints( decoded );
+  }
+
+  // the node may let us refine further (and there is a free place for another load)
+  updateSelection();
+}
@@ -0,0 +1,163 @@
+#ifndef POINTCLOUDSTREAMER_H
+#define POINTCLOUDSTREAMER_H
+
+#include <QFutureWatcher>
+#include <QHash>
+#include <QMatrix4x4>
+#include <QObject>
+#include <QPointer>
+#include <QSet>
+#include <QSizeF>
+#include <QVariantList>
+#include <QVector>
+
+#include <Qt3DRender/QAttribute>
+#include <Qt3DRender/QBuffer>
+#include <Qt3DRender/QGeometry>
+
+#include "pointcloudoctree.h"
+
+/**
+ * Geometry of a slot of PointCloudStreamer: points of one resident octree node.
+ *
+ * Slots get reused for other nodes - the buffer is allocated for the largest node once
+ * and then just overwritten, so loading a node never reallocates any memory.
+ */
+class PointCloudNodeGeometry : public Qt3DRender::QGeometry
+{
+  Q_OBJECT
+
+  Q_PROPERTY(int count READ count NOTIFY countChanged)
+  Q_PROPERTY(bool visible READ isVisible NOTIFY visibleChanged)
+
+public:
+  //! Creates a slot for up to \a capacity points
+  PointCloudNodeGeometry( int capacity, Qt3DCore::QNode *parent = nullptr );
+
+  //! Sets decoded points (see PointCloudOctree::readNode())
+  void setPoints( const QByteArray &decoded );
+
+  //! Returns number of points
+  int count() const { return mCount; }
+
+  //! Returns whether the node was selected in the last update
+  bool isVisible() const { return mVisible; }
+
+  //! Sets whether the node is visible
+  void setVisible( bool visible );
+
+signals:
+  void countChanged( int count );
+  void visibleChanged( bool visible );
+
+private:
+  Qt3DRender::QBuffer *mBuffer = nullptr;
+  Qt3DRender::QAttribute *mPositionAttribute = nullptr;
+  Qt3DRender::QAttribute *mColorAttribute = nullptr;
+  int mCapacity = 0;
+  int mCount = 0;
+  bool mVisible = false;
+};
+
+
+/**
+ * Streams nodes of a PointCloudOctree from the disk, so that clouds much larger than
+ * the memory can be drawn.
+ *
+ * On each camera update, nodes get selected from the root down in the order of their projected
+ * size, until the sum of their points reaches the point budget. Nodes that are too small
+ * on the screen (see minimumNodeSize()) or outside of the view frustum are skipped together
+ * with their subtrees. Children only get selected once their parent is loaded.
+ *
+ * Selected nodes that are not resident get read and decoded on the global thread pool
+ * (the largest ones on the screen first, with a limited number of loads running at once). Loaded points
+ * go to a fixed pool of slots (PointCloudNodeGeometry objects, each drawn by its own entity),
+ * evicting the least recently selected node when there is no free slot. Whenever a load
+ * finishes, the selection is updated again for the last camera, so the cloud gets
+ * refined until the budget is reached.
+ */
+class PointCloudStreamer : public QObject
+{
+  Q_OBJECT
+
+  Q_PROPERTY(QVariantList nodes READ nodes NOTIFY nodesChanged)
+  Q_PROPERTY(int pointBudget READ pointBudget WRITE setPointBudget NOTIFY pointBudgetChanged)
+  Q_PROPERTY(int visiblePointCount READ visiblePointCount NOTIFY visiblePointCountChanged)
+  Q_PROPERTY(int loadingCount READ loadingCount NOTIFY loadingCountChanged)
+
+public:
+  PointCloudStreamer( QObject *parent = nullptr );
+  ~PointCloudStreamer() override;
+
+  /**
+   * Opens octree file at \a path (see PointCloudOctree::write()), with \a slotCount nodes
+   * kept resident at most. Returns false if the file could not be read.
+   */
+  bool open( const QString &path, int slotCount = 256 );
+
+  //! Returns slots for resident nodes (PointCloudNodeGeometry objects)
+  QVariantList nodes() const;
+
+  //! Returns maximum number of points to be drawn
+  int pointBudget() const { return mPointBudget; }
+
+  //! Sets maximum number of points to be drawn
+  void setPointBudget( int budget );
+
+  //! Returns number of points drawn after the last update
+  int visiblePointCount() const { return mVisiblePointCount; }
+
+  //! Returns number of nodes being loaded
+  int loadingCount() const { return mLoads.count(); }
+
+  //! Returns projected diameter in pixels below which nodes are not drawn
+  static float minimumNodeSize();
+
+  /**
+   * Updates the selection of nodes for the given projection * view matrix, \a cameraPosition,
+   * vertical field of view \a fieldOfView (in degrees) and viewport of \a viewportSize pixels.
+   * Missing nodes start to load.
+   */
+  Q_INVOKABLE void updateCamera( const QMatrix4x4 &viewProjection, const QVector3D &cameraPosition, float fieldOfView, const QSizeF &viewportSize );
+
+signals:
+  void nodesChanged();
+  void pointBudgetChanged( int budget );
+  void visiblePointCountChanged( int count );
+  void loadingCountChanged( int count );
+
+private:
+  //! Selects nodes for the last camera, updates visibility of slots and starts loads
+  void updateSelection();
+
+  //! Moves points of a loaded \a node to a slot (if it is still needed and there is one)
+  void loadFinished( int node );
+
+  //! Returns a free slot or the least recently used one not selected now (-1 if there is none)
+  int slotForLoad() const;
+
+  //! Deletes slots that have not been taken over by Qt3D entities
+  void clear();
+
+  PointCloudOctree mOctree;
+
+  //! Slots are not owned by us once they get parented to a Qt3D entity
+  QVector<QPointer<PointCloudNodeGeometry>> mSlots;
+  QVector<int> mSlotNodes;        //!< Node in each slot (-1 if free)
+  QVector<quint64> mSlotLastUsed; //!< Update in which the node of each slot was last selected
+  QVector<int> mNodeSlots;        //!< Slot of each node (-1 if not resident)
+
+  QHash<int, QFutureWatcher<QByteArray> *> mLoads;
+  QSet<int> mFailedNodes;   //!< Nodes that could not be read
+
+  bool mHasCamera = false;
+  QMatrix4x4 mViewProjection;
+  QVector3D mCameraPosition;
+  float mPixelScale = 0;
+  quint64 mUpdate = 0;
+
+  int mPointBudget = 3000000;
+  int mVisiblePointCount = 0;
+};
+
+#endif // POINTCLOUDSTREAMER_H
@@ -0,0 +1,436 @@
+/**
+ * Micro-benchmarks of double precision Matrix4x4 math (scalar reference code
+ * vs SIMD kernels) compared to single precision QMatrix4x4.
+ *
+ * Covers multiplication, mapping of points, lookAt(), translate(), fuzzy comparison
+ * (operator== with qgsDoubleNear) and conversions between float and double matrices.
+ * Each benchmark iteration processes a batch of BATCH matrices.
+ *
+ * Runs headless. Use "-csv" or "-o results.xml,xml" to get machine-readable output
+ * (the "benchmarks" build target writes CSV files to the build directory).
+ */
+
+#include <QtTest>
+#include <QMatrix4x4>
+#include <QRandomGenerator>
+
+#include "matrix4x4.h"
+#include "matrix4x4_p.h"
+
+// number of matrices processed by a single benchmark iteration
+static const int BATCH = 1024;
+
+
+class BenchMatrix4x4 : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void initTestCase();
+
+    void multiply_data();
+    void multiply();
+
+    void map_data();
+    void map();
+
+    void multiplyTranslation_data();
+    void multiplyTranslation();
+
+    void lookAt_data();
+    void lookAt();
+
+    void translate_data();
+    void translate();
+
+    void compare_data();
+    void compare();
+
+    void floatToDouble_data();
+    void floatToDouble();
+
+    void doubleToFloat_data();
+    void doubleToFloat();
+
+  private:
+    void addImplementationRows();
+    void addDoubleFloatRows( const QStringList &extraRows = QStringList() );
+
+    QVector<Matrix4x4> mA, mB, mOut;
+    QVector<Vector3D> mVectors, mVectorsOut;
+    QVector<double> mMapOut;        // BATCH results of map kernels, 4 doubles each
+    QVector<QMatrix4x4> mFloatA, mFloatB, mFloatOut;
+    QVector<QVector3D> mFloatVectors, mFloatVectorsOut;
+};
+
+
+Q_DECLARE_METATYPE( Matrix4x4Kernels::Isa )
+
+
+void BenchMatrix4x4::initTestCase()
+{
+    qInfo() << "Matrix4x4 kernels picked at runtime:" << Matrix4x4Kernels::isaName( Matrix4x4Kernels::bestIsa() );
+
+    // fixed seed so that all runs work with the same data
+    QRandomGenerator rng( 42 );
+    auto rnd = [&rng] { return rng.bounded( 2000.0 ) - 1000.0; };
+
+    for ( int i = 0; i < BATCH; ++i )
+    {
+        Matrix4x4 a, b;
+        float fa[16], fb[16];
+        for ( int j = 0; j < 16; ++j )
+        {
+            a.data()[j] = rnd();
+            b.data()[j] = rnd();
+            fa[j] = a.constData()[j];
+            fb[j] = b.constData()[j];
+        }
+        mA << a;
+        mB << b;
+        mVectors << Vector3D( rnd(), rnd(), rnd() );
+
+        // QMatrix4x4( const float * ) expects row-major data - but we only care about speed
+        mFloatA << QMatrix4x4( fa );
+        mFloatB << QMatrix4x4( fb );
+        mFloatVectors << mVectors.last().toVector3D();
+    }
+    mOut.resize( BATCH );
+    mVectorsOut.resize( BATCH );
+    mMapOut.resize( BATCH * 4 );
+    mFloatOut.resize( BATCH );
+    mFloatVectorsOut.resize( BATCH );
+}
+
+
+// Rows: "scalar", "sse2", "avx" (kernels called directly), "Matrix4x4" (public API
+// with the kernel picked at runtime) and "QMatrix4x4" (single precision for comparison)
+void BenchMatrix4x4::addImplementationRows()
+{
+    QTest::addColumn<QString>( "impl" );
+    QTest::addColumn<Matrix4x4Kernels::Isa>( "isa" );
+
+    for ( Matrix4x4Kernels::Isa isa : { Matrix4x4Kernels::Isa::Scalar, Matrix4x4Kernels::Isa::Sse2, Matrix4x4Kernels::Isa::Avx } )
+    {
+        if ( Matrix4x4Kernels::isSupported( isa ) )
+            QTest::newRow( Matrix4x4Kernels::isaName( isa ) ) << QString( Matrix4x4Kernels::isaName( isa ) ) << isa;
+    }
+    QTest::newRow( "Matrix4x4" ) << QStringLiteral( "Matrix4x4" ) << Matrix4x4Kernels::Isa::Scalar;
+    QTest::newRow( "QMatrix4x4" ) << QStringLiteral( "QMatrix4x4" ) << Matrix4x4Kernels::Isa::Scalar;
+}
+
+
+// Rows: "Matrix4x4" (public double precision API) and "QMatrix4x4" (its single precision equivalent)
+void BenchMatrix4x4::addDoubleFloatRows( const QStringList &extraRows )
+{
+    QTest::addColumn<QString>( "impl" );
+    QTest::newRow( "Matrix4x4" ) << QStringLiteral( "Matrix4x4" );
+    for ( const QString &row : extraRows )
+        QTest::newRow( row.toUtf8().constData() ) << row;
+    QTest::newRow( "QMatrix4x4" ) << QStringLiteral( "QMatrix4x4" );
+}
+
+
+void BenchMatrix4x4::multiply_data()
+{
+    addImplementationRows();
+}
+
+void BenchMatrix4x4::multiply()
+{
+    QFETCH( QString, impl );
+    QFETCH( Matrix4x4Kernels::Isa, isa );
+
+    if ( impl == QLatin1String( "QMatrix4x4" ) )
+    {
+        QBENCHMARK
+        {
+            for ( int i = 0; i < BATCH; ++i )
+                mFloatOut[i] = mFloatA[i] * mFloatB[i];
+        }
+    }
+    else if ( impl == QLatin1String( "Matrix4x4" ) )
+    {
+        QBENCHMARK
+        {
+            for ( int i = 0; i < BATCH; ++i )
+                mOut[i] = mA[i] * mB[i];
+        }
+    }
+    else
+    {
+        const Matrix4x4Kernels::MultiplyFunc kernel = Matrix4x4Kernels::multiplyKernel( isa );
+        QBENCHMARK
+        {
+            for ( int i = 0; i < BATCH; ++i )
+                kernel( mA[i].constData(), mB[i].constData(), mOut[i].data() );
+        }
+    }
+}
+
+
+void BenchMatrix4x4::map_data()
+{
+    addImplementationRows();
+}
+
+void BenchMatrix4x4::map()
+{
+    QFETCH( QString, impl );
+    QFETCH( Matrix4x4Kernels::Isa, isa );
+
+    if ( impl == QLatin1String( "QMatrix4x4" ) )
+    {
+        QBENCHMARK
+        {
+            for ( int i = 0; i < BATCH; ++i )
+                mFloatVectorsOut[i] = mFloatA[i].map( mFloatVectors[i] );
+        }
+    }
+    else if ( impl == QLatin1String( "Matrix4x4" ) )
+    {
+        QBENCHMARK
+        {
+            for ( int i = 0; i < BATCH; ++i )
+                mVectorsOut[i] = mA[i].map( mVectors[i] );
+        }
+    }
+    else
+    {
+        const Matrix4x4Kernels::MapFunc kernel = Matrix4x4Kernels::mapKernel( isa );
+        QBENCHMARK
+        {
+            for ( int i = 0; i < BATCH; ++i )
+            {
+                const double v[3] = { mVectors[i].x(), mVectors[i].y(), mVectors[i].z() };
+                kernel( mA[i].constData(), v, mMapOut.data() + i * 4 );
+            }
+        }
+    }
+}
+
+
+void BenchMatrix4x4::multiplyTranslation_data()
+{
+    QTest::addColumn<QString>( "impl" );
+    QTest::newRow( "Matrix4x4" ) << QStringLiteral( "Matrix4x4" );
+    QTest::newRow( "Matrix4x4 general" ) << QStringLiteral( "Matrix4x4 general" );
+    QTest::newRow( "QMatrix4x4" ) << QStringLiteral( "QMatrix4x4" );
+}
+
+// P*V multiplied by translation-only model matrices (the typical RTC case)
+void BenchMatrix4x4::multiplyTranslation()
+{
+    QFETCH( QString, impl );
+
+    QVector<Matrix4x4> models( BATCH );
+    QVector<QMatrix4x4> floatModels( BATCH );
+    for ( int i = 0; i < BATCH; ++i )
+    {
+        models[i].translate( mVectors[i] );
+        floatModels[i].translate( mFloatVectors[i] );
+        if ( impl == QLatin1String( "Matrix4x4 general" ) )
+            models[i].data();  // drop the type flags
+    }
+
+    if ( impl == QLatin1String( "QMatrix4x4" ) )
+    {
+        QBENCHMARK
+        {
+            for ( int i = 0; i < BATCH; ++i )
+                mFloatOut[i] = mFloatA[0] * floatModels[i];
+        }
+    }
+    else
+    {
+        QBENCHMARK
+        {
+            for ( int i = 0; i < BATCH; ++i )
+                mOut[i] = mA[0] * models[i];
+        }
+    }
+}
+
+
+
+void BenchMatrix4x4::lookAt_data()
+{
+    addDoubleFloatRows();
+}
+
+// view matrix of a camera looking at the origin from each of the points
+void BenchMatrix4x4::lookAt()
+{
+    QFETCH( QString, impl );
+
+    if ( impl == QLatin1String( "QMatrix4x4" ) )
+    {
+        QBENCHMARK
+        {
+            for ( int i = 0; i < BATCH; ++i )
+            {
+                QMatrix4x4 m;
+                m.lookAt( mFloatVectors[i], QVector3D(), QVector3D( 0, 0, 1 ) );
+                mFloatOut[i] = m;
+            }
+        }
+    }
+    else
+    {
+        QBENCHMARK
+        {
+            for ( int i = 0; i < BATCH; ++i )
+            {
+                Matrix4x4 m;
+                m.lookAt( mVectors[i], Vector3D(), Vector3D( 0, 0, 1 ) );
+                mOut[i] = m;
+            }
+        }
+    }
+}
+
+
+void BenchMatrix4x4::translate_data()
+{
+    addDoubleFloatRows( QStringList() << QStringLiteral( "Matrix4x4 translation" ) );
+}
+
+// translation of general matrices (and of translation-only matrices that take the fast path)
+void BenchMatrix4x4::translate()
+{
+    QFETCH( QString, impl );
+
+    if ( impl == QLatin1String( "QMatrix4x4" ) )
+    {
+        mFloatOut = mFloatA;
+        QBENCHMARK
+        {
+            for ( int i = 0; i < BATCH; ++i )
+                mFloatOut[i].translate( mFloatVectors[i] );
+        }
+    }
+    else
+    {
+        if ( impl == QLatin1String( "Matrix4x4 translation" ) )
+        {
+            for ( int i = 0; i < BATCH; ++i )
+                mOut[i].setToIdentity();
+        }
+        else
+            mOut = mA;
+
+        QBENCHMARK
+        {
+            for ( int i = 0; i < BATCH; ++i )
+                mOut[i].translate( mVectors[i] );
+        }
+    }
+}
+
+
+void BenchMatrix4x4::compare_data()
+{
+    addDoubleFloatRows( QStringList() << QStringLiteral( "QMatrix4x4 fuzzy" ) );
+}
+
+// comparison of equal matrices (the worst case - all 16 values need to be checked).
+// Matrix4x4 uses qgsDoubleNear(), QMatrix4x4 has exact operator== and fuzzy qFuzzyCompare()
+void BenchMatrix4x4::compare()
+{
+    QFETCH( QString, impl );
+
+    const QVector<Matrix4x4> copies = mA;
+    const QVector<QMatrix4x4> floatCopies = mFloatA;
+    qint64 equalCount = 0;
+
+    if ( impl == QLatin1String( "QMatrix4x4" ) )
+    {
+        QBENCHMARK
+        {
+            for ( int i = 0; i < BATCH; ++i )
+                equalCount += mFloatA[i] == floatCopies[i];
+        }
+    }
+    else if ( impl == QLatin1String( "QMatrix4x4 fuzzy" ) )
+    {
+        QBENCHMARK
+        {
+            for ( int i = 0; i < BATCH; ++i )
+                equalCount += qFuzzyCompare( mFloatA[i], floatCopies[i] );
+        }
+    }
+    else
+    {
+        QBENCHMARK
+        {
+            for ( int i = 0; i < BATCH; ++i )
+                equalCount += mA[i] == copies[i];
+        }
+    }
+
+    // also keeps the compiler from throwing the comparisons away
+    QVERIFY( equalCount > 0 && equalCount % BATCH == 0 );
+}
+
+
+void BenchMatrix4x4::floatToDouble_data()
+{
+    addDoubleFloatRows();
+}
+
+// floatToDoubleMatrix() vs plain copy of QMatrix4x4 (there is no conversion for floats)
+void BenchMatrix4x4::floatToDouble()
+{
+    QFETCH( QString, impl );
+
+    if ( impl == QLatin1String( "QMatrix4x4" ) )
+    {
+        QBENCHMARK
+        {
+            for ( int i = 0; i < BATCH; ++i )
+                mFloatOut[i] = mFloatA[i];
+        }
+    }
+    else
+    {
+        QBENCHMARK
+        {
+            for ( int i = 0; i < BATCH; ++i )
+                mOut[i] = floatToDoubleMatrix( mFloatA[i] );
+        }
+    }
+}
+
+
+void BenchMatrix4x4::doubleToFloat_data()
+{
+    addDoubleFloatRows();
+}
+
+// doubleToFloatMatrix() vs plain copy of QMatrix4x4 (there is no conversion for floats)
+void BenchMatrix4x4::doubleToFloat()
+{
+    QFETCH( QString, impl );
+
+    if ( impl == QLatin1String( "QMatrix4x4" ) )
+    {
+        QBENCHMARK
+        {
+            for ( int i = 0; i < BATCH; ++i )
+                mFloatOut[i] = mFloatA[i];
+        }
+    }
+    else
+    {
+        QBENCHMARK
+        {
+            for ( int i = 0; i < BATCH; ++i )
+                mFloatOut[i] = doubleToFloatMatrix( mA[i] );
+        }
+    }
+}
+
+
+QTEST_GUILESS_MAIN( BenchMatrix4x4 )
+
+#include "benchmatrix4x4.moc"
@@ -0,0 +1,156 @@
+/**
+ * Throughput benchmark of RtcVertexEncoder: conversion of double precision
+ * world coordinates to float vertex buffers relative to a center.
+ *
+ * Besides the usual QTest timings, each case prints its throughput
+ * in million points per second.
+ */
+
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+
+#include "rtcencoder.h"
+#include "rtcencoder_p.h"
+
+Q_DECLARE_METATYPE( Matrix4x4Kernels::Isa )
+
+
+class BenchRtcEncoder : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void initTestCase();
+
+    void encode_data();
+    void encode();
+
+    void encodeHighLow_data();
+    void encodeHighLow();
+
+    void boundingBoxCenter();
+
+  private:
+    static const qsizetype POINT_COUNT = 4 * 1024 * 1024;
+
+    QVector<double> mPositions;
+    QVector<float> mOutput;
+    QVector<float> mHighLowOutput;
+};
+
+
+void BenchRtcEncoder::initTestCase()
+{
+    // points of a 10 km tile somewhere on the Earth's surface (ECEF)
+    QRandomGenerator rng( 42 );
+    mPositions.resize( POINT_COUNT * 3 );
+    for ( qsizetype i = 0; i < POINT_COUNT; ++i )
+    {
+        mPositions[i * 3 + 0] = 1089205 + rng.bounded( 10000.0 );
+        mPositions[i * 3 + 1] = 932789 + rng.bounded( 10000.0 );
+        mPositions[i * 3 + 2] = 2009853 + rng.bounded( 10000.0 );
+    }
+    mOutput.resize( POINT_COUNT * 3 );
+    mHighLowOutput.resize( POINT_COUNT * 6 );
+}
+
+
+static void addKernelRows()
+{
+    QTest::addColumn<Matrix4x4Kernels::Isa>( "isa" );
+    QTest::addColumn<bool>( "parallel" );
+
+    for ( Matrix4x4Kernels::Isa isa : { Matrix4x4Kernels::Isa::Scalar, Matrix4x4Kernels::Isa::Sse2, Matrix4x4Kernels::Isa::Avx } )
+    {
+        if ( !Matrix4x4Kernels::isSupported( isa ) )
+            continue;
+        const QByteArray name( Matrix4x4Kernels::isaName( isa ) );
+        QTest::newRow( ( name + " single thread" ).constData() ) << isa << false;
+        QTest::newRow( ( name + " parallel" ).constData() ) << isa << true;
+    }
+}
+
+void BenchRtcEncoder::encode_data()
+{
+    addKernelRows();
+}
+
+void BenchRtcEncoder::encode()
+{
+    QFETCH( Matrix4x4Kernels::Isa, isa );
+    QFETCH( bool, parallel );
+
+    const Vector3D center = RtcVertexEncoder::boundingBoxCenter( mPositions.constData(), POINT_COUNT );
+    const double c[3] = { center.x(), center.y(), center.z() };
+
+    QElapsedTimer timer;
+    qint64 elapsedNs = 0;
+    qint64 runs = 0;
+
+    QBENCHMARK
+    {
+        timer.start();
+        if ( parallel )
+            RtcEncoderKernels::subtractCenterParallel( isa, mPositions.constData(), POINT_COUNT, c, mOutput.data() );
+        else
+            RtcEncoderKernels::subtractCenter( isa, mPositions.constData(), POINT_COUNT, c, mOutput.data() );
+        elapsedNs += timer.nsecsElapsed();
+        ++runs;
+    }
+
+    qInfo( "%s: %.1f Mpts/s", QTest::currentDataTag(), double( POINT_COUNT ) * runs / ( elapsedNs / 1e9 ) / 1e6 );
+}
+
+
+void BenchRtcEncoder::encodeHighLow_data()
+{
+    addKernelRows();
+}
+
+void BenchRtcEncoder::encodeHighLow()
+{
+    QFETCH( Matrix4x4Kernels::Isa, isa );
+    QFETCH( bool, parallel );
+
+    QElapsedTimer timer;
+    qint64 elapsedNs = 0;
+    qint64 runs = 0;
+
+    QBENCHMARK
+    {
+        timer.start();
+        if ( parallel )
+            RtcEncoderKernels::splitHighLowParallel( isa, mPositions.constData(), POINT_COUNT, mHighLowOutput.data() );
+        else
+            RtcEncoderKernels::splitHighLow( isa, mPositions.constData(), POINT_COUNT, mHighLowOutput.data() );
+        elapsedNs += timer.nsecsElapsed();
+        ++runs;
+    }
+
+    qInfo( "high/low %s: %.1f Mpts/s", QTest::currentDataTag(), double( POINT_COUNT ) * runs / ( elapsedNs / 1e9 ) / 1e6 );
+}
+
+
+void BenchRtcEncoder::boundingBoxCenter()
+{
+    QElapsedTimer timer;
+    qint64 elapsedNs = 0;
+    qint64 runs = 0;
+
+    QBENCHMARK
+    {
+        timer.start();
+        const Vector3D center = RtcVertexEncoder::boundingBoxCenter( mPositions.constData(), POINT_COUNT );
+        Q_UNUSED( center )
+        elapsedNs += timer.nsecsElapsed();
+        ++runs;
+    }
+
+    qInfo( "boundingBoxCenter: %.1f Mpts/s", double( POINT_COUNT ) * runs / ( elapsedNs / 1e9 ) / 1e6 );
+}
+
+
+QTEST_GUILESS_MAIN( BenchRtcEncoder )
+
+#include "benchrtcencoder.moc"
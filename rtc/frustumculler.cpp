@@ -0,0 +1,181 @@
+#include "frustumculler.h"
+#include "matrix4x4_p.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <QVector>
+#include <QtConcurrent/QtConcurrentMap>
+
+// spheres tested by a single task when running in parallel
+static const qsizetype CHUNK_SIZE = 16 * 1024;
+
+
+FrustumCuller::FrustumCuller( const Matrix4x4 &viewProjectionMatrix )
+{
+  // Gribb-Hartmann plane extraction: planes are combinations of the last row with other rows
+  const Matrix4x4 &m = viewProjectionMatrix;
+  for ( int i = 0; i < 3; ++i )
+  {
+    for ( int col = 0; col < 4; ++col )
+    {
+      mPlanes[i * 2][col] = m( 3, col ) + m( i, col );      // left, bottom, near
+      mPlanes[i * 2 + 1][col] = m( 3, col ) - m( i, col );  // right, top, far
+    }
+  }
+
+  // normalize so that plane equation gives signed distance
+  for ( double *plane : mPlanes )
+  {
+    const double len = std::sqrt( plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2] );
+    if ( len > 0 )
+    {
+      for ( int col = 0; col < 4; ++col )
+        plane[col] /= len;
+    }
+  }
+}
+
+bool FrustumCuller::isSphereVisible( const Vector3D &center, double radius ) const
+{
+  for ( const double *plane : mPlanes )
+  {
+    if ( plane[0] * center.x() + plane[1] * center.y() + plane[2] * center.z() + plane[3] < -radius )
+      return false;
+  }
+  return true;
+}
+
+
+namespace
+{
+
+  void cullSpheresScalar( const double ( *planes )[4], const double *cx, const double *cy, const double *cz, const double *r,
+                          qsizetype count, quint8 *visible )
+  {
+    for ( qsizetype i = 0; i < count; ++i )
+    {
+      bool inside = true;
+      for ( int p = 0; p < 6 && inside; ++p )
+      {
+        const double *plane = planes[p];
+        inside = plane[0] * cx[i] + plane[1] * cy[i] + plane[2] * cz[i] + plane[3] >= -r[i];
+      }
+      visible[i] = inside ? 1 : 0;
+    }
+  }
+
+#ifdef CPU_HAS_SSE2
+
+  // 2 spheres per iteration
+
+  void cullSpheresSse2( const double ( *planes )[4], const double *cx, const double *cy, const double *cz, const double *r,
+                        qsizetype count, quint8 *visible )
+  {
+    qsizetype i = 0;
+    for ( ; i + 2 <= count; i += 2 )
+    {
+      const __m128d x = _mm_loadu_pd( cx + i );
+      const __m128d y = _mm_loadu_pd( cy + i );
+      const __m128d z = _mm_loadu_pd( cz + i );
+      const __m128d negRadius = _mm_sub_pd( _mm_setzero_pd(), _mm_loadu_pd( r + i ) );
+
+      __m128d inside = _mm_castsi128_pd( _mm_set1_epi32( -1 ) );
+      for ( int p = 0; p < 6; ++p )
+      {
+        const double *plane = planes[p];
+        __m128d dist = _mm_mul_pd( x, _mm_set1_pd( plane[0] ) );
+        dist = _mm_add_pd( dist, _mm_mul_pd( y, _mm_set1_pd( plane[1] ) ) );
+        dist = _mm_add_pd( dist, _mm_mul_pd( z, _mm_set1_pd( plane[2] ) ) );
+        dist = _mm_add_pd( dist, _mm_set1_pd( plane[3] ) );
+        inside = _mm_and_pd( inside, _mm_cmpge_pd( dist, negRadius ) );
+      }
+      const int mask = _mm_movemask_pd( inside );
+      visible[i] = mask & 1;
+      visible[i + 1] = ( mask >> 1 ) & 1;
+    }
+    cullSpheresScalar( planes, cx + i, cy + i, cz + i, r + i, count - i, visible + i );
+  }
+
+#endif
+
+#ifdef CPU_HAS_AVX
+
+  // 4 spheres per iteration
+
+  CPU_TARGET_AVX
+  void cullSpheresAvx( const double ( *planes )[4], const double *cx, const double *cy, const double *cz, const double *r,
+                       qsizetype count, quint8 *visible )
+  {
+    qsizetype i = 0;
+    for ( ; i + 4 <= count; i += 4 )
+    {
+      const __m256d x = _mm256_loadu_pd( cx + i );
+      const __m256d y = _mm256_loadu_pd( cy + i );
+      const __m256d z = _mm256_loadu_pd( cz + i );
+      const __m256d negRadius = _mm256_sub_pd( _mm256_setzero_pd(), _mm256_loadu_pd( r + i ) );
+
+      int mask = 0xf;
+      for ( int p = 0; p < 6 && mask; ++p )
+      {
+        const double *plane = planes[p];
+        __m256d dist = _mm256_mul_pd( x, _mm256_broadcast_sd( plane + 0 ) );
+        dist = _mm256_add_pd( dist, _mm256_mul_pd( y, _mm256_broadcast_sd( plane + 1 ) ) );
+        dist = _mm256_add_pd( dist, _mm256_mul_pd( z, _mm256_broadcast_sd( plane + 2 ) ) );
+        dist = _mm256_add_pd( dist, _mm256_broadcast_sd( plane + 3 ) );
+        mask &= _mm256_movemask_pd( _mm256_cmp_pd( dist, negRadius, _CMP_GE_OQ ) );
+      }
+      for ( int j = 0; j < 4; ++j )
+        visible[i + j] = ( mask >> j ) & 1;
+    }
+    cullSpheresScalar( planes, cx + i, cy + i, cz + i, r + i, count - i, visible + i );
+  }
+
+#endif
+
+  typedef void ( *CullFunc )( const double ( *planes )[4], const double *, const double *, const double *, const double *, qsizetype, quint8 * );
+
+  CullFunc cullKernel()
+  {
+    static const CullFunc f = []() -> CullFunc
+    {
+      switch ( Matrix4x4Kernels::bestIsa() )
+      {
+#ifdef CPU_HAS_AVX
+        case Matrix4x4Kernels::Isa::Avx:
+          return cullSpheresAvx;
+#endif
+#ifdef CPU_HAS_SSE2
+        case Matrix4x4Kernels::Isa::Sse2:
+          return cullSpheresSse2;
+#endif
+        default:
+          return cullSpheresScalar;
+      }
+    }();
+    return f;
+  }
+
+}
+
+
+void FrustumCuller::cullSpheres( const double *centerX, const double *centerY, const double *centerZ, const double *radius,
+                                 qsizetype count, quint8 *visible ) const
+{
+  const CullFunc kernel = cullKernel();
+  if ( count <= CHUNK_SIZE )
+  {
+    kernel( mPlanes, centerX, centerY, centerZ, radius, count, visible );
+    return;
+  }
+
+  QVector<qsizetype> chunks;
+  for ( qsizetype begin = 0; begin < count; begin += CHUNK_SIZE )
+    chunks.append( begin );
+
+  QtConcurrent::blockingMap( chunks, [ = ]( qsizetype begin )
+  {
+    const qsizetype n = std::min( CHUNK_SIZE, count - begin );
+    kernel( mPlanes, centerX + begin, centerY + begin, centerZ + begin, radius + begin, n, visible + begin );
+  } );
+}
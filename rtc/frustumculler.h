@@ -0,0 +1,42 @@
+#ifndef FRUSTUMCULLER_H
+#define FRUSTUMCULLER_H
+
+#include <QtGlobal>
+
+#include "matrix4x4.h"
+
+/**
+ * Double precision view frustum culling of bounding spheres.
+ *
+ * The six frustum planes are extracted from a (double precision) projection * view
+ * matrix, so culling works even with huge world coordinates where Qt3D's own
+ * single precision culling would be unreliable.
+ *
+ * Spheres are given as structure-of-arrays (separate arrays for x, y, z of centers
+ * and radii), which lets the plane tests run on several spheres at once with SIMD.
+ */
+class FrustumCuller
+{
+  public:
+    //! Constructs culler for the given projection * view matrix
+    explicit FrustumCuller( const Matrix4x4 &viewProjectionMatrix );
+
+    //! Returns whether a sphere is at least partially inside the frustum
+    bool isSphereVisible( const Vector3D &center, double radius ) const;
+
+    /**
+     * Tests \a count spheres (centers in \a centerX, \a centerY, \a centerZ and
+     * radii in \a radius arrays) and writes 1 for visible and 0 for culled spheres
+     * to \a visible. Large inputs are split into chunks that run in parallel.
+     */
+    void cullSpheres( const double *centerX, const double *centerY, const double *centerZ, const double *radius,
+                      qsizetype count, quint8 *visible ) const;
+
+    //! Returns planes as [a, b, c, d] quadruples (normals point inside, normalized)
+    const double *planes() const { return *mPlanes; }
+
+  private:
+    double mPlanes[6][4];
+};
+
+#endif // FRUSTUMCULLER_H
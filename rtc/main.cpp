@@ -12,13 +12,21 @@
  * - all our materials have a "my_mvp" uniform, that contains MVP matrix we have
  *   calculated ourselves using MyTransform and MyCamera
  * - on any change of camera's transform or model's transform, we need to update
- *   my_mvp uniform in the materials accordingly
+ *   my_mvp uniform in the materials accordingly (done once per frame, only for
+ *   the entities that need it)
+ * - frustum culling is done on the CPU in double precision as well (FrustumCuller):
+ *   entities out of view get disabled and their MVP is not calculated
  * 
  * The test scene is just a sphere and two planes partially intersecting the sphere,
  * all moved far away from the scene's origin (see "megaOffset" variable) to
  * demonstrate the issue with large coordinates, and how that creates jitter
  * (especially when the animation is started by pressing SPACE)
  * 
+ * There is also a yellow ring drawn with the "GPU relative to eye" (RTE) variant:
+ * its vertices are kept in world coordinates split into high and low floats,
+ * and the vertex shader subtracts camera position (split the same way), so there
+ * is no per-entity MVP matrix to update (see rte.vert and RtcVertexEncoder)
+ *
  * Check out rtc.py in this directory if you are just after the math bits.
  * 
  * For more see:
@@ -42,6 +50,8 @@
 #include <Qt3DExtras/QPlaneMesh>
 #include <Qt3DExtras/QPhongMaterial>
 #include <Qt3DExtras/QForwardRenderer>
+#include <Qt3DLogic/QFrameAction>
+#include <Qt3DRender/QGeometryRenderer>
 #include <Qt3DRender/QParameter>
 #include <Qt3DRender/QMaterial>
 #include <Qt3DRender/QTechnique>
@@ -56,6 +66,9 @@
 
 #include "vector3d.h"
 #include "matrix4x4.h"
+#include "transformstore.h"
+#include "rtcencoder.h"
+#include "rtegeometry.h"
 
 
 // comment out to see how things would behave with single precision math
@@ -66,12 +79,12 @@ QTimer *timer;
 int counter = 0;
 
 
-Qt3DRender::QMaterial* basicMaterial( QColor color, Qt3DRender::QParameter **pParamMvp )
+Qt3DRender::QMaterial* shaderMaterial( const QString &vertexShaderUrl, const QList<Qt3DRender::QParameter *> &parameters )
 {
     Qt3DRender::QMaterial *material = new Qt3DRender::QMaterial();
 
     Qt3DRender::QShaderProgram* shaderProgram = new Qt3DRender::QShaderProgram();
-    shaderProgram->setVertexShaderCode(Qt3DRender::QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/basic.vert"))));
+    shaderProgram->setVertexShaderCode(Qt3DRender::QShaderProgram::loadSource(QUrl(vertexShaderUrl)));
     shaderProgram->setFragmentShaderCode(Qt3DRender::QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/basic.frag"))));
 
     Qt3DRender::QRenderPass *renderPass = new Qt3DRender::QRenderPass();
@@ -89,10 +102,8 @@ Qt3DRender::QMaterial* basicMaterial( QColor color, Qt3DRender::QParameter **pPa
     filterKey->setValue( QStringLiteral( "forward" ) );
     technique->addFilterKey( filterKey );
 
-    technique->addParameter( new Qt3DRender::QParameter( QStringLiteral( "color" ), color ) );
-
-    *pParamMvp = new Qt3DRender::QParameter( QStringLiteral( "my_mvp" ), QMatrix4x4() );
-    technique->addParameter( *pParamMvp );
+    for ( Qt3DRender::QParameter *parameter : parameters )
+        technique->addParameter( parameter );
 
     Qt3DRender::QEffect* effect = new Qt3DRender::QEffect();
     effect->addTechnique(technique);
@@ -101,26 +112,33 @@ Qt3DRender::QMaterial* basicMaterial( QColor color, Qt3DRender::QParameter **pPa
 }
 
 
-
-Matrix4x4 floatToDoubleMatrix( QMatrix4x4 m )
+Qt3DRender::QMaterial* basicMaterial( QColor color, Qt3DRender::QParameter **pParamMvp )
 {
-    Matrix4x4 out;
-    double *outData = out.data();
-    const float *mData = m.constData();
-    for ( int i = 0; i < 16; ++i )
-        outData[i] = mData[i];  // conversion float->double
-    return out;
+    *pParamMvp = new Qt3DRender::QParameter( QStringLiteral( "my_mvp" ), QMatrix4x4() );
+
+    return shaderMaterial( QStringLiteral("qrc:/basic.vert"), {
+        new Qt3DRender::QParameter( QStringLiteral( "color" ), color ),
+        *pParamMvp } );
 }
 
 
-QMatrix4x4 doubleToFloatMatrix( Matrix4x4 m )
+// uniforms of materials using "GPU relative to eye" (rte.vert) - shared by all
+// such materials, as they only depend on the camera
+struct RteParameters
 {
-    QMatrix4x4 out;
-    float *outData = out.data();
-    const double *mData = m.constData();
-    for ( int i = 0; i < 16; ++i )
-        outData[i] = mData[i];  // conversion double->float
-    return out;
+    Qt3DRender::QParameter *eyeHigh = new Qt3DRender::QParameter( QStringLiteral( "camera_eye_high" ), QVector3D() );
+    Qt3DRender::QParameter *eyeLow = new Qt3DRender::QParameter( QStringLiteral( "camera_eye_low" ), QVector3D() );
+    Qt3DRender::QParameter *mvpRte = new Qt3DRender::QParameter( QStringLiteral( "my_mvp_rte" ), QMatrix4x4() );
+    quint64 cameraVersion = 0;  // camera version used for the last update
+    bool initialized = false;
+};
+
+
+Qt3DRender::QMaterial* rteMaterial( QColor color, RteParameters *rteParams )
+{
+    return shaderMaterial( QStringLiteral("qrc:/rte.vert"), {
+        new Qt3DRender::QParameter( QStringLiteral( "color" ), color ),
+        rteParams->eyeHigh, rteParams->eyeLow, rteParams->mvpRte } );
 }
 
 
@@ -151,17 +169,32 @@ Qt3DRender::QFrameGraphNode * myFrameGraph()
 
 
 // Our double precision 4x4 transform (replaces QTransform from Qt3D)
+// The matrix itself lives in the transform store, so that all model matrices
+// are kept together in one array
 class MyTransform : public Qt3DCore::QComponent {
 
   public:
+    MyTransform( TransformStore *store, Qt3DRender::QParameter *paramMvp )
+        : m_store( store ), m_index( store->addEntity( paramMvp ) ) {}
+
     void setTranslation( Vector3D t ) {
-        m_matrix4x4.translate( t );
+        m_store->translate( m_index, t );
+    }
+
+    Matrix4x4 matrix() const { return m_store->modelMatrix( m_index ); }
+
+    // the entity gets disabled whenever the bounding sphere (in model coordinates) is outside of the view
+    void setCulling( Qt3DCore::QEntity *entity, double boundingRadius ) {
+        m_store->setEntity( m_index, entity );
+        m_store->setBoundingSphere( m_index, Vector3D(), boundingRadius );
     }
-    
-    Matrix4x4 matrix() const { return m_matrix4x4; }
+
+    // incremented whenever the matrix changes
+    quint64 version() const { return m_store->version( m_index ); }
 
   private:
-    Matrix4x4 m_matrix4x4;
+    TransformStore *m_store;
+    int m_index;
 };
 
 
@@ -188,6 +221,7 @@ class MyCamera
             0, 0, -(m_near + m_far) / clip, -(2.0f * m_near * m_far) / clip,
             0, 0, -1, 0
             );
+        ++m_version;
     }
 
     void setDouble( Vector3D position, Vector3D viewCenter ) {
@@ -213,14 +247,25 @@ class MyCamera
         // this pretty much figures our rotation from the vectors + applies negative translation of "position"
         Matrix4x4 viewMatrix;
         viewMatrix.lookAt(position, viewCenter, upVector);
+        if (viewMatrix == m_viewMatrix4x4)
+            return;
         m_viewMatrix4x4 = viewMatrix;
+        m_position = position;
+        ++m_version;
     }
 
     void setAspectRatio(float aspectRatio) {
+        if (aspectRatio == m_aspectRatio)
+            return;
         m_aspectRatio = aspectRatio;
         updateProjectionMatrix();
     }
 
+    // incremented whenever projection or view matrix changes
+    quint64 version() const {
+        return m_version;
+    }
+
     Matrix4x4 projectionMatrix() const {
         return m_projectionMatrix;
     }
@@ -229,6 +274,25 @@ class MyCamera
         return m_viewMatrix4x4;
     }
 
+    // for "GPU relative to eye": projection * view matrix without the translation
+    // (the vertex shader subtracts the camera position from vertex positions)
+    Matrix4x4 rteViewProjectionMatrix() const {
+        Matrix4x4 viewRotation = m_viewMatrix4x4;
+        double *data = viewRotation.data();
+        data[12] = data[13] = data[14] = 0;
+        viewRotation.optimize();
+        return m_projectionMatrix * viewRotation;
+    }
+
+    // updates uniforms of materials using rte.vert (camera position split to high/low floats)
+    void updateRteParameters( Qt3DRender::QParameter *paramEyeHigh, Qt3DRender::QParameter *paramEyeLow, Qt3DRender::QParameter *paramMvpRte ) const {
+        QVector3D eyeHigh, eyeLow;
+        RtcVertexEncoder::splitHighLow( m_position, eyeHigh, eyeLow );
+        paramEyeHigh->setValue( eyeHigh );
+        paramEyeLow->setValue( eyeLow );
+        paramMvpRte->setValue( doubleToFloatMatrix( rteViewProjectionMatrix() ) );
+    }
+
     float m_near = 0.1;
     float m_far = 1024;
     float m_fovAngleVertical = 25;  // in degrees
@@ -236,66 +300,25 @@ class MyCamera
 
     Matrix4x4 m_projectionMatrix;
     Matrix4x4 m_viewMatrix4x4;
+    Vector3D m_position;
+    quint64 m_version = 0;
 };
 
 
 
-void updateMvp( MyCamera *camera, MyTransform *transform, Qt3DRender::QParameter *paramMvp )
+// updates MVP matrix in the material of all entities that need it
+// (called once per frame - all changes since the last frame get coalesced)
+void updateAllMvp( MyCamera *camera, TransformStore *store, RteParameters *rteParams )
 {
-#ifdef USE_DOUBLE
-
-    // GOOD: using doubles
-
-    Matrix4x4 P = camera->projectionMatrix();
-    Matrix4x4 V = camera->viewMatrix();
-    Matrix4x4 M = transform->matrix();
-    qDebug() << "P" << P;
-    qDebug() << "M" << M;
-    qDebug() << "V" << V;
-
-    // approach A: simpler (in my opinion)
-    Matrix4x4 MV = V * M;
-    qDebug() << "MV" << MV;
-    Matrix4x4 MVP = P * MV;
-    paramMvp->setValue( doubleToFloatMatrix( MVP ) );
-
-    // approach B: as described in the virtual globes book
-    //Vector3D centerWgs = Vector3D(1089205, 932789, 2009853); // TODO - center of this entity - could be our megaOffset
-    //Vector3D centerEye = MV.map(centerWgs);
-    //Matrix4x4 MV_RTC = MV;
-    //MV_RTC.data()[12] = centerEye.x();
-    //MV_RTC.data()[13] = centerEye.y();
-    //MV_RTC.data()[14] = centerEye.z();
-    //qDebug() << "MV_RTC" << MV_RTC;
-    //Matrix4x4 MVP_RTC = P * MV_RTC;
-    //paramMvp->setValue( doubleToFloatMatrix( MVP_RTC ) );
-
-    // verification that both approaches A and B give the same result
-    //Vector3D testPt(1089205, 932785, 2009853);
-    //qDebug() << "final mvp pt:" << MV.map(testPt);
-    //qDebug() << "final rtc pt:" << MV_RTC.map(testPt);
-
-#else
-
-    // BAD: using floating point arithmetics
-
-    QMatrix4x4 P = doubleToFloatMatrix( camera->projectionMatrix() );
-    QMatrix4x4 V = doubleToFloatMatrix( camera->viewMatrix() );
-    QMatrix4x4 M = doubleToFloatMatrix( transform->matrix() );
-    QMatrix4x4 MV = V * M;
-    QMatrix4x4 MVP = P * MV;
-    qDebug() << "MVP" << MVP;
-    paramMvp->setValue( MVP );
-#endif
-}
+    if ( store->needsUpdate( camera->version() ) )
+        store->updateMvp( camera->projectionMatrix(), camera->viewMatrix(), camera->version() );
 
-
-// updates MVP matrix in the material of all entities
-void updateAllMvp( MyCamera *camera, QList< QPair< MyTransform*, Qt3DRender::QParameter *> > lst )
-{
-    for ( auto pair : lst )
+    // "GPU relative to eye" entities only need the camera uniforms updated
+    if ( !rteParams->initialized || rteParams->cameraVersion != camera->version() )
     {
-        updateMvp(camera, pair.first, pair.second);
+        camera->updateRteParameters( rteParams->eyeHigh, rteParams->eyeLow, rteParams->mvpRte );
+        rteParams->cameraVersion = camera->version();
+        rteParams->initialized = true;
     }
 }
 
@@ -358,6 +381,9 @@ int main(int argc, char *argv[]) {
     Qt3DRender::QMaterial *materialGreen = basicMaterial(Qt::green, &paramMvpGreen);
     Qt3DRender::QMaterial *materialBlue = basicMaterial(Qt::blue, &paramMvpBlue);
 
+    RteParameters *rteParams = new RteParameters;
+    Qt3DRender::QMaterial *materialRte = rteMaterial(Qt::yellow, rteParams);
+
     // transforms
 
     //Vector3D megaOffset(0, 0, 0);
@@ -367,13 +393,18 @@ int main(int argc, char *argv[]) {
 
     float animationRange = 0.1;
 
-    MyTransform *sphereTransform = new MyTransform;
+    TransformStore *store = new TransformStore;
+#ifndef USE_DOUBLE
+    store->setUseDoublePrecision( false );
+#endif
+
+    MyTransform *sphereTransform = new MyTransform(store, paramMvpRed);
     sphereTransform->setTranslation(Vector3D(0.0, 0.0, 0.0) + megaOffset);
 
-    MyTransform *planeATransform = new MyTransform;
+    MyTransform *planeATransform = new MyTransform(store, paramMvpGreen);
     planeATransform->setTranslation(Vector3D(-0.51, 1.98, 0.0) + megaOffset);
 
-    MyTransform *planeBTransform = new MyTransform;
+    MyTransform *planeBTransform = new MyTransform(store, paramMvpBlue);
     planeBTransform->setTranslation(Vector3D(+0.51, 1.98, 0.0) + megaOffset);
 
     // scene
@@ -395,15 +426,37 @@ int main(int argc, char *argv[]) {
     planeBEntity->addComponent(materialBlue);
     planeBEntity->addComponent(planeBTransform);
 
-    //
+    // frustum culling is done by the transform store in double precision
+    // (plane meshes are 1x1 by default)
+    sphereTransform->setCulling(sphereEntity, sphereMesh->radius());
+    planeATransform->setCulling(planeAEntity, M_SQRT1_2);
+    planeBTransform->setCulling(planeBEntity, M_SQRT1_2);
+
+    // a ring around the sphere drawn using "GPU relative to eye": its vertices are
+    // in world coordinates (split to high/low floats), no transform or MVP per entity
+    const int ringVertexCount = 360;
+    QVector<double> ringPositions;
+    for ( int i = 0; i < ringVertexCount; ++i )
+    {
+        const double angle = 2 * M_PI * i / ringVertexCount;
+        ringPositions << megaOffset.x() + 3 * cos(angle) << megaOffset.y() << megaOffset.z() + 3 * sin(angle);
+    }
+    RteGeometry *ringGeometry = new RteGeometry;
+    ringGeometry->setPositions(ringPositions.constData(), ringVertexCount);
 
-    QList< QPair< MyTransform*, Qt3DRender::QParameter *> > allEntities;
-    allEntities << qMakePair(sphereTransform, paramMvpRed);
-    allEntities << qMakePair(planeATransform, paramMvpGreen);
-    allEntities << qMakePair(planeBTransform, paramMvpBlue);
+    Qt3DRender::QGeometryRenderer *ringRenderer = new Qt3DRender::QGeometryRenderer;
+    ringRenderer->setPrimitiveType(Qt3DRender::QGeometryRenderer::LineLoop);
+    ringRenderer->setGeometry(ringGeometry);
+    ringRenderer->setVertexCount(ringGeometry->vertexCount());
+
+    Qt3DCore::QEntity *ringEntity = new Qt3DCore::QEntity(rootEntity);
+    ringEntity->addComponent(ringRenderer);
+    ringEntity->addComponent(materialRte);
 
     // set up frame graph
-    // (like a frame graph from QForwardRenderer, but without frustum culling + camera selector)
+    // (like a frame graph from QForwardRenderer, but without frustum culling + camera selector:
+    // Qt3D's culling would use its own single precision camera, so we cull entities ourselves
+    // in double precision in the transform store and disable those that are not visible)
 
     view->setActiveFrameGraph( myFrameGraph() );
 
@@ -413,13 +466,19 @@ int main(int argc, char *argv[]) {
     //myCamera->setParent(rootEntity);
     myCamera->setAspectRatio(float(view->width()) / std::max(1.f, static_cast<float>(view->height())));
 
-    QObject::connect( view, &QWindow::widthChanged, [view, myCamera, allEntities] {
+    // changes of camera or transforms only bump their versions - the actual
+    // MVP update is done at most once per frame by the frame action
+    QObject::connect( view, &QWindow::widthChanged, [view, myCamera] {
         myCamera->setAspectRatio(float(view->width()) / std::max(1.f, static_cast<float>(view->height())));
-        updateAllMvp(myCamera, allEntities);
     });
-    QObject::connect( view, &QWindow::heightChanged, [view, myCamera, allEntities] {
+    QObject::connect( view, &QWindow::heightChanged, [view, myCamera] {
         myCamera->setAspectRatio(float(view->width()) / std::max(1.f, static_cast<float>(view->height())));
-        updateAllMvp(myCamera, allEntities);
+    });
+
+    Qt3DLogic::QFrameAction *frameAction = new Qt3DLogic::QFrameAction;
+    rootEntity->addComponent(frameAction);
+    QObject::connect( frameAction, &Qt3DLogic::QFrameAction::triggered, [myCamera, store, rteParams] {
+        updateAllMvp(myCamera, store, rteParams);
     });
 
     // Setup camera
@@ -429,21 +488,19 @@ int main(int argc, char *argv[]) {
     cameraBaseViewCenter = cameraBaseViewCenter + megaOffset;
     myCamera->setDouble( cameraBasePosition, cameraBaseViewCenter );
 
-    updateAllMvp(myCamera, allEntities);
+    updateAllMvp(myCamera, store, rteParams);
 
     // Add root entity to scene
     view->setRootEntity(rootEntity);
 
     view->show();
 
-    QObject::connect( timer, &QTimer::timeout, [myCamera, allEntities, animationRange, cameraBasePosition, cameraBaseViewCenter] {
+    QObject::connect( timer, &QTimer::timeout, [myCamera, animationRange, cameraBasePosition, cameraBaseViewCenter] {
         ++counter;
         double t = (double) (counter % 50) / 50.;
         Vector3D tOffset(sin(t*3.14159*2) * animationRange, 0, cos(t*3.14159*2) * animationRange);
 
         myCamera->setDouble( cameraBasePosition + tOffset, cameraBaseViewCenter + tOffset );
-
-        updateAllMvp(myCamera, allEntities);
     });
 
     return app.exec();
@@ -1,5 +1,8 @@
 
 #include "matrix4x4.h"
+#include "matrix4x4_p.h"
+
+#include <algorithm>
 
 // the implementation is partially based on Qt's QMatrix4x4 (simplified)
 
@@ -13,14 +16,39 @@ Matrix4x4::Matrix4x4( double m11, double m12, double m13, double m14,
   m[1][0] = m12; m[1][1] = m22; m[1][2] = m32; m[1][3] = m42;
   m[2][0] = m13; m[2][1] = m23; m[2][2] = m33; m[2][3] = m43;
   m[3][0] = m14; m[3][1] = m24; m[3][2] = m34; m[3][3] = m44;
+  optimize();
 }
 
 void Matrix4x4::translate( const Vector3D &vector )
 {
+  if ( isTranslation() )
+  {
+    // the upper-left 3x3 part is identity and the last row is [0, 0, 0, 1]
+    m[3][0] += vector.x();
+    m[3][1] += vector.y();
+    m[3][2] += vector.z();
+    flagBits |= Translation;
+    return;
+  }
+
   m[3][0] += m[0][0] * vector.x() + m[1][0] * vector.y() + m[2][0] * vector.z();
   m[3][1] += m[0][1] * vector.x() + m[1][1] * vector.y() + m[2][1] * vector.z();
   m[3][2] += m[0][2] * vector.x() + m[1][2] * vector.y() + m[2][2] * vector.z();
   m[3][3] += m[0][3] * vector.x() + m[1][3] * vector.y() + m[2][3] * vector.z();
+  flagBits |= Translation;
+}
+
+void Matrix4x4::optimize()
+{
+  flagBits = Identity;
+  if ( m[0][3] != 0.0 || m[1][3] != 0.0 || m[2][3] != 0.0 || m[3][3] != 1.0 )
+    flagBits |= Perspective;
+  if ( m[3][0] != 0.0 || m[3][1] != 0.0 || m[3][2] != 0.0 )
+    flagBits |= Translation;
+  if ( m[0][0] != 1.0 || m[0][1] != 0.0 || m[0][2] != 0.0 ||
+       m[1][0] != 0.0 || m[1][1] != 1.0 || m[1][2] != 0.0 ||
+       m[2][0] != 0.0 || m[2][1] != 0.0 || m[2][2] != 1.0 )
+    flagBits |= Linear;
 }
 
 #if 0
@@ -38,32 +66,38 @@ QList< double > Matrix4x4::dataList() const
 
 Vector3D operator*( const Matrix4x4 &matrix, const Vector3D &vector )
 {
-  double x, y, z, w;
-
-  x = vector.x() * matrix.m[0][0] +
-      vector.y() * matrix.m[1][0] +
-      vector.z() * matrix.m[2][0] +
-      matrix.m[3][0];
-  y = vector.x() * matrix.m[0][1] +
-      vector.y() * matrix.m[1][1] +
-      vector.z() * matrix.m[2][1] +
-      matrix.m[3][1];
-  z = vector.x() * matrix.m[0][2] +
-      vector.y() * matrix.m[1][2] +
-      vector.z() * matrix.m[2][2] +
-      matrix.m[3][2];
-  w = vector.x() * matrix.m[0][3] +
-      vector.y() * matrix.m[1][3] +
-      vector.z() * matrix.m[2][3] +
-      matrix.m[3][3];
-  if ( w == 1.0f )
-    return Vector3D( x, y, z );
+  if ( matrix.flagBits == Matrix4x4::Identity )
+  {
+    return vector;
+  }
+  else if ( matrix.flagBits == Matrix4x4::Translation )
+  {
+    return Vector3D( vector.x() + matrix.m[3][0],
+                     vector.y() + matrix.m[3][1],
+                     vector.z() + matrix.m[3][2] );
+  }
+  else if ( matrix.isAffine() )
+  {
+    // w is always 1 - no need to calculate it and divide
+    return Vector3D( vector.x() * matrix.m[0][0] + vector.y() * matrix.m[1][0] + vector.z() * matrix.m[2][0] + matrix.m[3][0],
+                     vector.x() * matrix.m[0][1] + vector.y() * matrix.m[1][1] + vector.z() * matrix.m[2][1] + matrix.m[3][1],
+                     vector.x() * matrix.m[0][2] + vector.y() * matrix.m[1][2] + vector.z() * matrix.m[2][2] + matrix.m[3][2] );
+  }
+
+  const double v[3] = { vector.x(), vector.y(), vector.z() };
+  double r[4];
+  Matrix4x4Kernels::map()( *matrix.m, v, r );
+
+  if ( r[3] == 1.0 )
+    return Vector3D( r[0], r[1], r[2] );
   else
-    return Vector3D( x / w, y / w, z / w );
+    return Vector3D( r[0] / r[3], r[1] / r[3], r[2] / r[3] );
 }
 
 bool Matrix4x4::isIdentity() const
 {
+  if ( flagBits == Identity )
+    return true;
   if ( m[0][0] != 1.0 || m[0][1] != 0.0 || m[0][2] != 0.0 )
     return false;
   if ( m[0][3] != 0.0 || m[1][0] != 0.0 || m[1][1] != 1.0 )
@@ -95,79 +129,66 @@ void Matrix4x4::setToIdentity()
   m[3][1] = 0.0;
   m[3][2] = 0.0;
   m[3][3] = 1.0;
+  flagBits = Identity;
 }
 
 
 Matrix4x4 operator*( const Matrix4x4 &m1, const Matrix4x4 &m2 )
 {
+  // Note: the fast paths give the same results as the full product (they only
+  // skip multiplications by zero and one)
+
+  if ( m1.flagBits == Matrix4x4::Identity )
+    return m2;
+  if ( m2.flagBits == Matrix4x4::Identity )
+    return m1;
+
   Matrix4x4 m( 1 );
-  m.m[0][0] = m1.m[0][0] * m2.m[0][0]
-              + m1.m[1][0] * m2.m[0][1]
-              + m1.m[2][0] * m2.m[0][2]
-              + m1.m[3][0] * m2.m[0][3];
-  m.m[0][1] = m1.m[0][1] * m2.m[0][0]
-              + m1.m[1][1] * m2.m[0][1]
-              + m1.m[2][1] * m2.m[0][2]
-              + m1.m[3][1] * m2.m[0][3];
-  m.m[0][2] = m1.m[0][2] * m2.m[0][0]
-              + m1.m[1][2] * m2.m[0][1]
-              + m1.m[2][2] * m2.m[0][2]
-              + m1.m[3][2] * m2.m[0][3];
-  m.m[0][3] = m1.m[0][3] * m2.m[0][0]
-              + m1.m[1][3] * m2.m[0][1]
-              + m1.m[2][3] * m2.m[0][2]
-              + m1.m[3][3] * m2.m[0][3];
-
-  m.m[1][0] = m1.m[0][0] * m2.m[1][0]
-              + m1.m[1][0] * m2.m[1][1]
-              + m1.m[2][0] * m2.m[1][2]
-              + m1.m[3][0] * m2.m[1][3];
-  m.m[1][1] = m1.m[0][1] * m2.m[1][0]
-              + m1.m[1][1] * m2.m[1][1]
-              + m1.m[2][1] * m2.m[1][2]
-              + m1.m[3][1] * m2.m[1][3];
-  m.m[1][2] = m1.m[0][2] * m2.m[1][0]
-              + m1.m[1][2] * m2.m[1][1]
-              + m1.m[2][2] * m2.m[1][2]
-              + m1.m[3][2] * m2.m[1][3];
-  m.m[1][3] = m1.m[0][3] * m2.m[1][0]
-              + m1.m[1][3] * m2.m[1][1]
-              + m1.m[2][3] * m2.m[1][2]
-              + m1.m[3][3] * m2.m[1][3];
-
-  m.m[2][0] = m1.m[0][0] * m2.m[2][0]
-              + m1.m[1][0] * m2.m[2][1]
-              + m1.m[2][0] * m2.m[2][2]
-              + m1.m[3][0] * m2.m[2][3];
-  m.m[2][1] = m1.m[0][1] * m2.m[2][0]
-              + m1.m[1][1] * m2.m[2][1]
-              + m1.m[2][1] * m2.m[2][2]
-              + m1.m[3][1] * m2.m[2][3];
-  m.m[2][2] = m1.m[0][2] * m2.m[2][0]
-              + m1.m[1][2] * m2.m[2][1]
-              + m1.m[2][2] * m2.m[2][2]
-              + m1.m[3][2] * m2.m[2][3];
-  m.m[2][3] = m1.m[0][3] * m2.m[2][0]
-              + m1.m[1][3] * m2.m[2][1]
-              + m1.m[2][3] * m2.m[2][2]
-              + m1.m[3][3] * m2.m[2][3];
-
-  m.m[3][0] = m1.m[0][0] * m2.m[3][0]
-              + m1.m[1][0] * m2.m[3][1]
-              + m1.m[2][0] * m2.m[3][2]
-              + m1.m[3][0] * m2.m[3][3];
-  m.m[3][1] = m1.m[0][1] * m2.m[3][0]
-              + m1.m[1][1] * m2.m[3][1]
-              + m1.m[2][1] * m2.m[3][2]
-              + m1.m[3][1] * m2.m[3][3];
-  m.m[3][2] = m1.m[0][2] * m2.m[3][0]
-              + m1.m[1][2] * m2.m[3][1]
-              + m1.m[2][2] * m2.m[3][2]
-              + m1.m[3][2] * m2.m[3][3];
-  m.m[3][3] = m1.m[0][3] * m2.m[3][0]
-              + m1.m[1][3] * m2.m[3][1]
-              + m1.m[2][3] * m2.m[3][2]
-              + m1.m[3][3] * m2.m[3][3];
+  m.flagBits = m1.flagBits | m2.flagBits;
+
+  if ( m2.isTranslation() )
+  {
+    // typically projection-view matrix multiplied by model matrix: the first
+    // three columns are the same as in m1, the last one is m1 * [tx, ty, tz, 1]
+    std::copy( *m1.m, *m1.m + 12, *m.m );
+    Matrix4x4Kernels::map()( *m1.m, m2.m[3], m.m[3] );
+    return m;
+  }
+
+  if ( m1.isTranslation() )
+  {
+    // only the first three rows get the translation added
+    for ( int col = 0; col < 4; ++col )
+    {
+      m.m[col][0] = m2.m[col][0] + m1.m[3][0] * m2.m[col][3];
+      m.m[col][1] = m2.m[col][1] + m1.m[3][1] * m2.m[col][3];
+      m.m[col][2] = m2.m[col][2] + m1.m[3][2] * m2.m[col][3];
+      m.m[col][3] = m2.m[col][3];
+    }
+    return m;
+  }
+
+  if ( m1.isAffine() && m2.isAffine() )
+  {
+    // the last row is [0, 0, 0, 1] in both matrices and in the result
+    for ( int col = 0; col < 4; ++col )
+    {
+      for ( int row = 0; row < 3; ++row )
+      {
+        m.m[col][row] = m1.m[0][row] * m2.m[col][0]
+                        + m1.m[1][row] * m2.m[col][1]
+                        + m1.m[2][row] * m2.m[col][2];
+      }
+    }
+    m.m[3][0] += m1.m[3][0];
+    m.m[3][1] += m1.m[3][1];
+    m.m[3][2] += m1.m[3][2];
+    m.m[0][3] = m.m[1][3] = m.m[2][3] = 0.0;
+    m.m[3][3] = 1.0;
+    return m;
+  }
+
+  Matrix4x4Kernels::multiply()( *m1.m, *m2.m, *m.m );
   return m;
 }
 
@@ -208,6 +229,7 @@ void Matrix4x4::lookAt(const Vector3D& eye, const Vector3D& center, const Vector
   m.m[1][3] = 0.0f;
   m.m[2][3] = 0.0f;
   m.m[3][3] = 1.0f;
+  m.flagBits = Matrix4x4::Linear;
 
   if ( !isIdentity() )
     *this = *this * m;
@@ -215,3 +237,26 @@ void Matrix4x4::lookAt(const Vector3D& eye, const Vector3D& center, const Vector
     *this = m;
   translate(-eye);
 }
+
+
+Matrix4x4 floatToDoubleMatrix( const QMatrix4x4 &m )
+{
+  Matrix4x4 out;
+  double *outData = out.data();
+  const float *mData = m.constData();
+  for ( int i = 0; i < 16; ++i )
+    outData[i] = mData[i];  // conversion float->double
+  out.optimize();
+  return out;
+}
+
+
+QMatrix4x4 doubleToFloatMatrix( const Matrix4x4 &m )
+{
+  QMatrix4x4 out;
+  float *outData = out.data();
+  const double *mData = m.constData();
+  for ( int i = 0; i < 16; ++i )
+    outData[i] = static_cast< float >( mData[i] );  // conversion double->float
+  return out;
+}
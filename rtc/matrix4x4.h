@@ -5,6 +5,15 @@
 
 #include "vector3d.h"
 
+/**
+ * Double precision 4x4 matrix.
+ *
+ * Like QMatrix4x4, the matrix keeps track of its type (identity, translation only,
+ * affine or general) so that the common cases of multiplication, mapping of points
+ * and translation can skip unnecessary work. The type flags are conservative:
+ * a matrix may be flagged as more general than it really is (e.g. after data()
+ * has been called), but never the other way round. Use optimize() to recalculate them.
+ */
 class Matrix4x4
 {
   public:
@@ -35,8 +44,12 @@ class Matrix4x4
 
     //! Returns pointer to the matrix data (stored in column-major order)
     const double *constData() const { return *m; }
-    //! Returns pointer to the matrix data (stored in column-major order)
-    double *data() { return *m; }
+    //! Returns pointer to the matrix data (stored in column-major order). The matrix is flagged as general afterwards.
+    double *data()
+    {
+      flagBits = General;
+      return *m;
+    }
 #if 0
     //! Returns matrix data (in column-major order)
     QList< double > dataList() const;
@@ -58,6 +71,17 @@ class Matrix4x4
     //! Sets matrix to be identity matrix
     void setToIdentity();
 
+    //! Returns whether the matrix is flagged to only contain translation (or to be identity)
+    bool isTranslation() const { return ( flagBits & ~Translation ) == 0; }
+    //! Returns whether the matrix is flagged to be affine (the last row is [0, 0, 0, 1])
+    bool isAffine() const { return ( flagBits & Perspective ) == 0; }
+
+    /**
+     * Recalculates the type flags of the matrix from its values. Useful after
+     * the matrix was modified through data() to enable the fast code paths again.
+     */
+    void optimize();
+
     friend Matrix4x4 operator*( const Matrix4x4 &m1, const Matrix4x4 &m2 );
     friend Vector3D operator*( const Matrix4x4 &matrix, const Vector3D &vector );
 
@@ -73,6 +97,18 @@ class Matrix4x4
     // Matrix data - in column-major order
     double m[4][4];
 
+    //! Type of the matrix (like in QMatrix4x4 - but only the distinctions we make use of)
+    enum Flag
+    {
+      Identity = 0x00,     //!< Identity matrix
+      Translation = 0x01,  //!< Contains translation (last column)
+      Linear = 0x02,       //!< Contains rotation, scale or any other linear transform (upper-left 3x3 part)
+      Perspective = 0x04,  //!< Last row is not [0, 0, 0, 1]
+      General = 0x07       //!< General matrix, unknown contents
+    };
+
+    int flagBits = General;
+
     //! Construct without initializing identity matrix.
     explicit Matrix4x4( int ) { }   // cppcheck-suppress uninitMemberVarPrivate
 };
@@ -83,6 +119,15 @@ Vector3D operator*( const Matrix4x4 &matrix, const Vector3D &vector );
 Matrix4x4 operator*( const Matrix4x4 &m1, const Matrix4x4 &m2 );
 
 
+#include <QMatrix4x4>
+
+//! Converts single precision QMatrix4x4 to double precision Matrix4x4
+Matrix4x4 floatToDoubleMatrix( const QMatrix4x4 &m );
+
+//! Converts double precision Matrix4x4 to single precision QMatrix4x4
+QMatrix4x4 doubleToFloatMatrix( const Matrix4x4 &m );
+
+
 #include <QDebug>
 
 inline QDebug operator<<(QDebug dbg, const Matrix4x4 &m)
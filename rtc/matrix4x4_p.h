@@ -0,0 +1,53 @@
+#ifndef MATRIX4X4_P_H
+#define MATRIX4X4_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the public API. It exposes the low-level kernels
+// used by Matrix4x4 so that they can be benchmarked against each other.
+//
+
+#include "cpufeatures.h"
+
+/**
+ * Low-level kernels for double precision 4x4 matrix math.
+ *
+ * All matrices are arrays of 16 doubles in column-major order (the same layout
+ * as Matrix4x4::constData()). The SIMD kernels perform the multiplications and
+ * additions in exactly the same order as the scalar code (no fused multiply-add),
+ * so all variants give bit-identical results.
+ *
+ * The best variant for the running CPU is chosen at runtime on first use.
+ */
+namespace Matrix4x4Kernels
+{
+  //! Instruction set used by a kernel (SSE2 holds two doubles per register, AVX four - one register per column)
+  using Isa = CpuFeatures::Isa;
+
+  //! Computes matrix-matrix product out = a * b. The output must not alias the inputs.
+  typedef void ( *MultiplyFunc )( const double *a, const double *b, double *out );
+
+  //! Computes out = m * [v0, v1, v2, 1] (without the division by w). The output has 4 elements.
+  typedef void ( *MapFunc )( const double *m, const double *v, double *out );
+
+  // instruction set support (see common/cpufeatures.h)
+  using CpuFeatures::isSupported;
+  using CpuFeatures::bestIsa;
+  using CpuFeatures::isaName;
+
+  //! Returns matrix-matrix product kernel for the given instruction set (must be supported)
+  MultiplyFunc multiplyKernel( Isa isa );
+
+  //! Returns matrix-vector product kernel for the given instruction set (must be supported)
+  MapFunc mapKernel( Isa isa );
+
+  //! Returns matrix-matrix product kernel picked for the running CPU
+  MultiplyFunc multiply();
+
+  //! Returns matrix-vector product kernel picked for the running CPU
+  MapFunc map();
+}
+
+#endif // MATRIX4X4_P_H
@@ -0,0 +1,176 @@
+#include "matrix4x4_p.h"
+
+
+namespace Matrix4x4Kernels
+{
+
+  // Scalar versions - these are the reference implementation (based on QMatrix4x4).
+  // Note: the other kernels must keep the same order of operations to give identical results.
+
+  static void multiplyScalar( const double *a, const double *b, double *out )
+  {
+    for ( int col = 0; col < 4; ++col )
+    {
+      const double *bc = b + col * 4;
+      for ( int row = 0; row < 4; ++row )
+      {
+        out[col * 4 + row] = a[row] * bc[0]
+                             + a[4 + row] * bc[1]
+                             + a[8 + row] * bc[2]
+                             + a[12 + row] * bc[3];
+      }
+    }
+  }
+
+  static void mapScalar( const double *m, const double *v, double *out )
+  {
+    for ( int row = 0; row < 4; ++row )
+    {
+      out[row] = v[0] * m[row] +
+                 v[1] * m[4 + row] +
+                 v[2] * m[8 + row] +
+                 m[12 + row];
+    }
+  }
+
+#ifdef CPU_HAS_SSE2
+
+  // Each column is held in two registers: rows (0,1) and rows (2,3)
+
+  static void multiplySse2( const double *a, const double *b, double *out )
+  {
+    const __m128d a0l = _mm_loadu_pd( a + 0 ), a0h = _mm_loadu_pd( a + 2 );
+    const __m128d a1l = _mm_loadu_pd( a + 4 ), a1h = _mm_loadu_pd( a + 6 );
+    const __m128d a2l = _mm_loadu_pd( a + 8 ), a2h = _mm_loadu_pd( a + 10 );
+    const __m128d a3l = _mm_loadu_pd( a + 12 ), a3h = _mm_loadu_pd( a + 14 );
+
+    for ( int col = 0; col < 4; ++col )
+    {
+      const double *bc = b + col * 4;
+      const __m128d b0 = _mm_set1_pd( bc[0] );
+      const __m128d b1 = _mm_set1_pd( bc[1] );
+      const __m128d b2 = _mm_set1_pd( bc[2] );
+      const __m128d b3 = _mm_set1_pd( bc[3] );
+
+      __m128d lo = _mm_mul_pd( a0l, b0 );
+      lo = _mm_add_pd( lo, _mm_mul_pd( a1l, b1 ) );
+      lo = _mm_add_pd( lo, _mm_mul_pd( a2l, b2 ) );
+      lo = _mm_add_pd( lo, _mm_mul_pd( a3l, b3 ) );
+
+      __m128d hi = _mm_mul_pd( a0h, b0 );
+      hi = _mm_add_pd( hi, _mm_mul_pd( a1h, b1 ) );
+      hi = _mm_add_pd( hi, _mm_mul_pd( a2h, b2 ) );
+      hi = _mm_add_pd( hi, _mm_mul_pd( a3h, b3 ) );
+
+      _mm_storeu_pd( out + col * 4, lo );
+      _mm_storeu_pd( out + col * 4 + 2, hi );
+    }
+  }
+
+  static void mapSse2( const double *m, const double *v, double *out )
+  {
+    const __m128d x = _mm_set1_pd( v[0] );
+    const __m128d y = _mm_set1_pd( v[1] );
+    const __m128d z = _mm_set1_pd( v[2] );
+
+    __m128d lo = _mm_mul_pd( x, _mm_loadu_pd( m + 0 ) );
+    lo = _mm_add_pd( lo, _mm_mul_pd( y, _mm_loadu_pd( m + 4 ) ) );
+    lo = _mm_add_pd( lo, _mm_mul_pd( z, _mm_loadu_pd( m + 8 ) ) );
+    lo = _mm_add_pd( lo, _mm_loadu_pd( m + 12 ) );
+
+    __m128d hi = _mm_mul_pd( x, _mm_loadu_pd( m + 2 ) );
+    hi = _mm_add_pd( hi, _mm_mul_pd( y, _mm_loadu_pd( m + 6 ) ) );
+    hi = _mm_add_pd( hi, _mm_mul_pd( z, _mm_loadu_pd( m + 10 ) ) );
+    hi = _mm_add_pd( hi, _mm_loadu_pd( m + 14 ) );
+
+    _mm_storeu_pd( out, lo );
+    _mm_storeu_pd( out + 2, hi );
+  }
+
+#endif
+
+#ifdef CPU_HAS_AVX
+
+  // Each column fits into a single register
+
+  CPU_TARGET_AVX
+  static void multiplyAvx( const double *a, const double *b, double *out )
+  {
+    const __m256d a0 = _mm256_loadu_pd( a + 0 );
+    const __m256d a1 = _mm256_loadu_pd( a + 4 );
+    const __m256d a2 = _mm256_loadu_pd( a + 8 );
+    const __m256d a3 = _mm256_loadu_pd( a + 12 );
+
+    for ( int col = 0; col < 4; ++col )
+    {
+      const double *bc = b + col * 4;
+      __m256d r = _mm256_mul_pd( a0, _mm256_broadcast_sd( bc + 0 ) );
+      r = _mm256_add_pd( r, _mm256_mul_pd( a1, _mm256_broadcast_sd( bc + 1 ) ) );
+      r = _mm256_add_pd( r, _mm256_mul_pd( a2, _mm256_broadcast_sd( bc + 2 ) ) );
+      r = _mm256_add_pd( r, _mm256_mul_pd( a3, _mm256_broadcast_sd( bc + 3 ) ) );
+      _mm256_storeu_pd( out + col * 4, r );
+    }
+  }
+
+  CPU_TARGET_AVX
+  static void mapAvx( const double *m, const double *v, double *out )
+  {
+    __m256d r = _mm256_mul_pd( _mm256_broadcast_sd( v + 0 ), _mm256_loadu_pd( m + 0 ) );
+    r = _mm256_add_pd( r, _mm256_mul_pd( _mm256_broadcast_sd( v + 1 ), _mm256_loadu_pd( m + 4 ) ) );
+    r = _mm256_add_pd( r, _mm256_mul_pd( _mm256_broadcast_sd( v + 2 ), _mm256_loadu_pd( m + 8 ) ) );
+    r = _mm256_add_pd( r, _mm256_loadu_pd( m + 12 ) );
+    _mm256_storeu_pd( out, r );
+  }
+
+#endif
+
+
+  MultiplyFunc multiplyKernel( Isa isa )
+  {
+    Q_ASSERT( isSupported( isa ) );
+    switch ( isa )
+    {
+#ifdef CPU_HAS_SSE2
+      case Isa::Sse2:
+        return multiplySse2;
+#endif
+#ifdef CPU_HAS_AVX
+      case Isa::Avx:
+        return multiplyAvx;
+#endif
+      default:
+        return multiplyScalar;
+    }
+  }
+
+  MapFunc mapKernel( Isa isa )
+  {
+    Q_ASSERT( isSupported( isa ) );
+    switch ( isa )
+    {
+#ifdef CPU_HAS_SSE2
+      case Isa::Sse2:
+        return mapSse2;
+#endif
+#ifdef CPU_HAS_AVX
+      case Isa::Avx:
+        return mapAvx;
+#endif
+      default:
+        return mapScalar;
+    }
+  }
+
+  MultiplyFunc multiply()
+  {
+    static const MultiplyFunc f = multiplyKernel( bestIsa() );
+    return f;
+  }
+
+  MapFunc map()
+  {
+    static const MapFunc f = mapKernel( bestIsa() );
+    return f;
+  }
+
+}
@@ -0,0 +1,331 @@
+#include "rtcencoder.h"
+#include "rtcencoder_p.h"
+
+#include <algorithm>
+#include <limits>
+
+#include <QVector>
+#include <QtConcurrent/QtConcurrentMap>
+
+
+namespace RtcEncoderKernels
+{
+
+  static void subtractCenterScalar( const double *positions, qsizetype count, const double *center, float *output )
+  {
+    for ( qsizetype i = 0; i < count; ++i )
+    {
+      output[i * 3 + 0] = static_cast< float >( positions[i * 3 + 0] - center[0] );
+      output[i * 3 + 1] = static_cast< float >( positions[i * 3 + 1] - center[1] );
+      output[i * 3 + 2] = static_cast< float >( positions[i * 3 + 2] - center[2] );
+    }
+  }
+
+#ifdef CPU_HAS_SSE2
+
+  // 2 positions (6 doubles) per iteration, center is repeated as [cx,cy] [cz,cx] [cy,cz]
+
+  static void subtractCenterSse2( const double *positions, qsizetype count, const double *center, float *output )
+  {
+    const __m128d c0 = _mm_setr_pd( center[0], center[1] );
+    const __m128d c1 = _mm_setr_pd( center[2], center[0] );
+    const __m128d c2 = _mm_setr_pd( center[1], center[2] );
+
+    qsizetype i = 0;
+    for ( ; i + 2 <= count; i += 2 )
+    {
+      const double *p = positions + i * 3;
+      float *o = output + i * 3;
+      const __m128 r0 = _mm_cvtpd_ps( _mm_sub_pd( _mm_loadu_pd( p + 0 ), c0 ) );
+      const __m128 r1 = _mm_cvtpd_ps( _mm_sub_pd( _mm_loadu_pd( p + 2 ), c1 ) );
+      const __m128 r2 = _mm_cvtpd_ps( _mm_sub_pd( _mm_loadu_pd( p + 4 ), c2 ) );
+      // each conversion gives two floats in the lower half
+      _mm_storeu_ps( o, _mm_movelh_ps( r0, r1 ) );
+      _mm_storel_pi( reinterpret_cast< __m64 * >( o + 4 ), r2 );
+    }
+    subtractCenterScalar( positions + i * 3, count - i, center, output + i * 3 );
+  }
+
+#endif
+
+#ifdef CPU_HAS_AVX
+
+  // 4 positions (12 doubles) per iteration, center is repeated as [cx,cy,cz,cx] [cy,cz,cx,cy] [cz,cx,cy,cz]
+
+  CPU_TARGET_AVX
+  static void subtractCenterAvx( const double *positions, qsizetype count, const double *center, float *output )
+  {
+    const __m256d c0 = _mm256_setr_pd( center[0], center[1], center[2], center[0] );
+    const __m256d c1 = _mm256_setr_pd( center[1], center[2], center[0], center[1] );
+    const __m256d c2 = _mm256_setr_pd( center[2], center[0], center[1], center[2] );
+
+    qsizetype i = 0;
+    for ( ; i + 4 <= count; i += 4 )
+    {
+      const double *p = positions + i * 3;
+      float *o = output + i * 3;
+      _mm_storeu_ps( o + 0, _mm256_cvtpd_ps( _mm256_sub_pd( _mm256_loadu_pd( p + 0 ), c0 ) ) );
+      _mm_storeu_ps( o + 4, _mm256_cvtpd_ps( _mm256_sub_pd( _mm256_loadu_pd( p + 4 ), c1 ) ) );
+      _mm_storeu_ps( o + 8, _mm256_cvtpd_ps( _mm256_sub_pd( _mm256_loadu_pd( p + 8 ), c2 ) ) );
+    }
+    subtractCenterScalar( positions + i * 3, count - i, center, output + i * 3 );
+  }
+
+#endif
+
+  void subtractCenter( Isa isa, const double *positions, qsizetype count, const double *center, float *output )
+  {
+    Q_ASSERT( Matrix4x4Kernels::isSupported( isa ) );
+    switch ( isa )
+    {
+#ifdef CPU_HAS_SSE2
+      case Isa::Sse2:
+        subtractCenterSse2( positions, count, center, output );
+        return;
+#endif
+#ifdef CPU_HAS_AVX
+      case Isa::Avx:
+        subtractCenterAvx( positions, count, center, output );
+        return;
+#endif
+      default:
+        subtractCenterScalar( positions, count, center, output );
+        return;
+    }
+  }
+
+  static void splitHighLowScalar( const double *positions, qsizetype count, float *output )
+  {
+    for ( qsizetype i = 0; i < count; ++i )
+    {
+      for ( int c = 0; c < 3; ++c )
+      {
+        const double value = positions[i * 3 + c];
+        const float high = static_cast< float >( value );
+        output[i * 6 + c] = high;
+        output[i * 6 + 3 + c] = static_cast< float >( value - static_cast< double >( high ) );
+      }
+    }
+  }
+
+#ifdef CPU_HAS_SSE2
+
+  // 2 positions (6 doubles) per iteration
+
+  static void splitHighLowSse2( const double *positions, qsizetype count, float *output )
+  {
+    qsizetype i = 0;
+    for ( ; i + 2 <= count; i += 2 )
+    {
+      alignas( 16 ) float high[8], low[8];
+      for ( int j = 0; j < 3; ++j )
+      {
+        const __m128d value = _mm_loadu_pd( positions + i * 3 + j * 2 );
+        const __m128 h = _mm_cvtpd_ps( value );
+        const __m128 l = _mm_cvtpd_ps( _mm_sub_pd( value, _mm_cvtps_pd( h ) ) );
+        _mm_storel_pi( reinterpret_cast< __m64 * >( high + j * 2 ), h );
+        _mm_storel_pi( reinterpret_cast< __m64 * >( low + j * 2 ), l );
+      }
+      float *o = output + i * 6;
+      std::copy( high, high + 3, o );
+      std::copy( low, low + 3, o + 3 );
+      std::copy( high + 3, high + 6, o + 6 );
+      std::copy( low + 3, low + 6, o + 9 );
+    }
+    splitHighLowScalar( positions + i * 3, count - i, output + i * 6 );
+  }
+
+#endif
+
+#ifdef CPU_HAS_AVX
+
+  // 4 positions (12 doubles) per iteration
+
+  CPU_TARGET_AVX
+  static void splitHighLowAvx( const double *positions, qsizetype count, float *output )
+  {
+    qsizetype i = 0;
+    for ( ; i + 4 <= count; i += 4 )
+    {
+      alignas( 16 ) float high[12], low[12];
+      for ( int j = 0; j < 3; ++j )
+      {
+        const __m256d value = _mm256_loadu_pd( positions + i * 3 + j * 4 );
+        const __m128 h = _mm256_cvtpd_ps( value );
+        const __m128 l = _mm256_cvtpd_ps( _mm256_sub_pd( value, _mm256_cvtps_pd( h ) ) );
+        _mm_store_ps( high + j * 4, h );
+        _mm_store_ps( low + j * 4, l );
+      }
+      // interleave high and low parts of each vertex
+      float *o = output + i * 6;
+      for ( int v = 0; v < 4; ++v )
+      {
+        std::copy( high + v * 3, high + v * 3 + 3, o + v * 6 );
+        std::copy( low + v * 3, low + v * 3 + 3, o + v * 6 + 3 );
+      }
+    }
+    splitHighLowScalar( positions + i * 3, count - i, output + i * 6 );
+  }
+
+#endif
+
+  void splitHighLow( Isa isa, const double *positions, qsizetype count, float *output )
+  {
+    Q_ASSERT( Matrix4x4Kernels::isSupported( isa ) );
+    switch ( isa )
+    {
+#ifdef CPU_HAS_SSE2
+      case Isa::Sse2:
+        splitHighLowSse2( positions, count, output );
+        return;
+#endif
+#ifdef CPU_HAS_AVX
+      case Isa::Avx:
+        splitHighLowAvx( positions, count, output );
+        return;
+#endif
+      default:
+        splitHighLowScalar( positions, count, output );
+        return;
+    }
+  }
+
+  //! Returns start offsets of chunks for a parallel run over \a count positions
+  static QVector<qsizetype> chunkOffsets( qsizetype count )
+  {
+    QVector<qsizetype> chunks;
+    for ( qsizetype begin = 0; begin < count; begin += CHUNK_SIZE )
+      chunks.append( begin );
+    return chunks;
+  }
+
+  void subtractCenterParallel( Isa isa, const double *positions, qsizetype count, const double *center, float *output )
+  {
+    if ( count <= CHUNK_SIZE )
+    {
+      subtractCenter( isa, positions, count, center, output );
+      return;
+    }
+
+    QVector<qsizetype> chunks = chunkOffsets( count );
+    QtConcurrent::blockingMap( chunks, [ = ]( qsizetype begin )
+    {
+      const qsizetype n = std::min( CHUNK_SIZE, count - begin );
+      subtractCenter( isa, positions + begin * 3, n, center, output + begin * 3 );
+    } );
+  }
+
+  void splitHighLowParallel( Isa isa, const double *positions, qsizetype count, float *output )
+  {
+    if ( count <= CHUNK_SIZE )
+    {
+      splitHighLow( isa, positions, count, output );
+      return;
+    }
+
+    QVector<qsizetype> chunks = chunkOffsets( count );
+    QtConcurrent::blockingMap( chunks, [ = ]( qsizetype begin )
+    {
+      const qsizetype n = std::min( CHUNK_SIZE, count - begin );
+      splitHighLow( isa, positions + begin * 3, n, output + begin * 6 );
+    } );
+  }
+
+}
+
+
+Vector3D RtcVertexEncoder::boundingBoxCenter( const double *positions, qsizetype count )
+{
+  if ( count == 0 )
+    return Vector3D();
+
+  // per-chunk bounding boxes: [xmin, ymin, zmin, xmax, ymax, zmax]
+  QVector<qsizetype> chunks = RtcEncoderKernels::chunkOffsets( count );
+  QVector<double> boxes( chunks.count() * 6 );
+  double *boxesData = boxes.data();
+
+  auto chunkBox = [ = ]( qsizetype begin )
+  {
+    const qsizetype end = std::min( begin + RtcEncoderKernels::CHUNK_SIZE, count );
+    double *box = boxesData + ( begin / RtcEncoderKernels::CHUNK_SIZE ) * 6;
+    std::fill( box, box + 3, std::numeric_limits<double>::max() );
+    std::fill( box + 3, box + 6, std::numeric_limits<double>::lowest() );
+    for ( qsizetype i = begin; i < end; ++i )
+    {
+      for ( int c = 0; c < 3; ++c )
+      {
+        box[c] = std::min( box[c], positions[i * 3 + c] );
+        box[c + 3] = std::max( box[c + 3], positions[i * 3 + c] );
+      }
+    }
+  };
+
+  if ( chunks.count() == 1 )
+    chunkBox( 0 );
+  else
+    QtConcurrent::blockingMap( chunks, chunkBox );
+
+  double box[6];
+  std::copy( boxesData, boxesData + 6, box );
+  for ( int i = 1; i < chunks.count(); ++i )
+  {
+    for ( int c = 0; c < 3; ++c )
+    {
+      box[c] = std::min( box[c], boxesData[i * 6 + c] );
+      box[c + 3] = std::max( box[c + 3], boxesData[i * 6 + c + 3] );
+    }
+  }
+
+  return Vector3D( ( box[0] + box[3] ) / 2, ( box[1] + box[4] ) / 2, ( box[2] + box[5] ) / 2 );
+}
+
+void RtcVertexEncoder::encode( const double *positions, qsizetype count, const Vector3D &center, float *output )
+{
+  const double c[3] = { center.x(), center.y(), center.z() };
+  RtcEncoderKernels::subtractCenterParallel( Matrix4x4Kernels::bestIsa(), positions, count, c, output );
+}
+
+QByteArray RtcVertexEncoder::encode( const double *positions, qsizetype count, const Vector3D &center )
+{
+  QByteArray data;
+  data.resize( count * 3 * sizeof( float ) );
+  encode( positions, count, center, reinterpret_cast< float * >( data.data() ) );
+  return data;
+}
+
+QByteArray RtcVertexEncoder::encode( const double *positions, qsizetype count, Vector3D *center )
+{
+  const Vector3D c = boundingBoxCenter( positions, count );
+  if ( center )
+    *center = c;
+  return encode( positions, count, c );
+}
+
+Matrix4x4 RtcVertexEncoder::modelMatrix( const Vector3D &center )
+{
+  Matrix4x4 m;
+  m.translate( center );
+  return m;
+}
+
+void RtcVertexEncoder::encodeHighLow( const double *positions, qsizetype count, float *output )
+{
+  RtcEncoderKernels::splitHighLowParallel( Matrix4x4Kernels::bestIsa(), positions, count, output );
+}
+
+QByteArray RtcVertexEncoder::encodeHighLow( const double *positions, qsizetype count )
+{
+  QByteArray data;
+  data.resize( count * HIGH_LOW_STRIDE );
+  encodeHighLow( positions, count, reinterpret_cast< float * >( data.data() ) );
+  return data;
+}
+
+void RtcVertexEncoder::splitHighLow( const Vector3D &position, QVector3D &high, QVector3D &low )
+{
+  const double p[3] = { position.x(), position.y(), position.z() };
+  float out[6];
+  RtcEncoderKernels::splitHighLow( Matrix4x4Kernels::Isa::Scalar, p, 1, out );
+  high = QVector3D( out[0], out[1], out[2] );
+  low = QVector3D( out[3], out[4], out[5] );
+}
@@ -0,0 +1,66 @@
+#ifndef RTCENCODER_H
+#define RTCENCODER_H
+
+#include <QByteArray>
+
+#include "vector3d.h"
+#include "matrix4x4.h"
+
+/**
+ * Converts large arrays of double precision world coordinates (e.g. ECEF)
+ * to single precision vertex buffers relative to a center (RTC).
+ *
+ * Positions are given as packed [x, y, z] triplets of doubles. The output
+ * is a packed [x, y, z] float buffer ready to be used as data of a vertex QBuffer,
+ * while the center goes to the model matrix of the entity (see modelMatrix()).
+ *
+ * Alternatively, for the "GPU relative to eye" (RTE) technique from the virtual globes
+ * book, positions can be split into high and low floats (emulated doubles) with
+ * encodeHighLow(). The vertex shader then subtracts the similarly split camera position
+ * (see splitHighLow()), so a single mesh of any size needs no per-tile RTC center.
+ *
+ * The conversion is vectorized and large inputs are split into chunks
+ * that are processed in parallel.
+ */
+class RtcVertexEncoder
+{
+  public:
+
+    //! Returns center of the bounding box of \a count positions
+    static Vector3D boundingBoxCenter( const double *positions, qsizetype count );
+
+    /**
+     * Writes \a count positions relative to the \a center as floats to \a output
+     * (which must have space for 3 * count floats).
+     */
+    static void encode( const double *positions, qsizetype count, const Vector3D &center, float *output );
+
+    //! Returns vertex buffer data with \a count positions relative to the \a center
+    static QByteArray encode( const double *positions, qsizetype count, const Vector3D &center );
+
+    /**
+     * Returns vertex buffer data with \a count positions relative to the center
+     * of their bounding box. The center is written to \a center.
+     */
+    static QByteArray encode( const double *positions, qsizetype count, Vector3D *center );
+
+    //! Returns model matrix that moves the encoded positions back from the \a center
+    static Matrix4x4 modelMatrix( const Vector3D &center );
+
+    //! Byte stride of a vertex in the buffers returned by encodeHighLow()
+    static const int HIGH_LOW_STRIDE = 6 * sizeof( float );
+
+    /**
+     * Writes \a count positions split into high and low floats to \a output (which must
+     * have space for 6 * count floats). Each vertex is [hx, hy, hz, lx, ly, lz].
+     */
+    static void encodeHighLow( const double *positions, qsizetype count, float *output );
+
+    //! Returns vertex buffer data with \a count positions split into high and low floats
+    static QByteArray encodeHighLow( const double *positions, qsizetype count );
+
+    //! Splits a single position into \a high and \a low floats (e.g. camera position for RTE)
+    static void splitHighLow( const Vector3D &position, QVector3D &high, QVector3D &low );
+};
+
+#endif // RTCENCODER_H
@@ -0,0 +1,43 @@
+#ifndef RTCENCODER_P_H
+#define RTCENCODER_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the public API. It exposes the low-level kernels
+// used by RtcVertexEncoder so that they can be benchmarked against each other.
+//
+
+#include <QtGlobal>
+
+#include "matrix4x4_p.h"
+
+/**
+ * Low-level kernels for RtcVertexEncoder. Positions are packed [x, y, z]
+ * triplets of doubles, center is an array of 3 doubles.
+ */
+namespace RtcEncoderKernels
+{
+  using Isa = Matrix4x4Kernels::Isa;
+
+  //! Writes float( positions - center ) for \a count positions using the given instruction set
+  void subtractCenter( Isa isa, const double *positions, qsizetype count, const double *center, float *output );
+
+  //! Same as subtractCenter(), but large inputs are split into chunks that run in parallel
+  void subtractCenterParallel( Isa isa, const double *positions, qsizetype count, const double *center, float *output );
+
+  /**
+   * Splits \a count positions into high and low floats (high = float(x), low = float(x - high)).
+   * The output is interleaved: [hx, hy, hz, lx, ly, lz] for each position.
+   */
+  void splitHighLow( Isa isa, const double *positions, qsizetype count, float *output );
+
+  //! Same as splitHighLow(), but large inputs are split into chunks that run in parallel
+  void splitHighLowParallel( Isa isa, const double *positions, qsizetype count, float *output );
+
+  //! Number of positions processed by a single task when running in parallel
+  const qsizetype CHUNK_SIZE = 64 * 1024;
+}
+
+#endif // RTCENCODER_P_H
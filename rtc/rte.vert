@@ -0,0 +1,20 @@
+#version 330 core
+
+// "GPU relative to eye" (RTE) rendering: positions come as emulated doubles
+// (high and low floats), the camera position is split the same way.
+// The difference is calculated in (roughly) double precision here, so that
+// the MVP matrix only needs rotation + projection (no huge translations).
+
+uniform vec3 camera_eye_high;
+uniform vec3 camera_eye_low;
+
+uniform mat4 my_mvp_rte;   // P * V with translation removed from V
+
+in vec3 positionHigh;
+in vec3 positionLow;
+
+void main() {
+    vec3 highDifference = positionHigh - camera_eye_high;
+    vec3 lowDifference = positionLow - camera_eye_low;
+    gl_Position = my_mvp_rte * vec4(highDifference + lowDifference, 1.0);
+}
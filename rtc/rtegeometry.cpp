@@ -0,0 +1,38 @@
+#include "rtegeometry.h"
+
+#include "rtcencoder.h"
+
+
+RteGeometry::RteGeometry( Qt3DCore::QNode *parent )
+  : Qt3DGeometry::QGeometry( parent )
+  , mHighAttribute( new Qt3DGeometry::QAttribute( this ) )
+  , mLowAttribute( new Qt3DGeometry::QAttribute( this ) )
+  , mVertexBuffer( new Qt3DGeometry::QBuffer( this ) )
+{
+  mHighAttribute->setAttributeType( Qt3DGeometry::QAttribute::VertexAttribute );
+  mHighAttribute->setBuffer( mVertexBuffer );
+  mHighAttribute->setVertexBaseType( Qt3DGeometry::QAttribute::Float );
+  mHighAttribute->setVertexSize( 3 );
+  mHighAttribute->setByteOffset( 0 );
+  mHighAttribute->setByteStride( RtcVertexEncoder::HIGH_LOW_STRIDE );
+  mHighAttribute->setName( QStringLiteral( "positionHigh" ) );
+
+  mLowAttribute->setAttributeType( Qt3DGeometry::QAttribute::VertexAttribute );
+  mLowAttribute->setBuffer( mVertexBuffer );
+  mLowAttribute->setVertexBaseType( Qt3DGeometry::QAttribute::Float );
+  mLowAttribute->setVertexSize( 3 );
+  mLowAttribute->setByteOffset( 3 * sizeof( float ) );
+  mLowAttribute->setByteStride( RtcVertexEncoder::HIGH_LOW_STRIDE );
+  mLowAttribute->setName( QStringLiteral( "positionLow" ) );
+
+  addAttribute( mHighAttribute );
+  addAttribute( mLowAttribute );
+}
+
+void RteGeometry::setPositions( const double *positions, qsizetype count )
+{
+  mVertexCount = static_cast< int >( count );
+  mVertexBuffer->setData( RtcVertexEncoder::encodeHighLow( positions, count ) );
+  mHighAttribute->setCount( mVertexCount );
+  mLowAttribute->setCount( mVertexCount );
+}
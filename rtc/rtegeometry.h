@@ -0,0 +1,44 @@
+#ifndef RTEGEOMETRY_H
+#define RTEGEOMETRY_H
+
+#include <QtGlobal>
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+#include <Qt3DCore/QGeometry>
+#include <Qt3DCore/QAttribute>
+#include <Qt3DCore/QBuffer>
+namespace Qt3DGeometry = Qt3DCore;
+#else
+#include <Qt3DRender/QGeometry>
+#include <Qt3DRender/QAttribute>
+#include <Qt3DRender/QBuffer>
+namespace Qt3DGeometry = Qt3DRender;
+#endif
+
+/**
+ * Geometry for the "GPU relative to eye" technique: double precision world
+ * positions are stored as interleaved high/low floats ("positionHigh" and
+ * "positionLow" attributes, see rte.vert).
+ *
+ * The entity needs no model matrix - only the camera uniforms need updating
+ * when the camera moves (see MyCamera::updateRteParameters()).
+ */
+class RteGeometry : public Qt3DGeometry::QGeometry
+{
+  public:
+    explicit RteGeometry( Qt3DCore::QNode *parent = nullptr );
+
+    //! Sets vertex positions given as packed [x, y, z] doubles in world coordinates
+    void setPositions( const double *positions, qsizetype count );
+
+    //! Returns number of vertices
+    int vertexCount() const { return mVertexCount; }
+
+  private:
+    Qt3DGeometry::QAttribute *mHighAttribute = nullptr;
+    Qt3DGeometry::QAttribute *mLowAttribute = nullptr;
+    Qt3DGeometry::QBuffer *mVertexBuffer = nullptr;
+    int mVertexCount = 0;
+};
+
+#endif // RTEGEOMETRY_H
@@ -0,0 +1,211 @@
+#include "transformstore.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <utility>
+
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <Qt3DCore/QEntity>
+#include <Qt3DRender/QParameter>
+
+#include "frustumculler.h"
+
+// entities are processed in chunks of this size - smaller scenes are not worth
+// dispatching to the thread pool
+static const int CHUNK_SIZE = 1024;
+
+
+int TransformStore::addEntity( Qt3DRender::QParameter *paramMvp )
+{
+  mModelMatrices.append( Matrix4x4() );
+  mMvpMatrices.append( QMatrix4x4() );
+  mMvpParameters.append( paramMvp );
+  // new entity is dirty until its first update
+  mVersions.append( 1 );
+  mUpdatedVersions.append( 0 );
+  ++mDirtyCount;
+
+  // no bounds - always visible
+  mLocalCenters.append( Vector3D() );
+  mLocalRadii.append( std::numeric_limits<double>::infinity() );
+  mWorldCenterX.append( 0 );
+  mWorldCenterY.append( 0 );
+  mWorldCenterZ.append( 0 );
+  mWorldRadii.append( std::numeric_limits<double>::infinity() );
+  mVisible.append( 1 );
+  ++mVisibleCount;
+  mEntities.append( nullptr );
+  return mModelMatrices.count() - 1;
+}
+
+void TransformStore::setModelMatrix( int index, const Matrix4x4 &matrix )
+{
+  mModelMatrices[index] = matrix;
+  ++mVersions[index];
+  ++mDirtyCount;
+  updateWorldBounds( index );
+}
+
+void TransformStore::translate( int index, const Vector3D &vector )
+{
+  mModelMatrices[index].translate( vector );
+  ++mVersions[index];
+  ++mDirtyCount;
+  updateWorldBounds( index );
+}
+
+void TransformStore::setEntity( int index, Qt3DCore::QEntity *entity )
+{
+  mEntities[index] = entity;
+  if ( entity )
+    entity->setEnabled( mVisible[index] );
+}
+
+void TransformStore::setBoundingSphere( int index, const Vector3D &center, double radius )
+{
+  mLocalCenters[index] = center;
+  mLocalRadii[index] = radius;
+  updateWorldBounds( index );
+  // make sure the culling gets re-evaluated
+  ++mVersions[index];
+  ++mDirtyCount;
+}
+
+void TransformStore::updateWorldBounds( int index )
+{
+  const Matrix4x4 &m = mModelMatrices[index];
+  const Vector3D center = m.map( mLocalCenters[index] );
+  mWorldCenterX[index] = center.x();
+  mWorldCenterY[index] = center.y();
+  mWorldCenterZ[index] = center.z();
+
+  // radius gets scaled by the largest scale of the model matrix
+  double scale = 1;
+  if ( !m.isTranslation() )
+  {
+    for ( int col = 0; col < 3; ++col )
+      scale = std::max( scale, Vector3D( m( 0, col ), m( 1, col ), m( 2, col ) ).length() );
+  }
+  mWorldRadii[index] = mLocalRadii[index] * scale;
+}
+
+void TransformStore::setVisible( int index, bool visible )
+{
+  if ( mVisible[index] == visible )
+    return;
+
+  mVisible[index] = visible;
+  mVisibleCount += visible ? 1 : -1;
+  if ( mEntities[index] )
+    mEntities[index]->setEnabled( visible );
+}
+
+bool TransformStore::needsUpdate( quint64 cameraVersion ) const
+{
+  return mDirtyCount > 0 || !mHasCameraVersion || cameraVersion != mCameraVersion;
+}
+
+void TransformStore::calculateRange( int begin, int end, const Matrix4x4 &pv, const QMatrix4x4 &pvFloat )
+{
+  // only raw pointers are used here as this runs on worker threads
+  const Matrix4x4 *models = mModelMatrices.constData();
+  const int *indices = mUpdateIndices.constData();
+  QMatrix4x4 *mvps = mMvpOutput;
+
+  if ( mUseDoublePrecision )
+  {
+    // GOOD: using doubles - the large translations of PV and M cancel out
+    // before the result gets converted to floats
+    for ( int i = begin; i < end; ++i )
+      mvps[indices[i]] = doubleToFloatMatrix( pv * models[indices[i]] );
+
+    // Note: the virtual globes book instead does the RTC trick on MV matrix:
+    // it replaces translation of MV by the entity's center transformed to eye
+    // coordinates (MV.map(center)) - both approaches give the same result.
+  }
+  else
+  {
+    // BAD: using floating point arithmetics
+    for ( int i = begin; i < end; ++i )
+      mvps[indices[i]] = pvFloat * doubleToFloatMatrix( models[indices[i]] );
+  }
+}
+
+int TransformStore::updateMvp( const Matrix4x4 &projectionMatrix, const Matrix4x4 &viewMatrix, quint64 cameraVersion )
+{
+  const int count = mModelMatrices.count();
+  const bool cameraChanged = !mHasCameraVersion || cameraVersion != mCameraVersion;
+
+  // figure out which entities need to be updated - only those that are visible
+  // (invisible entities stay dirty, so they get updated once they become visible)
+  const Matrix4x4 pv = projectionMatrix * viewMatrix;
+  const FrustumCuller culler( pv );
+  mUpdateIndices.clear();
+  if ( cameraChanged )
+  {
+    mCullResults.resize( count );
+    culler.cullSpheres( mWorldCenterX.constData(), mWorldCenterY.constData(), mWorldCenterZ.constData(),
+                        mWorldRadii.constData(), count, mCullResults.data() );
+    for ( int i = 0; i < count; ++i )
+    {
+      setVisible( i, mCullResults[i] );
+      if ( mCullResults[i] )
+        mUpdateIndices.append( i );
+    }
+  }
+  else if ( mDirtyCount > 0 )
+  {
+    for ( int i = 0; i < count; ++i )
+    {
+      if ( mVersions[i] != mUpdatedVersions[i] )
+      {
+        const bool visible = culler.isSphereVisible( Vector3D( mWorldCenterX[i], mWorldCenterY[i], mWorldCenterZ[i] ), mWorldRadii[i] );
+        setVisible( i, visible );
+        if ( visible )
+          mUpdateIndices.append( i );
+      }
+    }
+  }
+
+  mCameraVersion = cameraVersion;
+  mHasCameraVersion = true;
+  mDirtyCount = 0;
+
+  const int n = mUpdateIndices.count();
+  if ( n == 0 )
+    return 0;
+
+  // shared for all entities
+  const QMatrix4x4 pvFloat = doubleToFloatMatrix( projectionMatrix ) * doubleToFloatMatrix( viewMatrix );
+
+  // detach (if needed) on this thread, before the workers start writing
+  mMvpOutput = mMvpMatrices.data();
+
+  if ( n <= CHUNK_SIZE )
+  {
+    calculateRange( 0, n, pv, pvFloat );
+  }
+  else
+  {
+    QVector<int> chunks;
+    for ( int begin = 0; begin < n; begin += CHUNK_SIZE )
+      chunks.append( begin );
+
+    QtConcurrent::blockingMap( chunks, [this, n, &pv, &pvFloat]( int begin )
+    {
+      calculateRange( begin, std::min( begin + CHUNK_SIZE, n ), pv, pvFloat );
+    } );
+  }
+
+  // parameters may only be touched from the main thread - each setValue()
+  // is a change notification sent to the backend, so only touch updated ones
+  for ( int index : std::as_const( mUpdateIndices ) )
+  {
+    mMvpParameters[index]->setValue( mMvpMatrices[index] );
+    mUpdatedVersions[index] = mVersions[index];
+  }
+
+  return n;
+}
@@ -0,0 +1,128 @@
+#ifndef TRANSFORMSTORE_H
+#define TRANSFORMSTORE_H
+
+#include <QVector>
+#include <QMatrix4x4>
+
+#include "matrix4x4.h"
+
+namespace Qt3DCore
+{
+  class QEntity;
+}
+
+namespace Qt3DRender
+{
+  class QParameter;
+}
+
+/**
+ * Keeps double precision model matrices of all entities in one contiguous array
+ * and updates "my_mvp" parameters of their materials in a single batched pass.
+ *
+ * The shared P*V matrix is only calculated once per update, then the per-entity
+ * products run in parallel across cores (for larger scenes). Only the final
+ * QParameter::setValue() calls happen on the calling (GUI) thread.
+ *
+ * Each model matrix has a version counter that gets incremented on change.
+ * An update only recalculates (and re-sends to the backend) parameters of entities
+ * whose model matrix changed, unless the camera has changed too.
+ *
+ * Entities may have a bounding sphere set: those outside of the view frustum
+ * get disabled (so they are not drawn) and their MVP is not calculated at all
+ * until they become visible again. Culling is done in double precision
+ * (see FrustumCuller) on all bounding spheres kept as structure-of-arrays.
+ */
+class TransformStore
+{
+  public:
+
+    /**
+     * Adds a new entity with identity model matrix. The \a paramMvp parameter
+     * will receive the entity's MVP matrix on each update. Returns index of the entity.
+     */
+    int addEntity( Qt3DRender::QParameter *paramMvp );
+
+    //! Returns number of entities in the store
+    int count() const { return mModelMatrices.count(); }
+
+    //! Returns model matrix of the entity at the given \a index
+    const Matrix4x4 &modelMatrix( int index ) const { return mModelMatrices[index]; }
+
+    //! Sets model matrix of the entity at the given \a index
+    void setModelMatrix( int index, const Matrix4x4 &matrix );
+
+    //! Multiplies model matrix of the entity at the given \a index by a translation
+    void translate( int index, const Vector3D &vector );
+
+    //! Returns version of the model matrix of the entity (incremented on each change)
+    quint64 version( int index ) const { return mVersions[index]; }
+
+    //! Sets Qt3D entity to be enabled/disabled based on visibility of the entity at the given \a index
+    void setEntity( int index, Qt3DCore::QEntity *entity );
+
+    /**
+     * Sets bounding sphere of the entity at the given \a index (in model coordinates).
+     * Entities without a bounding sphere are never culled.
+     */
+    void setBoundingSphere( int index, const Vector3D &center, double radius );
+
+    //! Returns whether the entity was inside the view frustum in the last update
+    bool isVisible( int index ) const { return mVisible[index]; }
+
+    //! Returns number of entities that were inside the view frustum in the last update
+    int visibleCount() const { return mVisibleCount; }
+
+    /**
+     * Sets whether to calculate MVP matrices in double precision (the default).
+     * Single precision is only there to demonstrate the jitter it causes.
+     */
+    void setUseDoublePrecision( bool enabled ) { mUseDoublePrecision = enabled; }
+
+    /**
+     * Returns whether a call to updateMvp() with the given camera version would
+     * have anything to do (camera or some model matrices have changed since last update)
+     */
+    bool needsUpdate( quint64 cameraVersion ) const;
+
+    /**
+     * Calculates MVP matrices of entities that need it and updates their parameters.
+     * The \a cameraVersion should change whenever projection or view matrix changes.
+     * Returns number of updated entities.
+     */
+    int updateMvp( const Matrix4x4 &projectionMatrix, const Matrix4x4 &viewMatrix, quint64 cameraVersion );
+
+  private:
+    //! Calculates MVP matrices of entities from mUpdateIndices[begin] to mUpdateIndices[end-1]
+    void calculateRange( int begin, int end, const Matrix4x4 &pv, const QMatrix4x4 &pvFloat );
+
+    //! Recalculates world bounding sphere of the entity from its model matrix and local bounds
+    void updateWorldBounds( int index );
+
+    //! Sets visibility of the entity (and enables/disables its Qt3D entity if changed)
+    void setVisible( int index, bool visible );
+
+    QVector<Matrix4x4> mModelMatrices;
+    QVector<QMatrix4x4> mMvpMatrices;  //!< Results of the last update
+    QMatrix4x4 *mMvpOutput = nullptr;  //!< Raw pointer to mMvpMatrices used while updating
+    QVector<Qt3DRender::QParameter *> mMvpParameters;
+    bool mUseDoublePrecision = true;
+
+    QVector<quint64> mVersions;          //!< Current versions of model matrices
+    QVector<quint64> mUpdatedVersions;   //!< Versions of model matrices used by the last update
+    int mDirtyCount = 0;                 //!< Number of entities with changes since last update (may overestimate)
+    quint64 mCameraVersion = 0;          //!< Camera version used by the last update
+    bool mHasCameraVersion = false;      //!< Whether there was any update yet
+    QVector<int> mUpdateIndices;         //!< Entities to be updated by the current update
+
+    // bounding spheres - local (model coordinates) and world (structure-of-arrays for culling)
+    QVector<Vector3D> mLocalCenters;
+    QVector<double> mLocalRadii;
+    QVector<double> mWorldCenterX, mWorldCenterY, mWorldCenterZ, mWorldRadii;
+    QVector<quint8> mVisible;            //!< Results of culling from the last update
+    QVector<quint8> mCullResults;        //!< Temporary array for culling results
+    int mVisibleCount = 0;
+    QVector<Qt3DCore::QEntity *> mEntities;
+};
+
+#endif // TRANSFORMSTORE_H